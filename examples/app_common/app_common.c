@@ -70,21 +70,14 @@
 #define ICE_SERVER_TYPE_TURNS                     "turns:"
 #define ICE_SERVER_TYPE_TURNS_LENGTH              ( 6 )
 
-/**
- * EMA (Exponential Moving Average) alpha value and 1-alpha value - over appx 20 samples
- */
-#define EMA_ALPHA_VALUE           ( ( double ) 0.05 )
-#define ONE_MINUS_EMA_ALPHA_VALUE ( ( double ) ( 1 - EMA_ALPHA_VALUE ) )
-
-/**
- * Calculates the EMA (Exponential Moving Average) accumulator value
- *
- * a - Accumulator value
- * v - Next sample point
- *
- * @return the new Accumulator value
- */
-#define EMA_ACCUMULATOR_GET_NEXT( a, v ) ( double )( EMA_ALPHA_VALUE * ( v ) + ONE_MINUS_EMA_ALPHA_VALUE * ( a ) )
+/* A viewer moves to the low video stream under the first bitrate and back to the high one above the second. */
+#define DEMO_VIDEO_LOW_STREAM_ENTER_KBPS          ( 600 )
+#define DEMO_VIDEO_LOW_STREAM_LEAVE_KBPS          ( 900 )
+/* The estimate of a viewer on the low stream can't grow far above that stream, so the high one is retried
+ * once the path stayed clean that long. After any switch the viewer keeps its stream for the hold time unless it overuses. */
+#define DEMO_VIDEO_HIGH_STREAM_RETRY_MS           ( 20000 )
+#define DEMO_VIDEO_HIGH_STREAM_RETRY_MAX_LOSS     ( 2 )
+#define DEMO_VIDEO_STREAM_SWITCH_HOLD_MS          ( 10000 )
 
 #ifndef MIN
 #define MIN( a, b ) ( ( ( a ) < ( b ) ) ? ( a ) : ( b ) )
@@ -125,15 +118,18 @@ static int32_t GetIceServerList( AppContext_t * pAppContext,
                                  IceControllerIceServer_t * pOutputIceServers,
                                  size_t * pOutputIceServersCount );
 #if ENABLE_TWCC_SUPPORT
-    /* Sample callback for TWCC. The average packet loss is tracked using an exponential moving average (EMA).
-       - If packet loss stays at or below 5%, the bitrate increases by 5%.
-       - If packet loss exceeds 5%, the bitrate decreases by the same percentage as the loss.
-       The bitrate is adjusted once per second, ensuring it stays within predefined limits. */
-       static void SampleSenderBandwidthEstimationHandler( void * pCustomContext,
-                                                           TwccBandwidthInfo_t * pTwccBandwidthInfo );
+static void SampleSenderBandwidthEstimationHandler( void * pCustomContext,
+                                                    TwccBandwidthInfo_t * pTwccBandwidthInfo,
+                                                    const PeerConnectionBandwidthEstimate_t * pEstimate );
+static void UpdateVideoEncoderBitrate( AppContext_t * pAppContext );
+static void UpdateTargetVideoStream( AppSession_t * pAppSession,
+                                     uint64_t videoBitrate,
+                                     const PeerConnectionBandwidthEstimate_t * pEstimate );
 #endif /* ENABLE_TWCC_SUPPORT */
 static int32_t InitializeAppSession( AppContext_t * pAppContext,
                                      AppSession_t * pAppSession );
+static void HandlePictureLossIndication( void * pCustomContext,
+                                         RtcpPliPacket_t * pRtcpPliPacket );
 static PeerConnectionResult_t HandleRxVideoFrame( void * pCustomContext,
                                                   PeerConnectionFrame_t * pFrame );
 static PeerConnectionResult_t HandleRxAudioFrame( void * pCustomContext,
@@ -306,6 +302,13 @@ static int32_t StartPeerConnectionSession( AppContext_t * pAppContext,
 
     if( ret == 0 )
     {
+        /* Every viewer starts on the high stream until its bandwidth estimate says otherwise. */
+        pAppSession->videoStream = MEDIA_FRAME_VIDEO_STREAM_HIGH;
+        pAppSession->targetVideoStream = MEDIA_FRAME_VIDEO_STREAM_HIGH;
+        pAppSession->targetVideoStreamTick = xTaskGetTickCount();
+        pAppSession->isVideoStarted = 0U;
+        pAppSession->isVideoLive = 0U;
+
         memset( &pcConfig,
                 0,
                 sizeof( PeerConnectionSessionConfiguration_t ) );
@@ -725,49 +728,121 @@ static int32_t GetIceServerList( AppContext_t * pAppContext,
 }
 
 #if ENABLE_TWCC_SUPPORT
-/* Sample callback for TWCC. The average packet loss is tracked using an exponential moving average (EMA).
-   - If packet loss stays at or below 5%, the bitrate increases by 5%.
-   - If packet loss exceeds 5%, the bitrate decreases by the same percentage as the loss.
-   The bitrate is adjusted once per second, ensuring it stays within predefined limits. */
+/* All viewers on the high stream share its encoder, so it runs at the lowest video bitrate suggested for them. */
+static void UpdateVideoEncoderBitrate( AppContext_t * pAppContext )
+{
+    PeerConnectionSession_t * pSession;
+    uint64_t videoBitrate;
+    uint64_t minVideoBitrate = UINT64_MAX;
+    int i;
+
+    for( i = 0; i < AWS_MAX_VIEWER_NUM; i++ )
+    {
+        pSession = &pAppContext->appSessions[ i ].peerConnectionSession;
+        if( ( pSession->state != PEER_CONNECTION_SESSION_STATE_CONNECTION_READY ) ||
+            ( pAppContext->appSessions[ i ].videoStream != MEDIA_FRAME_VIDEO_STREAM_HIGH ) )
+        {
+            continue;
+        }
+
+        videoBitrate = 0U;
+        if( xSemaphoreTake( pSession->twccMetaData.twccBitrateMutex,
+                            portMAX_DELAY ) == pdTRUE )
+        {
+            videoBitrate = pSession->twccMetaData.updatedVideoBitrate;
+            xSemaphoreGive( pSession->twccMetaData.twccBitrateMutex );
+        }
+
+        /* Sessions without an estimate yet don't vote. */
+        if( videoBitrate != 0U )
+        {
+            minVideoBitrate = MIN( minVideoBitrate,
+                                   videoBitrate );
+        }
+    }
+
+    if( ( minVideoBitrate != UINT64_MAX ) && ( pAppContext->pAppMediaSourcesContext != NULL ) )
+    {
+        /* The suggested video bitrate is in kbps. */
+        ( void ) AppMediaSource_SetVideoTargetBitrate( pAppContext->pAppMediaSourcesContext,
+                                                       ( uint32_t ) MIN( minVideoBitrate * 1000U, UINT32_MAX ) );
+    }
+}
+
+/* Pick the video stream the viewer should receive, the switch itself happens on the next key frame of that stream. */
+static void UpdateTargetVideoStream( AppSession_t * pAppSession,
+                                     uint64_t videoBitrate,
+                                     const PeerConnectionBandwidthEstimate_t * pEstimate )
+{
+    TickType_t nowTick = xTaskGetTickCount();
+    TickType_t elapsedTick = nowTick - pAppSession->targetVideoStreamTick;
+    uint8_t isOverusing = ( pEstimate->usage == PEER_CONNECTION_BWE_USAGE_OVERUSING ) ? 1U : 0U;
+
+    if( pAppSession->targetVideoStream == MEDIA_FRAME_VIDEO_STREAM_HIGH )
+    {
+        if( ( videoBitrate < DEMO_VIDEO_LOW_STREAM_ENTER_KBPS ) &&
+            ( ( isOverusing != 0U ) || ( elapsedTick >= pdMS_TO_TICKS( DEMO_VIDEO_STREAM_SWITCH_HOLD_MS ) ) ) )
+        {
+            pAppSession->targetVideoStream = MEDIA_FRAME_VIDEO_STREAM_LOW;
+            pAppSession->targetVideoStreamTick = nowTick;
+        }
+    }
+    else if( ( isOverusing != 0U ) || ( pEstimate->lossPercent > DEMO_VIDEO_HIGH_STREAM_RETRY_MAX_LOSS ) )
+    {
+        /* Restart the clean period. */
+        pAppSession->targetVideoStreamTick = nowTick;
+    }
+    else if( ( videoBitrate > DEMO_VIDEO_LOW_STREAM_LEAVE_KBPS ) ||
+             ( elapsedTick >= pdMS_TO_TICKS( DEMO_VIDEO_HIGH_STREAM_RETRY_MS ) ) )
+    {
+        pAppSession->targetVideoStream = MEDIA_FRAME_VIDEO_STREAM_HIGH;
+        pAppSession->targetVideoStreamTick = nowTick;
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+}
+
+/* Sample callback for TWCC. The session's delay-based estimator reports a target bitrate on every feedback,
+   audio keeps its bitrate and video gets the rest, within predefined limits. */
 static void SampleSenderBandwidthEstimationHandler( void * pCustomContext,
-                                                    TwccBandwidthInfo_t * pTwccBandwidthInfo )
+                                                    TwccBandwidthInfo_t * pTwccBandwidthInfo,
+                                                    const PeerConnectionBandwidthEstimate_t * pEstimate )
 {
     PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    AppSession_t * pAppSession = NULL;
+    PeerConnectionSession_t * pSession = NULL;
     PeerConnectionTwccMetaData_t * pTwccMetaData = NULL;
     uint64_t videoBitrate = 0;
     uint64_t audioBitrate = 0;
-    uint64_t currentTimeUs = 0;
-    uint64_t timeDifference = 0;
-    uint32_t lostPacketCount = 0;
     uint8_t isLocked = 0;
-    double percentLost = 0.0;
 
     if( ( pCustomContext == NULL ) ||
-        ( pTwccBandwidthInfo == NULL ) )
+        ( pTwccBandwidthInfo == NULL ) ||
+        ( pEstimate == NULL ) )
     {
-        LogError( ( "Invalid input, pCustomContext: %p, pTwccBandwidthInfo: %p",
-                    pCustomContext, pTwccBandwidthInfo ) );
+        LogError( ( "Invalid input, pCustomContext: %p, pTwccBandwidthInfo: %p, pEstimate: %p",
+                    pCustomContext, pTwccBandwidthInfo, pEstimate ) );
         ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
     }
 
-    // Calculate packet loss
+    // Split the target bitrate
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        pTwccMetaData = ( PeerConnectionTwccMetaData_t * ) pCustomContext;
-
-        currentTimeUs = NetworkingUtils_GetCurrentTimeUs( NULL );
-        lostPacketCount = pTwccBandwidthInfo->sentPackets - pTwccBandwidthInfo->receivedPackets;
-        percentLost = ( double ) ( ( pTwccBandwidthInfo->sentPackets > 0 ) ? ( ( double ) ( lostPacketCount * 100 ) / ( double )pTwccBandwidthInfo->sentPackets ) : 0.0 );
-        timeDifference = currentTimeUs - pTwccMetaData->lastAdjustmentTimeUs;
+        pAppSession = ( AppSession_t * ) pCustomContext;
+        pSession = &pAppSession->peerConnectionSession;
+        pTwccMetaData = &pSession->twccMetaData;
 
-        pTwccMetaData->averagePacketLoss = EMA_ACCUMULATOR_GET_NEXT( pTwccMetaData->averagePacketLoss,
-                                                                     ( ( double ) percentLost ) );
+        audioBitrate = ( pTwccMetaData->currentAudioBitrate != 0 ) ? pTwccMetaData->currentAudioBitrate : PEER_CONNECTION_MIN_AUDIO_BITRATE_BPS;
+        audioBitrate = MIN( MAX( audioBitrate,
+                                 PEER_CONNECTION_MIN_AUDIO_BITRATE_BPS ),
+                            PEER_CONNECTION_MAX_AUDIO_BITRATE_BPS );
 
-        if( timeDifference < PEER_CONNECTION_TWCC_BITRATE_ADJUSTMENT_INTERVAL_US )
-        {
-            // Too soon for another adjustment
-            ret = PEER_CONNECTION_RESULT_FAIL_RTCP_TWCC_INIT;
-        }
+        videoBitrate = ( pEstimate->targetBitrate > audioBitrate ) ? ( ( pEstimate->targetBitrate - audioBitrate ) / 1000U ) : 0U;
+        videoBitrate = MIN( MAX( videoBitrate,
+                                 PEER_CONNECTION_MIN_VIDEO_BITRATE_KBPS ),
+                            PEER_CONNECTION_MAX_VIDEO_BITRATE_KBPS );
     }
 
     if( ret == PEER_CONNECTION_RESULT_OK )
@@ -786,47 +861,56 @@ static void SampleSenderBandwidthEstimationHandler( void * pCustomContext,
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        videoBitrate = pTwccMetaData->currentVideoBitrate;
-        audioBitrate = pTwccMetaData->currentAudioBitrate;
-
-        if( pTwccMetaData->averagePacketLoss <= 5 )
-        {
-            // Increase encoder bitrates by 5 percent with cap at MAX_BITRATE
-            videoBitrate = ( uint64_t ) MIN( videoBitrate * 1.05,
-                                             PEER_CONNECTION_MAX_VIDEO_BITRATE_KBPS );
-            audioBitrate = ( uint64_t ) MIN( audioBitrate * 1.05,
-                                             PEER_CONNECTION_MAX_AUDIO_BITRATE_BPS );
-        }
-        else
-        {
-            // Decrease encoder bitrate by average packet loss percent, with a cap at MIN_BITRATE
-            videoBitrate = ( uint64_t ) MAX( videoBitrate * ( 1.0 - ( pTwccMetaData->averagePacketLoss / 100.0 ) ),
-                                             PEER_CONNECTION_MIN_VIDEO_BITRATE_KBPS );
-            audioBitrate = ( uint64_t ) MAX( audioBitrate * ( 1.0 - ( pTwccMetaData->averagePacketLoss / 100.0 ) ),
-                                             PEER_CONNECTION_MIN_AUDIO_BITRATE_BPS );
-        }
-
         pTwccMetaData->updatedVideoBitrate = videoBitrate;
         pTwccMetaData->updatedAudioBitrate = audioBitrate;
+
+        UpdateTargetVideoStream( pAppSession,
+                                 videoBitrate,
+                                 pEstimate );
     }
 
     if( isLocked != 0 )
     {
         xSemaphoreGive( pTwccMetaData->twccBitrateMutex );
-
     }
+
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        pTwccMetaData->lastAdjustmentTimeUs = currentTimeUs;
+        /* Let the pacer follow the estimate, the video bitrate is in kbps. */
+        ( void ) PeerConnection_SetVideoPacingBitrate( pSession,
+                                                       ( uint32_t ) MIN( videoBitrate * 1000U, UINT32_MAX ) );
 
-        LogInfo( ( "Adjusted made : average packet loss = %.2f%%, timeDifference = %llu us", pTwccMetaData->averagePacketLoss, timeDifference  ) );
-        LogInfo( ( "Suggested video bitrate: %llu kbps, suggested audio bitrate: %llu bps, sent: %llu bytes, %llu packets,   received: %llu bytes, %llu packets, in %llu msec ",
-                   videoBitrate, audioBitrate, pTwccBandwidthInfo->sentBytes, pTwccBandwidthInfo->sentPackets, pTwccBandwidthInfo->receivedBytes, pTwccBandwidthInfo->receivedPackets, pTwccBandwidthInfo->duration / 10000ULL ) );
-    }
+        LogDebug( ( "Target bitrate: %lu bps, acked: %lu bps, loss: %lu%%, usage: %d, suggested video bitrate: %llu kbps, audio bitrate: %llu bps",
+                    pEstimate->targetBitrate, pEstimate->ackedBitrate, pEstimate->lossPercent, pEstimate->usage, videoBitrate, audioBitrate ) );
 
+        UpdateVideoEncoderBitrate( pAppSession->pAppContext );
+    }
 }
 #endif
 
+/* PLI and FIR of every viewer go to the key frame arbiter of the stream the viewer receives. */
+static void HandlePictureLossIndication( void * pCustomContext,
+                                         RtcpPliPacket_t * pRtcpPliPacket )
+{
+    AppSession_t * pAppSession = ( AppSession_t * ) pCustomContext;
+
+    ( void ) pRtcpPliPacket;
+
+    if( ( pAppSession == NULL ) || ( pAppSession->pAppContext == NULL ) )
+    {
+        LogError( ( "Invalid input, pAppSession: %p", pAppSession ) );
+    }
+    else if( pAppSession->pAppContext->pAppMediaSourcesContext != NULL )
+    {
+        ( void ) AppMediaSource_RequestKeyFrame( pAppSession->pAppContext->pAppMediaSourcesContext,
+                                                 pAppSession->videoStream );
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+}
+
 static int32_t InitializeAppSession( AppContext_t * pAppContext,
                                      AppSession_t * pAppSession )
 {
@@ -854,7 +938,7 @@ static int32_t InitializeAppSession( AppContext_t * pAppContext,
         /* In case you want to set a different callback based on your business logic, you could replace SampleSenderBandwidthEstimationHandler() with your Handler. */
         peerConnectionResult = PeerConnection_SetSenderBandwidthEstimationCallback( &pAppSession->peerConnectionSession,
                                                                                     SampleSenderBandwidthEstimationHandler,
-                                                                                    &pAppSession->peerConnectionSession.twccMetaData );
+                                                                                    pAppSession );
         if( peerConnectionResult != PEER_CONNECTION_RESULT_OK )
         {
             LogError( ( "Fail to set Sender Bandwidth Estimation Callback, result: %d", peerConnectionResult ) );
@@ -863,9 +947,22 @@ static int32_t InitializeAppSession( AppContext_t * pAppContext,
     }
 #endif /* ENABLE_TWCC_SUPPORT */
 
+    if( ret == 0 )
+    {
+        peerConnectionResult = PeerConnection_SetPictureLossIndicationCallback( &pAppSession->peerConnectionSession,
+                                                                                HandlePictureLossIndication,
+                                                                                pAppSession );
+        if( peerConnectionResult != PEER_CONNECTION_RESULT_OK )
+        {
+            LogError( ( "Fail to set picture loss indication callback, result: %d", peerConnectionResult ) );
+            ret = -1;
+        }
+    }
+
     if( ret == 0 )
     {
         pAppSession->pSignalingControllerContext = &( pAppContext->signalingControllerContext );
+        pAppSession->pAppContext = pAppContext;
     }
 
     return ret;
@@ -1752,6 +1849,35 @@ void AppCommon_WaitSignalingControllerStop( AppContext_t * pAppContext )
     }
 }
 
+uint8_t AppCommon_IsVideoFrameForSession( AppSession_t * pAppSession,
+                                          const MediaFrame_t * pFrame )
+{
+    uint8_t isForSession = 0U;
+
+    if( ( pAppSession == NULL ) || ( pFrame == NULL ) )
+    {
+        LogError( ( "Invalid input, pAppSession: %p, pFrame: %p", pAppSession, pFrame ) );
+    }
+    else
+    {
+        /* Switching streams in the middle of a GOP would leave the decoder without a reference,
+         * so wait for a key frame on the target stream. */
+        if( ( pFrame->videoStream != pAppSession->videoStream ) &&
+            ( pFrame->videoStream == pAppSession->targetVideoStream ) &&
+            ( pFrame->isKeyFrame != 0U ) )
+        {
+            LogInfo( ( "Switch video stream %u -> %u for client ID: %.*s",
+                       pAppSession->videoStream, pFrame->videoStream,
+                       ( int ) pAppSession->remoteClientIdLength, pAppSession->remoteClientId ) );
+            pAppSession->videoStream = pFrame->videoStream;
+        }
+
+        isForSession = ( pFrame->videoStream == pAppSession->videoStream ) ? 1U : 0U;
+    }
+
+    return isForSession;
+}
+
 AppSession_t * AppCommon_GetPeerConnectionSession( AppContext_t * pAppContext,
                                                    const char * pRemoteClientId,
                                                    size_t remoteClientIdLength )
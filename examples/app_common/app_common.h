@@ -27,6 +27,7 @@
 #include "sdp_controller.h"
 #include "signaling_controller.h"
 #include "peer_connection.h"
+#include "app_media_source_port.h"
 
 #define DEMO_SDP_BUFFER_MAX_LENGTH ( 10000 )
 #define DEMO_TRANSCEIVER_MEDIA_INDEX_VIDEO ( 0 )
@@ -35,6 +36,7 @@
 
 struct AppMediaSourcesContext;
 typedef struct AppMediaSourcesContext AppMediaSourcesContext_t;
+struct AppContext;
 
 typedef int32_t ( * InitTransceiverFunc_t )( void * pCtx,
                                              TransceiverTrackKind_t trackKind,
@@ -55,6 +57,18 @@ typedef struct AppSession
 
     /* Initialized signaling controller. */
     SignalingControllerContext_t * pSignalingControllerContext;
+
+    /* The app context owning this session. */
+    struct AppContext * pAppContext;
+
+    /* MEDIA_FRAME_VIDEO_STREAM_* sent to the viewer, it only moves to the target stream on an IDR. */
+    uint8_t videoStream;
+    uint8_t targetVideoStream;
+    TickType_t targetVideoStreamTick;
+    /* Cleared for a new viewer, which gets the cached GOP before the live video. */
+    uint8_t isVideoStarted;
+    /* Set once the cached GOP is sent, the media sink hook only sends live video from then on. */
+    volatile uint8_t isVideoLive;
 } AppSession_t;
 
 typedef struct AppContext
@@ -90,5 +104,8 @@ void AppCommon_WaitSignalingControllerStop( AppContext_t * pAppContext );
 AppSession_t * AppCommon_GetPeerConnectionSession( AppContext_t * pAppContext,
                                                    const char * pRemoteClientId,
                                                    size_t remoteClientIdLength );
+/* Return 1 if the video frame belongs to the stream the session is receiving, switching streams on key frames. */
+uint8_t AppCommon_IsVideoFrameForSession( AppSession_t * pAppSession,
+                                          const MediaFrame_t * pFrame );
 
 #endif /* APP_COMMON_H */
@@ -23,6 +23,9 @@
 #include "FreeRTOS.h"
 #include "task.h"
 #include "app_media_source.h"
+#if METRIC_PRINT_ENABLED
+#include "metric.h"
+#endif
 
 #define DEFAULT_TRANSCEIVER_ROLLING_BUFFER_DURACTION_SECOND ( 3 )
 
@@ -45,10 +48,417 @@
 #define DEMO_TRANSCEIVER_MAX_TX_QUEUE_MSG_NUM ( 10 )
 #define DEMO_TRANSCEIVER_MAX_RX_QUEUE_MSG_NUM ( 10 )
 
+/* The encoder bitrate follows the target once it moves by more than this percentage. */
+#define APP_MEDIA_SOURCE_VIDEO_BITRATE_HYSTERESIS_PERCENT ( 10 )
+/* Minimum time between two bitrate increases, decreases are never delayed. */
+#define APP_MEDIA_SOURCE_VIDEO_BITRATE_UP_HOLD_MS ( 2000 )
+/* Stepping up a level needs this much headroom above its minimum bitrate for the hold time. */
+#define APP_MEDIA_SOURCE_VIDEO_LEVEL_UP_HEADROOM_PERCENT ( 20 )
+#define APP_MEDIA_SOURCE_VIDEO_LEVEL_UP_HOLD_MS ( 5000 )
+
+/* Key frame requests arriving within the window share one IDR. */
+#define APP_MEDIA_SOURCE_KEY_FRAME_COALESCE_WINDOW_MS ( 100 )
+/* Minimum time between two forced IDRs on a stream. */
+#define APP_MEDIA_SOURCE_KEY_FRAME_MIN_INTERVAL_MS ( 1000 )
+
+/* The reference count of a frame owning its data is kept in front of it, 8 bytes keep the data aligned. */
+#define APP_MEDIA_SOURCE_FRAME_DATA_OFFSET ( 8 )
+
+/* A gap this long between frames means the stream was stopped, the cached GOP is stale. */
+#define APP_MEDIA_SOURCE_GOP_CACHE_MAX_GAP_US ( 1000000 )
+/* Frames the GOP cache array holds at first, it doubles when a GOP has more. */
+#define APP_MEDIA_SOURCE_GOP_CACHE_INITIAL_FRAMES ( 32 )
+
+typedef struct AppMediaSourceVideoLevel
+{
+    uint32_t minBitrate;
+    uint32_t width;
+    uint32_t height;
+    uint32_t fps;
+} AppMediaSourceVideoLevel_t;
+
+/* Ordered from the best level, the last one is used whatever the bitrate. */
+static const AppMediaSourceVideoLevel_t videoLevels[] = {
+    { 900000U, 1280U, 720U, 30U },
+    { 500000U, 1280U, 720U, 15U },
+    { 250000U, 640U, 360U, 15U },
+    { 0U, 640U, 360U, 10U },
+};
+
 static void VideoTx_Task( void * pParameter );
 static void AudioTx_Task( void * pParameter );
 static int32_t OnFrameReadyToSend( void * pCtx,
                                    MediaFrame_t * pFrame );
+static void ReleaseFrameData( MediaFrame_t * pFrame );
+static void AttachFrameRefCount( MediaFrame_t * pFrame );
+static int32_t ApplyVideoLevel( size_t level,
+                                size_t nextLevel );
+static void SetVideoTargetLevel( AppMediaSourcesContext_t * pCtx,
+                                 size_t level );
+static void VideoEncoder_Task( void * pParameter );
+static void ResetVideoEncoder( AppMediaSourcesContext_t * pCtx );
+static void ArbitrateKeyFrame( AppMediaSourcesContext_t * pCtx,
+                               const MediaFrame_t * pFrame );
+static void ClearGopCache( AppMediaSourceGopCache_t * pCache );
+static int32_t GrowGopCache( AppMediaSourceGopCache_t * pCache );
+static void ResetGopCaches( AppMediaSourcesContext_t * pCtx );
+static void UpdateGopCache( AppMediaSourcesContext_t * pCtx,
+                            const MediaFrame_t * pFrame );
+static void EndGopCacheFrame( AppMediaSourcesContext_t * pCtx,
+                              const MediaFrame_t * pFrame );
+
+static void ReleaseFrameData( MediaFrame_t * pFrame )
+{
+    if( pFrame->onFrameReleaseFunc != NULL )
+    {
+        /* The frame data is owned by the media port, hand it back. */
+        pFrame->onFrameReleaseFunc( pFrame->pOnFrameReleaseCustomContext );
+    }
+    else if( pFrame->freeData )
+    {
+        AppMediaSource_FreeFrameData( pFrame->pData );
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+}
+
+static void AttachFrameRefCount( MediaFrame_t * pFrame )
+{
+    if( pFrame->freeData )
+    {
+        pFrame->pRefCount = ( uint32_t * )( pFrame->pData - APP_MEDIA_SOURCE_FRAME_DATA_OFFSET );
+    }
+
+    /* The reference held by the queue that the frame is about to enter. A lent buffer
+     * without a reference count from its port can't be shared. */
+    if( pFrame->pRefCount != NULL )
+    {
+        *pFrame->pRefCount = 1U;
+    }
+}
+
+static int32_t ApplyVideoLevel( size_t level,
+                                size_t nextLevel )
+{
+    int32_t ret = 0;
+    const AppMediaSourceVideoLevel_t * pCurrent = &videoLevels[ level ];
+    const AppMediaSourceVideoLevel_t * pNext = &videoLevels[ nextLevel ];
+
+    if( ( pCurrent->width != pNext->width ) || ( pCurrent->height != pNext->height ) )
+    {
+        ret = AppMediaSourcePort_SetVideoResolution( pNext->width,
+                                                     pNext->height );
+    }
+
+    if( ( ret == 0 ) && ( pCurrent->fps != pNext->fps ) )
+    {
+        ret = AppMediaSourcePort_SetVideoFrameRate( pNext->fps );
+    }
+
+    if( ret == 0 )
+    {
+        LogInfo( ( "Video encoder level %u -> %u, %lux%lu@%lu",
+                   ( unsigned int ) level, ( unsigned int ) nextLevel, pNext->width, pNext->height, pNext->fps ) );
+    }
+
+    return ret;
+}
+
+/* Must be called with mediaMutex held. */
+static void SetVideoTargetLevel( AppMediaSourcesContext_t * pCtx,
+                                 size_t level )
+{
+    pCtx->videoEncoder.isLevelUpPending = 0U;
+
+    if( pCtx->videoEncoder.targetLevel != level )
+    {
+        pCtx->videoEncoder.targetLevel = level;
+        ( void ) xSemaphoreGive( pCtx->videoEncoderSemaphore );
+    }
+}
+
+/* Changing the resolution restarts the encoder and every encoder control is too slow for the task
+ * reporting the estimates, which is the socket listener. */
+static void VideoEncoder_Task( void * pParameter )
+{
+    AppMediaSourcesContext_t * pCtx = ( AppMediaSourcesContext_t * )pParameter;
+    AppMediaSourceVideoEncoder_t * pEncoder = &pCtx->videoEncoder;
+    size_t level = 0U;
+    size_t targetLevel = 0U;
+    uint32_t bitrate = 0U;
+    uint32_t targetBitrate = 0U;
+
+    for( ;; )
+    {
+        if( xSemaphoreTake( pCtx->videoEncoderSemaphore,
+                            portMAX_DELAY ) != pdTRUE )
+        {
+            continue;
+        }
+
+        if( xSemaphoreTake( pCtx->mediaMutex,
+                            portMAX_DELAY ) == pdTRUE )
+        {
+            level = pEncoder->level;
+            targetLevel = pEncoder->targetLevel;
+            bitrate = pEncoder->bitrate;
+            targetBitrate = pEncoder->targetBitrate;
+            xSemaphoreGive( pCtx->mediaMutex );
+        }
+
+        /* The level and the bitrate in use only change here, so the encoder is updated without holding mediaMutex. */
+        if( level != targetLevel )
+        {
+            if( ApplyVideoLevel( level,
+                                 targetLevel ) == 0 )
+            {
+                level = targetLevel;
+            }
+            else
+            {
+                LogWarn( ( "Fail to apply video encoder level %u", ( unsigned int ) targetLevel ) );
+            }
+        }
+
+        if( ( targetBitrate != 0U ) && ( bitrate != targetBitrate ) )
+        {
+            if( AppMediaSourcePort_SetVideoBitrate( targetBitrate ) == 0 )
+            {
+                LogDebug( ( "Video encoder bitrate %lu -> %lu bps", bitrate, targetBitrate ) );
+                bitrate = targetBitrate;
+            }
+            else
+            {
+                LogWarn( ( "Fail to apply video encoder bitrate %lu", targetBitrate ) );
+            }
+        }
+
+        if( xSemaphoreTake( pCtx->mediaMutex,
+                            portMAX_DELAY ) == pdTRUE )
+        {
+            pEncoder->level = level;
+            if( pEncoder->targetLevel == targetLevel )
+            {
+                /* Let the next estimate decide again from the level in use. */
+                pEncoder->targetLevel = level;
+            }
+
+            /* A reset while the encoder was updated leaves the bitrate to the next estimate. */
+            pEncoder->bitrate = ( pEncoder->targetBitrate != 0U ) ? bitrate : 0U;
+            if( pEncoder->targetBitrate == targetBitrate )
+            {
+                pEncoder->targetBitrate = pEncoder->bitrate;
+            }
+            xSemaphoreGive( pCtx->mediaMutex );
+        }
+    }
+}
+
+/* Must be called with mediaMutex held. */
+static void ResetVideoEncoder( AppMediaSourcesContext_t * pCtx )
+{
+    /* Leave the best level for the next viewer, the bitrate follows its first estimate. */
+    SetVideoTargetLevel( pCtx,
+                         0U );
+
+    pCtx->videoEncoder.bitrate = 0U;
+    pCtx->videoEncoder.targetBitrate = 0U;
+}
+
+/* Called for every video frame before it's sent, answers the pending request or forces an IDR once allowed. */
+static void ArbitrateKeyFrame( AppMediaSourcesContext_t * pCtx,
+                               const MediaFrame_t * pFrame )
+{
+    AppMediaSourceKeyFrameArbiter_t * pArbiter;
+    TickType_t nowTick;
+
+    /* Peek without the lock first, requests are rare compared to frames. */
+    if( ( pFrame->videoStream < MEDIA_FRAME_VIDEO_STREAM_COUNT ) &&
+        ( pCtx->keyFrameArbiters[ pFrame->videoStream ].isPending != 0U ) &&
+        ( xSemaphoreTake( pCtx->mediaMutex,
+                          portMAX_DELAY ) == pdTRUE ) )
+    {
+        pArbiter = &pCtx->keyFrameArbiters[ pFrame->videoStream ];
+        nowTick = xTaskGetTickCount();
+
+        if( pArbiter->isPending == 0U )
+        {
+            /* Nothing to do. */
+        }
+        else if( pFrame->isKeyFrame != 0U )
+        {
+            if( pArbiter->isForced == 0U )
+            {
+                pArbiter->stats.satisfiedByGop++;
+                #if METRIC_PRINT_ENABLED
+                Metric_IncreaseCounter( METRIC_COUNTER_KEY_FRAME_SATISFIED_BY_GOP, 1U );
+                #endif
+            }
+            pArbiter->isPending = 0U;
+            pArbiter->isForced = 0U;
+        }
+        else if( ( ( nowTick - pArbiter->pendingStartTick ) >= pdMS_TO_TICKS( APP_MEDIA_SOURCE_KEY_FRAME_COALESCE_WINDOW_MS ) ) &&
+                 ( ( pArbiter->hasForcedBefore == 0U ) ||
+                   ( ( nowTick - pArbiter->lastForcedTick ) >= pdMS_TO_TICKS( APP_MEDIA_SOURCE_KEY_FRAME_MIN_INTERVAL_MS ) ) ) )
+        {
+            /* Also retries an IDR that never showed up, e.g. dropped on a full queue. */
+            if( AppMediaSourcePort_ForceVideoKeyFrame( pFrame->videoStream ) == 0 )
+            {
+                pArbiter->isForced = 1U;
+                pArbiter->hasForcedBefore = 1U;
+                pArbiter->lastForcedTick = nowTick;
+                pArbiter->stats.issued++;
+                #if METRIC_PRINT_ENABLED
+                Metric_IncreaseCounter( METRIC_COUNTER_KEY_FRAME_ISSUED, 1U );
+                #endif
+                LogDebug( ( "Force key frame on video stream %u, requested: %lu, issued: %lu, satisfied by GOP: %lu",
+                            pFrame->videoStream, pArbiter->stats.requested, pArbiter->stats.issued, pArbiter->stats.satisfiedByGop ) );
+            }
+        }
+        else
+        {
+            /* Empty else marker. */
+        }
+
+        xSemaphoreGive( pCtx->mediaMutex );
+    }
+}
+
+static void ClearGopCache( AppMediaSourceGopCache_t * pCache )
+{
+    size_t i;
+
+    for( i = 0; i < pCache->frameCount; i++ )
+    {
+        AppMediaSource_ReleaseFrame( &pCache->pFrames[ i ] );
+    }
+
+    pCache->frameCount = 0U;
+    pCache->totalBytes = 0U;
+    pCache->isTruncated = 0U;
+    pCache->gopId++;
+}
+
+/* Drop the cached frames once the port stops, the next viewer starts from a new key frame anyway. */
+static void ResetGopCaches( AppMediaSourcesContext_t * pCtx )
+{
+    size_t i;
+
+    if( xSemaphoreTake( pCtx->gopCacheMutex,
+                        portMAX_DELAY ) == pdTRUE )
+    {
+        for( i = 0; i < MEDIA_FRAME_VIDEO_STREAM_COUNT; i++ )
+        {
+            ClearGopCache( &pCtx->gopCaches[ i ] );
+        }
+
+        xSemaphoreGive( pCtx->gopCacheMutex );
+    }
+    else
+    {
+        LogError( ( "Failed to lock GOP cache mutex." ) );
+    }
+}
+
+static int32_t GrowGopCache( AppMediaSourceGopCache_t * pCache )
+{
+    int32_t ret = 0;
+    MediaFrame_t * pFrames;
+    size_t frameCapacity;
+
+    frameCapacity = ( pCache->frameCapacity == 0U ) ? APP_MEDIA_SOURCE_GOP_CACHE_INITIAL_FRAMES : pCache->frameCapacity * 2U;
+    pFrames = ( MediaFrame_t * ) pvPortMalloc( frameCapacity * sizeof( MediaFrame_t ) );
+    if( pFrames == NULL )
+    {
+        LogWarn( ( "Fail to grow GOP cache to %u frames", ( unsigned int ) frameCapacity ) );
+        ret = -1;
+    }
+    else
+    {
+        if( pCache->pFrames != NULL )
+        {
+            memcpy( pFrames,
+                    pCache->pFrames,
+                    pCache->frameCount * sizeof( MediaFrame_t ) );
+            vPortFree( pCache->pFrames );
+        }
+
+        pCache->pFrames = pFrames;
+        pCache->frameCapacity = frameCapacity;
+    }
+
+    return ret;
+}
+
+/* Keep a reference to the frame if it belongs to the GOP being cached. A buffer lent by the encoder
+ * can't be held, it goes back as soon as the frame is packetized. Copying every lent frame would undo
+ * the zero-copy path, so their GOP isn't cached and new viewers get a key frame requested instead. */
+static void UpdateGopCache( AppMediaSourcesContext_t * pCtx,
+                            const MediaFrame_t * pFrame )
+{
+    AppMediaSourceGopCache_t * pCache;
+    MediaFrame_t * pCached;
+
+    if( ( pFrame->videoStream < MEDIA_FRAME_VIDEO_STREAM_COUNT ) &&
+        ( xSemaphoreTake( pCtx->gopCacheMutex,
+                          portMAX_DELAY ) == pdTRUE ) )
+    {
+        pCache = &pCtx->gopCaches[ pFrame->videoStream ];
+        pCache->isFrameInSink = 1U;
+
+        if( ( pFrame->isKeyFrame != 0U ) ||
+            ( ( pCache->frameCount > 0U ) &&
+              ( pFrame->timestampUs > pCache->pFrames[ pCache->frameCount - 1U ].timestampUs + APP_MEDIA_SOURCE_GOP_CACHE_MAX_GAP_US ) ) )
+        {
+            ClearGopCache( pCache );
+        }
+
+        if( ( ( pFrame->isKeyFrame != 0U ) || ( pCache->frameCount > 0U ) ) &&
+            ( pCache->isTruncated == 0U ) )
+        {
+            if( ( pCache->totalBytes + pFrame->size > APP_MEDIA_SOURCE_GOP_CACHE_MAX_BYTES ) ||
+                ( ( pCache->frameCount == pCache->frameCapacity ) &&
+                  ( GrowGopCache( pCache ) != 0 ) ) )
+            {
+                pCache->isTruncated = 1U;
+            }
+            else if( ( pFrame->pRefCount != NULL ) && ( pFrame->onFrameReleaseFunc == NULL ) )
+            {
+                /* The frame owns its data, share it. */
+                pCached = &pCache->pFrames[ pCache->frameCount ];
+                memcpy( pCached,
+                        pFrame,
+                        sizeof( MediaFrame_t ) );
+                ( void ) AppMediaSource_AcquireFrame( pCached );
+                pCache->frameCount++;
+                pCache->totalBytes += pFrame->size;
+            }
+            else
+            {
+                /* A lent buffer, nothing of this GOP is kept. */
+                ClearGopCache( pCache );
+                pCache->isTruncated = 1U;
+            }
+        }
+
+        xSemaphoreGive( pCtx->gopCacheMutex );
+    }
+}
+
+/* The media sink hook is done with the frame, a viewer catching up may go live now. */
+static void EndGopCacheFrame( AppMediaSourcesContext_t * pCtx,
+                              const MediaFrame_t * pFrame )
+{
+    if( ( pFrame->videoStream < MEDIA_FRAME_VIDEO_STREAM_COUNT ) &&
+        ( xSemaphoreTake( pCtx->gopCacheMutex,
+                          portMAX_DELAY ) == pdTRUE ) )
+    {
+        pCtx->gopCaches[ pFrame->videoStream ].isFrameInSink = 0U;
+        xSemaphoreGive( pCtx->gopCacheMutex );
+    }
+}
 
 static void VideoTx_Task( void * pParameter )
 {
@@ -80,16 +490,20 @@ static void VideoTx_Task( void * pParameter )
                 /* Received a media frame. */
                 LogVerbose( ( "Video Tx frame(%ld), trackKind: %d, timestamp: %llu, payload: 0x%x 0x%x 0x%x 0x%x", frame.size, frame.trackKind, frame.timestampUs, frame.pData[0], frame.pData[1], frame.pData[2], frame.pData[3] ) );
 
+                ArbitrateKeyFrame( pVideoContext->pSourcesContext,
+                                   &frame );
+                UpdateGopCache( pVideoContext->pSourcesContext,
+                                &frame );
+
                 if( pVideoContext->pSourcesContext->onMediaSinkHookFunc )
                 {
                     ( void ) pVideoContext->pSourcesContext->onMediaSinkHookFunc( pVideoContext->pSourcesContext->pOnMediaSinkHookCustom,
                                                                                   &frame );
                 }
 
-                if( frame.freeData )
-                {
-                    vPortFree( frame.pData );
-                }
+                EndGopCacheFrame( pVideoContext->pSourcesContext,
+                                  &frame );
+                AppMediaSource_ReleaseFrame( &frame );
             }
             else
             {
@@ -139,10 +553,8 @@ static void AudioTx_Task( void * pParameter )
                     ( void ) pAudioContext->pSourcesContext->onMediaSinkHookFunc( pAudioContext->pSourcesContext->pOnMediaSinkHookCustom,
                                                                                   &frame );
                 }
-                if( frame.freeData )
-                {
-                    vPortFree( frame.pData );
-                }
+
+                AppMediaSource_ReleaseFrame( &frame );
             }
             else
             {
@@ -189,10 +601,7 @@ static void AudioTx_Task( void * pParameter )
 
                     AppMediaSourcePort_PlayAudioFrame( &frame );
 
-                    if( frame.freeData )
-                    {
-                        vPortFree( frame.pData );
-                    }
+                    AppMediaSource_ReleaseFrame( &frame );
                 }
                 else
                 {
@@ -277,6 +686,8 @@ static int32_t OnPcEventRemotePeerClosed( AppMediaSourceContext_t * pMediaSource
             {
                 /* Stop media transmission. */
                 AppMediaSourcePort_Stop();
+                ResetVideoEncoder( pMediaSource->pSourcesContext );
+                ResetGopCaches( pMediaSource->pSourcesContext );
             }
 
             /* We have finished accessing the shared resource.  Release the mutex. */
@@ -406,12 +817,12 @@ static int32_t InitializeAudioSource( AppMediaSourceContext_t * pAudioSource )
 
     if( ret == 0 )
     {
-        /* Create task for audio Tx. */
+        /* Create task for audio Tx, above video Tx so a frame never waits for a whole video frame to be sent. */
         if( xTaskCreate( AudioTx_Task,
                          ( ( const char * )"AudioTxTask" ),
                          2048,
                          pAudioSource,
-                         tskIDLE_PRIORITY + 1,
+                         tskIDLE_PRIORITY + 3,
                          NULL ) != pdPASS )
         {
             LogError( ( "xTaskCreate(AudioTxTask) failed" ) );
@@ -478,21 +889,20 @@ static int32_t OnFrameReadyToSend( void * pCtx,
                                         &dropFrame,
                                         &dropFrameSize );
 
-            if( dropFrame.freeData )
-            {
-                vPortFree( dropFrame.pData );
-            }
+            AppMediaSource_ReleaseFrame( &dropFrame );
         }
     }
 
     if( ret == 0 )
     {
+        AttachFrameRefCount( pFrame );
         retMessageQueue = MessageQueue_Send( &pMediaSource->dataTxQueue,
                                              pFrame,
                                              sizeof( MediaFrame_t ) );
         if( retMessageQueue != MESSAGE_QUEUE_RESULT_OK )
         {
             LogError( ( "Fail to send frame ready message to queue, error: %d", retMessageQueue ) );
+            AppMediaSource_ReleaseFrame( pFrame );
             ret = -1;
         }
     }
@@ -520,13 +930,39 @@ int32_t AppMediaSource_Init( AppMediaSourcesContext_t * pCtx,
 
         /* Mutex can only be created in executing scheduler. */
         pCtx->mediaMutex = xSemaphoreCreateMutex();
-        if( pCtx->mediaMutex == NULL )
+        pCtx->gopCacheMutex = xSemaphoreCreateMutex();
+        if( ( pCtx->mediaMutex == NULL ) || ( pCtx->gopCacheMutex == NULL ) )
         {
             LogError( ( "Fail to create mutex for media source." ) );
             ret = -1;
         }
     }
 
+    if( ret == 0 )
+    {
+        pCtx->videoEncoderSemaphore = xSemaphoreCreateBinary();
+        if( pCtx->videoEncoderSemaphore == NULL )
+        {
+            LogError( ( "Fail to create video encoder semaphore." ) );
+            ret = -1;
+        }
+    }
+
+    if( ret == 0 )
+    {
+        /* Create task for video encoder changes. */
+        if( xTaskCreate( VideoEncoder_Task,
+                         ( ( const char * )"VideoEncoderTask" ),
+                         1024,
+                         pCtx,
+                         tskIDLE_PRIORITY + 1,
+                         NULL ) != pdPASS )
+        {
+            LogError( ( "xTaskCreate(VideoEncoderTask) failed" ) );
+            ret = -1;
+        }
+    }
+
     if( ret == 0 )
     {
         pCtx->videoContext.pSourcesContext = pCtx;
@@ -700,10 +1136,7 @@ int32_t AppMediaSource_RecvFrame( AppMediaSourcesContext_t * pCtx,
                                             &frame,
                                             &frameSize );
 
-                if( frame.freeData )
-                {
-                    vPortFree( frame.pData );
-                }
+                AppMediaSource_ReleaseFrame( &frame );
             }
             else if( retMessageQueue != MESSAGE_QUEUE_RESULT_MQ_IS_NOT_FULL )
             {
@@ -719,7 +1152,10 @@ int32_t AppMediaSource_RecvFrame( AppMediaSourcesContext_t * pCtx,
         if( ret == 0 )
         {
             /* Allocate memory and handle frame in port layer. */
-            frame.pData = pvPortMalloc( pFrame->size );
+            memset( &frame,
+                    0,
+                    sizeof( MediaFrame_t ) );
+            frame.pData = AppMediaSource_AllocateFrameData( pFrame->size );
             if( frame.pData == NULL )
             {
                 LogError( ( "Fail to allocate memory for Rx audio frame." ) );
@@ -732,6 +1168,8 @@ int32_t AppMediaSource_RecvFrame( AppMediaSourcesContext_t * pCtx,
                 frame.size = pFrame->size;
                 frame.timestampUs = pFrame->timestampUs;
                 frame.trackKind = pFrame->trackKind;
+
+                AttachFrameRefCount( &frame );
             }
         }
 
@@ -745,13 +1183,346 @@ int32_t AppMediaSource_RecvFrame( AppMediaSourcesContext_t * pCtx,
                 LogError( ( "Fail to send frame ready message to queue, error: %d", retMessageQueue ) );
                 ret = -1;
 
-                if( frame.freeData )
+                AppMediaSource_ReleaseFrame( &frame );
+            }
+        }
+    #endif /* ifdef ENABLE_STREAMING_LOOPBACK */
+
+    return ret;
+}
+
+int32_t AppMediaSource_SetVideoTargetBitrate( AppMediaSourcesContext_t * pCtx,
+                                              uint32_t bitrate )
+{
+    int32_t ret = 0;
+    uint8_t isLocked = 0U;
+    AppMediaSourceVideoEncoder_t * pEncoder;
+    TickType_t nowTick = xTaskGetTickCount();
+    size_t level;
+    uint64_t threshold;
+
+    if( pCtx == NULL )
+    {
+        LogError( ( "Invalid input, pCtx: %p", pCtx ) );
+        ret = -1;
+    }
+
+    if( ret == 0 )
+    {
+        if( xSemaphoreTake( pCtx->mediaMutex,
+                            portMAX_DELAY ) == pdTRUE )
+        {
+            isLocked = 1U;
+        }
+        else
+        {
+            LogError( ( "Failed to lock media mutex." ) );
+            ret = -1;
+        }
+    }
+
+    /* Resolution and frame rate. */
+    if( ret == 0 )
+    {
+        pEncoder = &pCtx->videoEncoder;
+
+        if( bitrate < videoLevels[ pEncoder->targetLevel ].minBitrate )
+        {
+            /* Step down at once to the best level the target still covers. */
+            level = pEncoder->targetLevel;
+            while( bitrate < videoLevels[ level ].minBitrate )
+            {
+                level++;
+            }
+            SetVideoTargetLevel( pCtx,
+                                 level );
+        }
+        else if( pEncoder->targetLevel > 0U )
+        {
+            threshold = ( uint64_t ) videoLevels[ pEncoder->targetLevel - 1U ].minBitrate * ( 100U + APP_MEDIA_SOURCE_VIDEO_LEVEL_UP_HEADROOM_PERCENT ) / 100U;
+
+            if( bitrate < threshold )
+            {
+                pEncoder->isLevelUpPending = 0U;
+            }
+            else if( pEncoder->isLevelUpPending == 0U )
+            {
+                pEncoder->isLevelUpPending = 1U;
+                pEncoder->levelUpStartTick = nowTick;
+            }
+            else if( ( nowTick - pEncoder->levelUpStartTick ) >= pdMS_TO_TICKS( APP_MEDIA_SOURCE_VIDEO_LEVEL_UP_HOLD_MS ) )
+            {
+                SetVideoTargetLevel( pCtx,
+                                     pEncoder->targetLevel - 1U );
+            }
+            else
+            {
+                /* Empty else marker. */
+            }
+        }
+        else
+        {
+            /* Empty else marker. */
+        }
+    }
+
+    /* Bitrate. */
+    if( ret == 0 )
+    {
+        threshold = ( uint64_t ) pEncoder->targetBitrate * APP_MEDIA_SOURCE_VIDEO_BITRATE_HYSTERESIS_PERCENT / 100U;
+
+        if( ( pEncoder->targetBitrate == 0U ) ||
+            ( ( uint64_t ) bitrate + threshold < pEncoder->targetBitrate ) ||
+            ( ( ( uint64_t ) bitrate > pEncoder->targetBitrate + threshold ) &&
+              ( ( nowTick - pEncoder->lastBitrateChangeTick ) >= pdMS_TO_TICKS( APP_MEDIA_SOURCE_VIDEO_BITRATE_UP_HOLD_MS ) ) ) )
+        {
+            pEncoder->targetBitrate = bitrate;
+            pEncoder->lastBitrateChangeTick = nowTick;
+            ( void ) xSemaphoreGive( pCtx->videoEncoderSemaphore );
+        }
+    }
+
+    if( isLocked != 0U )
+    {
+        xSemaphoreGive( pCtx->mediaMutex );
+    }
+
+    return ret;
+}
+
+int32_t AppMediaSource_RequestKeyFrame( AppMediaSourcesContext_t * pCtx,
+                                        uint8_t videoStream )
+{
+    int32_t ret = 0;
+    AppMediaSourceKeyFrameArbiter_t * pArbiter;
+
+    if( ( pCtx == NULL ) || ( videoStream >= MEDIA_FRAME_VIDEO_STREAM_COUNT ) )
+    {
+        LogError( ( "Invalid input, pCtx: %p, videoStream: %u", pCtx, videoStream ) );
+        ret = -1;
+    }
+
+    if( ret == 0 )
+    {
+        if( xSemaphoreTake( pCtx->mediaMutex,
+                            portMAX_DELAY ) == pdTRUE )
+        {
+            pArbiter = &pCtx->keyFrameArbiters[ videoStream ];
+            pArbiter->stats.requested++;
+            #if METRIC_PRINT_ENABLED
+            Metric_IncreaseCounter( METRIC_COUNTER_KEY_FRAME_REQUESTED, 1U );
+            #endif
+
+            if( pArbiter->isPending != 0U )
+            {
+                /* The key frame on its way serves this viewer too. */
+                pArbiter->stats.coalesced++;
+            }
+            else
+            {
+                pArbiter->isPending = 1U;
+                pArbiter->isForced = 0U;
+                pArbiter->pendingStartTick = xTaskGetTickCount();
+            }
+
+            xSemaphoreGive( pCtx->mediaMutex );
+        }
+        else
+        {
+            LogError( ( "Failed to lock media mutex." ) );
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+int32_t AppMediaSource_GetKeyFrameStats( AppMediaSourcesContext_t * pCtx,
+                                         uint8_t videoStream,
+                                         AppMediaSourceKeyFrameStats_t * pStats )
+{
+    int32_t ret = 0;
+
+    if( ( pCtx == NULL ) || ( videoStream >= MEDIA_FRAME_VIDEO_STREAM_COUNT ) || ( pStats == NULL ) )
+    {
+        LogError( ( "Invalid input, pCtx: %p, videoStream: %u, pStats: %p", pCtx, videoStream, pStats ) );
+        ret = -1;
+    }
+
+    if( ret == 0 )
+    {
+        if( xSemaphoreTake( pCtx->mediaMutex,
+                            portMAX_DELAY ) == pdTRUE )
+        {
+            memcpy( pStats,
+                    &pCtx->keyFrameArbiters[ videoStream ].stats,
+                    sizeof( AppMediaSourceKeyFrameStats_t ) );
+            xSemaphoreGive( pCtx->mediaMutex );
+        }
+        else
+        {
+            LogError( ( "Failed to lock media mutex." ) );
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+int32_t AppMediaSource_GetGopCacheFrame( AppMediaSourcesContext_t * pCtx,
+                                         uint8_t videoStream,
+                                         uint32_t * pGopId,
+                                         size_t * pFrameIndex,
+                                         MediaFrame_t * pFrame,
+                                         volatile uint8_t * pIsLive )
+{
+    int32_t ret = 0;
+    AppMediaSourceGopCache_t * pCache;
+    uint8_t isWaiting;
+
+    if( ( pCtx == NULL ) || ( videoStream >= MEDIA_FRAME_VIDEO_STREAM_COUNT ) ||
+        ( pGopId == NULL ) || ( pFrameIndex == NULL ) || ( pFrame == NULL ) || ( pIsLive == NULL ) )
+    {
+        LogError( ( "Invalid input, pCtx: %p, videoStream: %u, pGopId: %p, pFrameIndex: %p, pFrame: %p, pIsLive: %p",
+                    pCtx, videoStream, pGopId, pFrameIndex, pFrame, pIsLive ) );
+        ret = -1;
+    }
+
+    while( ret == 0 )
+    {
+        isWaiting = 0U;
+
+        if( xSemaphoreTake( pCtx->gopCacheMutex,
+                            portMAX_DELAY ) == pdTRUE )
+        {
+            pCache = &pCtx->gopCaches[ videoStream ];
+
+            if( *pGopId != pCache->gopId )
+            {
+                /* A new key frame replaced the GOP, it's decodable on its own. */
+                *pGopId = pCache->gopId;
+                *pFrameIndex = 0U;
+            }
+
+            /* A truncated cache doesn't reach the live frame, a viewer would see a broken picture. */
+            if( ( pCache->isTruncated != 0U ) || ( *pFrameIndex >= pCache->frameCount ) )
+            {
+                if( pCache->isFrameInSink != 0U )
+                {
+                    /* The media sink hook skips this viewer for the frame in flight, send it from the cache first. */
+                    isWaiting = 1U;
+                }
+                else
                 {
-                    vPortFree( frame.pData );
+                    *pIsLive = 1U;
+                    ret = 1;
                 }
             }
+            else
+            {
+                memcpy( pFrame,
+                        &pCache->pFrames[ *pFrameIndex ],
+                        sizeof( MediaFrame_t ) );
+                ( void ) AppMediaSource_AcquireFrame( pFrame );
+            }
+
+            xSemaphoreGive( pCtx->gopCacheMutex );
         }
-    #endif /* ifdef ENABLE_STREAMING_LOOPBACK */
+        else
+        {
+            LogError( ( "Failed to lock GOP cache mutex." ) );
+            ret = -1;
+        }
+
+        if( isWaiting == 0U )
+        {
+            break;
+        }
+
+        vTaskDelay( 1 );
+    }
+
+    return ret;
+}
+
+uint8_t * AppMediaSource_AllocateFrameData( uint32_t size )
+{
+    uint8_t * pBuffer;
+
+    pBuffer = ( uint8_t * ) pvPortMalloc( APP_MEDIA_SOURCE_FRAME_DATA_OFFSET + size );
+    if( pBuffer != NULL )
+    {
+        pBuffer += APP_MEDIA_SOURCE_FRAME_DATA_OFFSET;
+    }
+
+    return pBuffer;
+}
+
+void AppMediaSource_FreeFrameData( uint8_t * pData )
+{
+    if( pData != NULL )
+    {
+        vPortFree( pData - APP_MEDIA_SOURCE_FRAME_DATA_OFFSET );
+    }
+}
+
+int32_t AppMediaSource_AcquireFrame( MediaFrame_t * pFrame )
+{
+    int32_t ret = 0;
+
+    if( ( pFrame == NULL ) || ( pFrame->pRefCount == NULL ) )
+    {
+        LogError( ( "Invalid input, pFrame: %p", pFrame ) );
+        ret = -1;
+    }
+
+    if( ret == 0 )
+    {
+        taskENTER_CRITICAL();
+        ( *pFrame->pRefCount )++;
+        taskEXIT_CRITICAL();
+    }
 
     return ret;
 }
+
+void AppMediaSource_ReleaseFrame( MediaFrame_t * pFrame )
+{
+    uint32_t refCount = 0U;
+
+    if( pFrame != NULL )
+    {
+        if( pFrame->pRefCount != NULL )
+        {
+            taskENTER_CRITICAL();
+            refCount = --( *pFrame->pRefCount );
+            taskEXIT_CRITICAL();
+
+            if( refCount == 0U )
+            {
+                pFrame->pRefCount = NULL;
+                ReleaseFrameData( pFrame );
+            }
+        }
+        else
+        {
+            /* The frame was never shared, release it directly. */
+            ReleaseFrameData( pFrame );
+        }
+    }
+}
+
+void AppMediaSource_ReturnLentFrameData( MediaFrame_t * pFrame )
+{
+    if( ( pFrame != NULL ) &&
+        ( pFrame->onFrameReleaseFunc != NULL ) &&
+        ( ( pFrame->pRefCount == NULL ) || ( *pFrame->pRefCount == 1U ) ) )
+    {
+        /* The port may lend its next frame with the same reference count, so drop it from this copy too. */
+        pFrame->onFrameReleaseFunc( pFrame->pOnFrameReleaseCustomContext );
+        pFrame->onFrameReleaseFunc = NULL;
+        pFrame->pOnFrameReleaseCustomContext = NULL;
+        pFrame->pRefCount = NULL;
+        pFrame->pData = NULL;
+    }
+}
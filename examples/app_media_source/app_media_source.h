@@ -32,6 +32,11 @@ extern "C" {
 #include "semphr.h"
 
 typedef struct AppMediaSourcesContext AppMediaSourcesContext_t;
+
+/* Bound of the GOP cache kept per video stream for viewers that just connected. */
+#ifndef APP_MEDIA_SOURCE_GOP_CACHE_MAX_BYTES
+#define APP_MEDIA_SOURCE_GOP_CACHE_MAX_BYTES ( 256 * 1024 )
+#endif
 typedef int32_t (* AppMediaSourceOnMediaSinkHook)( void * pCustom,
                                                    MediaFrame_t * pFrame );
 
@@ -45,6 +50,62 @@ typedef struct AppMediaSourceContext
     AppMediaSourcesContext_t * pSourcesContext;
 } AppMediaSourceContext_t;
 
+typedef struct AppMediaSourceVideoEncoder
+{
+    /* Index of the resolution/frame rate level in use, 0 is the best one. */
+    size_t level;
+    /* Level picked from the estimates, the video encoder task applies it to the encoder. */
+    size_t targetLevel;
+    /* Bitrate applied to the encoder in bps, 0 until the first estimate arrives. */
+    uint32_t bitrate;
+    /* Bitrate picked from the estimates, the video encoder task applies it to the encoder. */
+    uint32_t targetBitrate;
+    TickType_t lastBitrateChangeTick;
+    /* Set while the target stays high enough to step up a level. */
+    uint8_t isLevelUpPending;
+    TickType_t levelUpStartTick;
+} AppMediaSourceVideoEncoder_t;
+
+typedef struct AppMediaSourceKeyFrameStats
+{
+    /* PLI/FIR received from every viewer. */
+    uint32_t requested;
+    /* Requests merged into one that was already waiting for a key frame. */
+    uint32_t coalesced;
+    /* IDRs forced on the encoder. */
+    uint32_t issued;
+    /* Pending requests answered by a regular GOP key frame before an IDR was forced. */
+    uint32_t satisfiedByGop;
+} AppMediaSourceKeyFrameStats_t;
+
+typedef struct AppMediaSourceKeyFrameArbiter
+{
+    uint8_t isPending;
+    TickType_t pendingStartTick;
+    /* Set once an IDR is forced for the pending request. */
+    uint8_t isForced;
+    uint8_t hasForcedBefore;
+    TickType_t lastForcedTick;
+    AppMediaSourceKeyFrameStats_t stats;
+} AppMediaSourceKeyFrameArbiter_t;
+
+typedef struct AppMediaSourceGopCache
+{
+    /* The last key frame and the frames after it, each holding one reference. The array grows
+     * when a GOP has more frames, only the bytes of the frames bound the cache. */
+    MediaFrame_t * pFrames;
+    size_t frameCapacity;
+    size_t frameCount;
+    size_t totalBytes;
+    /* Changes every time the cache restarts from a new key frame. */
+    uint32_t gopId;
+    /* Set when a frame didn't fit or couldn't be kept, the cache can't be decoded up to the live stream until the next key frame. */
+    uint8_t isTruncated;
+    /* Set from adding a frame until the media sink hook has given it to the live viewers,
+     * a viewer catching up doesn't go live in between so it gets that frame exactly once. */
+    uint8_t isFrameInSink;
+} AppMediaSourceGopCache_t;
+
 typedef struct AppMediaSourcesContext
 {
     /* Mutex to protect totalNumReadyPeer because we might receive multiple ready/close message from different tasks. */
@@ -56,6 +117,18 @@ typedef struct AppMediaSourcesContext
     AppMediaSourceOnMediaSinkHook onMediaSinkHookFunc;
     void * pOnMediaSinkHookCustom;
     uint8_t totalNumReadyPeer;
+
+    /* Encoder settings driven by the bandwidth estimates, protected by mediaMutex. */
+    AppMediaSourceVideoEncoder_t videoEncoder;
+    /* Given when targetLevel or targetBitrate changes, updating the encoder is left to the video encoder task. */
+    SemaphoreHandle_t videoEncoderSemaphore;
+
+    /* Key frame requests of all viewers per video stream, protected by mediaMutex. */
+    AppMediaSourceKeyFrameArbiter_t keyFrameArbiters[ MEDIA_FRAME_VIDEO_STREAM_COUNT ];
+
+    /* Updated by the video Tx task and read by the task sending them to new viewers, protected by gopCacheMutex. */
+    SemaphoreHandle_t gopCacheMutex;
+    AppMediaSourceGopCache_t gopCaches[ MEDIA_FRAME_VIDEO_STREAM_COUNT ];
 } AppMediaSourcesContext_t;
 
 int32_t AppMediaSource_Init( AppMediaSourcesContext_t * pCtx,
@@ -67,6 +140,42 @@ int32_t AppMediaSource_InitAudioTransceiver( AppMediaSourcesContext_t * pCtx,
                                              Transceiver_t * pAudioTranceiver );
 int32_t AppMediaSource_RecvFrame( AppMediaSourcesContext_t * pCtx,
                                   MediaFrame_t * pFrame );
+/* Adapt the video encoder to the bitrate, in bps, that every viewer can receive.
+ * Decreases apply at once, increases and resolution/frame rate changes are held back to avoid oscillating.
+ * The new settings are only recorded here, a separate task updates the encoder. */
+int32_t AppMediaSource_SetVideoTargetBitrate( AppMediaSourcesContext_t * pCtx,
+                                              uint32_t bitrate );
+
+/* Ask for a key frame on a video stream. Requests are merged within a short window and IDRs are
+ * forced at a limited rate, a regular GOP key frame answers every pending request. */
+int32_t AppMediaSource_RequestKeyFrame( AppMediaSourcesContext_t * pCtx,
+                                        uint8_t videoStream );
+/* Copy the key frame counters of a video stream. */
+int32_t AppMediaSource_GetKeyFrameStats( AppMediaSourcesContext_t * pCtx,
+                                         uint8_t videoStream,
+                                         AppMediaSourceKeyFrameStats_t * pStats );
+
+/* Take a reference to the cached frame *pFrameIndex of a video stream, release it with AppMediaSource_ReleaseFrame().
+ * The cache holds the frames from the last key frame up to the live one. *pGopId tracks the GOP being sent,
+ * when the cache restarts from a new key frame *pFrameIndex goes back to 0.
+ * Returns 0 with a frame. At the end of the cache it waits for the live frame to leave the media sink hook,
+ * then returns 1 after setting *pIsLive under the cache lock. The hook sends the next frame to the viewer,
+ * so no frame is missed or sent twice. */
+int32_t AppMediaSource_GetGopCacheFrame( AppMediaSourcesContext_t * pCtx,
+                                         uint8_t videoStream,
+                                         uint32_t * pGopId,
+                                         size_t * pFrameIndex,
+                                         MediaFrame_t * pFrame,
+                                         volatile uint8_t * pIsLive );
+
+/* Take one more reference on a frame given to the media sink hook to keep it after the hook returns. */
+int32_t AppMediaSource_AcquireFrame( MediaFrame_t * pFrame );
+/* Drop one reference on the frame, the last owner releases the payload. */
+void AppMediaSource_ReleaseFrame( MediaFrame_t * pFrame );
+/* Hand a buffer lent by the media port back as soon as the sink hook no longer reads the data,
+ * e.g. once it's packetized, so the encoder isn't held up by the viewers sending it.
+ * Only done while the hook holds the sole reference, pData is NULL afterwards. */
+void AppMediaSource_ReturnLentFrameData( MediaFrame_t * pFrame );
 
 #ifdef __cplusplus
 }
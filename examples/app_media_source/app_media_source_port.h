@@ -26,17 +26,36 @@ extern "C" {
 #include <stdio.h>
 #include "transceiver_data_types.h"
 
+/* Video streams a port can encode, every viewer receives one of them. */
+#define MEDIA_FRAME_VIDEO_STREAM_HIGH ( 0 )
+#define MEDIA_FRAME_VIDEO_STREAM_LOW  ( 1 )
+#define MEDIA_FRAME_VIDEO_STREAM_COUNT ( 2 )
+
+typedef void (* OnFrameRelease_t)( void * pCustomContext );
+
 typedef struct MediaFrame {
     uint8_t * pData;
     uint32_t size;
     uint64_t timestampUs;
     TransceiverTrackKind_t trackKind;
-    uint8_t freeData;  /* indicate user need to free pData after using it */
+    uint8_t freeData;  /* indicate user need to free pData after using it, pData must come from AppMediaSource_AllocateFrameData() */
+    OnFrameRelease_t onFrameReleaseFunc; /* If set, called instead of freeing pData once the frame is no longer used. */
+    void * pOnFrameReleaseCustomContext;
+    /* Shared by every copy of the frame, managed by app media source. It's kept in front of the data
+     * when freeData is set, a port lending its buffer through onFrameReleaseFunc may provide one. */
+    uint32_t * pRefCount;
+    uint8_t videoStream; /* MEDIA_FRAME_VIDEO_STREAM_*, only for video frames. */
+    uint8_t isKeyFrame; /* The video frame starts with an IDR picture. */
 } MediaFrame_t;
 
 typedef int32_t (* OnFrameReadyToSend_t)( void * pCtx,
                                           MediaFrame_t * pFrame );
 
+/* Allocate the data of a frame that sets freeData, with room for its reference count in front. */
+uint8_t * AppMediaSource_AllocateFrameData( uint32_t size );
+/* Free data from AppMediaSource_AllocateFrameData() of a frame that never reached the media source. */
+void AppMediaSource_FreeFrameData( uint8_t * pData );
+
 int32_t AppMediaSourcePort_Init( void );
 int32_t AppMediaSourcePort_Start( OnFrameReadyToSend_t onVideoFrameReadyToSendFunc,
                                   void * pOnVideoFrameReadyToSendCustomContext,
@@ -45,6 +64,14 @@ int32_t AppMediaSourcePort_Start( OnFrameReadyToSend_t onVideoFrameReadyToSendFu
 void AppMediaSourcePort_Stop( void );
 void AppMediaSourcePort_Destroy( void );
 void AppMediaSourcePort_PlayAudioFrame( MediaFrame_t * pFrame );
+/* Runtime encoder controls, the new settings apply from the next encoded frame. */
+int32_t AppMediaSourcePort_SetVideoBitrate( uint32_t bitrate );
+int32_t AppMediaSourcePort_SetVideoFrameRate( uint32_t fps );
+/* Restarts the video stream, the resolution can't exceed the one the port is initialized with. */
+int32_t AppMediaSourcePort_SetVideoResolution( uint32_t width,
+                                               uint32_t height );
+/* Make the encoder of the video stream output an IDR as its next frame. */
+int32_t AppMediaSourcePort_ForceVideoKeyFrame( uint8_t videoStream );
 
 #ifdef __cplusplus
 }
@@ -72,6 +72,25 @@ extern int max_skb_buf_num;
 #define MEDIA_PORT_V1_BPS 512 * 1024
 #define MEDIA_PORT_V1_RCMODE 2 // 1: CBR, 2: VBR
 
+/*****************************************************************************
+* ISP channel : 1
+* Video type  : H264/HEVC, low resolution stream
+*****************************************************************************/
+#define MEDIA_PORT_V2_CHANNEL 1
+#define MEDIA_PORT_V2_WIDTH 640
+#define MEDIA_PORT_V2_HEIGHT 360
+#define MEDIA_PORT_V2_FPS 15
+#define MEDIA_PORT_V2_GOP 15
+#define MEDIA_PORT_V2_BPS 256 * 1024
+#define MEDIA_PORT_V2_RCMODE 2 // 1: CBR, 2: VBR
+
+#define MEDIA_PORT_H264_NALU_TYPE_MASK ( 0x1F )
+#define MEDIA_PORT_H264_NALU_TYPE_IDR ( 5 )
+#define MEDIA_PORT_H265_NALU_TYPE( header ) ( ( ( header ) >> 1 ) & 0x3F )
+#define MEDIA_PORT_H265_NALU_TYPE_IRAP_MIN ( 16 )
+#define MEDIA_PORT_H265_NALU_TYPE_IRAP_MAX ( 23 )
+#define MEDIA_PORT_H265_NALU_TYPE_VCL_MAX ( 31 )
+
 #if USE_VIDEO_CODEC_H265
 #define MEDIA_PORT_VIDEO_TYPE VIDEO_HEVC
 #define MEDIA_PORT_VIDEO_CODEC AV_CODEC_ID_H265
@@ -106,9 +125,16 @@ static mm_context_t * pOpusdContext = NULL;
 #endif /* MEDIA_PORT_ENABLE_AUDIO_RECV */
 #endif /* AUDIO_OPUS */
 static mm_context_t * pWebrtcMmContext = NULL;
+#if MEDIA_PORT_ENABLE_VIDEO_LOW_STREAM
+static mm_context_t * pVideoLowContext = NULL;
+static mm_context_t * pWebrtcLowMmContext = NULL;
+#endif /* MEDIA_PORT_ENABLE_VIDEO_LOW_STREAM */
 
 static mm_siso_t * pSisoAudioA1 = NULL;
 static mm_miso_t * pMisoWebrtc = NULL;
+#if MEDIA_PORT_ENABLE_VIDEO_LOW_STREAM
+static mm_siso_t * pSisoWebrtcV2 = NULL;
+#endif /* MEDIA_PORT_ENABLE_VIDEO_LOW_STREAM */
 #if MEDIA_PORT_ENABLE_AUDIO_RECV
 static mm_siso_t * pSisoWebrtcA2 = NULL;
 static mm_siso_t * pSisoAudioA2 = NULL;
@@ -127,6 +153,20 @@ static video_params_t videoParams = {
     .use_static_addr = 1
 };
 
+#if MEDIA_PORT_ENABLE_VIDEO_LOW_STREAM
+static video_params_t videoLowParams = {
+    .stream_id = MEDIA_PORT_V2_CHANNEL,
+    .type = MEDIA_PORT_VIDEO_TYPE,
+    .width = MEDIA_PORT_V2_WIDTH,
+    .height = MEDIA_PORT_V2_HEIGHT,
+    .bps = MEDIA_PORT_V2_BPS,
+    .fps = MEDIA_PORT_V2_FPS,
+    .gop = MEDIA_PORT_V2_GOP,
+    .rc_mode = MEDIA_PORT_V2_RCMODE,
+    .use_static_addr = 1
+};
+#endif /* MEDIA_PORT_ENABLE_VIDEO_LOW_STREAM */
+
 #if !USE_DEFAULT_AUDIO_SET
 static audio_params_t audioParams = {
     .sample_rate = ASR_8KHZ,
@@ -209,14 +249,66 @@ mm_module_t webrtcMmModule = {
     .name = "KVS_WebRTC"
 };
 
+#if MEDIA_PORT_ENABLE_VIDEO_ZERO_COPY
+static void OnVideoFrameRelease( void * pCustomContext )
+{
+    MediaModuleContext_t * pCtx = ( MediaModuleContext_t * )pCustomContext;
+
+    ( void ) xSemaphoreGive( pCtx->videoFrameReleaseSemaphore );
+}
+#endif /* #if MEDIA_PORT_ENABLE_VIDEO_ZERO_COPY */
+
+/* Check if the first picture of an Annex-B access unit is an IDR, parameter sets before it are skipped. */
+static uint8_t IsVideoKeyFrame( const uint8_t * pData,
+                                uint32_t size,
+                                uint32_t codec )
+{
+    uint8_t isKeyFrame = 0U;
+    uint8_t nalType;
+    uint32_t i;
+
+    for( i = 0U; ( i + 3U ) < size; i++ )
+    {
+        if( ( pData[ i ] != 0x00 ) || ( pData[ i + 1U ] != 0x00 ) || ( pData[ i + 2U ] != 0x01 ) )
+        {
+            continue;
+        }
+
+        if( codec == AV_CODEC_ID_H265 )
+        {
+            nalType = MEDIA_PORT_H265_NALU_TYPE( pData[ i + 3U ] );
+            if( nalType <= MEDIA_PORT_H265_NALU_TYPE_VCL_MAX )
+            {
+                isKeyFrame = ( ( nalType >= MEDIA_PORT_H265_NALU_TYPE_IRAP_MIN ) && ( nalType <= MEDIA_PORT_H265_NALU_TYPE_IRAP_MAX ) ) ? 1U : 0U;
+                break;
+            }
+        }
+        else
+        {
+            nalType = pData[ i + 3U ] & MEDIA_PORT_H264_NALU_TYPE_MASK;
+            if( ( nalType >= 1U ) && ( nalType <= MEDIA_PORT_H264_NALU_TYPE_IDR ) )
+            {
+                isKeyFrame = ( nalType == MEDIA_PORT_H264_NALU_TYPE_IDR ) ? 1U : 0U;
+                break;
+            }
+        }
+
+        i += 2U;
+    }
+
+    return isKeyFrame;
+}
+
 static int HandleModuleFrameHook( void * p,
                                   void * input,
                                   void * output )
 {
     int ret = 0;
+    int32_t callbackRet;
     MediaModuleContext_t * pCtx = ( MediaModuleContext_t * )p;
     MediaFrame_t frame;
     mm_queue_item_t * pInputItem = ( mm_queue_item_t * )input;
+    uint8_t isVideo;
 
     ( void ) output;
 
@@ -233,33 +325,75 @@ static int HandleModuleFrameHook( void * p,
                 break; //skip this frame and wait for skb resource release.
             }
 
+            isVideo = ( ( pInputItem->type == AV_CODEC_ID_H264 ) || ( pInputItem->type == AV_CODEC_ID_H265 ) ) ? 1U : 0U;
+            memset( &frame,
+                    0,
+                    sizeof( MediaFrame_t ) );
             frame.size = pInputItem->size;
-            frame.pData = ( uint8_t * ) pvPortMalloc( frame.size );
-            if( !frame.pData )
+            frame.timestampUs = NetworkingUtils_GetCurrentTimeUs( &pInputItem->timestamp );
+
+            #if MEDIA_PORT_ENABLE_VIDEO_ZERO_COPY
+            if( isVideo != 0U )
             {
-                LogWarn( ( "Fail to allocate memory for webrtc media frame, size: %lu", frame.size ) );
-                ret = -1;
-                break;
+                /* The encoder output stays valid until this hook returns the item to MMF,
+                 * so hold the item until the media source releases the frame. */
+                frame.pData = ( uint8_t * )pInputItem->data_addr;
+                frame.onFrameReleaseFunc = OnVideoFrameRelease;
+                frame.pOnFrameReleaseCustomContext = pCtx;
+                /* Only one lent frame is out at a time, so its reference count lives in the context. */
+                frame.pRefCount = &pCtx->videoFrameRefCount;
+
+                /* Drop a stale release from a frame that was rejected by the callback. */
+                ( void ) xSemaphoreTake( pCtx->videoFrameReleaseSemaphore,
+                                         0 );
             }
+            else
+            #endif /* #if MEDIA_PORT_ENABLE_VIDEO_ZERO_COPY */
+            {
+                frame.pData = AppMediaSource_AllocateFrameData( frame.size );
+                if( !frame.pData )
+                {
+                    LogWarn( ( "Fail to allocate memory for webrtc media frame, size: %lu", frame.size ) );
+                    ret = -1;
+                    break;
+                }
 
-            memcpy( frame.pData,
-                    ( uint8_t * )pInputItem->data_addr,
-                    frame.size );
-            frame.freeData = 1;
-            frame.timestampUs = NetworkingUtils_GetCurrentTimeUs( &pInputItem->timestamp );
+                memcpy( frame.pData,
+                        ( uint8_t * )pInputItem->data_addr,
+                        frame.size );
+                frame.freeData = 1;
+            }
 
-            if( ( pInputItem->type == AV_CODEC_ID_H264 ) || ( pInputItem->type == AV_CODEC_ID_H265 ) )
+            if( isVideo != 0U )
             {
                 if( pCtx->onVideoFrameReadyToSendFunc )
                 {
                     frame.trackKind = TRANSCEIVER_TRACK_KIND_VIDEO;
-                    ( void ) pCtx->onVideoFrameReadyToSendFunc( pCtx->pOnVideoFrameReadyToSendCustomContext,
-                                                                &frame );
+                    frame.videoStream = pCtx->videoStream;
+                    frame.isKeyFrame = IsVideoKeyFrame( ( uint8_t * )pInputItem->data_addr,
+                                                        pInputItem->size,
+                                                        pInputItem->type );
+                    callbackRet = pCtx->onVideoFrameReadyToSendFunc( pCtx->pOnVideoFrameReadyToSendCustomContext,
+                                                                     &frame );
+
+                    #if MEDIA_PORT_ENABLE_VIDEO_ZERO_COPY
+                    if( callbackRet == 0 )
+                    {
+                        /* Wait until the frame is packetized for the viewers, or dropped, before MMF recycles the buffer. */
+                        ( void ) xSemaphoreTake( pCtx->videoFrameReleaseSemaphore,
+                                                 portMAX_DELAY );
+                    }
+                    #else
+                    ( void ) callbackRet;
+                    #endif /* #if MEDIA_PORT_ENABLE_VIDEO_ZERO_COPY */
                 }
                 else
                 {
                     LogError( ( "No available ready to send callback function pointer for video." ) );
-                    vPortFree( frame.pData );
+                    if( frame.freeData )
+                    {
+                        AppMediaSource_FreeFrameData( frame.pData );
+                    }
                     ret = -1;
                 }
             }
@@ -275,14 +409,14 @@ static int HandleModuleFrameHook( void * p,
                 else
                 {
                     LogError( ( "No available ready to send callback function pointer for audio." ) );
-                    vPortFree( frame.pData );
+                    AppMediaSource_FreeFrameData( frame.pData );
                     ret = -1;
                 }
             }
             else
             {
                 LogWarn( ( "Input type cannot be handled: %ld", pInputItem->type ) );
-                vPortFree( frame.pData );
+                AppMediaSource_FreeFrameData( frame.pData );
                 ret = -1;
             }
         } while( pdFALSE );
@@ -323,6 +457,9 @@ static int ControlModuleHook( void * p,
         case CMD_KVS_WEBRTC_REG_AUDIO_SEND_CALLBACK_CUSTOM_CONTEXT:
             pCtx->pOnAudioFrameReadyToSendCustomContext = ( void * ) arg;
             break;
+        case CMD_KVS_WEBRTC_SET_VIDEO_STREAM:
+            pCtx->videoStream = ( uint8_t ) arg;
+            break;
         default:
             LogWarn( ( "Unknown module command: %d", cmd ) );
             break;
@@ -335,6 +472,12 @@ static void * DestroyModuleHook( void * p )
     MediaModuleContext_t * ctx = ( MediaModuleContext_t * )p;
     if( ctx )
     {
+        #if MEDIA_PORT_ENABLE_VIDEO_ZERO_COPY
+        if( ctx->videoFrameReleaseSemaphore != NULL )
+        {
+            vSemaphoreDelete( ctx->videoFrameReleaseSemaphore );
+        }
+        #endif /* #if MEDIA_PORT_ENABLE_VIDEO_ZERO_COPY */
         vPortFree( ctx );
     }
     return NULL;
@@ -350,6 +493,16 @@ static void * CreateModuleHook( void * parent )
                 0,
                 sizeof( MediaModuleContext_t ) );
         ctx->pParent = parent;
+
+        #if MEDIA_PORT_ENABLE_VIDEO_ZERO_COPY
+        ctx->videoFrameReleaseSemaphore = xSemaphoreCreateBinary();
+        if( ctx->videoFrameReleaseSemaphore == NULL )
+        {
+            LogError( ( "Fail to create video frame release semaphore." ) );
+            vPortFree( ctx );
+            ctx = NULL;
+        }
+        #endif /* #if MEDIA_PORT_ENABLE_VIDEO_ZERO_COPY */
     }
 
     return ctx;
@@ -388,6 +541,9 @@ void AppMediaSourcePort_Destroy( void )
     siso_pause( pSisoAudioA1 );
     miso_pause( pMisoWebrtc,
                 MM_OUTPUT );
+    #if MEDIA_PORT_ENABLE_VIDEO_LOW_STREAM
+    siso_pause( pSisoWebrtcV2 );
+    #endif /* MEDIA_PORT_ENABLE_VIDEO_LOW_STREAM */
     #if MEDIA_PORT_ENABLE_AUDIO_RECV
     siso_pause( pSisoWebrtcA2 );
     siso_pause( pSisoAudioA2 );
@@ -400,6 +556,14 @@ void AppMediaSourcePort_Destroy( void )
     mm_module_ctrl( pVideoContext,
                     CMD_VIDEO_STREAM_STOP,
                     MEDIA_PORT_V1_CHANNEL );
+    #if MEDIA_PORT_ENABLE_VIDEO_LOW_STREAM
+    mm_module_ctrl( pWebrtcLowMmContext,
+                    CMD_KVS_WEBRTC_STOP,
+                    0 );
+    mm_module_ctrl( pVideoLowContext,
+                    CMD_VIDEO_STREAM_STOP,
+                    MEDIA_PORT_V2_CHANNEL );
+    #endif /* MEDIA_PORT_ENABLE_VIDEO_LOW_STREAM */
     mm_module_ctrl( pAudioContext,
                     CMD_AUDIO_SET_TRX,
                     0 );
@@ -407,6 +571,9 @@ void AppMediaSourcePort_Destroy( void )
     // Delete linkers
     pSisoAudioA1 = siso_delete( pSisoAudioA1 );
     pMisoWebrtc = miso_delete( pMisoWebrtc );
+    #if MEDIA_PORT_ENABLE_VIDEO_LOW_STREAM
+    pSisoWebrtcV2 = siso_delete( pSisoWebrtcV2 );
+    #endif /* MEDIA_PORT_ENABLE_VIDEO_LOW_STREAM */
     #if MEDIA_PORT_ENABLE_AUDIO_RECV
     pSisoWebrtcA2 = siso_delete( pSisoWebrtcA2 );
     pSisoAudioA2 = siso_delete( pSisoAudioA2 );
@@ -415,6 +582,10 @@ void AppMediaSourcePort_Destroy( void )
     // Close modules
     pWebrtcMmContext = mm_module_close( pWebrtcMmContext );
     pVideoContext = mm_module_close( pVideoContext );
+    #if MEDIA_PORT_ENABLE_VIDEO_LOW_STREAM
+    pWebrtcLowMmContext = mm_module_close( pWebrtcLowMmContext );
+    pVideoLowContext = mm_module_close( pVideoLowContext );
+    #endif /* MEDIA_PORT_ENABLE_VIDEO_LOW_STREAM */
     pAudioContext = mm_module_close( pAudioContext );
     #if ( AUDIO_G711_MULAW || AUDIO_G711_ALAW )
     pG711eContext = mm_module_close( pG711eContext );
@@ -456,10 +627,17 @@ int32_t AppMediaSourcePort_Init( void )
 
     if( ret == 0 )
     {
+        #if MEDIA_PORT_ENABLE_VIDEO_LOW_STREAM
+        voe_heap_size = video_voe_presetting( 1, MEDIA_PORT_V1_WIDTH, MEDIA_PORT_V1_HEIGHT, MEDIA_PORT_V1_BPS, 0,
+                                              1, MEDIA_PORT_V2_WIDTH, MEDIA_PORT_V2_HEIGHT, MEDIA_PORT_V2_BPS, 0,
+                                              0, 0, 0, 0, 0,
+                                              0, 0, 0 );
+        #else
         voe_heap_size = video_voe_presetting( 1, MEDIA_PORT_V1_WIDTH, MEDIA_PORT_V1_HEIGHT, MEDIA_PORT_V1_BPS, 0,
                                               0, 0, 0, 0, 0,
                                               0, 0, 0, 0, 0,
                                               0, 0, 0 );
+        #endif /* MEDIA_PORT_ENABLE_VIDEO_LOW_STREAM */
         ( void ) voe_heap_size;
         LogInfo( ( "voe heap size = %d", voe_heap_size ) );
     }
@@ -489,6 +667,85 @@ int32_t AppMediaSourcePort_Init( void )
         }
     }
 
+    #if MEDIA_PORT_ENABLE_VIDEO_LOW_STREAM
+    if( ret == 0 )
+    {
+        pVideoLowContext = mm_module_open( &video_module );
+        if( pVideoLowContext )
+        {
+            mm_module_ctrl( pVideoLowContext,
+                            CMD_VIDEO_SET_PARAMS,
+                            ( int )&videoLowParams );
+            mm_module_ctrl( pVideoLowContext,
+                            MM_CMD_SET_QUEUE_LEN,
+                            MEDIA_PORT_V2_FPS * 3 );
+            mm_module_ctrl( pVideoLowContext,
+                            MM_CMD_INIT_QUEUE_ITEMS,
+                            MMQI_FLAG_DYNAMIC );
+            mm_module_ctrl( pVideoLowContext,
+                            CMD_VIDEO_APPLY,
+                            MEDIA_PORT_V2_CHANNEL ); // start channel 1
+        }
+        else
+        {
+            LogError( ( "low video open fail" ) );
+            ret = -1;
+        }
+    }
+
+    if( ret == 0 )
+    {
+        /* The low stream gets its own KVS module instance so its frames can be tagged at the source. */
+        pWebrtcLowMmContext = mm_module_open( &webrtcMmModule );
+        if( pWebrtcLowMmContext )
+        {
+            mm_module_ctrl( pWebrtcLowMmContext,
+                            MM_CMD_SET_QUEUE_LEN,
+                            6 );
+            mm_module_ctrl( pWebrtcLowMmContext,
+                            MM_CMD_INIT_QUEUE_ITEMS,
+                            MMQI_FLAG_STATIC );
+            mm_module_ctrl( pWebrtcLowMmContext,
+                            CMD_KVS_WEBRTC_SET_VIDEO_STREAM,
+                            MEDIA_FRAME_VIDEO_STREAM_LOW );
+            mm_module_ctrl( pWebrtcLowMmContext, CMD_KVS_WEBRTC_SET_APPLY, 0 );
+        }
+        else
+        {
+            LogError( ( "KVS low stream open fail" ) );
+            ret = -1;
+        }
+    }
+
+    if( ret == 0 )
+    {
+        pSisoWebrtcV2 = siso_create();
+        if( pSisoWebrtcV2 )
+        {
+            #if defined( configENABLE_TRUSTZONE ) && ( configENABLE_TRUSTZONE == 1 )
+            siso_ctrl( pSisoWebrtcV2,
+                       MMIC_CMD_SET_SECURE_CONTEXT,
+                       1,
+                       0 );
+            #endif
+            siso_ctrl( pSisoWebrtcV2,
+                       MMIC_CMD_ADD_INPUT,
+                       ( uint32_t )pVideoLowContext,
+                       0 );
+            siso_ctrl( pSisoWebrtcV2,
+                       MMIC_CMD_ADD_OUTPUT,
+                       ( uint32_t )pWebrtcLowMmContext,
+                       0 );
+            siso_start( pSisoWebrtcV2 );
+        }
+        else
+        {
+            LogError( ( "pSisoWebrtcV2 open fail" ) );
+            ret = -1;
+        }
+    }
+    #endif /* MEDIA_PORT_ENABLE_VIDEO_LOW_STREAM */
+
     if( ret == 0 )
     {
         pAudioContext = mm_module_open( &audio_module );
@@ -778,6 +1035,17 @@ int32_t AppMediaSourcePort_Start( OnFrameReadyToSend_t onVideoFrameReadyToSendFu
     mm_module_ctrl( pWebrtcMmContext,
                     CMD_KVS_WEBRTC_START,
                     0 );
+    #if MEDIA_PORT_ENABLE_VIDEO_LOW_STREAM
+    mm_module_ctrl( pWebrtcLowMmContext,
+                    CMD_KVS_WEBRTC_REG_VIDEO_SEND_CALLBACK,
+                    ( int ) onVideoFrameReadyToSendFunc );
+    mm_module_ctrl( pWebrtcLowMmContext,
+                    CMD_KVS_WEBRTC_REG_VIDEO_SEND_CALLBACK_CUSTOM_CONTEXT,
+                    ( int ) pOnVideoFrameReadyToSendCustomContext );
+    mm_module_ctrl( pWebrtcLowMmContext,
+                    CMD_KVS_WEBRTC_START,
+                    0 );
+    #endif /* MEDIA_PORT_ENABLE_VIDEO_LOW_STREAM */
     #if METRIC_PRINT_ENABLED
     Metric_EndEvent( METRIC_EVENT_MEDIA_PORT_START );
     #endif
@@ -793,6 +1061,11 @@ void AppMediaSourcePort_Stop( void )
     mm_module_ctrl( pWebrtcMmContext,
                     CMD_KVS_WEBRTC_STOP,
                     0 );
+    #if MEDIA_PORT_ENABLE_VIDEO_LOW_STREAM
+    mm_module_ctrl( pWebrtcLowMmContext,
+                    CMD_KVS_WEBRTC_STOP,
+                    0 );
+    #endif /* MEDIA_PORT_ENABLE_VIDEO_LOW_STREAM */
     #if METRIC_PRINT_ENABLED
     Metric_EndEvent( METRIC_EVENT_MEDIA_PORT_STOP );
     #endif
@@ -846,3 +1119,135 @@ void AppMediaSourcePort_PlayAudioFrame( MediaFrame_t * pFrame )
         }
     }
 }
+
+int32_t AppMediaSourcePort_SetVideoBitrate( uint32_t bitrate )
+{
+    int32_t ret = 0;
+
+    if( pVideoContext == NULL )
+    {
+        LogError( ( "Video module is not opened." ) );
+        ret = -1;
+    }
+
+    if( ret == 0 )
+    {
+        videoParams.bps = bitrate;
+        mm_module_ctrl( pVideoContext,
+                        CMD_VIDEO_BPS,
+                        ( int ) bitrate );
+    }
+
+    return ret;
+}
+
+int32_t AppMediaSourcePort_SetVideoFrameRate( uint32_t fps )
+{
+    int32_t ret = 0;
+
+    if( ( fps == 0U ) || ( fps > MEDIA_PORT_V1_FPS ) )
+    {
+        LogError( ( "Invalid input, fps: %lu", fps ) );
+        ret = -1;
+    }
+    else if( pVideoContext == NULL )
+    {
+        LogError( ( "Video module is not opened." ) );
+        ret = -1;
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    if( ret == 0 )
+    {
+        videoParams.fps = fps;
+        mm_module_ctrl( pVideoContext,
+                        CMD_VIDEO_FPS,
+                        ( int ) fps );
+    }
+
+    return ret;
+}
+
+int32_t AppMediaSourcePort_SetVideoResolution( uint32_t width,
+                                               uint32_t height )
+{
+    int32_t ret = 0;
+
+    /* The VOE heap is preset for the V1 resolution, so the stream can only shrink. */
+    if( ( width == 0U ) || ( height == 0U ) ||
+        ( width > MEDIA_PORT_V1_WIDTH ) || ( height > MEDIA_PORT_V1_HEIGHT ) )
+    {
+        LogError( ( "Invalid input, width: %lu, height: %lu", width, height ) );
+        ret = -1;
+    }
+    else if( pVideoContext == NULL )
+    {
+        LogError( ( "Video module is not opened." ) );
+        ret = -1;
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    if( ( ret == 0 ) &&
+        ( ( videoParams.width != width ) || ( videoParams.height != height ) ) )
+    {
+        /* The encoder has to be restarted to change the resolution, the next frame is an IDR. */
+        mm_module_ctrl( pVideoContext,
+                        CMD_VIDEO_STREAM_STOP,
+                        MEDIA_PORT_V1_CHANNEL );
+        videoParams.width = width;
+        videoParams.height = height;
+        mm_module_ctrl( pVideoContext,
+                        CMD_VIDEO_SET_PARAMS,
+                        ( int )&videoParams );
+        mm_module_ctrl( pVideoContext,
+                        CMD_VIDEO_APPLY,
+                        MEDIA_PORT_V1_CHANNEL );
+    }
+
+    return ret;
+}
+
+int32_t AppMediaSourcePort_ForceVideoKeyFrame( uint8_t videoStream )
+{
+    int32_t ret = 0;
+    mm_context_t * pContext = NULL;
+    int channel = MEDIA_PORT_V1_CHANNEL;
+
+    if( videoStream == MEDIA_FRAME_VIDEO_STREAM_HIGH )
+    {
+        pContext = pVideoContext;
+    }
+    #if MEDIA_PORT_ENABLE_VIDEO_LOW_STREAM
+    else if( videoStream == MEDIA_FRAME_VIDEO_STREAM_LOW )
+    {
+        pContext = pVideoLowContext;
+        channel = MEDIA_PORT_V2_CHANNEL;
+    }
+    #endif /* MEDIA_PORT_ENABLE_VIDEO_LOW_STREAM */
+    else
+    {
+        LogError( ( "Invalid input, videoStream: %u", videoStream ) );
+        ret = -1;
+    }
+
+    if( ( ret == 0 ) && ( pContext == NULL ) )
+    {
+        LogError( ( "Video module is not opened." ) );
+        ret = -1;
+    }
+
+    if( ret == 0 )
+    {
+        mm_module_ctrl( pContext,
+                        CMD_VIDEO_FORCE_IFRAME,
+                        channel );
+    }
+
+    return ret;
+}
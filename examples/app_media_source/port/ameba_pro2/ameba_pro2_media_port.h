@@ -17,9 +17,21 @@
 #ifndef MODULE_KVS_WEBRTC_H
 #define MODULE_KVS_WEBRTC_H
 
+#include "FreeRTOS.h"
+#include "semphr.h"
 #include "mmf2_module.h"
 #include "app_media_source_port.h"
 
+/* Hand the video encoder output buffer to the senders without copying it. */
+#ifndef MEDIA_PORT_ENABLE_VIDEO_ZERO_COPY
+#define MEDIA_PORT_ENABLE_VIDEO_ZERO_COPY ( 1 )
+#endif
+
+/* Encode a second, low resolution video stream on another channel for viewers with less bandwidth. */
+#ifndef MEDIA_PORT_ENABLE_VIDEO_LOW_STREAM
+#define MEDIA_PORT_ENABLE_VIDEO_LOW_STREAM ( 1 )
+#endif
+
 #define CMD_KVS_WEBRTC_SET_PARAMS                               MM_MODULE_CMD( 0x00 )
 #define CMD_KVS_WEBRTC_GET_PARAMS                               MM_MODULE_CMD( 0x01 )
 #define CMD_KVS_WEBRTC_SET_APPLY                                MM_MODULE_CMD( 0x02 )
@@ -29,15 +41,24 @@
 #define CMD_KVS_WEBRTC_REG_VIDEO_SEND_CALLBACK_CUSTOM_CONTEXT   MM_MODULE_CMD( 0x06 )
 #define CMD_KVS_WEBRTC_REG_AUDIO_SEND_CALLBACK                  MM_MODULE_CMD( 0x07 )
 #define CMD_KVS_WEBRTC_REG_AUDIO_SEND_CALLBACK_CUSTOM_CONTEXT   MM_MODULE_CMD( 0x08 )
+#define CMD_KVS_WEBRTC_SET_VIDEO_STREAM                         MM_MODULE_CMD( 0x09 )
 
 typedef struct MediaModuleContext {
     void * pParent;
     uint8_t mediaStart;
+    /* MEDIA_FRAME_VIDEO_STREAM_* of the video frames going through this module. */
+    uint8_t videoStream;
 
     OnFrameReadyToSend_t onVideoFrameReadyToSendFunc;
     void * pOnVideoFrameReadyToSendCustomContext;
     OnFrameReadyToSend_t onAudioFrameReadyToSendFunc;
     void * pOnAudioFrameReadyToSendCustomContext;
+
+    #if MEDIA_PORT_ENABLE_VIDEO_ZERO_COPY
+    /* Given when the zero-copy video frame is released by the media source. */
+    SemaphoreHandle_t videoFrameReleaseSemaphore;
+    uint32_t videoFrameRefCount;
+    #endif /* #if MEDIA_PORT_ENABLE_VIDEO_ZERO_COPY */
 } MediaModuleContext_t;
 
 #endif /* MODULE_KVS_WEBRTC_H */
@@ -745,6 +745,9 @@ void IceController_HandleEvent( IceControllerContext_t * pCtx,
             {
                 ReleaseOtherSockets( pCtx, pCtx->pNominatedSocketContext );
                 LogDebug( ( "Released all other socket contexts" ) );
+
+                /* The nominated pair is fixed from now on, let media skip the socket mutex. */
+                IceControllerNet_PublishSendHandle( pCtx, pCtx->pNominatedSocketContext );
                 break;
             }
             default:
@@ -1573,6 +1576,8 @@ IceControllerResult_t IceController_SendToRemotePeer( IceControllerContext_t * p
     size_t turnBufferLength;
     IceEndpoint_t * pDestEndpoint = NULL;
     uint8_t turnSendBuffer[ ICE_CONTROLLER_MAX_MTU ];
+    IceControllerSendBuffer_t sendBuffer;
+    uint8_t isSent = 0U;
 
     if( ( pCtx == NULL ) ||
         ( pBuffer == NULL ) )
@@ -1582,6 +1587,24 @@ IceControllerResult_t IceController_SendToRemotePeer( IceControllerContext_t * p
     }
 
     if( ret == ICE_CONTROLLER_RESULT_OK )
+    {
+        sendBuffer.pBuffer = pBuffer;
+        sendBuffer.bufferLength = bufferLength;
+        ret = IceControllerNet_SendPacketsWithHandle( pCtx,
+                                                      &sendBuffer,
+                                                      1 );
+        if( ret != ICE_CONTROLLER_RESULT_SEND_HANDLE_NOT_PUBLISHED )
+        {
+            isSent = 1U;
+        }
+        else
+        {
+            /* Not published yet or relay candidate, send it through the locked path. */
+            ret = ICE_CONTROLLER_RESULT_OK;
+        }
+    }
+
+    if( ( ret == ICE_CONTROLLER_RESULT_OK ) && ( isSent == 0U ) )
     {
         if( ( pCtx->pNominatedSocketContext == NULL ) ||
             ( pCtx->pNominatedSocketContext->state < ICE_CONTROLLER_SOCKET_CONTEXT_STATE_SELECTED ) )
@@ -1610,7 +1633,7 @@ IceControllerResult_t IceController_SendToRemotePeer( IceControllerContext_t * p
         }
     }
 
-    if( ret == ICE_CONTROLLER_RESULT_OK )
+    if( ( ret == ICE_CONTROLLER_RESULT_OK ) && ( isSent == 0U ) )
     {
         if( pCtx->pNominatedSocketContext->pLocalCandidate->candidateType == ICE_CANDIDATE_TYPE_RELAY )
         {
@@ -1660,7 +1683,7 @@ IceControllerResult_t IceController_SendToRemotePeer( IceControllerContext_t * p
         }
     }
 
-    if( ret == ICE_CONTROLLER_RESULT_OK )
+    if( ( ret == ICE_CONTROLLER_RESULT_OK ) && ( isSent == 0U ) )
     {
         ret = IceControllerNet_SendPacket( pCtx,
                                            pCtx->pNominatedSocketContext,
@@ -1672,6 +1695,79 @@ IceControllerResult_t IceController_SendToRemotePeer( IceControllerContext_t * p
     return ret;
 }
 
+IceControllerResult_t IceController_SendBatchToRemotePeer( IceControllerContext_t * pCtx,
+                                                           const IceControllerSendBuffer_t * pSendBuffers,
+                                                           size_t sendBufferCount )
+{
+    IceControllerResult_t ret = ICE_CONTROLLER_RESULT_OK;
+    size_t i;
+    uint8_t isSent = 0U;
+
+    if( ( pCtx == NULL ) ||
+        ( pSendBuffers == NULL ) )
+    {
+        LogError( ( "Invalid input, pCtx: %p, pSendBuffers: %p", pCtx, pSendBuffers ) );
+        ret = ICE_CONTROLLER_RESULT_BAD_PARAMETER;
+    }
+
+    if( ret == ICE_CONTROLLER_RESULT_OK )
+    {
+        ret = IceControllerNet_SendPacketsWithHandle( pCtx,
+                                                      pSendBuffers,
+                                                      sendBufferCount );
+        if( ret != ICE_CONTROLLER_RESULT_SEND_HANDLE_NOT_PUBLISHED )
+        {
+            isSent = 1U;
+        }
+        else
+        {
+            /* Not published yet or relay candidate, send them through the locked path. */
+            ret = ICE_CONTROLLER_RESULT_OK;
+        }
+    }
+
+    if( ( ret == ICE_CONTROLLER_RESULT_OK ) && ( isSent == 0U ) )
+    {
+        if( ( pCtx->pNominatedSocketContext == NULL ) ||
+            ( pCtx->pNominatedSocketContext->state < ICE_CONTROLLER_SOCKET_CONTEXT_STATE_SELECTED ) ||
+            ( pCtx->pNominatedSocketContext->pLocalCandidate == NULL ) ||
+            ( pCtx->pNominatedSocketContext->pRemoteCandidate == NULL ) ||
+            ( pCtx->pNominatedSocketContext->pCandidatePair == NULL ) )
+        {
+            LogWarn( ( "The connection of this session is not ready." ) );
+            ret = ICE_CONTROLLER_RESULT_FAIL_CONNECTION_NOT_READY;
+        }
+    }
+
+    if( ( ret == ICE_CONTROLLER_RESULT_OK ) && ( isSent == 0U ) )
+    {
+        if( pCtx->pNominatedSocketContext->pLocalCandidate->candidateType == ICE_CANDIDATE_TYPE_RELAY )
+        {
+            /* Every packet needs its own TURN channel data header, send them one by one. */
+            for( i = 0; i < sendBufferCount; i++ )
+            {
+                ret = IceController_SendToRemotePeer( pCtx,
+                                                      pSendBuffers[ i ].pBuffer,
+                                                      pSendBuffers[ i ].bufferLength );
+                if( ret != ICE_CONTROLLER_RESULT_OK )
+                {
+                    break;
+                }
+            }
+        }
+        else
+        {
+            ret = IceControllerNet_SendPackets( pCtx,
+                                                pCtx->pNominatedSocketContext,
+                                                &pCtx->pNominatedSocketContext->pRemoteCandidate->endpoint,
+                                                pSendBuffers,
+                                                sendBufferCount );
+        }
+    }
+
+    return ret;
+}
+
 IceControllerResult_t IceController_AddIceServerConfig( IceControllerContext_t * pCtx,
                                                         IceControllerIceServerConfig_t * pIceServersConfig )
 {
@@ -42,6 +42,9 @@ IceControllerResult_t IceController_ProcessIceCandidatesAndPairs( IceControllerC
 IceControllerResult_t IceController_SendToRemotePeer( IceControllerContext_t * pCtx,
                                                       const uint8_t * pBuffer,
                                                       size_t bufferLength );
+IceControllerResult_t IceController_SendBatchToRemotePeer( IceControllerContext_t * pCtx,
+                                                           const IceControllerSendBuffer_t * pSendBuffers,
+                                                           size_t sendBufferCount );
 IceControllerResult_t IceController_AddIceServerConfig( IceControllerContext_t * pCtx,
                                                         IceControllerIceServerConfig_t * pIceServersConfig );
 IceControllerResult_t IceController_PeriodConnectionCheck( IceControllerContext_t * pCtx );
@@ -188,6 +188,7 @@ typedef enum IceControllerResult
     ICE_CONTROLLER_RESULT_JSON_CANDIDATE_INVALID_TYPE_ID,
     ICE_CONTROLLER_RESULT_JSON_CANDIDATE_INVALID_TYPE,
     ICE_CONTROLLER_RESULT_JSON_CANDIDATE_LACK_OF_ELEMENT,
+    ICE_CONTROLLER_RESULT_SEND_HANDLE_NOT_PUBLISHED,
 } IceControllerResult_t;
 
 typedef enum IceControllerEvent
@@ -271,6 +272,27 @@ typedef struct IceControllerSocketContext
     int socketFd;
 } IceControllerSocketContext_t;
 
+typedef struct IceControllerSendBuffer
+{
+    const uint8_t * pBuffer;
+    size_t bufferLength;
+} IceControllerSendBuffer_t;
+
+/* Destination of the nominated pair resolved in advance. It's published once the pair is fixed
+ * and never modified while published, so media packets can be sent without taking socketMutex. */
+typedef struct IceControllerSendHandle
+{
+    IceControllerSocketContext_t * pSocketContext;
+    int socketFd;
+    union
+    {
+        struct sockaddr_in ipv4Address;
+        struct sockaddr_in6 ipv6Address;
+    } destinationAddress;
+    socklen_t addressLength;
+    IceEndpoint_t remoteEndpoint;
+} IceControllerSendHandle_t;
+
 typedef struct IceControllerIceServerConfig
 {
     IceControllerIceServer_t * pIceServers;
@@ -387,6 +409,11 @@ typedef struct IceControllerContext
 
     /* Mutex to protect global variables shared between Ice controller and socket listener. */
     SemaphoreHandle_t socketMutex;
+    /* Send handle of the nominated pair, swapped atomically. sendHandleUsers counts the senders
+     * still using it, so the socket is only closed after they are done. */
+    IceControllerSendHandle_t sendHandle;
+    IceControllerSendHandle_t * volatile pSendHandle;
+    volatile uint32_t sendHandleUsers;
     /* Mutex to ice context while invoking APIs of ICE library. */
     SemaphoreHandle_t iceMutex;
 
@@ -29,6 +29,9 @@
 #endif
 #include "networking_utils.h"
 
+/* FreeRTOS includes. */
+#include "atomic.h"
+
 #define ICE_CONTROLLER_STUN_MESSAGE_TYPE_STRING_UNKNOWN "UNKNOWN"
 #define ICE_CONTROLLER_STUN_MESSAGE_TYPE_STRING_BINDING_REQUEST "BINDING_REQUEST"
 #define ICE_CONTROLLER_STUN_MESSAGE_TYPE_STRING_BINDING_SUCCESS "BINDING_SUCCESS_RESPONSE"
@@ -400,6 +403,42 @@ static IceControllerResult_t CreateSocketContext( IceControllerContext_t * pCtx,
     return ret;
 }
 
+static void HandleSendFailure( IceControllerContext_t * pCtx,
+                               IceControllerSocketContext_t * pSocketContext )
+{
+    /*
+     * Socket read error detected.
+     * This typically indicates the remote peer closed the connection or WiFi disconnection.
+     * Action required: Close the local socket to properly terminate the connection.
+     */
+    ( void ) Ice_CloseCandidate( &pCtx->iceContext, pSocketContext->pLocalCandidate );
+    IceControllerNet_FreeSocketContext( pCtx, pSocketContext );
+
+    if( pSocketContext == pCtx->pNominatedSocketContext )
+    {
+        /* Disconnecting nominated socket connection, closing. */
+        LogWarn( ( "Unable to send packet through nominated socket, closing session: %.*s",
+                   ( int ) pCtx->iceContext.creds.combinedUsernameLength,
+                   pCtx->iceContext.creds.pCombinedUsername ) );
+
+        /* Notify peer connection for closing the connection. */
+        if( pCtx->onIceEventCallbackFunc )
+        {
+            pCtx->onIceEventCallbackFunc( pCtx->pOnIceEventCustomContext,
+                                          ICE_CONTROLLER_CB_EVENT_ICE_CLOSE_NOTIFY,
+                                          NULL );
+
+            /* Re-set the timer. */
+            IceController_UpdateTimerInterval( pCtx,
+                                               ICE_CONTROLLER_CLOSING_INTERVAL_MS );
+        }
+        else
+        {
+            LogError( ( "There is no ICE event callback function set." ) );
+        }
+    }
+}
+
 static IceControllerResult_t SendSocketPacket( IceControllerSocketContext_t * pSocketContext,
                                                const uint8_t * pBuffer,
                                                size_t length,
@@ -487,9 +526,18 @@ void IceControllerNet_FreeSocketContext( IceControllerContext_t * pCtx,
                                          IceControllerSocketContext_t * pSocketContext )
 {
     TlsTransportStatus_t retTlsTransport;
+    IceControllerSendHandle_t * pSendHandle;
 
     if( pSocketContext && ( pSocketContext->socketFd != -1 ) )
     {
+        /* Load the published handle once, it may be swapped concurrently. */
+        pSendHandle = pCtx->pSendHandle;
+        if( ( pSendHandle != NULL ) && ( pSendHandle->pSocketContext == pSocketContext ) )
+        {
+            /* Make sure no sender is still using the fd before closing it. */
+            IceControllerNet_RetractSendHandle( pCtx );
+        }
+
         if( xSemaphoreTake( pCtx->socketMutex, portMAX_DELAY ) == pdTRUE )
         {
             if( pSocketContext->socketType == ICE_CONTROLLER_SOCKET_TYPE_TLS )
@@ -1058,6 +1106,24 @@ IceControllerResult_t IceControllerNet_SendPacket( IceControllerContext_t * pCtx
                                                    IceEndpoint_t * pRemoteEndpoint,
                                                    const uint8_t * pBuffer,
                                                    size_t bufferLength )
+{
+    IceControllerSendBuffer_t sendBuffer;
+
+    sendBuffer.pBuffer = pBuffer;
+    sendBuffer.bufferLength = bufferLength;
+
+    return IceControllerNet_SendPackets( pCtx,
+                                         pSocketContext,
+                                         pRemoteEndpoint,
+                                         &sendBuffer,
+                                         1 );
+}
+
+IceControllerResult_t IceControllerNet_SendPackets( IceControllerContext_t * pCtx,
+                                                    IceControllerSocketContext_t * pSocketContext,
+                                                    IceEndpoint_t * pRemoteEndpoint,
+                                                    const IceControllerSendBuffer_t * pSendBuffers,
+                                                    size_t sendBufferCount )
 {
     IceControllerResult_t ret = ICE_CONTROLLER_RESULT_OK;
     struct sockaddr * pDestinationAddress = NULL;
@@ -1065,19 +1131,32 @@ IceControllerResult_t IceControllerNet_SendPacket( IceControllerContext_t * pCtx
     struct sockaddr_in6 ipv6Address;
     socklen_t addressLength = 0;
     uint8_t isLocked = 0;
+    size_t i;
+    #if METRIC_PRINT_ENABLED
+    uint64_t lockStartTimeUs = 0;
+    #endif
 
-    if( ( pCtx == NULL ) || ( pSocketContext == NULL ) || ( pRemoteEndpoint == NULL ) || ( pBuffer == NULL ) )
+    if( ( pCtx == NULL ) || ( pSocketContext == NULL ) || ( pRemoteEndpoint == NULL ) || ( pSendBuffers == NULL ) )
     {
-        LogError( ( "Invalid input, pCtx: %p, pSocketContext: %p, pRemoteEndpoint: %p, pBuffer: %p",
-                    pCtx, pSocketContext, pRemoteEndpoint, pBuffer ) );
+        LogError( ( "Invalid input, pCtx: %p, pSocketContext: %p, pRemoteEndpoint: %p, pSendBuffers: %p",
+                    pCtx, pSocketContext, pRemoteEndpoint, pSendBuffers ) );
         ret = ICE_CONTROLLER_RESULT_BAD_PARAMETER;
     }
 
     if( ret == ICE_CONTROLLER_RESULT_OK )
     {
+        #if METRIC_PRINT_ENABLED
+        lockStartTimeUs = NetworkingUtils_GetCurrentTimeUs( NULL );
+        #endif
+
         if( xSemaphoreTake( pCtx->socketMutex, portMAX_DELAY ) == pdTRUE )
         {
             isLocked = 1;
+
+            #if METRIC_PRINT_ENABLED
+            Metric_IncreaseCounter( METRIC_COUNTER_SOCKET_MUTEX_SENDS, 1U );
+            Metric_IncreaseCounter( METRIC_COUNTER_SOCKET_MUTEX_WAIT_US, ( uint32_t )( NetworkingUtils_GetCurrentTimeUs( NULL ) - lockStartTimeUs ) );
+            #endif
         }
         else
         {
@@ -1132,13 +1211,27 @@ IceControllerResult_t IceControllerNet_SendPacket( IceControllerContext_t * pCtx
         }
     }
 
-    /* Send data */
+    /* Send data, the destination address and the socket lock are shared by all buffers. */
     if( ret == ICE_CONTROLLER_RESULT_OK )
     {
         if( ( pSocketContext->socketType == ICE_CONTROLLER_SOCKET_TYPE_UDP ) ||
             ( pSocketContext->socketType == ICE_CONTROLLER_SOCKET_TYPE_TLS ) )
         {
-            ret = SendSocketPacket( pSocketContext, pBuffer, bufferLength, 0, pDestinationAddress, addressLength, pRemoteEndpoint );
+            for( i = 0; i < sendBufferCount; i++ )
+            {
+                if( pSendBuffers[ i ].pBuffer == NULL )
+                {
+                    LogError( ( "Invalid input, the buffer at index %u is NULL", i ) );
+                    ret = ICE_CONTROLLER_RESULT_BAD_PARAMETER;
+                    break;
+                }
+
+                ret = SendSocketPacket( pSocketContext, pSendBuffers[ i ].pBuffer, pSendBuffers[ i ].bufferLength, 0, pDestinationAddress, addressLength, pRemoteEndpoint );
+                if( ret != ICE_CONTROLLER_RESULT_OK )
+                {
+                    break;
+                }
+            }
         }
         else
         {
@@ -1154,37 +1247,153 @@ IceControllerResult_t IceControllerNet_SendPacket( IceControllerContext_t * pCtx
 
     if( ret == ICE_CONTROLLER_RESULT_FAIL_SOCKET_SENDTO )
     {
-        /*
-         * Socket read error detected.
-         * This typically indicates the remote peer closed the connection or WiFi disconnection.
-         * Action required: Close the local socket to properly terminate the connection.
-         */
-        ( void ) Ice_CloseCandidate( &pCtx->iceContext, pSocketContext->pLocalCandidate );
-        IceControllerNet_FreeSocketContext( pCtx, pSocketContext );
+        HandleSendFailure( pCtx, pSocketContext );
+    }
+
+    return ret;
+}
+
+void IceControllerNet_PublishSendHandle( IceControllerContext_t * pCtx,
+                                         IceControllerSocketContext_t * pSocketContext )
+{
+    IceControllerSendHandle_t * pSendHandle = NULL;
+    IceEndpoint_t * pRemoteEndpoint = NULL;
+
+    if( ( pCtx == NULL ) || ( pSocketContext == NULL ) )
+    {
+        LogError( ( "Invalid input, pCtx: %p, pSocketContext: %p", pCtx, pSocketContext ) );
+    }
+    else
+    {
+        /* Readers may still use the previous handle, wait for them before overwriting it. */
+        IceControllerNet_RetractSendHandle( pCtx );
+
+        if( xSemaphoreTake( pCtx->socketMutex, portMAX_DELAY ) == pdTRUE )
+        {
+            /* TURN channel data and TLS need the ICE context or TLS session on every packet, keep them on the locked path. */
+            if( ( pSocketContext->state == ICE_CONTROLLER_SOCKET_CONTEXT_STATE_SELECTED ) &&
+                ( pSocketContext->socketType == ICE_CONTROLLER_SOCKET_TYPE_UDP ) &&
+                ( pSocketContext->pLocalCandidate != NULL ) &&
+                ( pSocketContext->pLocalCandidate->candidateType != ICE_CANDIDATE_TYPE_RELAY ) &&
+                ( pSocketContext->pRemoteCandidate != NULL ) &&
+                ( pSocketContext->pLocalCandidate->endpoint.transportAddress.family == pSocketContext->pRemoteCandidate->endpoint.transportAddress.family ) )
+            {
+                pSendHandle = &pCtx->sendHandle;
+                pRemoteEndpoint = &pSocketContext->pRemoteCandidate->endpoint;
+
+                memset( pSendHandle, 0, sizeof( IceControllerSendHandle_t ) );
+                pSendHandle->pSocketContext = pSocketContext;
+                pSendHandle->socketFd = pSocketContext->socketFd;
+                memcpy( &pSendHandle->remoteEndpoint, pRemoteEndpoint, sizeof( IceEndpoint_t ) );
+
+                if( pRemoteEndpoint->transportAddress.family == STUN_ADDRESS_IPv4 )
+                {
+                    pSendHandle->destinationAddress.ipv4Address.sin_family = AF_INET;
+                    pSendHandle->destinationAddress.ipv4Address.sin_port = htons( pRemoteEndpoint->transportAddress.port );
+                    memcpy( &pSendHandle->destinationAddress.ipv4Address.sin_addr, pRemoteEndpoint->transportAddress.address, STUN_IPV4_ADDRESS_SIZE );
+                    pSendHandle->addressLength = sizeof( struct sockaddr_in );
+                }
+                else
+                {
+                    pSendHandle->destinationAddress.ipv6Address.sin6_family = AF_INET6;
+                    pSendHandle->destinationAddress.ipv6Address.sin6_port = htons( pRemoteEndpoint->transportAddress.port );
+                    memcpy( &pSendHandle->destinationAddress.ipv6Address.sin6_addr, pRemoteEndpoint->transportAddress.address, STUN_IPV6_ADDRESS_SIZE );
+                    pSendHandle->addressLength = sizeof( struct sockaddr_in6 );
+                }
+            }
+
+            xSemaphoreGive( pCtx->socketMutex );
+        }
+        else
+        {
+            LogError( ( "Failed to lock socket mutex." ) );
+        }
+    }
+
+    if( pSendHandle != NULL )
+    {
+        ( void ) Atomic_SwapPointers_p32( ( void * volatile * ) &pCtx->pSendHandle,
+                                          pSendHandle );
+        LogDebug( ( "Published send handle for socket fd %d", pSendHandle->socketFd ) );
+    }
+}
+
+void IceControllerNet_RetractSendHandle( IceControllerContext_t * pCtx )
+{
+    if( ( pCtx != NULL ) &&
+        ( Atomic_SwapPointers_p32( ( void * volatile * ) &pCtx->pSendHandle, NULL ) != NULL ) )
+    {
+        /* New senders see NULL from now on, wait for the ones that loaded the handle before. */
+        while( pCtx->sendHandleUsers != 0U )
+        {
+            vTaskDelay( pdMS_TO_TICKS( 1 ) );
+        }
+    }
+}
+
+IceControllerResult_t IceControllerNet_SendPacketsWithHandle( IceControllerContext_t * pCtx,
+                                                              const IceControllerSendBuffer_t * pSendBuffers,
+                                                              size_t sendBufferCount )
+{
+    IceControllerResult_t ret = ICE_CONTROLLER_RESULT_OK;
+    IceControllerSendHandle_t * pSendHandle = NULL;
+    IceControllerSocketContext_t * pSocketContext = NULL;
+    size_t i;
+
+    if( ( pCtx == NULL ) || ( pSendBuffers == NULL ) )
+    {
+        LogError( ( "Invalid input, pCtx: %p, pSendBuffers: %p", pCtx, pSendBuffers ) );
+        ret = ICE_CONTROLLER_RESULT_BAD_PARAMETER;
+    }
 
-        if( pSocketContext == pCtx->pNominatedSocketContext )
+    if( ret == ICE_CONTROLLER_RESULT_OK )
+    {
+        /* Count as a user before loading the pointer, so a retracting task always waits for us. */
+        ( void ) Atomic_Increment_u32( &pCtx->sendHandleUsers );
+        pSendHandle = pCtx->pSendHandle;
+        if( pSendHandle == NULL )
         {
-            /* Disconnecting nominated socket connection, closing. */
-            LogWarn( ( "Unable to send packet through nominated socket, closing session: %.*s",
-                       ( int ) pCtx->iceContext.creds.combinedUsernameLength,
-                       pCtx->iceContext.creds.pCombinedUsername ) );
+            ( void ) Atomic_Decrement_u32( &pCtx->sendHandleUsers );
+            ret = ICE_CONTROLLER_RESULT_SEND_HANDLE_NOT_PUBLISHED;
+        }
+    }
 
-            /* Notify peer connection for closing the connection. */
-            if( pCtx->onIceEventCallbackFunc )
+    if( ret == ICE_CONTROLLER_RESULT_OK )
+    {
+        for( i = 0; i < sendBufferCount; i++ )
+        {
+            if( pSendBuffers[ i ].pBuffer == NULL )
             {
-                pCtx->onIceEventCallbackFunc( pCtx->pOnIceEventCustomContext,
-                                              ICE_CONTROLLER_CB_EVENT_ICE_CLOSE_NOTIFY,
-                                              NULL );
-                
-                /* Re-set the timer. */
-                IceController_UpdateTimerInterval( pCtx,
-                                                   ICE_CONTROLLER_CLOSING_INTERVAL_MS );
+                LogError( ( "Invalid input, the buffer at index %u is NULL", i ) );
+                ret = ICE_CONTROLLER_RESULT_BAD_PARAMETER;
+                break;
             }
-            else
+
+            ret = SendSocketPacket( pSendHandle->pSocketContext,
+                                    pSendBuffers[ i ].pBuffer,
+                                    pSendBuffers[ i ].bufferLength,
+                                    0,
+                                    ( struct sockaddr * ) &pSendHandle->destinationAddress,
+                                    pSendHandle->addressLength,
+                                    &pSendHandle->remoteEndpoint );
+            if( ret != ICE_CONTROLLER_RESULT_OK )
             {
-                LogError( ( "There is no ICE event callback function set." ) );
+                break;
             }
         }
+
+        pSocketContext = pSendHandle->pSocketContext;
+        ( void ) Atomic_Decrement_u32( &pCtx->sendHandleUsers );
+
+        #if METRIC_PRINT_ENABLED
+        Metric_IncreaseCounter( METRIC_COUNTER_SEND_HANDLE_SENDS, 1U );
+        #endif
+    }
+
+    if( ret == ICE_CONTROLLER_RESULT_FAIL_SOCKET_SENDTO )
+    {
+        /* The handle is released above, closing the socket retracts it. */
+        HandleSendFailure( pCtx, pSocketContext );
     }
 
     return ret;
@@ -52,6 +52,19 @@ IceControllerResult_t IceControllerNet_SendPacket( IceControllerContext_t * pCtx
                                                    IceEndpoint_t * pRemoteEndpoint,
                                                    const uint8_t * pBuffer,
                                                    size_t bufferLength );
+IceControllerResult_t IceControllerNet_SendPackets( IceControllerContext_t * pCtx,
+                                                    IceControllerSocketContext_t * pSocketContext,
+                                                    IceEndpoint_t * pRemoteEndpoint,
+                                                    const IceControllerSendBuffer_t * pSendBuffers,
+                                                    size_t sendBufferCount );
+/* Publish the send handle of a fixed UDP pair, media is then sent by IceControllerNet_SendPacketsWithHandle() without locks. */
+void IceControllerNet_PublishSendHandle( IceControllerContext_t * pCtx,
+                                         IceControllerSocketContext_t * pSocketContext );
+/* Unpublish the send handle and wait until no sender is using it. */
+void IceControllerNet_RetractSendHandle( IceControllerContext_t * pCtx );
+IceControllerResult_t IceControllerNet_SendPacketsWithHandle( IceControllerContext_t * pCtx,
+                                                              const IceControllerSendBuffer_t * pSendBuffers,
+                                                              size_t sendBufferCount );
 void IceControllerNet_FreeSocketContext( IceControllerContext_t * pCtx,
                                          IceControllerSocketContext_t * pSocketContext );
 void IceControllerNet_UpdateSocketContext( IceControllerContext_t * pCtx,
@@ -231,6 +231,9 @@ static IceControllerResult_t UpdateNominatedSocketContext( IceControllerContext_
 
     if( ret == ICE_CONTROLLER_RESULT_OK )
     {
+        /* The published send handle belongs to the previous nomination. */
+        IceControllerNet_RetractSendHandle( pCtx );
+
         /* Update nominated socket context. */
         if( xSemaphoreTake( pCtx->socketMutex, portMAX_DELAY ) == pdTRUE )
         {
@@ -21,6 +21,7 @@
 
 #include "FreeRTOS.h"
 #include "task.h"
+#include "queue.h"
 
 #include "sys_api.h"      /* sys_backtrace_enable() */
 #include "sntp/sntp.h"    /* SNTP series APIs */
@@ -37,6 +38,8 @@
 
 AppContext_t appContext;
 AppMediaSourcesContext_t appMediaSourceContext;
+/* New viewers waiting for the cached GOP, sent by a task below the video Tx priority. */
+static QueueHandle_t gopCacheSessionQueue;
 gpio_t button_gpio;  // Button GPIO object
 
 static void Master_Task( void * pParameter );
@@ -48,6 +51,9 @@ static int32_t InitTransceiver( void * pMediaCtx,
                                 Transceiver_t * pTranceiver );
 static int32_t OnMediaSinkHook( void * pCustom,
                                 MediaFrame_t * pFrame );
+static void SendGopCache( AppContext_t * pAppContext,
+                          AppSession_t * pAppSession );
+static void GopCacheTx_Task( void * pParameter );
 static int32_t InitializeAppMediaSource( AppContext_t * pAppContext,
                                          AppMediaSourcesContext_t * pAppMediaSourceContext );
 
@@ -114,6 +120,90 @@ static int32_t InitTransceiver( void * pMediaCtx,
     return ret;
 }
 
+/* Catch a new viewer up with the cached GOP, then hand it over to the live video.
+ * The pacer spreads the burst, the video of the other viewers doesn't wait for it. */
+static void SendGopCache( AppContext_t * pAppContext,
+                          AppSession_t * pAppSession )
+{
+    Transceiver_t * pTransceiver = &pAppSession->transceivers[ DEMO_TRANSCEIVER_MEDIA_INDEX_VIDEO ];
+    uint8_t videoStream = pAppSession->videoStream;
+    uint32_t gopId = 0U;
+    size_t frameIndex = 0U;
+    size_t sentCount = 0U;
+    MediaFrame_t frame;
+    PeerConnectionResult_t peerConnectionResult = PEER_CONNECTION_RESULT_OK;
+    PeerConnectionFrame_t peerConnectionFrame;
+    PeerConnectionPacketizedFrame_t packetizedFrame;
+
+    while( ( peerConnectionResult == PEER_CONNECTION_RESULT_OK ) &&
+           ( pAppSession->peerConnectionSession.state == PEER_CONNECTION_SESSION_STATE_CONNECTION_READY ) &&
+           ( AppMediaSource_GetGopCacheFrame( pAppContext->pAppMediaSourcesContext,
+                                              videoStream,
+                                              &gopId,
+                                              &frameIndex,
+                                              &frame,
+                                              &pAppSession->isVideoLive ) == 0 ) )
+    {
+        peerConnectionFrame.version = PEER_CONNECTION_FRAME_CURRENT_VERSION;
+        peerConnectionFrame.presentationUs = frame.timestampUs;
+        peerConnectionFrame.pData = frame.pData;
+        peerConnectionFrame.dataLength = frame.size;
+
+        peerConnectionResult = PeerConnection_PacketizeFrame( pTransceiver,
+                                                              &peerConnectionFrame,
+                                                              &packetizedFrame );
+        if( peerConnectionResult == PEER_CONNECTION_RESULT_OK )
+        {
+            peerConnectionResult = PeerConnection_WritePacketizedFrame( &pAppSession->peerConnectionSession,
+                                                                        pTransceiver,
+                                                                        &packetizedFrame );
+            PeerConnection_ReleasePacketizedFrame( &packetizedFrame );
+        }
+
+        AppMediaSource_ReleaseFrame( &frame );
+        frameIndex++;
+        sentCount++;
+    }
+
+    if( peerConnectionResult != PEER_CONNECTION_RESULT_OK )
+    {
+        LogError( ( "Fail to send cached video frame, result: %d", peerConnectionResult ) );
+    }
+    else if( sentCount == 0U )
+    {
+        /* Nothing cached to start from, e.g. the port lends its buffers, so get the viewer a key frame soon. */
+        ( void ) AppMediaSource_RequestKeyFrame( pAppContext->pAppMediaSourcesContext,
+                                                 videoStream );
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    LogInfo( ( "Sent %u cached frames to client ID: %.*s",
+               ( unsigned int ) sentCount, ( int ) pAppSession->remoteClientIdLength, pAppSession->remoteClientId ) );
+
+    /* Already set when the cache was caught up, otherwise let the live video go on. */
+    pAppSession->isVideoLive = 1U;
+}
+
+static void GopCacheTx_Task( void * pParameter )
+{
+    AppContext_t * pAppContext = ( AppContext_t * ) pParameter;
+    AppSession_t * pAppSession;
+
+    for( ;; )
+    {
+        if( xQueueReceive( gopCacheSessionQueue,
+                           &pAppSession,
+                           portMAX_DELAY ) == pdTRUE )
+        {
+            SendGopCache( pAppContext,
+                          pAppSession );
+        }
+    }
+}
+
 static int32_t OnMediaSinkHook( void * pCustom,
                                 MediaFrame_t * pFrame )
 {
@@ -121,9 +211,21 @@ static int32_t OnMediaSinkHook( void * pCustom,
     AppContext_t * pAppContext = ( AppContext_t * ) pCustom;
     PeerConnectionResult_t peerConnectionResult;
     Transceiver_t * pTransceiver = NULL;
+    AppSession_t * pAppSession;
     PeerConnectionFrame_t peerConnectionFrame;
+    PeerConnectionPacketizedFrame_t packetizedFrame;
+    uint8_t isPacketized = 0;
+    /* Per session progress of the video frame, a delay of 0 means the session has nothing left to send. */
+    size_t nextPayloadIndexes[ AWS_MAX_VIEWER_NUM ];
+    uint32_t pacingDelaysMs[ AWS_MAX_VIEWER_NUM ];
+    uint32_t waitMs;
+    TickType_t waitTicks;
     int i;
 
+    memset( pacingDelaysMs,
+            0,
+            sizeof( pacingDelaysMs ) );
+
     if( ( pAppContext == NULL ) || ( pFrame == NULL ) )
     {
         LogError( ( "Invalid input, pCustom: %p, pFrame: %p", pCustom, pFrame ) );
@@ -154,20 +256,134 @@ static int32_t OnMediaSinkHook( void * pCustom,
                 break;
             }
 
-            if( pAppContext->appSessions[ i ].peerConnectionSession.state == PEER_CONNECTION_SESSION_STATE_CONNECTION_READY )
+            if( pAppContext->appSessions[ i ].peerConnectionSession.state != PEER_CONNECTION_SESSION_STATE_CONNECTION_READY )
+            {
+                continue;
+            }
+
+            if( ( pFrame->trackKind == TRANSCEIVER_TRACK_KIND_VIDEO ) &&
+                ( pAppContext->appSessions[ i ].isVideoStarted == 0U ) )
+            {
+                pAppContext->appSessions[ i ].isVideoStarted = 1U;
+                pAppSession = &pAppContext->appSessions[ i ];
+                if( xQueueSend( gopCacheSessionQueue,
+                                &pAppSession,
+                                0 ) != pdPASS )
+                {
+                    LogWarn( ( "Fail to queue GOP cache for client ID: %.*s", ( int ) pAppSession->remoteClientIdLength, pAppSession->remoteClientId ) );
+                    pAppSession->isVideoLive = 1U;
+                }
+            }
+
+            if( ( pFrame->trackKind == TRANSCEIVER_TRACK_KIND_VIDEO ) &&
+                ( pAppContext->appSessions[ i ].isVideoLive == 0U ) )
+            {
+                /* The GOP cache task sends this frame from the cache. */
+                continue;
+            }
+
+            if( ( pFrame->trackKind == TRANSCEIVER_TRACK_KIND_VIDEO ) &&
+                ( AppCommon_IsVideoFrameForSession( &pAppContext->appSessions[ i ],
+                                                    pFrame ) == 0U ) )
+            {
+                /* The frame is from the other video stream. */
+                continue;
+            }
+
+            if( pFrame->trackKind == TRANSCEIVER_TRACK_KIND_VIDEO )
+            {
+                /* Video frames are split into many payloads, do it once for the first viewer of the stream
+                 * and let every session only build its own RTP headers and SRTP packets. */
+                if( isPacketized == 0U )
+                {
+                    peerConnectionResult = PeerConnection_PacketizeFrame( pTransceiver,
+                                                                          &peerConnectionFrame,
+                                                                          &packetizedFrame );
+                    if( peerConnectionResult != PEER_CONNECTION_RESULT_OK )
+                    {
+                        LogError( ( "Fail to packetize video frame, result: %d", peerConnectionResult ) );
+                        ret = -3;
+                        break;
+                    }
+                    isPacketized = 1U;
+                }
+
+                nextPayloadIndexes[ i ] = 0;
+                peerConnectionResult = PeerConnection_WritePacketizedFrameBurst( &pAppContext->appSessions[ i ].peerConnectionSession,
+                                                                                 pTransceiver,
+                                                                                 &packetizedFrame,
+                                                                                 &nextPayloadIndexes[ i ],
+                                                                                 &pacingDelaysMs[ i ] );
+            }
+            else
             {
                 peerConnectionResult = PeerConnection_WriteFrame( &pAppContext->appSessions[ i ].peerConnectionSession,
                                                                   pTransceiver,
                                                                   &peerConnectionFrame );
+            }
+
+            if( peerConnectionResult != PEER_CONNECTION_RESULT_OK )
+            {
+                LogError( ( "Fail to write %s frame, result: %d", ( pFrame->trackKind == TRANSCEIVER_TRACK_KIND_VIDEO ) ? "video" : "audio",
+                            peerConnectionResult ) );
+                ret = -3;
+            }
+        }
+
+        if( pFrame->trackKind == TRANSCEIVER_TRACK_KIND_VIDEO )
+        {
+            /* Every session reads the packetized copy from here on, the encoder can have its buffer back. */
+            AppMediaSource_ReturnLentFrameData( pFrame );
+        }
+
+        /* Sessions held back by their pacer get their next burst in turn, so a viewer doesn't
+         * wait for the viewers before it to send the whole frame. */
+        while( isPacketized != 0U )
+        {
+            waitMs = 0U;
+            for( i = 0; i < AWS_MAX_VIEWER_NUM; i++ )
+            {
+                if( ( pacingDelaysMs[ i ] != 0U ) &&
+                    ( ( waitMs == 0U ) || ( pacingDelaysMs[ i ] < waitMs ) ) )
+                {
+                    waitMs = pacingDelaysMs[ i ];
+                }
+            }
+
+            if( waitMs == 0U )
+            {
+                break;
+            }
+
+            /* A wait shorter than a tick would round down to no wait at all and spin. */
+            waitTicks = pdMS_TO_TICKS( waitMs );
+            vTaskDelay( ( waitTicks > 0U ) ? waitTicks : 1U );
 
+            for( i = 0; i < AWS_MAX_VIEWER_NUM; i++ )
+            {
+                if( pacingDelaysMs[ i ] == 0U )
+                {
+                    continue;
+                }
+
+                peerConnectionResult = PeerConnection_WritePacketizedFrameBurst( &pAppContext->appSessions[ i ].peerConnectionSession,
+                                                                                 &pAppContext->appSessions[ i ].transceivers[ DEMO_TRANSCEIVER_MEDIA_INDEX_VIDEO ],
+                                                                                 &packetizedFrame,
+                                                                                 &nextPayloadIndexes[ i ],
+                                                                                 &pacingDelaysMs[ i ] );
                 if( peerConnectionResult != PEER_CONNECTION_RESULT_OK )
                 {
-                    LogError( ( "Fail to write %s frame, result: %d", ( pFrame->trackKind == TRANSCEIVER_TRACK_KIND_VIDEO ) ? "video" : "audio",
-                                peerConnectionResult ) );
+                    LogError( ( "Fail to write video frame, result: %d", peerConnectionResult ) );
+                    pacingDelaysMs[ i ] = 0U;
                     ret = -3;
                 }
             }
         }
+
+        if( isPacketized != 0U )
+        {
+            PeerConnection_ReleasePacketizedFrame( &packetizedFrame );
+        }
     }
 
     return ret;
@@ -229,6 +445,31 @@ static void Master_Task( void * pParameter )
         ret = InitializeAppMediaSource( &appContext, &appMediaSourceContext );
     }
 
+    if( ret == 0 )
+    {
+        gopCacheSessionQueue = xQueueCreate( AWS_MAX_VIEWER_NUM,
+                                             sizeof( AppSession_t * ) );
+        if( gopCacheSessionQueue == NULL )
+        {
+            LogError( ( "Fail to create GOP cache queue" ) );
+            ret = -1;
+        }
+        else if( xTaskCreate( GopCacheTx_Task,
+                              ( ( const char * ) "GopCacheTx" ),
+                              2048,
+                              &appContext,
+                              tskIDLE_PRIORITY + 1,
+                              NULL ) != pdPASS )
+        {
+            LogError( ( "xTaskCreate(GopCacheTx) failed" ) );
+            ret = -1;
+        }
+        else
+        {
+            /* Empty else marker. */
+        }
+    }
+
     if( ret == 0 )
     {
         /* Configure signaling controller with client ID and role type. */
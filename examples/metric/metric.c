@@ -27,6 +27,12 @@ MetricContext_t context;
 /* Convert event ID enum into string. */
 static const char * ConvertEventToString( MetricEvent_t event );
 
+/* Convert counter ID enum into string. */
+static const char * ConvertCounterToString( MetricCounter_t counter );
+
+/* Convert gauge ID enum into string. */
+static const char * ConvertGaugeToString( MetricGauge_t gauge );
+
 /* Calculate the duration in miliseconds from start & end time. */
 static uint64_t CalculateEventDurationMs( uint64_t startTimeUs,
                                           uint64_t endTimeUs );
@@ -89,6 +95,71 @@ static const char * ConvertEventToString( MetricEvent_t event )
     return pRet;
 }
 
+static const char * ConvertCounterToString( MetricCounter_t counter )
+{
+    const char * pRet = "Unknown";
+    switch( counter )
+    {
+        case METRIC_COUNTER_NONE:
+            pRet = "None";
+            break;
+        case METRIC_COUNTER_ROLLING_BUFFER_HEAP_ALLOCATION:
+            pRet = "Rolling Buffer Heap Allocations";
+            break;
+        case METRIC_COUNTER_ROLLING_BUFFER_SLOT_ACQUIRE:
+            pRet = "Rolling Buffer Slot Acquisitions";
+            break;
+        case METRIC_COUNTER_PACER_WAIT:
+            pRet = "Pacer Waits";
+            break;
+        case METRIC_COUNTER_PACER_DELAY_MS:
+            pRet = "Pacer Delay Milliseconds";
+            break;
+        case METRIC_COUNTER_SOCKET_MUTEX_SENDS:
+            pRet = "Socket Mutex Sends";
+            break;
+        case METRIC_COUNTER_SOCKET_MUTEX_WAIT_US:
+            pRet = "Socket Mutex Wait Microseconds";
+            break;
+        case METRIC_COUNTER_SEND_HANDLE_SENDS:
+            pRet = "Send Handle Sends";
+            break;
+        case METRIC_COUNTER_KEY_FRAME_REQUESTED:
+            pRet = "Key Frames Requested";
+            break;
+        case METRIC_COUNTER_KEY_FRAME_ISSUED:
+            pRet = "Key Frames Issued";
+            break;
+        case METRIC_COUNTER_KEY_FRAME_SATISFIED_BY_GOP:
+            pRet = "Key Frames Satisfied By GOP";
+            break;
+        default:
+            pRet = "Unknown";
+            break;
+    }
+
+    return pRet;
+}
+
+static const char * ConvertGaugeToString( MetricGauge_t gauge )
+{
+    const char * pRet = "Unknown";
+    switch( gauge )
+    {
+        case METRIC_GAUGE_NONE:
+            pRet = "None";
+            break;
+        case METRIC_GAUGE_PACER_QUEUED_PACKETS:
+            pRet = "Pacer Queued Packets";
+            break;
+        default:
+            pRet = "Unknown";
+            break;
+    }
+
+    return pRet;
+}
+
 static uint64_t CalculateEventDurationMs( uint64_t startTimeUs,
                                           uint64_t endTimeUs )
 {
@@ -106,6 +177,7 @@ void Metric_Init( void )
     }
     else
     {
+        context.counterStartTimeUs = NetworkingUtils_GetCurrentTimeUs( NULL );
         context.isInit = 1U;
     }
 
@@ -145,11 +217,33 @@ void Metric_EndEvent( MetricEvent_t event )
     }
 }
 
+void Metric_IncreaseCounter( MetricCounter_t counter,
+                             uint32_t value )
+{
+    if( ( context.isInit == 1U ) && ( counter < METRIC_COUNTER_MAX ) )
+    {
+        taskENTER_CRITICAL();
+        context.counters[ counter ] += value;
+        taskEXIT_CRITICAL();
+    }
+}
+
+void Metric_SetGauge( MetricGauge_t gauge,
+                      uint32_t value )
+{
+    if( ( context.isInit == 1U ) && ( gauge < METRIC_GAUGE_MAX ) )
+    {
+        context.gauges[ gauge ] = value;
+    }
+}
+
 void Metric_PrintMetrics( void )
 {
     int i;
     MetricEventRecord_t * pEventRecord;
     static char runTimeStatsBuffer[ 4096 ];
+    uint64_t counters[ METRIC_COUNTER_MAX ];
+    uint64_t counterDurationMs;
 
     if( ( context.isInit == 1U ) &&
         ( xSemaphoreTake( context.mutex, portMAX_DELAY ) == pdTRUE ) )
@@ -167,6 +261,28 @@ void Metric_PrintMetrics( void )
             }
         }
 
+        taskENTER_CRITICAL();
+        memcpy( counters, context.counters, sizeof( counters ) );
+        taskEXIT_CRITICAL();
+
+        /* Print the rate per second so runs of different length can be compared. */
+        counterDurationMs = CalculateEventDurationMs( context.counterStartTimeUs, NetworkingUtils_GetCurrentTimeUs( NULL ) );
+        for( i = METRIC_COUNTER_NONE + 1; i < METRIC_COUNTER_MAX; i++ )
+        {
+            LogInfo( ( "Counter of %s: %llu in %llu ms, %llu per second",
+                       ConvertCounterToString( ( MetricCounter_t )i ),
+                       counters[ i ],
+                       counterDurationMs,
+                       ( counterDurationMs == 0 ) ? 0 : counters[ i ] * 1000 / counterDurationMs ) );
+        }
+
+        for( i = METRIC_GAUGE_NONE + 1; i < METRIC_GAUGE_MAX; i++ )
+        {
+            LogInfo( ( "Gauge of %s: %lu",
+                       ConvertGaugeToString( ( MetricGauge_t )i ),
+                       context.gauges[ i ] ) );
+        }
+
         LogInfo( ( "Remaining free heap size: %u", xPortGetFreeHeapSize() ) );
 
         vTaskGetRunTimeStats( runTimeStatsBuffer );
@@ -188,6 +304,12 @@ void Metric_ResetEvent( void )
             context.eventRecords[i].endTimeUs = 0;
             context.eventRecords[i].startTimeUs = 0;
         }
+
+        taskENTER_CRITICAL();
+        memset( context.counters, 0, sizeof( context.counters ) );
+        taskEXIT_CRITICAL();
+        context.counterStartTimeUs = NetworkingUtils_GetCurrentTimeUs( NULL );
+
         xSemaphoreGive( context.mutex );
     }
 }
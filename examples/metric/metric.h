@@ -75,16 +75,61 @@ typedef struct MetricEventRecord
     uint64_t endTimeUs;
 } MetricEventRecord_t;
 
+typedef enum MetricCounter
+{
+    METRIC_COUNTER_NONE = 0,
+
+    /* Rolling Buffer Counters. */
+    METRIC_COUNTER_ROLLING_BUFFER_HEAP_ALLOCATION,
+    METRIC_COUNTER_ROLLING_BUFFER_SLOT_ACQUIRE,
+
+    /* Pacer Counters. */
+    METRIC_COUNTER_PACER_WAIT,
+    METRIC_COUNTER_PACER_DELAY_MS,
+
+    /* Media Send Path Counters. */
+    METRIC_COUNTER_SOCKET_MUTEX_SENDS,
+    METRIC_COUNTER_SOCKET_MUTEX_WAIT_US,
+    METRIC_COUNTER_SEND_HANDLE_SENDS,
+
+    /* Key Frame Counters. */
+    METRIC_COUNTER_KEY_FRAME_REQUESTED,
+    METRIC_COUNTER_KEY_FRAME_ISSUED,
+    METRIC_COUNTER_KEY_FRAME_SATISFIED_BY_GOP,
+
+    METRIC_COUNTER_MAX,
+} MetricCounter_t;
+
+typedef enum MetricGauge
+{
+    METRIC_GAUGE_NONE = 0,
+
+    /* Pacer Gauges. */
+    METRIC_GAUGE_PACER_QUEUED_PACKETS,
+
+    METRIC_GAUGE_MAX,
+} MetricGauge_t;
+
 typedef struct MetricContext
 {
     uint8_t isInit;
     MetricEventRecord_t eventRecords[ METRIC_EVENT_MAX ];
     SemaphoreHandle_t mutex;
+
+    /* Counters are updated from the media path, so they are protected by critical sections instead of the mutex. */
+    uint64_t counters[ METRIC_COUNTER_MAX ];
+    uint64_t counterStartTimeUs;
+    /* Gauges hold the last value set, not a total. */
+    uint32_t gauges[ METRIC_GAUGE_MAX ];
 } MetricContext_t;
 
 void Metric_Init( void );
 void Metric_StartEvent( MetricEvent_t event );
 void Metric_EndEvent( MetricEvent_t event );
+void Metric_IncreaseCounter( MetricCounter_t counter,
+                             uint32_t value );
+void Metric_SetGauge( MetricGauge_t gauge,
+                      uint32_t value );
 void Metric_PrintMetrics( void );
 void Metric_ResetEvent( void );
 
@@ -25,6 +25,10 @@
 #include "rtp_api.h"
 #include "rtcp_api.h"
 #include "peer_connection_rolling_buffer.h"
+#include "peer_connection_pacer.h"
+#include "peer_connection_twcc.h"
+#include "peer_connection_bwe.h"
+#include "peer_connection_send_scheduler.h"
 #if METRIC_PRINT_ENABLED
 #include "metric.h"
 #endif
@@ -33,6 +37,7 @@
 #include "peer_connection_h264_helper.h"
 #include "peer_connection_h265_helper.h"
 #include "peer_connection_opus_helper.h"
+#include "peer_connection_payload_helper.h"
 #include "networking_utils.h"
 
 #include "lwip/sockets.h"
@@ -1341,6 +1346,7 @@ static PeerConnectionResult_t AllocateTransceiver( PeerConnectionSession_t * pSe
         {
             pTransceiver->ssrc = ( uint32_t ) rand();
             pTransceiver->rtxSsrc = ( uint32_t ) rand();
+            pTransceiver->fecSsrc = ( uint32_t ) rand();
             pSession->pTransceivers[ pSession->transceiverCount ] = pTransceiver;
             pSession->transceiverCount++;
         }
@@ -1468,6 +1474,7 @@ static PeerConnectionResult_t SetDefaultPayloadTypes( PeerConnectionSession_t *
         {
             pSession->rtpConfig.isVideoCodecPayloadSet = 1;
             pSession->rtpConfig.videoCodecRtxPayload = 0;
+            pSession->rtpConfig.videoCodecFecPayload = 0;
             pSession->rtpConfig.videoRtxSequenceNumber = 0;
             pSession->rtpConfig.videoSequenceNumber = 0;
             ret = GetDefaultCodec( pTransceiver->codecBitMap,
@@ -1477,6 +1484,7 @@ static PeerConnectionResult_t SetDefaultPayloadTypes( PeerConnectionSession_t *
         {
             pSession->rtpConfig.isAudioCodecPayloadSet = 1;
             pSession->rtpConfig.audioCodecRtxPayload = 0;
+            pSession->rtpConfig.audioCodecRedPayload = 0;
             pSession->rtpConfig.audioRtxSequenceNumber = 0;
             pSession->rtpConfig.audioSequenceNumber = 0;
             ret = GetDefaultCodec( pTransceiver->codecBitMap,
@@ -1491,9 +1499,6 @@ PeerConnectionResult_t PeerConnection_Init( PeerConnectionSession_t * pSession,
                                             PeerConnectionSessionConfiguration_t * pSessionConfig )
 {
     PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
-    #if ENABLE_TWCC_SUPPORT
-    RtcpTwccManagerResult_t resultRtcpTwccManager = RTCP_TWCC_MANAGER_RESULT_OK;
-    #endif
     MessageQueueResult_t retMessageQueue;
     TimerControllerResult_t retTimer;
     char tempName[ 20 ];
@@ -1561,10 +1566,20 @@ PeerConnectionResult_t PeerConnection_Init( PeerConnectionSession_t * pSession,
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        pSession->srtpSessionMutex = xSemaphoreCreateMutex();
-        if( pSession->srtpSessionMutex == NULL )
+        pSession->srtpTransmitSessionMutex = xSemaphoreCreateMutex();
+        if( pSession->srtpTransmitSessionMutex == NULL )
         {
-            LogError( ( "Fail to create mutex of SRTP session." ) );
+            LogError( ( "Fail to create mutex of Tx SRTP session." ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_CREATE_SRTP_MUTEX;
+        }
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        pSession->srtpReceiveSessionMutex = xSemaphoreCreateMutex();
+        if( pSession->srtpReceiveSessionMutex == NULL )
+        {
+            LogError( ( "Fail to create mutex of Rx SRTP session." ) );
             ret = PEER_CONNECTION_RESULT_FAIL_CREATE_SRTP_MUTEX;
         }
     }
@@ -1635,14 +1650,9 @@ PeerConnectionResult_t PeerConnection_Init( PeerConnectionSession_t * pSession,
     #if ENABLE_TWCC_SUPPORT
         if( ret == PEER_CONNECTION_RESULT_OK )
         {
-            resultRtcpTwccManager = RtcpTwccManager_Init( &pSession->pCtx->rtcpTwccManager,
-                                                          pSession->pCtx->twccPacketInfo,
-                                                          PEER_CONNECTION_RTCP_TWCC_MAX_ARRAY );
-            if( resultRtcpTwccManager != RTCP_TWCC_MANAGER_RESULT_OK )
-            {
-                LogError( ( "Fail to Initialize RTCP TWCC Manager, result: %d", resultRtcpTwccManager ) );
-                ret = PEER_CONNECTION_RESULT_FAIL_RTCP_TWCC_INIT;
-            }
+            PeerConnectionTwcc_Init( &pSession->twccHistory );
+            PeerConnectionBwe_Init( &pSession->bwe,
+                                    PEER_CONNECTION_BWE_START_BITRATE );
         }
 
         if( ret == PEER_CONNECTION_RESULT_OK )
@@ -1720,6 +1730,23 @@ PeerConnectionResult_t PeerConnection_Start( PeerConnectionSession_t * pSession
     {
         /* Clear all message queue because of new session is coming. */
         EmptyMessageQueue( &pSession->requestQueue );
+        #if ENABLE_TWCC_SUPPORT
+        /* Feedback of the previous viewer must not match packets of the new one, and the estimate starts over. */
+        PeerConnectionTwcc_Init( &pSession->twccHistory );
+        PeerConnectionBwe_Init( &pSession->bwe,
+                                PEER_CONNECTION_BWE_START_BITRATE );
+        #endif /* ENABLE_TWCC_SUPPORT */
+    }
+
+    if( ( ret == PEER_CONNECTION_RESULT_OK ) &&
+        ( pSession->sendScheduler.isInit == 0U ) )
+    {
+        /* The scheduler lives as long as the senders, it's deleted when the session closes. */
+        ret = PeerConnectionSendScheduler_Init( &pSession->sendScheduler );
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
         pSession->state = PEER_CONNECTION_SESSION_STATE_START;
     }
 
@@ -2088,7 +2115,9 @@ PeerConnectionResult_t PeerConnection_MatchTransceiverBySsrc( PeerConnectionSess
         *ppTransceiver = NULL;
         for( i = 0; i < pSession->transceiverCount; i++ )
         {
-            if( ( ssrc == pSession->pTransceivers[i]->ssrc ) || ( ssrc == pSession->pTransceivers[i]->rtxSsrc ) )
+            if( ( ssrc == pSession->pTransceivers[i]->ssrc ) ||
+                ( ssrc == pSession->pTransceivers[i]->rtxSsrc ) ||
+                ( ssrc == pSession->pTransceivers[i]->fecSsrc ) )
             {
                 *ppTransceiver = pSession->pTransceivers[i];
                 break;
@@ -2180,6 +2209,11 @@ PeerConnectionResult_t PeerConnection_CloseSession( PeerConnectionSession_t * pS
         }
     }
 
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        PeerConnectionSendScheduler_Deinit( &pSession->sendScheduler );
+    }
+
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
         /* Reset metrics. */
@@ -2268,6 +2302,128 @@ PeerConnectionResult_t PeerConnection_WriteFrame( PeerConnectionSession_t * pSes
     return ret;
 }
 
+PeerConnectionResult_t PeerConnection_PacketizeFrame( const Transceiver_t * pTransceiver,
+                                                      const PeerConnectionFrame_t * pFrame,
+                                                      PeerConnectionPacketizedFrame_t * pPacketizedFrame )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+
+    if( ( pTransceiver == NULL ) ||
+        ( pFrame == NULL ) ||
+        ( pPacketizedFrame == NULL ) )
+    {
+        LogError( ( "Invalid input, pTransceiver: %p, pFrame: %p, pPacketizedFrame: %p",
+                    pTransceiver, pFrame, pPacketizedFrame ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        memset( pPacketizedFrame,
+                0,
+                sizeof( PeerConnectionPacketizedFrame_t ) );
+
+        /* Only video frames are split into many payloads, audio is written per session by PeerConnection_WriteFrame(). */
+        if( TRANSCEIVER_IS_CODEC_ENABLED( pTransceiver->codecBitMap,
+                                          TRANSCEIVER_RTC_CODEC_H264_PROFILE_42E01F_LEVEL_ASYMMETRY_ALLOWED_PACKETIZATION_BIT ) )
+        {
+            ret = PeerConnectionH264Helper_PacketizeH264Frame( pFrame,
+                                                               pPacketizedFrame );
+        }
+        else if( TRANSCEIVER_IS_CODEC_ENABLED( pTransceiver->codecBitMap,
+                                               TRANSCEIVER_RTC_CODEC_H265_BIT ) )
+        {
+            ret = PeerConnectionH265Helper_PacketizeH265Frame( pFrame,
+                                                               pPacketizedFrame );
+        }
+        else
+        {
+            LogError( ( "Codec is not supported for packetizing, codec bit map: 0x%x", ( int ) pTransceiver->codecBitMap ) );
+            ret = PEER_CONNECTION_RESULT_UNKNOWN_TX_CODEC;
+        }
+    }
+
+    return ret;
+}
+
+PeerConnectionResult_t PeerConnection_WritePacketizedFrame( PeerConnectionSession_t * pSession,
+                                                            Transceiver_t * pTransceiver,
+                                                            const PeerConnectionPacketizedFrame_t * pPacketizedFrame )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+
+    if( ( pSession == NULL ) ||
+        ( pTransceiver == NULL ) ||
+        ( pPacketizedFrame == NULL ) )
+    {
+        LogError( ( "Invalid input, pSession: %p, pTransceiver: %p, pPacketizedFrame: %p",
+                    pSession, pTransceiver, pPacketizedFrame ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        if( pSession->state < PEER_CONNECTION_SESSION_STATE_CONNECTION_READY )
+        {
+            LogInfo( ( "This session is not ready for sending frames, state: %d.", pSession->state ) );
+        }
+        else
+        {
+            ret = PeerConnectionPayloadHelper_WritePacketizedFrame( pSession,
+                                                                    pTransceiver,
+                                                                    pPacketizedFrame );
+        }
+    }
+
+    return ret;
+}
+
+PeerConnectionResult_t PeerConnection_WritePacketizedFrameBurst( PeerConnectionSession_t * pSession,
+                                                                 Transceiver_t * pTransceiver,
+                                                                 const PeerConnectionPacketizedFrame_t * pPacketizedFrame,
+                                                                 size_t * pNextPayloadIndex,
+                                                                 uint32_t * pPacingDelayMs )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+
+    if( ( pSession == NULL ) ||
+        ( pTransceiver == NULL ) ||
+        ( pPacketizedFrame == NULL ) ||
+        ( pNextPayloadIndex == NULL ) ||
+        ( pPacingDelayMs == NULL ) )
+    {
+        LogError( ( "Invalid input, pSession: %p, pTransceiver: %p, pPacketizedFrame: %p, pNextPayloadIndex: %p, pPacingDelayMs: %p",
+                    pSession, pTransceiver, pPacketizedFrame, pNextPayloadIndex, pPacingDelayMs ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        if( pSession->state < PEER_CONNECTION_SESSION_STATE_CONNECTION_READY )
+        {
+            LogInfo( ( "This session is not ready for sending frames, state: %d.", pSession->state ) );
+            /* Nothing more can be sent to this session, let the caller move on. */
+            *pNextPayloadIndex = pPacketizedFrame->payloadCount;
+            *pPacingDelayMs = 0U;
+        }
+        else
+        {
+            ret = PeerConnectionPayloadHelper_WritePacketizedFrameBurst( pSession,
+                                                                         pTransceiver,
+                                                                         pPacketizedFrame,
+                                                                         pNextPayloadIndex,
+                                                                         pPacingDelayMs );
+        }
+    }
+
+    return ret;
+}
+
+void PeerConnection_ReleasePacketizedFrame( PeerConnectionPacketizedFrame_t * pPacketizedFrame )
+{
+    PeerConnectionPayloadHelper_FreePacketizedFrame( pPacketizedFrame );
+}
+
 PeerConnectionResult_t PeerConnection_CreateOffer( PeerConnectionSession_t * pSession,
                                                    PeerConnectionBufferSessionDescription_t * pOutputBufferSessionDescription,
                                                    char * pOutputSerializedSdpMessage,
@@ -2415,6 +2571,7 @@ static PeerConnectionResult_t PeerConnection_OnRtcpSenderReportCallback( PeerCon
 {
     PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
     IceControllerResult_t iceControllerResult;
+    IceControllerSendBuffer_t sendBuffer;
     RtcpSenderReport_t rtcpSenderReport = { 0 };
     uint8_t srtcpPacket[ PEER_CONNECTION_SRTCP_RTCP_PACKET_MIN_LENGTH ];
     uint8_t readyToSend = 0;
@@ -2474,9 +2631,13 @@ static PeerConnectionResult_t PeerConnection_OnRtcpSenderReportCallback( PeerCon
         /* Send the constructed RTCP packets through network. */
         if( ret == PEER_CONNECTION_RESULT_OK )
         {
-            iceControllerResult = IceController_SendToRemotePeer( &( pSession->iceControllerContext ),
-                                                                  ( srtcpPacket ),
-                                                                  srtcpPacketLength );
+            sendBuffer.pBuffer = srtcpPacket;
+            sendBuffer.bufferLength = srtcpPacketLength;
+            iceControllerResult = PeerConnectionSendScheduler_Send( &( pSession->sendScheduler ),
+                                                                    &( pSession->iceControllerContext ),
+                                                                    PEER_CONNECTION_SEND_CLASS_URGENT,
+                                                                    &sendBuffer,
+                                                                    1 );
 
             if( iceControllerResult != ICE_CONTROLLER_RESULT_OK )
             {
@@ -2527,8 +2688,27 @@ PeerConnectionResult_t PeerConnection_SetSenderBandwidthEstimationCallback( Peer
     }
     else
     {
-        pSession->pCtx->onBandwidthEstimationCallback = onBandwidthEstimationCallback;
-        pSession->pCtx->pOnBandwidthEstimationCallbackContext = pUserContext;
+        pSession->onBandwidthEstimationCallback = onBandwidthEstimationCallback;
+        pSession->pOnBandwidthEstimationCallbackContext = pUserContext;
+    }
+
+    return ret;
+}
+
+PeerConnectionResult_t PeerConnection_SetVideoPacingBitrate( PeerConnectionSession_t * pSession,
+                                                             uint32_t estimatedBitrate )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+
+    if( pSession == NULL )
+    {
+        LogError( ( "Invalid input, pSession: %p", pSession ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+    else
+    {
+        PeerConnectionPacer_SetBitrate( &pSession->videoSrtpSender.pacer,
+                                        estimatedBitrate );
     }
 
     return ret;
@@ -44,6 +44,9 @@ PeerConnectionResult_t PeerConnection_AddDataChannel( PeerConnectionSession_t *
 PeerConnectionResult_t PeerConnection_SetSenderBandwidthEstimationCallback( PeerConnectionSession_t * pSession,
                                                                             OnBandwidthEstimationCallback_t onBandwidthEstimationCallback,
                                                                             void * pUserContext );
+/* Set the video pacing rate from the estimated bitrate in bps. */
+PeerConnectionResult_t PeerConnection_SetVideoPacingBitrate( PeerConnectionSession_t * pSession,
+                                                             uint32_t estimatedBitrate );
 #endif /* ENABLE_TWCC_SUPPORT */
 
 PeerConnectionResult_t PeerConnection_MatchTransceiverBySsrc( PeerConnectionSession_t * pSession,
@@ -66,6 +69,22 @@ PeerConnectionResult_t PeerConnection_CloseSession( PeerConnectionSession_t * pS
 PeerConnectionResult_t PeerConnection_WriteFrame( PeerConnectionSession_t * pSession,
                                                   Transceiver_t * pTransceiver,
                                                   const PeerConnectionFrame_t * pFrame );
+/* Packetize a frame once so it can be written to multiple sessions by PeerConnection_WritePacketizedFrame().
+ * The packetized frame must be released by PeerConnection_ReleasePacketizedFrame(). */
+PeerConnectionResult_t PeerConnection_PacketizeFrame( const Transceiver_t * pTransceiver,
+                                                      const PeerConnectionFrame_t * pFrame,
+                                                      PeerConnectionPacketizedFrame_t * pPacketizedFrame );
+PeerConnectionResult_t PeerConnection_WritePacketizedFrame( PeerConnectionSession_t * pSession,
+                                                            Transceiver_t * pTransceiver,
+                                                            const PeerConnectionPacketizedFrame_t * pPacketizedFrame );
+/* Write the next paced burst of a packetized frame without waiting, so one task can interleave many sessions.
+ * Continue from *pNextPayloadIndex after *pPacingDelayMs until it reaches the payload count. */
+PeerConnectionResult_t PeerConnection_WritePacketizedFrameBurst( PeerConnectionSession_t * pSession,
+                                                                 Transceiver_t * pTransceiver,
+                                                                 const PeerConnectionPacketizedFrame_t * pPacketizedFrame,
+                                                                 size_t * pNextPayloadIndex,
+                                                                 uint32_t * pPacingDelayMs );
+void PeerConnection_ReleasePacketizedFrame( PeerConnectionPacketizedFrame_t * pPacketizedFrame );
 PeerConnectionResult_t PeerConnection_CreateAnswer( PeerConnectionSession_t * pSession,
                                                     PeerConnectionBufferSessionDescription_t * pOutputBufferSessionDescription,
                                                     char * pOutputSerializedSdpMessage,
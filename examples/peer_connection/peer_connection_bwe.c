@@ -0,0 +1,403 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include "logging.h"
+#include "peer_connection_bwe.h"
+
+#if ENABLE_TWCC_SUPPORT
+
+#define PEER_CONNECTION_BWE_US_IN_A_MS ( 1000ULL )
+#define PEER_CONNECTION_BWE_US_IN_A_SECOND ( 1000000ULL )
+
+/* Packets sent within this interval are one group, like the frames of a burst. */
+#define PEER_CONNECTION_BWE_BURST_INTERVAL_US ( 5000ULL )
+
+/* Trendline filter. */
+#define PEER_CONNECTION_BWE_SMOOTHING_COEFFICIENT ( 0.9 )
+#define PEER_CONNECTION_BWE_THRESHOLD_GAIN ( 4.0 )
+#define PEER_CONNECTION_BWE_MAX_DELTA_COUNT ( 60U )
+
+/* Overuse detector, the threshold adapts to the trend so competing TCP flows don't starve us. */
+#define PEER_CONNECTION_BWE_INITIAL_THRESHOLD_MS ( 12.5 )
+#define PEER_CONNECTION_BWE_MIN_THRESHOLD_MS ( 6.0 )
+#define PEER_CONNECTION_BWE_MAX_THRESHOLD_MS ( 600.0 )
+#define PEER_CONNECTION_BWE_THRESHOLD_K_UP ( 0.0087 )
+#define PEER_CONNECTION_BWE_THRESHOLD_K_DOWN ( 0.039 )
+#define PEER_CONNECTION_BWE_OVERUSE_TIME_MS ( 10.0 )
+#define PEER_CONNECTION_BWE_MAX_THRESHOLD_UPDATE_MS ( 100ULL )
+
+/* Acknowledged bitrate. */
+#define PEER_CONNECTION_BWE_ACKED_WINDOW_US ( 500000ULL )
+
+/* AIMD rate control. */
+#define PEER_CONNECTION_BWE_DECREASE_FACTOR ( 0.85 )
+#define PEER_CONNECTION_BWE_INCREASE_PERCENT_PER_SECOND ( 8U )
+#define PEER_CONNECTION_BWE_RESPONSE_TIME_MS ( 200U )
+#define PEER_CONNECTION_BWE_PACKET_BITS ( 1200U * 8U )
+#define PEER_CONNECTION_BWE_MIN_DECREASE_INTERVAL_US ( 200000ULL )
+#define PEER_CONNECTION_BWE_LOSS_DECREASE_PERCENT ( 10U )
+
+static double GetTrendlineSlope( const PeerConnectionBwe_t * pBwe )
+{
+    double sumX = 0.0;
+    double sumY = 0.0;
+    double averageX;
+    double averageY;
+    double numerator = 0.0;
+    double denominator = 0.0;
+    uint32_t i;
+
+    for( i = 0; i < pBwe->trendCount; i++ )
+    {
+        sumX += pBwe->trendArrivalMs[ i ];
+        sumY += pBwe->trendDelayMs[ i ];
+    }
+
+    averageX = sumX / pBwe->trendCount;
+    averageY = sumY / pBwe->trendCount;
+
+    for( i = 0; i < pBwe->trendCount; i++ )
+    {
+        numerator += ( pBwe->trendArrivalMs[ i ] - averageX ) * ( pBwe->trendDelayMs[ i ] - averageY );
+        denominator += ( pBwe->trendArrivalMs[ i ] - averageX ) * ( pBwe->trendArrivalMs[ i ] - averageX );
+    }
+
+    return ( denominator > 0.0 ) ? ( numerator / denominator ) : 0.0;
+}
+
+static void UpdateThreshold( PeerConnectionBwe_t * pBwe,
+                             double trend,
+                             uint64_t arrivalTimeUs )
+{
+    double absoluteTrend = ( trend < 0.0 ) ? -trend : trend;
+    double k;
+    uint64_t elapsedMs;
+
+    if( pBwe->lastThresholdUpdateUs == 0U )
+    {
+        pBwe->lastThresholdUpdateUs = arrivalTimeUs;
+    }
+
+    /* Don't let a spike, e.g. a WiFi retry storm, drag the threshold up. */
+    if( absoluteTrend <= pBwe->thresholdMs + 15.0 )
+    {
+        k = ( absoluteTrend < pBwe->thresholdMs ) ? PEER_CONNECTION_BWE_THRESHOLD_K_DOWN : PEER_CONNECTION_BWE_THRESHOLD_K_UP;
+        elapsedMs = ( arrivalTimeUs - pBwe->lastThresholdUpdateUs ) / PEER_CONNECTION_BWE_US_IN_A_MS;
+        if( elapsedMs > PEER_CONNECTION_BWE_MAX_THRESHOLD_UPDATE_MS )
+        {
+            elapsedMs = PEER_CONNECTION_BWE_MAX_THRESHOLD_UPDATE_MS;
+        }
+
+        pBwe->thresholdMs += k * ( absoluteTrend - pBwe->thresholdMs ) * ( double ) elapsedMs;
+        if( pBwe->thresholdMs < PEER_CONNECTION_BWE_MIN_THRESHOLD_MS )
+        {
+            pBwe->thresholdMs = PEER_CONNECTION_BWE_MIN_THRESHOLD_MS;
+        }
+        else if( pBwe->thresholdMs > PEER_CONNECTION_BWE_MAX_THRESHOLD_MS )
+        {
+            pBwe->thresholdMs = PEER_CONNECTION_BWE_MAX_THRESHOLD_MS;
+        }
+        else
+        {
+            /* Empty else marker. */
+        }
+    }
+
+    pBwe->lastThresholdUpdateUs = arrivalTimeUs;
+}
+
+static void DetectOveruse( PeerConnectionBwe_t * pBwe,
+                           double trend,
+                           double sendDeltaMs,
+                           uint64_t arrivalTimeUs )
+{
+    if( trend > pBwe->thresholdMs )
+    {
+        if( pBwe->overuseTimeMs < 0.0 )
+        {
+            /* Assume the overuse started in the middle of the last delta. */
+            pBwe->overuseTimeMs = sendDeltaMs / 2.0;
+        }
+        else
+        {
+            pBwe->overuseTimeMs += sendDeltaMs;
+        }
+        pBwe->overuseCount++;
+
+        /* Only signal when the delay keeps growing, a single long delta isn't congestion. */
+        if( ( pBwe->overuseTimeMs > PEER_CONNECTION_BWE_OVERUSE_TIME_MS ) &&
+            ( pBwe->overuseCount > 1U ) &&
+            ( trend >= pBwe->prevTrend ) )
+        {
+            pBwe->overuseTimeMs = 0.0;
+            pBwe->overuseCount = 0U;
+            pBwe->usage = PEER_CONNECTION_BWE_USAGE_OVERUSING;
+        }
+    }
+    else if( trend < -pBwe->thresholdMs )
+    {
+        pBwe->overuseTimeMs = -1.0;
+        pBwe->overuseCount = 0U;
+        pBwe->usage = PEER_CONNECTION_BWE_USAGE_UNDERUSING;
+    }
+    else
+    {
+        pBwe->overuseTimeMs = -1.0;
+        pBwe->overuseCount = 0U;
+        pBwe->usage = PEER_CONNECTION_BWE_USAGE_NORMAL;
+    }
+
+    pBwe->prevTrend = trend;
+    UpdateThreshold( pBwe,
+                     trend,
+                     arrivalTimeUs );
+}
+
+static void OnGroupDelta( PeerConnectionBwe_t * pBwe,
+                          double sendDeltaMs,
+                          double arrivalDeltaMs,
+                          uint64_t arrivalTimeUs )
+{
+    double trend;
+
+    pBwe->deltaCount++;
+    pBwe->accumulatedDelayMs += arrivalDeltaMs - sendDeltaMs;
+    pBwe->smoothedDelayMs = PEER_CONNECTION_BWE_SMOOTHING_COEFFICIENT * pBwe->smoothedDelayMs +
+                            ( 1.0 - PEER_CONNECTION_BWE_SMOOTHING_COEFFICIENT ) * pBwe->accumulatedDelayMs;
+
+    pBwe->trendArrivalMs[ pBwe->trendIndex ] = ( double )( arrivalTimeUs - pBwe->firstArrivalTimeUs ) / ( double ) PEER_CONNECTION_BWE_US_IN_A_MS;
+    pBwe->trendDelayMs[ pBwe->trendIndex ] = pBwe->smoothedDelayMs;
+    pBwe->trendIndex = ( pBwe->trendIndex + 1U ) % PEER_CONNECTION_BWE_TRENDLINE_WINDOW;
+    if( pBwe->trendCount < PEER_CONNECTION_BWE_TRENDLINE_WINDOW )
+    {
+        pBwe->trendCount++;
+    }
+
+    /* Wait for a full window before judging the trend. */
+    if( pBwe->trendCount == PEER_CONNECTION_BWE_TRENDLINE_WINDOW )
+    {
+        trend = GetTrendlineSlope( pBwe ) *
+                ( double )( ( pBwe->deltaCount < PEER_CONNECTION_BWE_MAX_DELTA_COUNT ) ? pBwe->deltaCount : PEER_CONNECTION_BWE_MAX_DELTA_COUNT ) *
+                PEER_CONNECTION_BWE_THRESHOLD_GAIN;
+        DetectOveruse( pBwe,
+                       trend,
+                       sendDeltaMs,
+                       arrivalTimeUs );
+    }
+}
+
+static void UpdateAckedBitrate( PeerConnectionBwe_t * pBwe,
+                                uint64_t arrivalTimeUs,
+                                size_t packetSize )
+{
+    uint64_t windowUs;
+    uint32_t bitrate;
+
+    if( ( pBwe->ackedWindowStartUs == 0U ) || ( arrivalTimeUs < pBwe->ackedWindowStartUs ) )
+    {
+        pBwe->ackedWindowStartUs = arrivalTimeUs;
+        pBwe->ackedWindowBytes = 0U;
+    }
+
+    pBwe->ackedWindowBytes += ( uint32_t ) packetSize;
+    windowUs = arrivalTimeUs - pBwe->ackedWindowStartUs;
+
+    if( windowUs >= PEER_CONNECTION_BWE_ACKED_WINDOW_US )
+    {
+        bitrate = ( uint32_t )( ( uint64_t ) pBwe->ackedWindowBytes * 8U * PEER_CONNECTION_BWE_US_IN_A_SECOND / windowUs );
+        if( pBwe->ackedBitrate == 0U )
+        {
+            pBwe->ackedBitrate = bitrate;
+        }
+        else
+        {
+            pBwe->ackedBitrate = ( uint32_t )( ( ( uint64_t ) pBwe->ackedBitrate * 4U + bitrate ) / 5U );
+        }
+
+        pBwe->ackedWindowStartUs = arrivalTimeUs;
+        pBwe->ackedWindowBytes = 0U;
+    }
+}
+
+void PeerConnectionBwe_Init( PeerConnectionBwe_t * pBwe,
+                             uint32_t startBitrate )
+{
+    if( pBwe == NULL )
+    {
+        LogError( ( "Invalid input, pBwe: %p", pBwe ) );
+    }
+    else
+    {
+        memset( pBwe,
+                0,
+                sizeof( PeerConnectionBwe_t ) );
+        pBwe->thresholdMs = PEER_CONNECTION_BWE_INITIAL_THRESHOLD_MS;
+        pBwe->overuseTimeMs = -1.0;
+        pBwe->usage = PEER_CONNECTION_BWE_USAGE_NORMAL;
+        pBwe->targetBitrate = startBitrate;
+    }
+}
+
+void PeerConnectionBwe_OnPacketFeedback( PeerConnectionBwe_t * pBwe,
+                                         uint64_t sentTimeUs,
+                                         uint64_t arrivalTimeUs,
+                                         size_t packetSize )
+{
+    if( pBwe == NULL )
+    {
+        LogError( ( "Invalid input, pBwe: %p", pBwe ) );
+    }
+    else if( sentTimeUs < pBwe->groupFirstSendTimeUs )
+    {
+        /* Re-ordered behind a newer group, it says nothing about the current queue. */
+    }
+    else
+    {
+        UpdateAckedBitrate( pBwe,
+                            arrivalTimeUs,
+                            packetSize );
+
+        if( pBwe->groupFirstSendTimeUs == 0U )
+        {
+            pBwe->firstArrivalTimeUs = arrivalTimeUs;
+            pBwe->groupFirstSendTimeUs = sentTimeUs;
+            pBwe->groupSendTimeUs = sentTimeUs;
+            pBwe->groupArrivalTimeUs = arrivalTimeUs;
+        }
+        else if( sentTimeUs - pBwe->groupFirstSendTimeUs <= PEER_CONNECTION_BWE_BURST_INTERVAL_US )
+        {
+            pBwe->groupSendTimeUs = sentTimeUs;
+            if( arrivalTimeUs > pBwe->groupArrivalTimeUs )
+            {
+                pBwe->groupArrivalTimeUs = arrivalTimeUs;
+            }
+        }
+        else
+        {
+            /* The packet starts a new group, so the current one is complete. */
+            if( pBwe->prevGroupSendTimeUs != 0U )
+            {
+                OnGroupDelta( pBwe,
+                              ( double )( int64_t )( pBwe->groupSendTimeUs - pBwe->prevGroupSendTimeUs ) / ( double ) PEER_CONNECTION_BWE_US_IN_A_MS,
+                              ( double )( int64_t )( pBwe->groupArrivalTimeUs - pBwe->prevGroupArrivalTimeUs ) / ( double ) PEER_CONNECTION_BWE_US_IN_A_MS,
+                              pBwe->groupArrivalTimeUs );
+            }
+
+            pBwe->prevGroupSendTimeUs = pBwe->groupSendTimeUs;
+            pBwe->prevGroupArrivalTimeUs = pBwe->groupArrivalTimeUs;
+            pBwe->groupFirstSendTimeUs = sentTimeUs;
+            pBwe->groupSendTimeUs = sentTimeUs;
+            pBwe->groupArrivalTimeUs = arrivalTimeUs;
+        }
+    }
+}
+
+void PeerConnectionBwe_Update( PeerConnectionBwe_t * pBwe,
+                               const TwccBandwidthInfo_t * pBandwidthInfo,
+                               uint64_t currentTimeUs,
+                               PeerConnectionBandwidthEstimate_t * pEstimate )
+{
+    uint64_t targetBitrate;
+    uint64_t elapsedUs;
+    uint64_t maxBitrate;
+    uint32_t lossPercent = 0U;
+
+    if( ( pBwe == NULL ) ||
+        ( pBandwidthInfo == NULL ) ||
+        ( pEstimate == NULL ) )
+    {
+        LogError( ( "Invalid input, pBwe: %p, pBandwidthInfo: %p, pEstimate: %p", pBwe, pBandwidthInfo, pEstimate ) );
+    }
+    else
+    {
+        if( pBandwidthInfo->sentPackets > 0U )
+        {
+            lossPercent = ( uint32_t )( ( pBandwidthInfo->sentPackets - pBandwidthInfo->receivedPackets ) * 100U / pBandwidthInfo->sentPackets );
+        }
+
+        targetBitrate = pBwe->targetBitrate;
+        elapsedUs = ( pBwe->lastRateUpdateUs == 0U ) ? 0U : currentTimeUs - pBwe->lastRateUpdateUs;
+        if( elapsedUs > PEER_CONNECTION_BWE_US_IN_A_SECOND )
+        {
+            elapsedUs = PEER_CONNECTION_BWE_US_IN_A_SECOND;
+        }
+
+        if( ( pBwe->usage == PEER_CONNECTION_BWE_USAGE_OVERUSING ) ||
+            ( lossPercent >= PEER_CONNECTION_BWE_LOSS_DECREASE_PERCENT ) )
+        {
+            /* Back off below what actually got through, once per response time. */
+            if( currentTimeUs - pBwe->lastDecreaseTimeUs >= PEER_CONNECTION_BWE_MIN_DECREASE_INTERVAL_US )
+            {
+                if( ( pBwe->ackedBitrate != 0U ) && ( pBwe->ackedBitrate < targetBitrate ) )
+                {
+                    targetBitrate = pBwe->ackedBitrate;
+                }
+
+                targetBitrate = ( uint64_t )( targetBitrate * PEER_CONNECTION_BWE_DECREASE_FACTOR );
+                pBwe->lastDecreaseBitrate = ( uint32_t ) targetBitrate;
+                pBwe->lastDecreaseTimeUs = currentTimeUs;
+            }
+        }
+        else if( pBwe->usage == PEER_CONNECTION_BWE_USAGE_UNDERUSING )
+        {
+            /* The queues are draining, hold until the delay is back to normal. */
+        }
+        else if( ( pBwe->lastDecreaseBitrate != 0U ) &&
+                 ( targetBitrate * 100U < ( uint64_t ) pBwe->lastDecreaseBitrate * 120U ) )
+        {
+            /* Close to the rate that congested the link last time, probe by about a packet per response time. */
+            targetBitrate += ( uint64_t ) PEER_CONNECTION_BWE_PACKET_BITS * elapsedUs / ( PEER_CONNECTION_BWE_RESPONSE_TIME_MS * PEER_CONNECTION_BWE_US_IN_A_MS );
+        }
+        else
+        {
+            targetBitrate += targetBitrate * PEER_CONNECTION_BWE_INCREASE_PERCENT_PER_SECOND * elapsedUs / 100U / PEER_CONNECTION_BWE_US_IN_A_SECOND;
+        }
+
+        /* Never run far ahead of what the remote acknowledges. */
+        if( pBwe->ackedBitrate != 0U )
+        {
+            maxBitrate = ( uint64_t ) pBwe->ackedBitrate * 3U / 2U + 10000U;
+            if( ( targetBitrate > maxBitrate ) && ( targetBitrate > pBwe->targetBitrate ) )
+            {
+                targetBitrate = ( maxBitrate > pBwe->targetBitrate ) ? maxBitrate : pBwe->targetBitrate;
+            }
+        }
+
+        if( targetBitrate < PEER_CONNECTION_BWE_MIN_BITRATE )
+        {
+            targetBitrate = PEER_CONNECTION_BWE_MIN_BITRATE;
+        }
+        else if( targetBitrate > PEER_CONNECTION_BWE_MAX_BITRATE )
+        {
+            targetBitrate = PEER_CONNECTION_BWE_MAX_BITRATE;
+        }
+        else
+        {
+            /* Empty else marker. */
+        }
+
+        pBwe->targetBitrate = ( uint32_t ) targetBitrate;
+        pBwe->lastRateUpdateUs = currentTimeUs;
+
+        pEstimate->targetBitrate = pBwe->targetBitrate;
+        pEstimate->ackedBitrate = pBwe->ackedBitrate;
+        pEstimate->lossPercent = lossPercent;
+        pEstimate->usage = pBwe->usage;
+    }
+}
+
+#endif /* ENABLE_TWCC_SUPPORT */
@@ -0,0 +1,71 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PEER_CONNECTION_BWE_H
+#define PEER_CONNECTION_BWE_H
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Standard includes. */
+#include <stdint.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+
+#include "peer_connection_data_types.h"
+
+#if ENABLE_TWCC_SUPPORT
+
+/* Range of the target bitrate in bps, audio and video together. */
+#ifndef PEER_CONNECTION_BWE_MIN_BITRATE
+#define PEER_CONNECTION_BWE_MIN_BITRATE ( 150000 )
+#endif
+
+#ifndef PEER_CONNECTION_BWE_START_BITRATE
+#define PEER_CONNECTION_BWE_START_BITRATE ( 1000000 )
+#endif
+
+#ifndef PEER_CONNECTION_BWE_MAX_BITRATE
+#define PEER_CONNECTION_BWE_MAX_BITRATE ( 4000000 )
+#endif
+
+void PeerConnectionBwe_Init( PeerConnectionBwe_t * pBwe,
+                             uint32_t startBitrate );
+
+/* Feed a packet the remote acknowledged, in the order of the feedback. Both times are in microseconds,
+ * the arrival time is on the remote clock. */
+void PeerConnectionBwe_OnPacketFeedback( PeerConnectionBwe_t * pBwe,
+                                         uint64_t sentTimeUs,
+                                         uint64_t arrivalTimeUs,
+                                         size_t packetSize );
+
+/* Update the target bitrate once all packets of a feedback are fed. */
+void PeerConnectionBwe_Update( PeerConnectionBwe_t * pBwe,
+                               const TwccBandwidthInfo_t * pBandwidthInfo,
+                               uint64_t currentTimeUs,
+                               PeerConnectionBandwidthEstimate_t * pEstimate );
+
+#endif /* ENABLE_TWCC_SUPPORT */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PEER_CONNECTION_BWE_H */
@@ -60,6 +60,12 @@ extern "C" {
  */
 #define PEER_CONNECTION_SRTP_RTX_WRITE_RESERVED_BYTES ( 2 )
 
+/* The RTP header written by the send path, see PeerConnectionRtpHeaderTemplate_t. */
+#define PEER_CONNECTION_SRTP_RTP_HEADER_MAX_LENGTH ( PEER_CONNECTION_RTP_HEADER_TEMPLATE_MAX_LENGTH )
+/* Headroom in front of the payload in a rolling buffer slot. The RTP header is serialized right before the payload,
+ * and a re-transmission puts the OSN in between. */
+#define PEER_CONNECTION_SRTP_RTP_HEADROOM_LENGTH ( PEER_CONNECTION_SRTP_RTP_HEADER_MAX_LENGTH + PEER_CONNECTION_SRTP_RTX_WRITE_RESERVED_BYTES )
+
 #define PEER_CONNECTION_SRTP_H264_MAX_NALUS_IN_A_FRAME        ( 64 )
 #define PEER_CONNECTION_SRTP_H265_MAX_NALUS_IN_A_FRAME        ( 64 )
 #define PEER_CONNECTION_SRTP_RTP_PAYLOAD_MAX_LENGTH      ( 1200 )
@@ -41,6 +41,9 @@ PeerConnectionResult_t PeerConnectionG711Helper_FillFrameG711( PeerConnectionJit
                                                                size_t * pOutBufferLength,
                                                                uint32_t * pRtpTimestamp );
 
+PeerConnectionResult_t PeerConnectionG711Helper_PacketizeG711Frame( const PeerConnectionFrame_t * pFrame,
+                                                                    PeerConnectionPacketizedFrame_t * pPacketizedFrame );
+
 PeerConnectionResult_t PeerConnectionG711Helper_WriteG711Frame( PeerConnectionSession_t * pSession,
                                                                 Transceiver_t * pTransceiver,
                                                                 const PeerConnectionFrame_t * pFrame );
@@ -15,6 +15,7 @@
  */
 
 #include "include/peer_connection_codec_helper.h"
+#include "peer_connection_payload_helper.h"
 #include "h264_packetizer.h"
 #include "h264_depacketizer.h"
 
@@ -140,52 +141,23 @@ PeerConnectionResult_t PeerConnectionH264Helper_FillFrameH264( PeerConnectionJit
     return ret;
 }
 
-PeerConnectionResult_t PeerConnectionH264Helper_WriteH264Frame( PeerConnectionSession_t * pSession,
-                                                                Transceiver_t * pTransceiver,
-                                                                const PeerConnectionFrame_t * pFrame )
+PeerConnectionResult_t PeerConnectionH264Helper_PacketizeH264Frame( const PeerConnectionFrame_t * pFrame,
+                                                                   PeerConnectionPacketizedFrame_t * pPacketizedFrame )
 {
     PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
     H264PacketizerContext_t h264PacketizerContext;
     H264Result_t resultH264;
     H264Packet_t packetH264;
-    uint8_t rtpBuffer[ PEER_CONNECTION_SRTP_RTP_PACKET_MAX_LENGTH ];
-    PeerConnectionRollingBufferPacket_t * pRollingBufferPacket = NULL;
-    uint8_t * pSrtpPacket = NULL;
-    size_t srtpPacketLength = 0;
     Nalu_t nalusArray[ PEER_CONNECTION_SRTP_H264_MAX_NALUS_IN_A_FRAME ];
     Frame_t h264Frame;
-    PeerConnectionSrtpSender_t * pSrtpSender = NULL;
-    uint8_t isLocked = 0;
-    uint8_t bufferAfterEncrypt = 1;
-    IceControllerResult_t resultIceController;
-    uint16_t * pRtpSeq = NULL;
-    uint32_t payloadType;
-    uint32_t * pSsrc = NULL;
-    uint32_t packetSent = 0;
-    uint32_t bytesSent = 0;
-    uint32_t randomRtpTimeoffset = 0;    // TODO : Spec required random rtp time offset ( current implementation of KVS SDK )
-    #if ENABLE_TWCC_SUPPORT
-    /* Add TWCC packet tracking */
-    TwccPacketInfo_t packetInfo;
-    #endif /* ENABLE_TWCC_SUPPORT */
+    uint8_t isAllocated = 0;
 
-    if( ( pSession == NULL ) ||
-        ( pTransceiver == NULL ) ||
-        ( pFrame == NULL ) )
+    if( ( pFrame == NULL ) ||
+        ( pPacketizedFrame == NULL ) )
     {
-        LogError( ( "Invalid input, pSession: %p, pTransceiver: %p, pFrame: %p",
-                    pSession, pTransceiver, pFrame ) );
-        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
-    }
-    else if( pTransceiver->trackKind != TRANSCEIVER_TRACK_KIND_VIDEO )
-    {
-        LogError( ( "Invalid track kind." ) );
+        LogError( ( "Invalid input, pFrame: %p, pPacketizedFrame: %p", pFrame, pPacketizedFrame ) );
         ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
     }
-    else
-    {
-        /* Empty else marker. */
-    }
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
@@ -207,205 +179,104 @@ PeerConnectionResult_t PeerConnectionH264Helper_WriteH264Frame( PeerConnectionSe
                                               &h264Frame );
         if( resultH264 != H264_RESULT_OK )
         {
-            LogError( ( "Fail to init H264 packetizer, result: %d", resultH264 ) );
+            LogError( ( "Fail to add frame in H264 packetizer, result: %d", resultH264 ) );
             ret = PEER_CONNECTION_RESULT_FAIL_PACKETIZER_ADD_FRAME;
         }
     }
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        pSsrc = &pTransceiver->ssrc;
-        pSrtpSender = &pSession->videoSrtpSender;
-        pRtpSeq = &pSession->rtpConfig.videoSequenceNumber;
-        payloadType = pSession->rtpConfig.videoCodecPayload;
-        if( ( pSession->rtpConfig.videoCodecRtxPayload != 0 ) &&
-            ( pSession->rtpConfig.videoCodecRtxPayload != pSession->rtpConfig.videoCodecPayload ) )
-        {
-            bufferAfterEncrypt = 0;
-        }
-
-        if( xSemaphoreTake( pSrtpSender->senderMutex,
-                            portMAX_DELAY ) == pdTRUE )
-        {
-            isLocked = 1;
-        }
-        else
+        ret = PeerConnectionPayloadHelper_AllocatePacketizedFrame( pPacketizedFrame,
+                                                                   pFrame->dataLength,
+                                                                   PEER_CONNECTION_SRTP_H264_MAX_NALUS_IN_A_FRAME );
+        if( ret == PEER_CONNECTION_RESULT_OK )
         {
-            LogError( ( "Fail to take sender mutex" ) );
-            ret = PEER_CONNECTION_RESULT_FAIL_TAKE_SENDER_MUTEX;
+            isAllocated = 1;
+            pPacketizedFrame->trackKind = TRANSCEIVER_TRACK_KIND_VIDEO;
+            pPacketizedFrame->rtpTimestamp = PEER_CONNECTION_SRTP_CONVERT_TIME_US_TO_RTP_TIMESTAMP( PEER_CONNECTION_SRTP_VIDEO_CLOCKRATE,
+                                                                                                    pFrame->presentationUs );
         }
     }
 
     while( ret == PEER_CONNECTION_RESULT_OK )
     {
-        /* Get buffer from sender for later use.
-         * PeerConnectionRollingBuffer_GetRtpSequenceBuffer() returns the buffer with its size.
-         * If the bufferAfterEncrypt = 0, we store only RTP payload to the buffer.
-         * If the bufferAfterEncrypt = 1, we store the encrypted SRTP packet to the buffer. */
-        pRollingBufferPacket = NULL;
-        ret = PeerConnectionRollingBuffer_GetRtpSequenceBuffer( &pSrtpSender->txRollingBuffer,
-                                                                *pRtpSeq,
-                                                                &pRollingBufferPacket );
-        if( ( ret != PEER_CONNECTION_RESULT_OK ) ||
-            ( pRollingBufferPacket == NULL ) )
+        ret = PeerConnectionPayloadHelper_GetNextPayloadBuffer( pPacketizedFrame,
+                                                                &packetH264.pPacketData,
+                                                                &packetH264.packetDataLength );
+        if( ret != PEER_CONNECTION_RESULT_OK )
         {
-            LogWarn( ( "Fail to get RTP buffer for seq: %u", *pRtpSeq ) );
             break;
         }
 
-        /* Get each NALU payload then serialize SRTP packet. */
-        if( bufferAfterEncrypt == 0 )
-        {
-            packetH264.pPacketData = pRollingBufferPacket->pPacketBuffer + PEER_CONNECTION_SRTP_RTX_WRITE_RESERVED_BYTES;
-            packetH264.packetDataLength = pRollingBufferPacket->packetBufferLength - PEER_CONNECTION_SRTP_RTX_WRITE_RESERVED_BYTES;
-
-            /* Using local buffer for SRTP packet, use the entire packet length. */
-            pSrtpPacket = rtpBuffer;
-            srtpPacketLength = PEER_CONNECTION_SRTP_RTP_PACKET_MAX_LENGTH;
-        }
-        else
-        {
-            /* Using local buffer for RTP payload only, set RTP payload length. */
-            packetH264.pPacketData = rtpBuffer;
-            packetH264.packetDataLength = PEER_CONNECTION_SRTP_RTP_PAYLOAD_MAX_LENGTH;
-
-            pSrtpPacket = pRollingBufferPacket->pPacketBuffer;
-            srtpPacketLength = pRollingBufferPacket->packetBufferLength;
-        }
-
         resultH264 = H264Packetizer_GetPacket( &h264PacketizerContext,
                                                &packetH264 );
         if( resultH264 == H264_RESULT_NO_MORE_PACKETS )
         {
-            PeerConnectionRollingBuffer_DiscardRtpSequenceBuffer( &pSrtpSender->txRollingBuffer,
-                                                                  pRollingBufferPacket );
-            /* Eraly break because no packet available. */
+            /* Early break because no packet available. */
             break;
         }
         else if( resultH264 == H264_RESULT_OK )
         {
-            /* Prepare RTP packet for each payload buffer. */
-            memset( &pRollingBufferPacket->rtpPacket,
-                    0,
-                    sizeof( RtpPacket_t ) );
-            pRollingBufferPacket->rtpPacket.header.payloadType = payloadType;
-            pRollingBufferPacket->rtpPacket.header.sequenceNumber = *pRtpSeq;
-            pRollingBufferPacket->rtpPacket.header.ssrc = *pSsrc;
-            if( h264PacketizerContext.naluCount == 0 )
-            {
-                /* This is the last packet, set the marker. */
-                pRollingBufferPacket->rtpPacket.header.flags |= RTP_HEADER_FLAG_MARKER;
-            }
-
-            pRollingBufferPacket->rtpPacket.header.csrcCount = 0;
-            pRollingBufferPacket->rtpPacket.header.pCsrc = NULL;
-            pRollingBufferPacket->rtpPacket.header.timestamp = PEER_CONNECTION_SRTP_CONVERT_TIME_US_TO_RTP_TIMESTAMP( PEER_CONNECTION_SRTP_VIDEO_CLOCKRATE,
-                                                                                                                      pFrame->presentationUs );
-
-            if( pSession->rtpConfig.twccId > 0 )
-            {
-                pRollingBufferPacket->rtpPacket.header.flags |= RTP_HEADER_FLAG_EXTENSION;
-                pRollingBufferPacket->rtpPacket.header.extension.extensionProfile = PEER_CONNECTION_SRTP_TWCC_EXT_PROFILE;
-                pRollingBufferPacket->rtpPacket.header.extension.extensionPayloadLength = 1;
-                pRollingBufferPacket->twccExtensionPayload = PEER_CONNECTION_SRTP_GET_TWCC_PAYLOAD( pSession->rtpConfig.twccId,
-                                                                                                    pSession->rtpConfig.twccSequence );
-                pRollingBufferPacket->rtpPacket.header.extension.pExtensionPayload = &pRollingBufferPacket->twccExtensionPayload;
-
-                #if ENABLE_TWCC_SUPPORT
-                memset( &packetInfo, 0, sizeof( TwccPacketInfo_t ) );
-                packetInfo.packetSize = packetH264.packetDataLength;
-                packetInfo.localSentTime = NetworkingUtils_GetCurrentTimeUs( NULL );
-                packetInfo.packetSeqNum = pSession->rtpConfig.twccSequence;
-
-                RtcpTwccManager_AddPacketInfo( &pSession->pCtx->rtcpTwccManager,
-                                               &packetInfo );
-                #endif /* ENABLE_TWCC_SUPPORT */
-
-                pSession->rtpConfig.twccSequence++;
-            }
-
-            pRollingBufferPacket->rtpPacket.payloadLength = packetH264.packetDataLength;
-            pRollingBufferPacket->rtpPacket.pPayload = packetH264.pPacketData;
-
-            /* PeerConnectionSrtp_ConstructSrtpPacket() serializes RTP packet and encrypt it. */
-            ret = PeerConnectionSrtp_ConstructSrtpPacket( pSession,
-                                                          &pRollingBufferPacket->rtpPacket,
-                                                          pSrtpPacket,
-                                                          &srtpPacketLength );
+            /* The last packet of the frame carries the marker. */
+            ret = PeerConnectionPayloadHelper_CommitPayload( pPacketizedFrame,
+                                                             packetH264.packetDataLength,
+                                                             ( h264PacketizerContext.naluCount == 0 ) ? 1U : 0U );
         }
         else
         {
             LogError( ( "Fail to get H264 packet, result: %d", resultH264 ) );
             ret = PEER_CONNECTION_RESULT_FAIL_PACKETIZER_GET_PACKET;
         }
+    }
 
-        if( ret == PEER_CONNECTION_RESULT_OK )
-        {
-            /* Update the rolling buffer length before storing. */
-            if( bufferAfterEncrypt == 0 )
-            {
-                pRollingBufferPacket->packetBufferLength = packetH264.packetDataLength;
-            }
-            else
-            {
-                pRollingBufferPacket->packetBufferLength = srtpPacketLength;
-            }
-
-            /* Udpate the packet into rolling buffer. */
-            ret = PeerConnectionRollingBuffer_SetPacket( &pSrtpSender->txRollingBuffer,
-                                                         ( *pRtpSeq )++,
-                                                         pRollingBufferPacket );
-        }
-
-        if( ( ret != PEER_CONNECTION_RESULT_OK ) && ( pRollingBufferPacket != NULL ) )
-        {
-            /* If any failure, release the allocated RTP buffer. */
-            PeerConnectionRollingBuffer_DiscardRtpSequenceBuffer( &pSrtpSender->txRollingBuffer,
-                                                                  pRollingBufferPacket );
-        }
+    if( ( ret != PEER_CONNECTION_RESULT_OK ) && ( isAllocated != 0U ) )
+    {
+        PeerConnectionPayloadHelper_FreePacketizedFrame( pPacketizedFrame );
+    }
 
-        /* Write the constructed RTP packets through network. */
-        if( ret == PEER_CONNECTION_RESULT_OK )
-        {
-            resultIceController = IceController_SendToRemotePeer( &pSession->iceControllerContext,
-                                                                  pSrtpPacket,
-                                                                  srtpPacketLength );
-            if( resultIceController != ICE_CONTROLLER_RESULT_OK )
-            {
-                LogWarn( ( "Fail to send RTP packet, ret: %d", resultIceController ) );
-                ret = PEER_CONNECTION_RESULT_FAIL_ICE_CONTROLLER_SEND_RTP_PACKET;
-            }
-        }
+    return ret;
+}
 
-        if( ret == PEER_CONNECTION_RESULT_OK )
-        {
-            packetSent++;
-            bytesSent += pRollingBufferPacket->rtpPacket.payloadLength;
-        }
+PeerConnectionResult_t PeerConnectionH264Helper_WriteH264Frame( PeerConnectionSession_t * pSession,
+                                                                Transceiver_t * pTransceiver,
+                                                                const PeerConnectionFrame_t * pFrame )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    PeerConnectionPacketizedFrame_t packetizedFrame;
 
-        #if METRIC_PRINT_ENABLED
-        if( ret == PEER_CONNECTION_RESULT_OK )
-        {
-            Metric_EndEvent( METRIC_EVENT_SENDING_FIRST_FRAME );
-        }
-        #endif
+    if( ( pSession == NULL ) ||
+        ( pTransceiver == NULL ) ||
+        ( pFrame == NULL ) )
+    {
+        LogError( ( "Invalid input, pSession: %p, pTransceiver: %p, pFrame: %p",
+                    pSession, pTransceiver, pFrame ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
     }
-
-    if( packetSent != 0 )
+    else if( pTransceiver->trackKind != TRANSCEIVER_TRACK_KIND_VIDEO )
     {
-        if( pTransceiver->rtpSender.rtpFirstFrameWallClockTimeUs == 0 )
-        {
-            pTransceiver->rtpSender.rtpFirstFrameWallClockTimeUs = NetworkingUtils_GetCurrentTimeUs( NULL );
-            pTransceiver->rtpSender.rtpTimeOffset = randomRtpTimeoffset;
-        }
+        LogError( ( "Invalid track kind." ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
 
-        pTransceiver->rtcpStats.rtpPacketsTransmitted += packetSent;
-        pTransceiver->rtcpStats.rtpBytesTransmitted += bytesSent;
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        memset( &packetizedFrame,
+                0,
+                sizeof( PeerConnectionPacketizedFrame_t ) );
+        ret = PeerConnectionH264Helper_PacketizeH264Frame( pFrame,
+                                                       &packetizedFrame );
     }
 
-    if( isLocked )
+    if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        xSemaphoreGive( pSrtpSender->senderMutex );
+        ret = PeerConnectionPayloadHelper_WritePacketizedFrame( pSession,
+                                                                pTransceiver,
+                                                                &packetizedFrame );
+        PeerConnectionPayloadHelper_FreePacketizedFrame( &packetizedFrame );
     }
 
     return ret;
@@ -41,6 +41,9 @@ PeerConnectionResult_t PeerConnectionH264Helper_FillFrameH264( PeerConnectionJit
                                                                size_t * pOutBufferLength,
                                                                uint32_t * pRtpTimestamp );
 
+PeerConnectionResult_t PeerConnectionH264Helper_PacketizeH264Frame( const PeerConnectionFrame_t * pFrame,
+                                                                   PeerConnectionPacketizedFrame_t * pPacketizedFrame );
+
 PeerConnectionResult_t PeerConnectionH264Helper_WriteH264Frame( PeerConnectionSession_t * pSession,
                                                                 Transceiver_t * pTransceiver,
                                                                 const PeerConnectionFrame_t * pFrame );
@@ -15,6 +15,7 @@
  */
 
 #include "include/peer_connection_codec_helper.h"
+#include "peer_connection_payload_helper.h"
 #include "h265_packetizer.h"
 #include "h265_depacketizer.h"
 
@@ -139,61 +140,32 @@ PeerConnectionResult_t PeerConnectionH265Helper_FillFrameH265( PeerConnectionJit
     return ret;
 }
 
-PeerConnectionResult_t PeerConnectionH265Helper_WriteH265Frame( PeerConnectionSession_t * pSession,
-                                                                Transceiver_t * pTransceiver,
-                                                                const PeerConnectionFrame_t * pFrame )
+PeerConnectionResult_t PeerConnectionH265Helper_PacketizeH265Frame( const PeerConnectionFrame_t * pFrame,
+                                                                   PeerConnectionPacketizedFrame_t * pPacketizedFrame )
 {
     PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
     H265PacketizerContext_t h265PacketizerContext;
-    H265Result_t resulth265;
-    H265Packet_t packeth265;
-    uint8_t rtpBuffer[ PEER_CONNECTION_SRTP_RTP_PACKET_MAX_LENGTH ];
-    PeerConnectionRollingBufferPacket_t * pRollingBufferPacket = NULL;
-    uint8_t * pSrtpPacket = NULL;
-    size_t srtpPacketLength = 0;
+    H265Result_t resultH265;
+    H265Packet_t packetH265;
     H265Nalu_t nalusArray[ PEER_CONNECTION_SRTP_H265_MAX_NALUS_IN_A_FRAME ];
     H265Frame_t h265Frame;
-    PeerConnectionSrtpSender_t * pSrtpSender = NULL;
-    uint8_t isLocked = 0;
-    uint8_t bufferAfterEncrypt = 1;
-    IceControllerResult_t resultIceController;
-    uint16_t * pRtpSeq = NULL;
-    uint32_t payloadType;
-    uint32_t * pSsrc = NULL;
-    uint32_t packetSent = 0;
-    uint32_t bytesSent = 0;
-    uint32_t randomRtpTimeoffset = 0;    // TODO : Spec required random rtp time offset ( current implementation of KVS SDK )
-    #if ENABLE_TWCC_SUPPORT
-    /* Add TWCC packet tracking */
-    TwccPacketInfo_t packetInfo;
-    #endif /* ENABLE_TWCC_SUPPORT */
+    uint8_t isAllocated = 0;
 
-    if( ( pSession == NULL ) ||
-        ( pTransceiver == NULL ) ||
-        ( pFrame == NULL ) )
-    {
-        LogError( ( "Invalid input, pSession: %p, pTransceiver: %p, pFrame: %p",
-                    pSession, pTransceiver, pFrame ) );
-        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
-    }
-    else if( pTransceiver->trackKind != TRANSCEIVER_TRACK_KIND_VIDEO )
+    if( ( pFrame == NULL ) ||
+        ( pPacketizedFrame == NULL ) )
     {
-        LogError( ( "Invalid track kind." ) );
+        LogError( ( "Invalid input, pFrame: %p, pPacketizedFrame: %p", pFrame, pPacketizedFrame ) );
         ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
     }
-    else
-    {
-        /* Empty else marker. */
-    }
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        resulth265 = H265Packetizer_Init( &h265PacketizerContext,
+        resultH265 = H265Packetizer_Init( &h265PacketizerContext,
                                           nalusArray,
                                           PEER_CONNECTION_SRTP_H265_MAX_NALUS_IN_A_FRAME );
-        if( resulth265 != H265_RESULT_OK )
+        if( resultH265 != H265_RESULT_OK )
         {
-            LogError( ( "Fail to init h265 packetizer, result: %d", resulth265 ) );
+            LogError( ( "Fail to init H265 packetizer, result: %d", resultH265 ) );
             ret = PEER_CONNECTION_RESULT_FAIL_PACKETIZER_INIT;
         }
     }
@@ -202,209 +174,108 @@ PeerConnectionResult_t PeerConnectionH265Helper_WriteH265Frame( PeerConnectionSe
     {
         h265Frame.pFrameData = pFrame->pData;
         h265Frame.frameDataLength = pFrame->dataLength;
-        resulth265 = H265Packetizer_AddFrame( &h265PacketizerContext,
+        resultH265 = H265Packetizer_AddFrame( &h265PacketizerContext,
                                               &h265Frame );
-        if( resulth265 != H265_RESULT_OK )
+        if( resultH265 != H265_RESULT_OK )
         {
-            LogError( ( "Fail to add frame in  h265 packetizer, result: %d", resulth265 ) );
+            LogError( ( "Fail to add frame in H265 packetizer, result: %d", resultH265 ) );
             ret = PEER_CONNECTION_RESULT_FAIL_PACKETIZER_ADD_FRAME;
         }
     }
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        pSsrc = &pTransceiver->ssrc;
-        pSrtpSender = &pSession->videoSrtpSender;
-        pRtpSeq = &pSession->rtpConfig.videoSequenceNumber;
-        payloadType = pSession->rtpConfig.videoCodecPayload;
-        if( ( pSession->rtpConfig.videoCodecRtxPayload != 0 ) &&
-            ( pSession->rtpConfig.videoCodecRtxPayload != pSession->rtpConfig.videoCodecPayload ) )
-        {
-            bufferAfterEncrypt = 0;
-        }
-
-        if( xSemaphoreTake( pSrtpSender->senderMutex,
-                            portMAX_DELAY ) == pdTRUE )
-        {
-            isLocked = 1;
-        }
-        else
+        ret = PeerConnectionPayloadHelper_AllocatePacketizedFrame( pPacketizedFrame,
+                                                                   pFrame->dataLength,
+                                                                   PEER_CONNECTION_SRTP_H265_MAX_NALUS_IN_A_FRAME );
+        if( ret == PEER_CONNECTION_RESULT_OK )
         {
-            LogError( ( "Fail to take sender mutex" ) );
-            ret = PEER_CONNECTION_RESULT_FAIL_TAKE_SENDER_MUTEX;
+            isAllocated = 1;
+            pPacketizedFrame->trackKind = TRANSCEIVER_TRACK_KIND_VIDEO;
+            pPacketizedFrame->rtpTimestamp = PEER_CONNECTION_SRTP_CONVERT_TIME_US_TO_RTP_TIMESTAMP( PEER_CONNECTION_SRTP_VIDEO_CLOCKRATE,
+                                                                                                    pFrame->presentationUs );
         }
     }
+
     while( ret == PEER_CONNECTION_RESULT_OK )
     {
-        /* Get buffer from sender for later use.
-         * PeerConnectionRollingBuffer_GetRtpSequenceBuffer() returns the buffer with its size.
-         * If the bufferAfterEncrypt = 0, we store only RTP payload to the buffer.
-         * If the bufferAfterEncrypt = 1, we store the encrypted SRTP packet to the buffer. */
-        pRollingBufferPacket = NULL;
-        ret = PeerConnectionRollingBuffer_GetRtpSequenceBuffer( &pSrtpSender->txRollingBuffer,
-                                                                *pRtpSeq,
-                                                                &pRollingBufferPacket );
-        if( ( ret != PEER_CONNECTION_RESULT_OK ) ||
-            ( pRollingBufferPacket == NULL ) )
+        ret = PeerConnectionPayloadHelper_GetNextPayloadBuffer( pPacketizedFrame,
+                                                                &packetH265.pPacketData,
+                                                                &packetH265.packetDataLength );
+        if( ret != PEER_CONNECTION_RESULT_OK )
         {
-            LogWarn( ( "Fail to get RTP buffer for seq: %u", *pRtpSeq ) );
             break;
         }
 
-        /* Get each NALU payload then serialize SRTP packet. */
-        if( bufferAfterEncrypt == 0 )
+        resultH265 = H265Packetizer_GetPacket( &h265PacketizerContext,
+                                               &packetH265 );
+        if( resultH265 == H265_RESULT_NO_MORE_PACKETS )
         {
-            packeth265.pPacketData = pRollingBufferPacket->pPacketBuffer + PEER_CONNECTION_SRTP_RTX_WRITE_RESERVED_BYTES;
-            packeth265.packetDataLength = pRollingBufferPacket->packetBufferLength - PEER_CONNECTION_SRTP_RTX_WRITE_RESERVED_BYTES;
-
-            /* Using local buffer for SRTP packet, use the entire packet length. */
-            pSrtpPacket = rtpBuffer;
-            srtpPacketLength = PEER_CONNECTION_SRTP_RTP_PACKET_MAX_LENGTH;
-        }
-        else
-        {
-            /* Using local buffer for RTP payload only, set RTP payload length. */
-            packeth265.pPacketData = rtpBuffer;
-            packeth265.packetDataLength = PEER_CONNECTION_SRTP_RTP_PAYLOAD_MAX_LENGTH;
-
-            pSrtpPacket = pRollingBufferPacket->pPacketBuffer;
-            srtpPacketLength = pRollingBufferPacket->packetBufferLength;
-        }
-
-        resulth265 = H265Packetizer_GetPacket( &h265PacketizerContext,
-                                               &packeth265 );
-
-        if( resulth265 == H265_RESULT_NO_MORE_PACKETS )
-        {
-            PeerConnectionRollingBuffer_DiscardRtpSequenceBuffer( &pSrtpSender->txRollingBuffer,
-                                                                  pRollingBufferPacket );
             /* Early break because no packet available. */
             break;
         }
-        else if( resulth265 == H265_RESULT_OK )
+        else if( resultH265 == H265_RESULT_OK )
         {
-            /* Prepare RTP packet for each payload buffer. */
-            memset( &pRollingBufferPacket->rtpPacket, 0, sizeof( RtpPacket_t ) );
-            pRollingBufferPacket->rtpPacket.header.payloadType = payloadType;
-            pRollingBufferPacket->rtpPacket.header.sequenceNumber = *pRtpSeq;
-            pRollingBufferPacket->rtpPacket.header.ssrc = *pSsrc;
-            if( h265PacketizerContext.naluCount == 0 )
-            {
-                /* This is the last packet, set the marker. */
-                pRollingBufferPacket->rtpPacket.header.flags |= RTP_HEADER_FLAG_MARKER;
-            }
-
-            pRollingBufferPacket->rtpPacket.header.csrcCount = 0;
-            pRollingBufferPacket->rtpPacket.header.pCsrc = NULL;
-            pRollingBufferPacket->rtpPacket.header.timestamp = PEER_CONNECTION_SRTP_CONVERT_TIME_US_TO_RTP_TIMESTAMP( PEER_CONNECTION_SRTP_VIDEO_CLOCKRATE,
-                                                                                                                      pFrame->presentationUs );
-
-            if( pSession->rtpConfig.twccId > 0 )
-            {
-                pRollingBufferPacket->rtpPacket.header.flags |= RTP_HEADER_FLAG_EXTENSION;
-                pRollingBufferPacket->rtpPacket.header.extension.extensionProfile = PEER_CONNECTION_SRTP_TWCC_EXT_PROFILE;
-                pRollingBufferPacket->rtpPacket.header.extension.extensionPayloadLength = 1;
-                pRollingBufferPacket->twccExtensionPayload = PEER_CONNECTION_SRTP_GET_TWCC_PAYLOAD( pSession->rtpConfig.twccId,
-                                                                                                    pSession->rtpConfig.twccSequence );
-                pRollingBufferPacket->rtpPacket.header.extension.pExtensionPayload = &pRollingBufferPacket->twccExtensionPayload;
-
-                #if ENABLE_TWCC_SUPPORT
-                memset( &packetInfo,
-                        0,
-                        sizeof( TwccPacketInfo_t ) );
-                packetInfo.packetSize = packeth265.packetDataLength;
-                packetInfo.localSentTime = NetworkingUtils_GetCurrentTimeUs( NULL );
-                packetInfo.packetSeqNum = pSession->rtpConfig.twccSequence;
-
-                RtcpTwccManager_AddPacketInfo( &pSession->pCtx->rtcpTwccManager,
-                                               &packetInfo );
-                #endif /* ENABLE_TWCC_SUPPORT */
-
-                pSession->rtpConfig.twccSequence++;
-            }
-
-            pRollingBufferPacket->rtpPacket.payloadLength = packeth265.packetDataLength;
-            pRollingBufferPacket->rtpPacket.pPayload = packeth265.pPacketData;
-
-            /* PeerConnectionSrtp_ConstructSrtpPacket() serializes RTP packet and encrypt it. */
-            ret = PeerConnectionSrtp_ConstructSrtpPacket( pSession,
-                                                          &pRollingBufferPacket->rtpPacket,
-                                                          pSrtpPacket,
-                                                          &srtpPacketLength );
+            /* The last packet of the frame carries the marker. */
+            ret = PeerConnectionPayloadHelper_CommitPayload( pPacketizedFrame,
+                                                             packetH265.packetDataLength,
+                                                             ( h265PacketizerContext.naluCount == 0 ) ? 1U : 0U );
         }
         else
         {
-            LogError( ( "Fail to get h265 packet, result: %d", resulth265 ) );
+            LogError( ( "Fail to get H265 packet, result: %d", resultH265 ) );
             ret = PEER_CONNECTION_RESULT_FAIL_PACKETIZER_GET_PACKET;
         }
+    }
 
-        if( ret == PEER_CONNECTION_RESULT_OK )
-        {
-            /* Update the rolling buffer length before storing. */
-            if( bufferAfterEncrypt == 0 )
-            {
-                pRollingBufferPacket->packetBufferLength = packeth265.packetDataLength;
-            }
-            else
-            {
-                pRollingBufferPacket->packetBufferLength = srtpPacketLength;
-            }
-
-            /* Udpate the packet into rolling buffer. */
-            ret = PeerConnectionRollingBuffer_SetPacket( &pSrtpSender->txRollingBuffer,
-                                                         ( *pRtpSeq )++,
-                                                         pRollingBufferPacket );
-        }
-
-        if( ( ret != PEER_CONNECTION_RESULT_OK ) && ( pRollingBufferPacket != NULL ) )
-        {
-            /* If any failure, release the allocated RTP buffer. */
-            PeerConnectionRollingBuffer_DiscardRtpSequenceBuffer( &pSrtpSender->txRollingBuffer,
-                                                                  pRollingBufferPacket );
-        }
+    if( ( ret != PEER_CONNECTION_RESULT_OK ) && ( isAllocated != 0U ) )
+    {
+        PeerConnectionPayloadHelper_FreePacketizedFrame( pPacketizedFrame );
+    }
 
-        /* Write the constructed RTP packets through network. */
-        if( ret == PEER_CONNECTION_RESULT_OK )
-        {
-            resultIceController = IceController_SendToRemotePeer( &pSession->iceControllerContext,
-                                                                  pSrtpPacket,
-                                                                  srtpPacketLength );
-            if( resultIceController != ICE_CONTROLLER_RESULT_OK )
-            {
-                LogWarn( ( "Fail to send RTP packet, ret: %d", resultIceController ) );
-                ret = PEER_CONNECTION_RESULT_FAIL_ICE_CONTROLLER_SEND_RTP_PACKET;
-            }
-        }
+    return ret;
+}
 
-        if( ret == PEER_CONNECTION_RESULT_OK )
-        {
-            packetSent++;
-            bytesSent += pRollingBufferPacket->rtpPacket.payloadLength;
-        }
+PeerConnectionResult_t PeerConnectionH265Helper_WriteH265Frame( PeerConnectionSession_t * pSession,
+                                                                Transceiver_t * pTransceiver,
+                                                                const PeerConnectionFrame_t * pFrame )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    PeerConnectionPacketizedFrame_t packetizedFrame;
 
-        #if METRIC_PRINT_ENABLED
-        if( ret == PEER_CONNECTION_RESULT_OK )
-        {
-            Metric_EndEvent( METRIC_EVENT_SENDING_FIRST_FRAME );
-        }
-        #endif
+    if( ( pSession == NULL ) ||
+        ( pTransceiver == NULL ) ||
+        ( pFrame == NULL ) )
+    {
+        LogError( ( "Invalid input, pSession: %p, pTransceiver: %p, pFrame: %p",
+                    pSession, pTransceiver, pFrame ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
     }
-
-    if( packetSent != 0 )
+    else if( pTransceiver->trackKind != TRANSCEIVER_TRACK_KIND_VIDEO )
     {
-        if( pTransceiver->rtpSender.rtpFirstFrameWallClockTimeUs == 0 )
-        {
-            pTransceiver->rtpSender.rtpFirstFrameWallClockTimeUs = NetworkingUtils_GetCurrentTimeUs( NULL );
-            pTransceiver->rtpSender.rtpTimeOffset = randomRtpTimeoffset;
-        }
+        LogError( ( "Invalid track kind." ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
 
-        pTransceiver->rtcpStats.rtpPacketsTransmitted += packetSent;
-        pTransceiver->rtcpStats.rtpBytesTransmitted += bytesSent;
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        memset( &packetizedFrame,
+                0,
+                sizeof( PeerConnectionPacketizedFrame_t ) );
+        ret = PeerConnectionH265Helper_PacketizeH265Frame( pFrame,
+                                                       &packetizedFrame );
     }
 
-    if( isLocked )
+    if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        xSemaphoreGive( pSrtpSender->senderMutex );
+        ret = PeerConnectionPayloadHelper_WritePacketizedFrame( pSession,
+                                                                pTransceiver,
+                                                                &packetizedFrame );
+        PeerConnectionPayloadHelper_FreePacketizedFrame( &packetizedFrame );
     }
 
     return ret;
@@ -41,6 +41,9 @@ PeerConnectionResult_t PeerConnectionH265Helper_FillFrameH265( PeerConnectionJit
                                                                size_t * pOutBufferLength,
                                                                uint32_t * pRtpTimestamp );
 
+PeerConnectionResult_t PeerConnectionH265Helper_PacketizeH265Frame( const PeerConnectionFrame_t * pFrame,
+                                                                   PeerConnectionPacketizedFrame_t * pPacketizedFrame );
+
 PeerConnectionResult_t PeerConnectionH265Helper_WriteH265Frame( PeerConnectionSession_t * pSession,
                                                                 Transceiver_t * pTransceiver,
                                                                 const PeerConnectionFrame_t * pFrame );
@@ -41,6 +41,9 @@ PeerConnectionResult_t PeerConnectionOpusHelper_FillFrameOpus( PeerConnectionJit
                                                                size_t * pOutBufferLength,
                                                                uint32_t * pRtpTimestamp );
 
+PeerConnectionResult_t PeerConnectionOpusHelper_PacketizeOpusFrame( const PeerConnectionFrame_t * pFrame,
+                                                                    PeerConnectionPacketizedFrame_t * pPacketizedFrame );
+
 PeerConnectionResult_t PeerConnectionOpusHelper_WriteOpusFrame( PeerConnectionSession_t * pSession,
                                                                 Transceiver_t * pTransceiver,
                                                                 const PeerConnectionFrame_t * pFrame );
@@ -0,0 +1,722 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "include/peer_connection_codec_helper.h"
+#include "peer_connection_payload_helper.h"
+#include "peer_connection_pacer.h"
+#include "peer_connection_twcc.h"
+#include "peer_connection_fec.h"
+#include "peer_connection_red.h"
+#include "peer_connection_send_scheduler.h"
+
+#include "task.h"
+
+/* The largest header a packetizer prepends to a fragment, 2 bytes for H264 FU-A and 3 bytes for H265 FU. */
+#define PEER_CONNECTION_PAYLOAD_HELPER_MAX_FRAGMENT_HEADER_LENGTH ( 3 )
+
+PeerConnectionResult_t PeerConnectionPayloadHelper_AllocatePacketizedFrame( PeerConnectionPacketizedFrame_t * pPacketizedFrame,
+                                                                           size_t frameLength,
+                                                                           size_t maxNaluCount )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    size_t maxPayloadCount;
+    size_t payloadBufferLength;
+    uint8_t * pMemory = NULL;
+
+    if( pPacketizedFrame == NULL )
+    {
+        LogError( ( "Invalid input, pPacketizedFrame: %p", pPacketizedFrame ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        /* Every NALU may end with a partial fragment, and every fragment may carry a fragment header. */
+        maxPayloadCount = frameLength / ( PEER_CONNECTION_SRTP_RTP_PAYLOAD_MAX_LENGTH - PEER_CONNECTION_PAYLOAD_HELPER_MAX_FRAGMENT_HEADER_LENGTH ) + maxNaluCount + 1;
+        payloadBufferLength = frameLength + maxPayloadCount * PEER_CONNECTION_PAYLOAD_HELPER_MAX_FRAGMENT_HEADER_LENGTH;
+
+        pMemory = ( uint8_t * ) pvPortMalloc( maxPayloadCount * sizeof( PeerConnectionPacketizedPayload_t ) + payloadBufferLength );
+        if( pMemory == NULL )
+        {
+            LogError( ( "Fail to allocate packetized frame, frame length: %u", frameLength ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_PACKETIZED_FRAME_ALLOCATE;
+        }
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        pPacketizedFrame->pPayloads = ( PeerConnectionPacketizedPayload_t * ) pMemory;
+        pPacketizedFrame->payloadCount = 0;
+        pPacketizedFrame->maxPayloadCount = maxPayloadCount;
+        pPacketizedFrame->pPayloadBuffer = pMemory + maxPayloadCount * sizeof( PeerConnectionPacketizedPayload_t );
+        pPacketizedFrame->payloadBufferLength = payloadBufferLength;
+        pPacketizedFrame->payloadBufferUsedLength = 0;
+    }
+
+    return ret;
+}
+
+void PeerConnectionPayloadHelper_FreePacketizedFrame( PeerConnectionPacketizedFrame_t * pPacketizedFrame )
+{
+    if( ( pPacketizedFrame != NULL ) && ( pPacketizedFrame->pPayloads != NULL ) )
+    {
+        /* Payload descriptors and payload buffer are in the same allocation. */
+        vPortFree( pPacketizedFrame->pPayloads );
+        pPacketizedFrame->pPayloads = NULL;
+        pPacketizedFrame->pPayloadBuffer = NULL;
+        pPacketizedFrame->payloadCount = 0;
+        pPacketizedFrame->maxPayloadCount = 0;
+        pPacketizedFrame->payloadBufferLength = 0;
+        pPacketizedFrame->payloadBufferUsedLength = 0;
+    }
+}
+
+PeerConnectionResult_t PeerConnectionPayloadHelper_GetNextPayloadBuffer( PeerConnectionPacketizedFrame_t * pPacketizedFrame,
+                                                                        uint8_t ** ppBuffer,
+                                                                        size_t * pBufferLength )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    size_t remainingLength;
+
+    if( ( pPacketizedFrame == NULL ) ||
+        ( ppBuffer == NULL ) ||
+        ( pBufferLength == NULL ) )
+    {
+        LogError( ( "Invalid input, pPacketizedFrame: %p, ppBuffer: %p, pBufferLength: %p", pPacketizedFrame, ppBuffer, pBufferLength ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        remainingLength = pPacketizedFrame->payloadBufferLength - pPacketizedFrame->payloadBufferUsedLength;
+        if( ( pPacketizedFrame->payloadCount >= pPacketizedFrame->maxPayloadCount ) ||
+            ( remainingLength == 0 ) )
+        {
+            LogError( ( "No space left in packetized frame, payload count: %u, used length: %u",
+                        pPacketizedFrame->payloadCount, pPacketizedFrame->payloadBufferUsedLength ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_PACKETIZED_FRAME_FULL;
+        }
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        *ppBuffer = pPacketizedFrame->pPayloadBuffer + pPacketizedFrame->payloadBufferUsedLength;
+        *pBufferLength = ( remainingLength < PEER_CONNECTION_SRTP_RTP_PAYLOAD_MAX_LENGTH ) ? remainingLength : PEER_CONNECTION_SRTP_RTP_PAYLOAD_MAX_LENGTH;
+    }
+
+    return ret;
+}
+
+PeerConnectionResult_t PeerConnectionPayloadHelper_CommitPayload( PeerConnectionPacketizedFrame_t * pPacketizedFrame,
+                                                                 size_t payloadLength,
+                                                                 uint8_t isMarker )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    PeerConnectionPacketizedPayload_t * pPayload;
+
+    if( pPacketizedFrame == NULL )
+    {
+        LogError( ( "Invalid input, pPacketizedFrame: %p", pPacketizedFrame ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+    else if( ( pPacketizedFrame->payloadCount >= pPacketizedFrame->maxPayloadCount ) ||
+             ( payloadLength > pPacketizedFrame->payloadBufferLength - pPacketizedFrame->payloadBufferUsedLength ) )
+    {
+        LogError( ( "Payload doesn't fit in packetized frame, payload length: %u", payloadLength ) );
+        ret = PEER_CONNECTION_RESULT_FAIL_PACKETIZED_FRAME_FULL;
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        pPayload = &pPacketizedFrame->pPayloads[ pPacketizedFrame->payloadCount++ ];
+        pPayload->pPayload = pPacketizedFrame->pPayloadBuffer + pPacketizedFrame->payloadBufferUsedLength;
+        pPayload->payloadLength = payloadLength;
+        pPayload->isMarker = isMarker;
+        pPacketizedFrame->payloadBufferUsedLength += payloadLength;
+    }
+
+    return ret;
+}
+
+static PeerConnectionResult_t BuildFecPacket( PeerConnectionSession_t * pSession,
+                                             PeerConnectionFecEncoder_t * pFecEncoder,
+                                             uint32_t rtpTimestamp,
+                                             uint8_t ** ppSrtpPacket,
+                                             size_t * pSrtpPacketLength )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    uint32_t twccExtensionPayload = 0U;
+    uint8_t * pRtpPacket = NULL;
+    size_t rtpPacketLength;
+    size_t srtpPacketLength;
+
+    if( pFecEncoder->rtpHeaderTemplate.twccId > 0 )
+    {
+        twccExtensionPayload = PEER_CONNECTION_SRTP_GET_TWCC_PAYLOAD( pFecEncoder->rtpHeaderTemplate.twccId,
+                                                                      pSession->rtpConfig.twccSequence );
+    }
+
+    rtpPacketLength = PeerConnectionFec_BuildPacket( pFecEncoder,
+                                                     rtpTimestamp,
+                                                     twccExtensionPayload,
+                                                     &pRtpPacket );
+    if( rtpPacketLength == 0U )
+    {
+        LogWarn( ( "No FEC packet to build" ) );
+        ret = PEER_CONNECTION_RESULT_FAIL_PACKETIZER_GET_PACKET;
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        /* FEC packets are paced and acknowledged like media, they are never re-transmitted. */
+        if( pFecEncoder->rtpHeaderTemplate.twccId > 0 )
+        {
+            #if ENABLE_TWCC_SUPPORT
+            /* Record the RTP payload size like the media packets do. */
+            PeerConnectionTwcc_AddPacket( &pSession->twccHistory,
+                                          pSession->rtpConfig.twccSequence,
+                                          rtpPacketLength - pFecEncoder->rtpHeaderTemplate.headerLength,
+                                          NetworkingUtils_GetCurrentTimeUs( NULL ) );
+            #endif /* ENABLE_TWCC_SUPPORT */
+
+            pSession->rtpConfig.twccSequence++;
+        }
+
+        /* Encrypt in place, the encoder buffer leaves room for the authentication tag. */
+        srtpPacketLength = PEER_CONNECTION_FEC_PACKET_MAX_LENGTH - ( size_t )( pRtpPacket - pFecEncoder->packet );
+        ret = PeerConnectionSrtp_EncryptRtpPacketInBatch( pSession,
+                                                          pRtpPacket,
+                                                          rtpPacketLength,
+                                                          pRtpPacket,
+                                                          &srtpPacketLength );
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        *ppSrtpPacket = pRtpPacket;
+        *pSrtpPacketLength = srtpPacketLength;
+    }
+
+    return ret;
+}
+
+PeerConnectionResult_t PeerConnectionPayloadHelper_WritePacketizedFrameBurst( PeerConnectionSession_t * pSession,
+                                                                             Transceiver_t * pTransceiver,
+                                                                             const PeerConnectionPacketizedFrame_t * pPacketizedFrame,
+                                                                             size_t * pNextPayloadIndex,
+                                                                             uint32_t * pPacingDelayMs )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    PeerConnectionRollingBufferPacket_t * pRollingBufferPacket = NULL;
+    const PeerConnectionPacketizedPayload_t * pPayload = NULL;
+    uint8_t * pPayloadStart = NULL;
+    size_t payloadLength = 0;
+    uint8_t * pRtpPacket = NULL;
+    size_t rtpHeaderLength = 0;
+    uint8_t * pSrtpPacket = NULL;
+    size_t srtpPacketLength = 0;
+    PeerConnectionSrtpSender_t * pSrtpSender = NULL;
+    PeerConnectionFecEncoder_t * pFecEncoder = NULL;
+    PeerConnectionRedEncoder_t * pRedEncoder = NULL;
+    uint8_t * pFecSrtpPacket = NULL;
+    size_t fecSrtpPacketLength = 0;
+    uint8_t isFecPending = 0U;
+    uint8_t isLocked = 0;
+    uint8_t isSrtpBatchLocked = 0U;
+    uint8_t bufferAfterEncrypt = 1;
+    IceControllerResult_t resultIceController;
+    PeerConnectionSendClass_t sendClass = PEER_CONNECTION_SEND_CLASS_URGENT;
+    uint16_t * pRtpSeq = NULL;
+    uint32_t packetSent = 0;
+    uint32_t bytesSent = 0;
+    /* One more for the FEC packet closing a group, it's always the last of its batch. */
+    IceControllerSendBuffer_t sendBuffers[ PEER_CONNECTION_SRTP_SEND_BATCH_MAX_COUNT + 1 ];
+    size_t sendBufferCount = 0;
+    size_t maxSendBufferCount = PEER_CONNECTION_SRTP_SEND_BATCH_MAX_COUNT;
+    uint32_t pendingBytes = 0;
+    size_t i = 0;
+    uint64_t currentTimeUs;
+    uint32_t randomRtpTimeoffset = 0;    // TODO : Spec required random rtp time offset ( current implementation of KVS SDK )
+
+    if( ( pSession == NULL ) ||
+        ( pTransceiver == NULL ) ||
+        ( pPacketizedFrame == NULL ) ||
+        ( pNextPayloadIndex == NULL ) ||
+        ( pPacingDelayMs == NULL ) )
+    {
+        LogError( ( "Invalid input, pSession: %p, pTransceiver: %p, pPacketizedFrame: %p, pNextPayloadIndex: %p, pPacingDelayMs: %p",
+                    pSession, pTransceiver, pPacketizedFrame, pNextPayloadIndex, pPacingDelayMs ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+    else if( pTransceiver->trackKind != pPacketizedFrame->trackKind )
+    {
+        LogError( ( "Invalid track kind, transceiver: %d, packetized frame: %d", pTransceiver->trackKind, pPacketizedFrame->trackKind ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        *pPacingDelayMs = 0U;
+
+        if( pTransceiver->trackKind == TRANSCEIVER_TRACK_KIND_VIDEO )
+        {
+            pSrtpSender = &pSession->videoSrtpSender;
+            pRtpSeq = &pSession->rtpConfig.videoSequenceNumber;
+            sendClass = PEER_CONNECTION_SEND_CLASS_VIDEO;
+            if( pSrtpSender->fecEncoder.isEnabled != 0U )
+            {
+                pFecEncoder = &pSrtpSender->fecEncoder;
+            }
+            if( ( pSession->rtpConfig.videoCodecRtxPayload != 0 ) &&
+                ( pSession->rtpConfig.videoCodecRtxPayload != pSession->rtpConfig.videoCodecPayload ) )
+            {
+                bufferAfterEncrypt = 0;
+            }
+        }
+        else
+        {
+            pSrtpSender = &pSession->audioSrtpSender;
+            pRtpSeq = &pSession->rtpConfig.audioSequenceNumber;
+            if( pSrtpSender->redEncoder.isEnabled != 0U )
+            {
+                pRedEncoder = &pSrtpSender->redEncoder;
+            }
+            if( ( pSession->rtpConfig.audioCodecRtxPayload != 0 ) &&
+                ( pSession->rtpConfig.audioCodecRtxPayload != pSession->rtpConfig.audioCodecPayload ) )
+            {
+                bufferAfterEncrypt = 0;
+            }
+        }
+
+        if( xSemaphoreTake( pSrtpSender->senderMutex,
+                            portMAX_DELAY ) == pdTRUE )
+        {
+            isLocked = 1;
+        }
+        else
+        {
+            LogError( ( "Fail to take sender mutex" ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_TAKE_SENDER_MUTEX;
+        }
+    }
+
+    if( ( ret == PEER_CONNECTION_RESULT_OK ) && ( bufferAfterEncrypt == 0 ) )
+    {
+        /* The rolling buffer keeps plain RTP payloads, so the SRTP packets are encrypted into the batch buffer. */
+        if( ( pSrtpSender->pSendBatchBuffer == NULL ) || ( pSrtpSender->sendBatchBufferCount == 0U ) )
+        {
+            LogError( ( "No send batch buffer for the sender." ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_SEND_BATCH_BUFFER_ALLOCATE;
+        }
+        else
+        {
+            maxSendBufferCount = pSrtpSender->sendBatchBufferCount;
+        }
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        /* Continue where the previous burst of this frame stopped. */
+        i = *pNextPayloadIndex;
+    }
+
+    for( ; ( ret == PEER_CONNECTION_RESULT_OK ) && ( i < pPacketizedFrame->payloadCount ); i++ )
+    {
+        /* Stop at a batch boundary once the pacing budget is used up, the caller waits without holding the sender. */
+        if( ( sendClass == PEER_CONNECTION_SEND_CLASS_VIDEO ) && ( sendBufferCount == 0U ) )
+        {
+            *pPacingDelayMs = PeerConnectionPacer_GetDelay( &pSrtpSender->pacer );
+            if( *pPacingDelayMs != 0U )
+            {
+                #if METRIC_PRINT_ENABLED
+                Metric_IncreaseCounter( METRIC_COUNTER_PACER_WAIT, 1U );
+                Metric_IncreaseCounter( METRIC_COUNTER_PACER_DELAY_MS, *pPacingDelayMs );
+                #endif
+                break;
+            }
+
+            if( PeerConnectionSendScheduler_IsRtxWaiting( &pSession->sendScheduler ) != 0U )
+            {
+                /* A re-transmission waits for the sender mutex, let it go out before the next batch.
+                 * Nothing of this frame is in flight here, the batch buffer is free for it. */
+                xSemaphoreGive( pSrtpSender->senderMutex );
+                taskYIELD();
+                if( xSemaphoreTake( pSrtpSender->senderMutex,
+                                    portMAX_DELAY ) != pdTRUE )
+                {
+                    LogError( ( "Fail to take sender mutex" ) );
+                    isLocked = 0;
+                    ret = PEER_CONNECTION_RESULT_FAIL_TAKE_SENDER_MUTEX;
+                    break;
+                }
+            }
+        }
+
+        pPayload = &pPacketizedFrame->pPayloads[ i ];
+
+        /* Get buffer from sender for later use.
+         * PeerConnectionRollingBuffer_GetRtpSequenceBuffer() returns the buffer with its size.
+         * If the bufferAfterEncrypt = 0, we store only RTP payload to the buffer.
+         * If the bufferAfterEncrypt = 1, we store the encrypted SRTP packet to the buffer. */
+        pRollingBufferPacket = NULL;
+        ret = PeerConnectionRollingBuffer_GetRtpSequenceBuffer( &pSrtpSender->txRollingBuffer,
+                                                                *pRtpSeq,
+                                                                &pRollingBufferPacket );
+        if( ( ret != PEER_CONNECTION_RESULT_OK ) ||
+            ( pRollingBufferPacket == NULL ) )
+        {
+            LogWarn( ( "Fail to get RTP buffer for seq: %u", *pRtpSeq ) );
+            break;
+        }
+
+        /* Copy the payload shared by all sessions to its final offset in the slot,
+         * the RTP header is written into the headroom in front of it. */
+        if( pPayload->payloadLength + PEER_CONNECTION_SRTP_RTP_HEADROOM_LENGTH > pRollingBufferPacket->packetBufferLength )
+        {
+            LogError( ( "Payload length %u exceeds rolling buffer packet size %u", pPayload->payloadLength, pRollingBufferPacket->packetBufferLength ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_PACKETIZER_GET_PACKET;
+        }
+        else if( pRedEncoder != NULL )
+        {
+            /* The previous frames depend on what this session sent, so RED is added per session.
+             * Every slot has room for a full RTP payload behind the headroom. */
+            pPayloadStart = pRollingBufferPacket->pPacketBuffer + PEER_CONNECTION_SRTP_RTP_HEADROOM_LENGTH;
+            ret = PeerConnectionRed_WritePayload( pRedEncoder,
+                                                  pPayload->pPayload,
+                                                  pPayload->payloadLength,
+                                                  pPacketizedFrame->rtpTimestamp,
+                                                  pPayloadStart,
+                                                  PEER_CONNECTION_SRTP_RTP_PAYLOAD_MAX_LENGTH,
+                                                  &payloadLength );
+        }
+        else
+        {
+            pPayloadStart = pRollingBufferPacket->pPacketBuffer + PEER_CONNECTION_SRTP_RTP_HEADROOM_LENGTH;
+            memcpy( pPayloadStart,
+                    pPayload->pPayload,
+                    pPayload->payloadLength );
+            payloadLength = pPayload->payloadLength;
+        }
+
+        if( ret == PEER_CONNECTION_RESULT_OK )
+        {
+            /* Keep what a re-transmission needs to rebuild the header, the rest comes from the sender's template. */
+            pRollingBufferPacket->rtpPacket.header.sequenceNumber = *pRtpSeq;
+            pRollingBufferPacket->rtpPacket.header.timestamp = pPacketizedFrame->rtpTimestamp;
+            pRollingBufferPacket->rtpPacket.header.flags = ( pPayload->isMarker != 0U ) ? RTP_HEADER_FLAG_MARKER : 0U;
+            pRollingBufferPacket->rtpPacket.pPayload = pPayloadStart;
+            pRollingBufferPacket->rtpPacket.payloadLength = payloadLength;
+            pRollingBufferPacket->twccExtensionPayload = 0U;
+
+            if( pSrtpSender->rtpHeaderTemplate.twccId > 0 )
+            {
+                pRollingBufferPacket->twccExtensionPayload = PEER_CONNECTION_SRTP_GET_TWCC_PAYLOAD( pSrtpSender->rtpHeaderTemplate.twccId,
+                                                                                                    pSession->rtpConfig.twccSequence );
+
+                #if ENABLE_TWCC_SUPPORT
+                PeerConnectionTwcc_AddPacket( &pSession->twccHistory,
+                                              pSession->rtpConfig.twccSequence,
+                                              payloadLength,
+                                              NetworkingUtils_GetCurrentTimeUs( NULL ) );
+                #endif /* ENABLE_TWCC_SUPPORT */
+
+                pSession->rtpConfig.twccSequence++;
+            }
+
+            pRtpPacket = pPayloadStart - pSrtpSender->rtpHeaderTemplate.headerLength;
+            rtpHeaderLength = PeerConnectionSrtp_WriteRtpHeader( &pSrtpSender->rtpHeaderTemplate,
+                                                                 pRtpPacket,
+                                                                 *pRtpSeq,
+                                                                 pPacketizedFrame->rtpTimestamp,
+                                                                 pPayload->isMarker,
+                                                                 pRollingBufferPacket->twccExtensionPayload );
+
+            if( pFecEncoder != NULL )
+            {
+                /* Protect the plain packet, it may be encrypted in place below. */
+                PeerConnectionFec_AddPacket( pFecEncoder,
+                                             pRtpPacket,
+                                             rtpHeaderLength + payloadLength );
+            }
+        }
+
+        if( ret == PEER_CONNECTION_RESULT_OK )
+        {
+            if( bufferAfterEncrypt == 0 )
+            {
+                /* Keep the plain payload in the slot for re-transmission, encrypt into the batch buffer. */
+                pSrtpPacket = pSrtpSender->pSendBatchBuffer + sendBufferCount * PEER_CONNECTION_SRTP_RTP_PACKET_MAX_LENGTH;
+                srtpPacketLength = PEER_CONNECTION_SRTP_RTP_PACKET_MAX_LENGTH;
+            }
+            else
+            {
+                /* Encrypt in place, the slot keeps the SRTP packet. */
+                pSrtpPacket = pRtpPacket;
+                srtpPacketLength = pRollingBufferPacket->packetBufferLength - ( size_t )( pRtpPacket - pRollingBufferPacket->pPacketBuffer );
+            }
+
+            /* Take the Tx SRTP session once for all packets of a send batch. */
+            if( isSrtpBatchLocked == 0U )
+            {
+                ret = PeerConnectionSrtp_BeginEncryptBatch( pSession );
+                if( ret == PEER_CONNECTION_RESULT_OK )
+                {
+                    isSrtpBatchLocked = 1U;
+                }
+            }
+        }
+
+        if( ret == PEER_CONNECTION_RESULT_OK )
+        {
+            ret = PeerConnectionSrtp_EncryptRtpPacketInBatch( pSession,
+                                                              pRtpPacket,
+                                                              rtpHeaderLength + payloadLength,
+                                                              pSrtpPacket,
+                                                              &srtpPacketLength );
+        }
+
+        if( ret == PEER_CONNECTION_RESULT_OK )
+        {
+            /* Update the rolling buffer length before storing. */
+            if( bufferAfterEncrypt == 0 )
+            {
+                pRollingBufferPacket->packetBufferLength = payloadLength;
+            }
+            else
+            {
+                pRollingBufferPacket->pPacketBuffer = pSrtpPacket;
+                pRollingBufferPacket->packetBufferLength = srtpPacketLength;
+                /* The slot holds the encrypted packet now, don't keep a reference to the payload. */
+                pRollingBufferPacket->rtpPacket.pPayload = NULL;
+            }
+
+            /* Udpate the packet into rolling buffer. */
+            ret = PeerConnectionRollingBuffer_SetPacket( &pSrtpSender->txRollingBuffer,
+                                                         ( *pRtpSeq )++,
+                                                         pRollingBufferPacket );
+        }
+
+        if( ( ret != PEER_CONNECTION_RESULT_OK ) && ( pRollingBufferPacket != NULL ) )
+        {
+            /* If any failure, release the allocated RTP buffer. */
+            PeerConnectionRollingBuffer_DiscardRtpSequenceBuffer( &pSrtpSender->txRollingBuffer,
+                                                                  pRollingBufferPacket );
+
+            if( pFecEncoder != NULL )
+            {
+                /* The sequence number gets reused, so the group can't cover this packet. */
+                PeerConnectionFec_ResetGroup( pFecEncoder );
+            }
+        }
+
+        if( ret == PEER_CONNECTION_RESULT_OK )
+        {
+            sendBuffers[ sendBufferCount ].pBuffer = pSrtpPacket;
+            sendBuffers[ sendBufferCount ].bufferLength = srtpPacketLength;
+            sendBufferCount++;
+            pendingBytes += payloadLength;
+        }
+
+        /* Close the FEC group right behind its last media packet, a group spanning frames
+         * is closed at the end of a frame once it gets old. */
+        if( ( ret == PEER_CONNECTION_RESULT_OK ) &&
+            ( pFecEncoder != NULL ) &&
+            ( PeerConnectionFec_IsGroupReady( pFecEncoder,
+                                              pPacketizedFrame->rtpTimestamp,
+                                              ( i + 1 == pPacketizedFrame->payloadCount ) ? 1U : 0U ) != 0U ) )
+        {
+            if( BuildFecPacket( pSession,
+                                pFecEncoder,
+                                pPacketizedFrame->rtpTimestamp,
+                                &pFecSrtpPacket,
+                                &fecSrtpPacketLength ) == PEER_CONNECTION_RESULT_OK )
+            {
+                sendBuffers[ sendBufferCount ].pBuffer = pFecSrtpPacket;
+                sendBuffers[ sendBufferCount ].bufferLength = fecSrtpPacketLength;
+                sendBufferCount++;
+                pendingBytes += fecSrtpPacketLength;
+                isFecPending = 1U;
+            }
+            else
+            {
+                /* Losing FEC only loses protection, the media packets are fine. */
+                LogWarn( ( "Fail to build FEC packet" ) );
+            }
+        }
+
+        /* Write the constructed RTP packets through network, the whole batch shares one socket lock.
+         * A batch with a FEC packet is sent at once, the encoder reuses its buffer for the next group. */
+        if( ( ret == PEER_CONNECTION_RESULT_OK ) &&
+            ( ( sendBufferCount >= maxSendBufferCount ) || ( i + 1 == pPacketizedFrame->payloadCount ) || ( isFecPending != 0U ) ) )
+        {
+            /* Don't hold the Tx SRTP session while pacing and sending. */
+            PeerConnectionSrtp_EndEncryptBatch( pSession );
+            isSrtpBatchLocked = 0U;
+
+            resultIceController = PeerConnectionSendScheduler_Send( &pSession->sendScheduler,
+                                                                    &pSession->iceControllerContext,
+                                                                    sendClass,
+                                                                    sendBuffers,
+                                                                    sendBufferCount );
+            if( resultIceController != ICE_CONTROLLER_RESULT_OK )
+            {
+                LogWarn( ( "Fail to send RTP packets, ret: %d", resultIceController ) );
+                ret = PEER_CONNECTION_RESULT_FAIL_ICE_CONTROLLER_SEND_RTP_PACKET;
+            }
+            else
+            {
+                /* Sender reports count the media SSRC only. */
+                packetSent += sendBufferCount - isFecPending;
+                bytesSent += pendingBytes - ( ( isFecPending != 0U ) ? fecSrtpPacketLength : 0U );
+            }
+
+            if( sendClass == PEER_CONNECTION_SEND_CLASS_VIDEO )
+            {
+                PeerConnectionPacer_Consume( &pSrtpSender->pacer,
+                                             pendingBytes );
+            }
+
+            sendBufferCount = 0;
+            pendingBytes = 0;
+            isFecPending = 0U;
+
+            #if METRIC_PRINT_ENABLED
+            if( ret == PEER_CONNECTION_RESULT_OK )
+            {
+                Metric_EndEvent( METRIC_EVENT_SENDING_FIRST_FRAME );
+            }
+            #endif
+        }
+    }
+
+    if( isSrtpBatchLocked != 0U )
+    {
+        PeerConnectionSrtp_EndEncryptBatch( pSession );
+    }
+
+    if( sendBufferCount != 0 )
+    {
+        /* Flush the packets prepared before the failure, they are already stored for re-transmission. */
+        resultIceController = PeerConnectionSendScheduler_Send( &pSession->sendScheduler,
+                                                                &pSession->iceControllerContext,
+                                                                sendClass,
+                                                                sendBuffers,
+                                                                sendBufferCount );
+        if( resultIceController == ICE_CONTROLLER_RESULT_OK )
+        {
+            /* Sender reports count the media SSRC only. */
+            packetSent += sendBufferCount - isFecPending;
+            bytesSent += pendingBytes - ( ( isFecPending != 0U ) ? fecSrtpPacketLength : 0U );
+        }
+    }
+
+    if( packetSent != 0 )
+    {
+        if( pTransceiver->rtpSender.rtpFirstFrameWallClockTimeUs == 0 )
+        {
+            pTransceiver->rtpSender.rtpFirstFrameWallClockTimeUs = NetworkingUtils_GetCurrentTimeUs( NULL );
+            pTransceiver->rtpSender.rtpTimeOffset = randomRtpTimeoffset;
+        }
+
+        pTransceiver->rtcpStats.rtpPacketsTransmitted += packetSent;
+        pTransceiver->rtcpStats.rtpBytesTransmitted += bytesSent;
+
+        /* Re-transmissions earn a share of the media sent. */
+        pSrtpSender->rtxBudgetBytes += ( bytesSent * PEER_CONNECTION_SRTP_RTX_BUDGET_PERCENT ) / 100U;
+        if( pSrtpSender->rtxBudgetBytes > PEER_CONNECTION_SRTP_RTX_BUDGET_MAX_BYTES )
+        {
+            pSrtpSender->rtxBudgetBytes = PEER_CONNECTION_SRTP_RTX_BUDGET_MAX_BYTES;
+        }
+
+        /* Keep history for as long as a NACK can ask for it at the rate the encoder produces packets. */
+        pSrtpSender->rateWindowPacketCount += packetSent;
+        currentTimeUs = NetworkingUtils_GetCurrentTimeUs( NULL );
+        if( pSrtpSender->rateWindowStartTimeUs == 0U )
+        {
+            pSrtpSender->rateWindowStartTimeUs = currentTimeUs;
+        }
+        else if( currentTimeUs - pSrtpSender->rateWindowStartTimeUs >= PEER_CONNECTION_ROLLING_BUFFER_RATE_WINDOW_US )
+        {
+            PeerConnectionRollingBuffer_UpdateRetention( &pSrtpSender->txRollingBuffer,
+                                                         ( uint32_t )( ( uint64_t ) pSrtpSender->rateWindowPacketCount * 1000000ULL / ( currentTimeUs - pSrtpSender->rateWindowStartTimeUs ) ),
+                                                         pSrtpSender->roundTripTimeMs );
+            pSrtpSender->rateWindowPacketCount = 0;
+            pSrtpSender->rateWindowStartTimeUs = currentTimeUs;
+        }
+        else
+        {
+            /* Empty else marker. */
+        }
+    }
+
+    if( isLocked )
+    {
+        xSemaphoreGive( pSrtpSender->senderMutex );
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        *pNextPayloadIndex = i;
+
+        #if METRIC_PRINT_ENABLED
+        if( sendClass == PEER_CONNECTION_SEND_CLASS_VIDEO )
+        {
+            /* The packets of the frame left for the next bursts, none once the frame is sent. */
+            Metric_SetGauge( METRIC_GAUGE_PACER_QUEUED_PACKETS,
+                             ( uint32_t )( pPacketizedFrame->payloadCount - i ) );
+        }
+        #endif
+    }
+
+    return ret;
+}
+
+PeerConnectionResult_t PeerConnectionPayloadHelper_WritePacketizedFrame( PeerConnectionSession_t * pSession,
+                                                                        Transceiver_t * pTransceiver,
+                                                                        const PeerConnectionPacketizedFrame_t * pPacketizedFrame )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    size_t nextPayloadIndex = 0;
+    uint32_t pacingDelayMs = 0;
+    TickType_t pacingDelayTicks;
+
+    do
+    {
+        if( pacingDelayMs != 0U )
+        {
+            /* The sender is released between bursts, so re-transmissions aren't held up by the wait.
+             * A wait shorter than a tick would round down to no wait at all and spin. */
+            pacingDelayTicks = pdMS_TO_TICKS( pacingDelayMs );
+            vTaskDelay( ( pacingDelayTicks > 0U ) ? pacingDelayTicks : 1U );
+        }
+
+        ret = PeerConnectionPayloadHelper_WritePacketizedFrameBurst( pSession,
+                                                                     pTransceiver,
+                                                                     pPacketizedFrame,
+                                                                     &nextPayloadIndex,
+                                                                     &pacingDelayMs );
+    } while( ( ret == PEER_CONNECTION_RESULT_OK ) && ( nextPayloadIndex < pPacketizedFrame->payloadCount ) );
+
+    return ret;
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PEER_CONNECTION_PAYLOAD_HELPER_H
+#define PEER_CONNECTION_PAYLOAD_HELPER_H
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Standard includes. */
+#include <stdint.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+
+#include "peer_connection_data_types.h"
+
+/* Allocate payload descriptors and payload storage for a frame of frameLength bytes
+ * that is split into at most maxNaluCount NALUs. */
+PeerConnectionResult_t PeerConnectionPayloadHelper_AllocatePacketizedFrame( PeerConnectionPacketizedFrame_t * pPacketizedFrame,
+                                                                           size_t frameLength,
+                                                                           size_t maxNaluCount );
+
+void PeerConnectionPayloadHelper_FreePacketizedFrame( PeerConnectionPacketizedFrame_t * pPacketizedFrame );
+
+/* Get the buffer for the next payload, the returned length is capped to the RTP payload max length. */
+PeerConnectionResult_t PeerConnectionPayloadHelper_GetNextPayloadBuffer( PeerConnectionPacketizedFrame_t * pPacketizedFrame,
+                                                                        uint8_t ** ppBuffer,
+                                                                        size_t * pBufferLength );
+
+/* Commit the payload that was written into the buffer returned by PeerConnectionPayloadHelper_GetNextPayloadBuffer(). */
+PeerConnectionResult_t PeerConnectionPayloadHelper_CommitPayload( PeerConnectionPacketizedFrame_t * pPacketizedFrame,
+                                                                 size_t payloadLength,
+                                                                 uint8_t isMarker );
+
+/* Build the RTP header of each payload for this session, then encrypt, store and send it.
+ * Video is paced, the call waits between bursts without holding the sender. */
+PeerConnectionResult_t PeerConnectionPayloadHelper_WritePacketizedFrame( PeerConnectionSession_t * pSession,
+                                                                        Transceiver_t * pTransceiver,
+                                                                        const PeerConnectionPacketizedFrame_t * pPacketizedFrame );
+
+/* Same as PeerConnectionPayloadHelper_WritePacketizedFrame() but never waits. It writes from *pNextPayloadIndex
+ * until the pacing budget is used up, then updates *pNextPayloadIndex and sets *pPacingDelayMs to the time to
+ * wait before the next call. The frame is done when *pNextPayloadIndex reaches the payload count. */
+PeerConnectionResult_t PeerConnectionPayloadHelper_WritePacketizedFrameBurst( PeerConnectionSession_t * pSession,
+                                                                             Transceiver_t * pTransceiver,
+                                                                             const PeerConnectionPacketizedFrame_t * pPacketizedFrame,
+                                                                             size_t * pNextPayloadIndex,
+                                                                             uint32_t * pPacingDelayMs );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PEER_CONNECTION_PAYLOAD_HELPER_H */
@@ -54,21 +54,40 @@ extern "C" {
 #define PEER_CONNECTION_CNAME_LENGTH ( 40 )
 #define PEER_CONNECTION_CERTIFICATE_FINGERPRINT_LENGTH ( CERTIFICATE_FINGERPRINT_LENGTH )
 #define PEER_CONNECTION_JITTER_BUFFER_MAX_ENTRY_NUM ( 1000 )
+/* Frames a jitter buffer assembles at once, 2 seconds of 20 ms audio frames or 30 fps video fit. */
+#define PEER_CONNECTION_JITTER_BUFFER_MAX_FRAME_NUM ( 128 )
 #define PEER_CONNECTION_FRAME_BUFFER_SIZE ( 16384 )
 
 #define PEER_CONNECTION_FRAME_CURRENT_VERSION ( 0 )
 
 #define PEER_CONNECTION_SDP_DESCRIPTION_BUFFER_MAX_LENGTH ( 10000 )
 
-#define PEER_CONNECTION_RTCP_TWCC_MAX_ARRAY ( 100 )
+/* Sent packets are kept per session and indexed by transport sequence number modulo the history length,
+ * so it must be a power of two. 1024 entries cover one second of 4 Mbps video in 1200-byte packets
+ * with room for audio and the smaller last packet of every frame. */
+#define PEER_CONNECTION_TWCC_HISTORY_LENGTH ( 1024 )
+/* Packets reported by a single TWCC feedback. */
+#define PEER_CONNECTION_TWCC_FEEDBACK_MAX_PACKETS ( 256 )
+/* Packet groups the delay trend is fitted over. */
+#define PEER_CONNECTION_BWE_TRENDLINE_WINDOW ( 20 )
+/* A FEC packet holds the RTP header, the FlexFEC header and the XOR of the protected packets. */
+#define PEER_CONNECTION_FEC_PACKET_MAX_LENGTH ( 1400 )
+
+/* Previous audio frames a RED packet can carry, and the largest frame kept for it. */
+#define PEER_CONNECTION_RED_MAX_REDUNDANT_FRAMES ( 2 )
+#define PEER_CONNECTION_RED_MAX_BLOCK_LENGTH ( 512 )
+
+/* Urgent packets waiting for the send lane, and the largest one that can wait.
+ * A 20 ms G711 frame with two redundant frames and the SRTP overhead fits. */
+#define PEER_CONNECTION_SEND_SCHEDULER_URGENT_QUEUE_LENGTH ( 4 )
+#define PEER_CONNECTION_SEND_SCHEDULER_URGENT_PACKET_MAX_LENGTH ( 640 )
 
 #define PEER_CONNECTION_MAX_DTLS_DECRYPTED_DATA_LENGTH ( 2048 )
 
 #define MAX_SCTP_DATA_CHANNELS          4
 #define PEER_CONNECTION_MAX_SCTP_DATA_CHANNELS_PER_PEER 2
 
-#define PEER_CONNECTION_TWCC_BITRATE_ADJUSTMENT_INTERVAL_US        1000 * 10000  //1,000,000 microseconds.
-#define PEER_CONNECTION_MIN_VIDEO_BITRATE_KBPS                     512     // Unit kilobits/sec. Value could change based on codec.
+#define PEER_CONNECTION_MIN_VIDEO_BITRATE_KBPS                     200     // Unit kilobits/sec. Value could change based on codec.
 #define PEER_CONNECTION_MAX_VIDEO_BITRATE_KBPS                     2048000 // Unit kilobits/sec. Value could change based on codec.
 #define PEER_CONNECTION_MIN_AUDIO_BITRATE_BPS                      4000    // Unit bits/sec. Value could change based on codec.
 #define PEER_CONNECTION_MAX_AUDIO_BITRATE_BPS                      650000  // Unit bits/sec. Value could change based on codec.
@@ -167,6 +186,16 @@ typedef enum PeerConnectionResult
     PEER_CONNECTION_RESULT_FAIL_SCTP_WRITE,
     PEER_CONNECTION_RESULT_FAIL_SCTP_READ,
     PEER_CONNECTION_RESULT_FAIL_SCTP_CLOSE,
+    PEER_CONNECTION_RESULT_FAIL_PACKETIZED_FRAME_ALLOCATE,
+    PEER_CONNECTION_RESULT_FAIL_PACKETIZED_FRAME_FULL,
+    PEER_CONNECTION_RESULT_FAIL_ROLLING_BUFFER_SLAB_NO_ENOUGH_MEMORY,
+    PEER_CONNECTION_RESULT_FAIL_ROLLING_BUFFER_NO_FREE_SLOT,
+    PEER_CONNECTION_RESULT_FAIL_SEND_BATCH_BUFFER_ALLOCATE,
+    PEER_CONNECTION_RESULT_FAIL_RED_PARSE,
+    PEER_CONNECTION_RESULT_FAIL_CREATE_SEND_SCHEDULER_MUTEX,
+    PEER_CONNECTION_RESULT_FAIL_JITTER_BUFFER_NO_ENOUGH_MEMORY,
+    PEER_CONNECTION_RESULT_FAIL_JITTER_BUFFER_NO_FREE_SLOT,
+    PEER_CONNECTION_RESULT_FAIL_JITTER_BUFFER_PACKET_TOO_LARGE,
 } PeerConnectionResult_t;
 
 /*
@@ -189,8 +218,26 @@ typedef void (* OnIceCandidateReadyCallback_t)( void * pCustomContext,
                                                 PeerConnectionIceLocalCandidate_t * pIceLocalCandidate );
 
 #if ENABLE_TWCC_SUPPORT
+    typedef enum PeerConnectionBweUsage
+    {
+        PEER_CONNECTION_BWE_USAGE_NORMAL = 0,
+        PEER_CONNECTION_BWE_USAGE_UNDERUSING,
+        PEER_CONNECTION_BWE_USAGE_OVERUSING,
+    } PeerConnectionBweUsage_t;
+
+    typedef struct PeerConnectionBandwidthEstimate
+    {
+        /* Bitrate in bps the session should send at, audio and video together. */
+        uint32_t targetBitrate;
+        /* Bitrate in bps the remote acknowledged receiving, 0 until measured. */
+        uint32_t ackedBitrate;
+        uint32_t lossPercent;
+        PeerConnectionBweUsage_t usage;
+    } PeerConnectionBandwidthEstimate_t;
+
     typedef void ( * OnBandwidthEstimationCallback_t )( void * pCustomContext,
-                                                        TwccBandwidthInfo_t * pTwccBandwidthInfo );
+                                                        TwccBandwidthInfo_t * pTwccBandwidthInfo,
+                                                        const PeerConnectionBandwidthEstimate_t * pEstimate );
 #endif
 
 typedef void ( * OnPictureLossIndicationCallback_t )( void * pCustomContext,
@@ -207,6 +254,27 @@ typedef struct PeerConnectionFrame
     uint64_t presentationUs;
 } PeerConnectionFrame_t;
 
+typedef struct PeerConnectionPacketizedPayload
+{
+    uint8_t * pPayload;
+    size_t payloadLength;
+    uint8_t isMarker; /* Set the RTP marker bit on this payload. */
+} PeerConnectionPacketizedPayload_t;
+
+/* A frame split into RTP payloads. Packetizing is session independent, so one packetized
+ * frame can be written to every session; each session only adds its own RTP header and SRTP protection. */
+typedef struct PeerConnectionPacketizedFrame
+{
+    TransceiverTrackKind_t trackKind;
+    uint32_t rtpTimestamp;
+    PeerConnectionPacketizedPayload_t * pPayloads;
+    size_t payloadCount;
+    size_t maxPayloadCount;
+    uint8_t * pPayloadBuffer; /* Backing storage that all pPayload pointers refer to. */
+    size_t payloadBufferLength;
+    size_t payloadBufferUsedLength;
+} PeerConnectionPacketizedFrame_t;
+
 typedef struct PeerConnectionJitterBufferPacket PeerConnectionJitterBufferPacket_t;
 typedef struct PeerConnectionJitterBuffer PeerConnectionJitterBuffer_t;
 
@@ -233,41 +301,96 @@ typedef struct PeerConnectionRollingBufferPacket
     uint32_t twccExtensionPayload;
     uint8_t * pPacketBuffer;
     size_t packetBufferLength;
+    uint64_t lastResendTimeUs; /* 0 until the packet is re-sent. */
+    uint8_t slabIndex; /* Slab the slot belongs to. */
+    struct PeerConnectionRollingBufferPacket * pNextFree; /* Next slot in the free list, only valid while the slot is free. */
 } PeerConnectionRollingBufferPacket_t;
 
+typedef struct PeerConnectionRollingBufferSlab
+{
+    uint8_t * pSlots; /* NULL while the slab isn't allocated. */
+    PeerConnectionRollingBufferPacket_t * pFreeSlots;
+    size_t freeCount;
+} PeerConnectionRollingBufferSlab_t;
+
 typedef struct PeerConnectionRollingBuffer
 {
     uint8_t isInit;
-    RtpPacketQueue_t packetQueue;
+    /* Stored packets indexed by sequence number modulo the index size, NULL for an empty position.
+     * The index size is a power of two, so it divides the sequence number space. */
+    PeerConnectionRollingBufferPacket_t ** ppIndex;
+    size_t indexMask;
     size_t maxSizePerPacket;
     size_t capacity; /* Buffer duration * highest expected bitrate (in bps) / 8 / maxPacketSize. */
+    /* Packets kept now, adapted to the round trip time and the packet rate, never above capacity. */
+    size_t retainedCount;
+    uint8_t hasPackets;
+    uint16_t oldestSeq;
+    uint16_t newestSeq;
+
+    /* Packet slots are reserved in slabs and recycled through the free list of each slab, so sending
+     * a packet doesn't touch the heap. Slabs are allocated and released as the retention changes. */
+    PeerConnectionRollingBufferSlab_t * pSlabs;
+    size_t slabCount;
+    size_t allocatedSlabCount;
+    size_t slotSize; /* sizeof( PeerConnectionRollingBufferPacket_t ) + maxSizePerPacket, aligned. */
 } PeerConnectionRollingBuffer_t;
 
 typedef struct PeerConnectionJitterBufferPacket
 {
     uint8_t isPushed;
+    uint8_t isMarker; /* The RTP marker bit, set on the last packet of a video frame. */
+    uint8_t payloadType;
     uint16_t sequenceNumber;
     uint32_t rtpTimestamp;
     TickType_t receiveTick;
-    uint8_t * pPacketBuffer;
+    uint8_t * pPacketBuffer; /* The RTP payload, inside a slot of the jitter buffer. */
     size_t packetBufferLength;
+    size_t payloadOffset; /* Offset of pPacketBuffer from the start of its slot, the RTP header is in front. */
 } PeerConnectionJitterBufferPacket_t;
 
+/* Assembly state of the frame of one RTP timestamp, updated as its packets are pushed. */
+typedef struct PeerConnectionJitterBufferFrame
+{
+    uint32_t rtpTimestamp;
+    uint8_t isStartSeen; /* The first packet of the frame is received, firstSequenceNumber is valid. */
+    uint8_t isMarkerSeen; /* The last packet of the frame is received, lastSequenceNumber is valid. */
+    uint16_t firstSequenceNumber;
+    uint16_t lastSequenceNumber;
+    uint16_t lowestSequenceNumber; /* The range of received packets of this timestamp, released when the frame is popped. */
+    uint16_t highestSequenceNumber;
+    uint32_t missingCount; /* Packets from first to last sequence number not received yet, valid once both are seen. */
+} PeerConnectionJitterBufferFrame_t;
+
 typedef struct PeerConnectionJitterBuffer
 {
     uint8_t isInit;
     uint8_t isStart; /* The jitter buffer starts to receive packet or not. */
+    uint8_t isSinglePacketFrame; /* Every packet is a frame of its own, e.g. audio codecs. */
+    uint8_t hasPoppedFrame; /* lastPopRtpTimestamp is valid. */
     size_t capacity; /* The total number of packets that packet queue can store. */
     uint32_t clockRate; /* The clock rate based on the codec. For example: the clock rate is 90000 if the chosen RTP is H264/90000. */
     uint32_t codec; /* The codec. For example: the codec is set to H264 if the chosen RTP is H264/90000. */
+    uint32_t redPayloadType; /* The packets with this payload type carry RED blocks. 0 if RED isn't negotiated. */
     uint32_t tolerenceRtpTimeStamp; /* The buffer time in RTP time stamp format. */
     uint32_t lastPopRtpTimestamp; /* The timestamp in last pop RTP packet. */
     TickType_t lastPopTick; /* The receive time ticks in last pop RTP packet. */
     uint16_t lastPopSequenceNumber; /* The RTP sequence number in last pop RTP packet. */
-    uint16_t oldestReceivedSequenceNumber; /* The oldest RTP sequence number that received in the packet queue. */
     uint16_t newestReceivedSequenceNumber; /* The newest RTP sequence number that received in the packet queue. */
     uint32_t newestReceivedTimestamp; /* The newest timestamp in packet queue. */
     PeerConnectionJitterBufferPacket_t rtpPackets[ PEER_CONNECTION_JITTER_BUFFER_MAX_ENTRY_NUM ]; /* The buffer for packet queue. */
+    PeerConnectionJitterBufferFrame_t frames[ PEER_CONNECTION_JITTER_BUFFER_MAX_FRAME_NUM ]; /* Frames in RTP timestamp order, from frameHead. */
+    size_t frameHead;
+    size_t frameCount;
+
+    /* Packet buffers are slots of a pool allocated at create time, so receiving doesn't touch the heap.
+     * A free slot holds the pointer to the next free slot in its first bytes. */
+    uint8_t * pSlotPool;
+    uint8_t * pFreeSlots;
+    size_t slotCount;
+    size_t freeSlotCount;
+    /* One more slot to decrypt into when none is free, frames are only given up for it once the packet has authenticated. */
+    uint8_t * pSpareSlot;
 
     /* Callback functions & custom contexts. */
     OnJitterBufferFrameReadyCallback_t onFrameReadyCallbackFunc;
@@ -278,6 +401,38 @@ typedef struct PeerConnectionJitterBuffer
     FillFrameFunc_t fillFrameFunc;
 } PeerConnectionJitterBuffer_t;
 
+/* Send classes of the session's send scheduler, from the highest priority. */
+typedef enum PeerConnectionSendClass
+{
+    PEER_CONNECTION_SEND_CLASS_URGENT = 0, /* RTCP and audio. */
+    PEER_CONNECTION_SEND_CLASS_RTX,
+    PEER_CONNECTION_SEND_CLASS_VIDEO,
+} PeerConnectionSendClass_t;
+
+typedef struct PeerConnectionSendSchedulerPacket
+{
+    uint8_t buffer[ PEER_CONNECTION_SEND_SCHEDULER_URGENT_PACKET_MAX_LENGTH ];
+    size_t bufferLength;
+} PeerConnectionSendSchedulerPacket_t;
+
+/* Every RTP/RTCP packet of a session leaves through one send lane. Video holds the lane for a small
+ * batch at a time, so urgent packets never wait behind more than one batch. An urgent packet finding
+ * the lane busy is queued, the lane holder sends it before its own next batch. */
+typedef struct PeerConnectionSendScheduler
+{
+    uint8_t isInit;
+    SemaphoreHandle_t laneMutex;
+    SemaphoreHandle_t queueMutex; /* Protects the urgent queue. */
+
+    PeerConnectionSendSchedulerPacket_t urgentPackets[ PEER_CONNECTION_SEND_SCHEDULER_URGENT_QUEUE_LENGTH ];
+    uint8_t urgentHead;
+    volatile uint8_t urgentCount;
+
+    /* Re-transmissions in progress, counted before they take the sender mutex.
+     * Video yields the sender mutex and the lane to them between batches. */
+    volatile uint32_t rtxWaitingCount;
+} PeerConnectionSendScheduler_t;
+
 /*
  * Session relates data structures.
  */
@@ -330,6 +485,10 @@ typedef struct PeerConnectionRtpConfig
     uint32_t audioCodecPayload;
     uint32_t videoCodecRtxPayload;
     uint32_t audioCodecRtxPayload;
+    /* FlexFEC payload type, 0 when the remote doesn't accept FEC for video. */
+    uint32_t videoCodecFecPayload;
+    /* RED payload type, 0 when the remote doesn't accept redundant audio. */
+    uint32_t audioCodecRedPayload;
     uint16_t videoRtxSequenceNumber;
     uint16_t audioRtxSequenceNumber;
 
@@ -340,11 +499,105 @@ typedef struct PeerConnectionRtpConfig
     uint32_t remoteAudioSsrc;
 } PeerConnectionRtpConfig_t;
 
+typedef struct PeerConnectionPacer
+{
+    /* Pacing rate in bps, 0 disables pacing. Written by bandwidth estimation without taking the sender mutex. */
+    volatile uint32_t pacingBitrate;
+    /* The pacing rate never goes below this rate, derived from the lowest bandwidth estimate. */
+    uint32_t minPacingBitrate;
+    uint32_t burstBytes;
+    /* Bytes allowed to be sent now, negative when the last batch overdrew the budget. */
+    int64_t budgetBytes;
+    uint64_t lastRefillTimeUs;
+} PeerConnectionPacer_t;
+
+/* 12 bytes fixed header and 8 bytes for the one-byte header extension carrying the TWCC sequence. */
+#define PEER_CONNECTION_RTP_HEADER_TEMPLATE_MAX_LENGTH ( 20 )
+
+/* RTP header prebuilt once the session is negotiated, so sending a packet only patches
+ * sequence number, timestamp, marker and TWCC sequence. */
+typedef struct PeerConnectionRtpHeaderTemplate
+{
+    uint8_t header[ PEER_CONNECTION_RTP_HEADER_TEMPLATE_MAX_LENGTH ];
+    size_t headerLength;
+    uint16_t twccId; /* 0 when TWCC isn't negotiated, the header then has no extension. */
+} PeerConnectionRtpHeaderTemplate_t;
+
+/* XOR FEC over groups of consecutive media packets, sent as FlexFEC on its own SSRC. */
+typedef struct PeerConnectionFecEncoder
+{
+    uint8_t isEnabled;
+    /* Media packets protected by one FEC packet, 0 while no loss is reported.
+     * Written from RTCP receiver reports without taking the sender mutex. */
+    volatile uint8_t mediaPacketsPerFec;
+    /* Fraction lost of the receiver reports in 1/256 units, rises at once and decays slowly. */
+    uint32_t smoothedFractionLost;
+
+    PeerConnectionRtpHeaderTemplate_t rtpHeaderTemplate;
+    uint32_t mediaSsrc;
+    uint16_t sequenceNumber;
+
+    /* Group being protected, its XOR is accumulated in the FEC packet buffer. */
+    uint8_t packetCount;
+    uint16_t baseSequenceNumber;
+    uint32_t baseTimestamp;
+    uint16_t mask;
+    size_t protectedLength;
+    uint8_t packet[ PEER_CONNECTION_FEC_PACKET_MAX_LENGTH ];
+} PeerConnectionFecEncoder_t;
+
+typedef struct PeerConnectionRedBlock
+{
+    uint8_t data[ PEER_CONNECTION_RED_MAX_BLOCK_LENGTH ];
+    size_t dataLength;
+    uint32_t rtpTimestamp;
+} PeerConnectionRedBlock_t;
+
+/* RFC 2198 encoder, every audio packet repeats the previous frames in front of the current one. */
+typedef struct PeerConnectionRedEncoder
+{
+    uint8_t isEnabled;
+    uint8_t payloadType; /* The negotiated RED payload type, the RTP header carries it. */
+    uint8_t primaryPayloadType; /* The audio codec payload type, each block header carries it. */
+    uint8_t redundantFrames;
+
+    /* The last frames sent, historyIndex is the slot of the next one. */
+    PeerConnectionRedBlock_t history[ PEER_CONNECTION_RED_MAX_REDUNDANT_FRAMES ];
+    uint8_t historyIndex;
+} PeerConnectionRedEncoder_t;
+
 typedef struct PeerConnectionSrtpSender
 {
     /* RTP Tx rolling buffer. */
     PeerConnectionRollingBuffer_t txRollingBuffer;
 
+    /* Headers of the media packets and their RTX re-transmissions. */
+    PeerConnectionRtpHeaderTemplate_t rtpHeaderTemplate;
+    PeerConnectionRtpHeaderTemplate_t rtxHeaderTemplate;
+
+    /* Pacer to smooth the bursts of large frames. */
+    PeerConnectionPacer_t pacer;
+
+    /* FEC of the video packets, protected by the sender mutex. */
+    PeerConnectionFecEncoder_t fecEncoder;
+
+    /* Redundant encoding of the audio frames, protected by the sender mutex. */
+    PeerConnectionRedEncoder_t redEncoder;
+
+    /* SRTP packets of one send batch, only needed when the rolling buffer keeps RTP payloads. */
+    uint8_t * pSendBatchBuffer;
+    size_t sendBatchBufferCount;
+
+    /* Round trip time of the last receiver report in ms, 0 until one arrives.
+     * Written from RTCP receiver reports without taking the sender mutex. */
+    volatile uint32_t roundTripTimeMs;
+    /* Bytes re-transmissions may still send, every media byte sent adds a share to it. */
+    uint32_t rtxBudgetBytes;
+
+    /* Packets sent since the rate window started, the packet rate sizes the rolling buffer retention. */
+    uint32_t rateWindowPacketCount;
+    uint64_t rateWindowStartTimeUs;
+
     /* Mutex to protect sender info like rolling buffer. */
     SemaphoreHandle_t senderMutex;
     uint8_t isSenderMutexInit;
@@ -365,13 +618,65 @@ typedef struct PeerConnectionSrtpReceiver
     {
         /* Mutex to protect updated Bitrate's because we might read the updated bitrate in between of updating the bitrate. */
         SemaphoreHandle_t twccBitrateMutex;
-        uint64_t lastAdjustmentTimeUs;
         uint64_t currentVideoBitrate;
         uint64_t currentAudioBitrate;
         uint64_t updatedVideoBitrate;
         uint64_t updatedAudioBitrate;
-        double averagePacketLoss;
     } PeerConnectionTwccMetaData_t;
+
+    typedef struct PeerConnectionTwccPacket
+    {
+        /* 0 when the entry is unused or its feedback is already handled. */
+        uint64_t sentTimeUs;
+        uint16_t seqNum;
+        uint16_t packetSize;
+    } PeerConnectionTwccPacket_t;
+
+    typedef struct PeerConnectionTwccHistory
+    {
+        PeerConnectionTwccPacket_t packets[ PEER_CONNECTION_TWCC_HISTORY_LENGTH ];
+        /* Parsed arrival list of the feedback being handled, kept here rather than on the socket listener stack. */
+        PacketArrivalInfo_t arrivalInfos[ PEER_CONNECTION_TWCC_FEEDBACK_MAX_PACKETS ];
+    } PeerConnectionTwccHistory_t;
+
+    typedef struct PeerConnectionBwe
+    {
+        /* Packets sent within a burst form a group, delay variation is measured between groups. */
+        uint64_t groupFirstSendTimeUs;
+        uint64_t groupSendTimeUs;
+        uint64_t groupArrivalTimeUs;
+        uint64_t prevGroupSendTimeUs;
+        uint64_t prevGroupArrivalTimeUs;
+        uint64_t firstArrivalTimeUs;
+
+        /* Trendline of the smoothed accumulated delay over arrival time. */
+        double accumulatedDelayMs;
+        double smoothedDelayMs;
+        double trendArrivalMs[ PEER_CONNECTION_BWE_TRENDLINE_WINDOW ];
+        double trendDelayMs[ PEER_CONNECTION_BWE_TRENDLINE_WINDOW ];
+        uint32_t trendCount;
+        uint32_t trendIndex;
+        uint32_t deltaCount;
+
+        /* Overuse detector with adaptive threshold. */
+        double thresholdMs;
+        double prevTrend;
+        double overuseTimeMs;
+        uint32_t overuseCount;
+        uint64_t lastThresholdUpdateUs;
+        PeerConnectionBweUsage_t usage;
+
+        /* Acknowledged bitrate over arrival time windows. */
+        uint64_t ackedWindowStartUs;
+        uint32_t ackedWindowBytes;
+        uint32_t ackedBitrate;
+
+        /* AIMD rate control. */
+        uint32_t targetBitrate;
+        uint32_t lastDecreaseBitrate;
+        uint64_t lastDecreaseTimeUs;
+        uint64_t lastRateUpdateUs;
+    } PeerConnectionBwe_t;
 #endif
 
 typedef struct PeerConnectionContext PeerConnectionContext_t;
@@ -430,8 +735,9 @@ typedef struct PeerConnectionSession
 
     /* DTLS session. */
     DtlsSession_t dtlsSession;
-    /* SRTP sessions. */
-    SemaphoreHandle_t srtpSessionMutex;
+    /* SRTP sessions, Tx and Rx have their own lock so decrypting never waits for encrypting. */
+    SemaphoreHandle_t srtpTransmitSessionMutex;
+    SemaphoreHandle_t srtpReceiveSessionMutex;
     srtp_t srtpTransmitSession;
     srtp_t srtpReceiveSession;
     /* RTP config. */
@@ -465,6 +771,9 @@ typedef struct PeerConnectionSession
     PeerConnectionSrtpReceiver_t videoSrtpReceiver;
     PeerConnectionSrtpReceiver_t audioSrtpReceiver;
 
+    /* Orders RTCP, audio, RTX and video packets onto the network. */
+    PeerConnectionSendScheduler_t sendScheduler;
+
     TimerHandler_t rtcpAudioSenderReportTimer;
     TimerHandler_t rtcpVideoSenderReportTimer;
     TimerHandler_t closeSessionTimer;
@@ -474,6 +783,12 @@ typedef struct PeerConnectionSession
 
     #if ENABLE_TWCC_SUPPORT
     PeerConnectionTwccMetaData_t twccMetaData;
+    PeerConnectionTwccHistory_t twccHistory;
+    PeerConnectionBwe_t bwe;
+
+    /* Callback for bandwidth estimation updates, every session estimates its own path. */
+    OnBandwidthEstimationCallback_t onBandwidthEstimationCallback;
+    void * pOnBandwidthEstimationCallbackContext;
     #endif
     /* Pointer that points to peer connection context. */
     PeerConnectionContext_t * pCtx;
@@ -519,15 +834,6 @@ typedef struct PeerConnectionContext
     PeerConnectionDtlsContext_t dtlsContext;
     RtpContext_t rtpContext;
     RtcpContext_t rtcpContext;
-
-    #if ENABLE_TWCC_SUPPORT
-    RtcpTwccManager_t rtcpTwccManager;
-    TwccPacketInfo_t twccPacketInfo[ PEER_CONNECTION_RTCP_TWCC_MAX_ARRAY ];
-
-    /* Callback for bandwidth estimation updates */
-    OnBandwidthEstimationCallback_t onBandwidthEstimationCallback;
-    void * pOnBandwidthEstimationCallbackContext;
-    #endif /* ENABLE_TWCC_SUPPORT */
 } PeerConnectionContext_t;
 
 #ifdef __cplusplus
@@ -0,0 +1,315 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <string.h>
+#include "logging.h"
+#include "peer_connection_fec.h"
+#include "peer_connection_srtp.h"
+
+#define PEER_CONNECTION_FEC_RTP_FIXED_HEADER_LENGTH ( 12 )
+#define PEER_CONNECTION_FEC_CLOCKRATE_KHZ ( 90 )
+
+/* The RTP header is written in front of the FlexFEC header once the group is closed. */
+#define PEER_CONNECTION_FEC_HEADER_OFFSET ( PEER_CONNECTION_RTP_HEADER_TEMPLATE_MAX_LENGTH )
+#define PEER_CONNECTION_FEC_PAYLOAD_OFFSET ( PEER_CONNECTION_FEC_HEADER_OFFSET + PEER_CONNECTION_FEC_HEADER_LENGTH )
+#define PEER_CONNECTION_FEC_MAX_PROTECTED_LENGTH ( PEER_CONNECTION_FEC_PACKET_MAX_LENGTH - PEER_CONNECTION_FEC_PAYLOAD_OFFSET )
+
+/* R and F bits are 0 for the flexible mask, the rest of the first byte recovers P, X and CC. */
+#define PEER_CONNECTION_FEC_RECOVERY_BITS_MASK ( 0x3FU )
+/* The K bit ends the packet mask after its first 15 bits. */
+#define PEER_CONNECTION_FEC_MASK_K_BIT ( 0x8000U )
+
+#define PEER_CONNECTION_FEC_READ_UINT16( pSrc ) ( ( uint16_t )( ( ( uint16_t )( pSrc )[ 0 ] << 8 ) | ( pSrc )[ 1 ] ) )
+#define PEER_CONNECTION_FEC_READ_UINT32( pSrc ) ( ( ( uint32_t )( pSrc )[ 0 ] << 24 ) | ( ( uint32_t )( pSrc )[ 1 ] << 16 ) | ( ( uint32_t )( pSrc )[ 2 ] << 8 ) | ( pSrc )[ 3 ] )
+
+typedef struct PeerConnectionFecLevel
+{
+    uint32_t minLossPercent;
+    uint8_t mediaPacketsPerFec;
+} PeerConnectionFecLevel_t;
+
+/* Protection levels from the highest loss down, the first level the loss reaches is used.
+ * One FEC packet recovers a single loss in its group, so the group shrinks as loss grows. */
+static const PeerConnectionFecLevel_t fecLevels[] = {
+    { 10, 3 },
+    { 5, 4 },
+    { 3, 6 },
+    { PEER_CONNECTION_FEC_MIN_LOSS_PERCENT, 10 },
+};
+
+void PeerConnectionFec_Init( PeerConnectionFecEncoder_t * pFec,
+                             uint32_t payloadType,
+                             uint32_t fecSsrc,
+                             uint32_t mediaSsrc,
+                             uint16_t twccId )
+{
+    if( pFec == NULL )
+    {
+        LogError( ( "Invalid input, pFec: %p", pFec ) );
+    }
+    else
+    {
+        memset( pFec,
+                0,
+                sizeof( PeerConnectionFecEncoder_t ) );
+
+        if( payloadType != 0U )
+        {
+            PeerConnectionSrtp_InitRtpHeaderTemplate( &pFec->rtpHeaderTemplate,
+                                                      payloadType,
+                                                      fecSsrc,
+                                                      twccId );
+            pFec->mediaSsrc = mediaSsrc;
+            pFec->isEnabled = 1U;
+        }
+    }
+}
+
+void PeerConnectionFec_UpdateLoss( PeerConnectionFecEncoder_t * pFec,
+                                   uint8_t fractionLost )
+{
+    uint32_t lossPercent;
+    uint8_t mediaPacketsPerFec = 0U;
+    size_t i;
+
+    if( pFec == NULL )
+    {
+        LogError( ( "Invalid input, pFec: %p", pFec ) );
+    }
+    else if( pFec->isEnabled != 0U )
+    {
+        /* React to a loss burst at once, but keep protecting for a while after it. */
+        if( fractionLost > pFec->smoothedFractionLost )
+        {
+            pFec->smoothedFractionLost = fractionLost;
+        }
+        else
+        {
+            pFec->smoothedFractionLost = ( pFec->smoothedFractionLost * 7U + fractionLost ) / 8U;
+        }
+
+        lossPercent = pFec->smoothedFractionLost * 100U / 256U;
+        for( i = 0; i < sizeof( fecLevels ) / sizeof( fecLevels[ 0 ] ); i++ )
+        {
+            if( lossPercent >= fecLevels[ i ].minLossPercent )
+            {
+                mediaPacketsPerFec = fecLevels[ i ].mediaPacketsPerFec;
+                break;
+            }
+        }
+
+        if( mediaPacketsPerFec != pFec->mediaPacketsPerFec )
+        {
+            LogInfo( ( "FEC protection changes from %u to %u media packets per FEC packet, loss: %lu%%",
+                       pFec->mediaPacketsPerFec,
+                       mediaPacketsPerFec,
+                       lossPercent ) );
+            pFec->mediaPacketsPerFec = mediaPacketsPerFec;
+        }
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+}
+
+void PeerConnectionFec_AddPacket( PeerConnectionFecEncoder_t * pFec,
+                                  const uint8_t * pRtpPacket,
+                                  size_t rtpPacketLength )
+{
+    uint8_t * pFecHeader;
+    uint8_t * pFecPayload;
+    const uint8_t * pMediaPayload;
+    size_t mediaPayloadLength;
+    uint16_t sequenceNumber;
+    uint16_t offset;
+    size_t i;
+
+    if( ( pFec == NULL ) || ( pRtpPacket == NULL ) )
+    {
+        LogError( ( "Invalid input, pFec: %p, pRtpPacket: %p", pFec, pRtpPacket ) );
+    }
+    else if( ( pFec->isEnabled == 0U ) || ( pFec->mediaPacketsPerFec == 0U ) )
+    {
+        /* Protection is off, drop a group left from before. */
+        pFec->packetCount = 0U;
+    }
+    else if( ( rtpPacketLength < PEER_CONNECTION_FEC_RTP_FIXED_HEADER_LENGTH ) ||
+             ( rtpPacketLength - PEER_CONNECTION_FEC_RTP_FIXED_HEADER_LENGTH > PEER_CONNECTION_FEC_MAX_PROTECTED_LENGTH ) )
+    {
+        LogWarn( ( "RTP packet length %u can't be protected by FEC", rtpPacketLength ) );
+        pFec->packetCount = 0U;
+    }
+    else
+    {
+        sequenceNumber = PEER_CONNECTION_FEC_READ_UINT16( &pRtpPacket[ 2 ] );
+        offset = ( uint16_t )( sequenceNumber - pFec->baseSequenceNumber );
+
+        if( ( pFec->packetCount != 0U ) && ( offset >= PEER_CONNECTION_FEC_MAX_MEDIA_PACKETS ) )
+        {
+            /* The mask can't reach this packet, start over with it. */
+            LogWarn( ( "RTP sequence %u is out of the FEC group based at %u", sequenceNumber, pFec->baseSequenceNumber ) );
+            pFec->packetCount = 0U;
+        }
+
+        pFecHeader = &pFec->packet[ PEER_CONNECTION_FEC_HEADER_OFFSET ];
+        pFecPayload = &pFec->packet[ PEER_CONNECTION_FEC_PAYLOAD_OFFSET ];
+
+        if( pFec->packetCount == 0U )
+        {
+            /* The previous FEC packet was encrypted in place, clear all of it. */
+            memset( pFecHeader,
+                    0,
+                    PEER_CONNECTION_FEC_PACKET_MAX_LENGTH - PEER_CONNECTION_FEC_HEADER_OFFSET );
+            pFec->baseSequenceNumber = sequenceNumber;
+            pFec->baseTimestamp = PEER_CONNECTION_FEC_READ_UINT32( &pRtpPacket[ 4 ] );
+            pFec->mask = 0U;
+            pFec->protectedLength = 0U;
+            offset = 0U;
+        }
+
+        /* P, X, CC, M and PT, the length after the fixed header and the timestamp are recovered from the header. */
+        mediaPayloadLength = rtpPacketLength - PEER_CONNECTION_FEC_RTP_FIXED_HEADER_LENGTH;
+        pFecHeader[ 0 ] ^= pRtpPacket[ 0 ];
+        pFecHeader[ 1 ] ^= pRtpPacket[ 1 ];
+        pFecHeader[ 2 ] ^= ( uint8_t )( mediaPayloadLength >> 8 );
+        pFecHeader[ 3 ] ^= ( uint8_t ) mediaPayloadLength;
+        pFecHeader[ 4 ] ^= pRtpPacket[ 4 ];
+        pFecHeader[ 5 ] ^= pRtpPacket[ 5 ];
+        pFecHeader[ 6 ] ^= pRtpPacket[ 6 ];
+        pFecHeader[ 7 ] ^= pRtpPacket[ 7 ];
+
+        /* Everything after the fixed header, header extensions included, is protected as payload. */
+        pMediaPayload = &pRtpPacket[ PEER_CONNECTION_FEC_RTP_FIXED_HEADER_LENGTH ];
+        for( i = 0; i < mediaPayloadLength; i++ )
+        {
+            pFecPayload[ i ] ^= pMediaPayload[ i ];
+        }
+
+        if( mediaPayloadLength > pFec->protectedLength )
+        {
+            pFec->protectedLength = mediaPayloadLength;
+        }
+
+        pFec->mask |= ( uint16_t )( 1U << ( PEER_CONNECTION_FEC_MAX_MEDIA_PACKETS - 1U - offset ) );
+        pFec->packetCount++;
+    }
+}
+
+uint8_t PeerConnectionFec_IsGroupReady( const PeerConnectionFecEncoder_t * pFec,
+                                        uint32_t timestamp,
+                                        uint8_t isFrameEnd )
+{
+    uint8_t isReady = 0U;
+    uint8_t mediaPacketsPerFec;
+
+    if( pFec == NULL )
+    {
+        LogError( ( "Invalid input, pFec: %p", pFec ) );
+    }
+    else if( pFec->packetCount != 0U )
+    {
+        mediaPacketsPerFec = pFec->mediaPacketsPerFec;
+
+        if( ( pFec->packetCount >= mediaPacketsPerFec ) ||
+            ( pFec->packetCount >= PEER_CONNECTION_FEC_MAX_MEDIA_PACKETS ) )
+        {
+            isReady = 1U;
+        }
+        else if( ( isFrameEnd != 0U ) &&
+                 ( timestamp - pFec->baseTimestamp >= PEER_CONNECTION_FEC_MAX_GROUP_DELAY_MS * PEER_CONNECTION_FEC_CLOCKRATE_KHZ ) )
+        {
+            isReady = 1U;
+        }
+        else
+        {
+            /* Empty else marker. */
+        }
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    return isReady;
+}
+
+size_t PeerConnectionFec_BuildPacket( PeerConnectionFecEncoder_t * pFec,
+                                      uint32_t timestamp,
+                                      uint32_t twccExtensionPayload,
+                                      uint8_t ** ppRtpPacket )
+{
+    size_t packetLength = 0U;
+    uint8_t * pFecHeader;
+    uint8_t * pRtpPacket;
+    uint16_t mask;
+
+    if( ( pFec == NULL ) || ( ppRtpPacket == NULL ) )
+    {
+        LogError( ( "Invalid input, pFec: %p, ppRtpPacket: %p", pFec, ppRtpPacket ) );
+    }
+    else if( pFec->packetCount != 0U )
+    {
+        pFecHeader = &pFec->packet[ PEER_CONNECTION_FEC_HEADER_OFFSET ];
+
+        pFecHeader[ 0 ] &= PEER_CONNECTION_FEC_RECOVERY_BITS_MASK;
+        /* SSRCCount and reserved bits. */
+        pFecHeader[ 8 ] = 1U;
+        pFecHeader[ 9 ] = 0U;
+        pFecHeader[ 10 ] = 0U;
+        pFecHeader[ 11 ] = 0U;
+        pFecHeader[ 12 ] = ( uint8_t )( pFec->mediaSsrc >> 24 );
+        pFecHeader[ 13 ] = ( uint8_t )( pFec->mediaSsrc >> 16 );
+        pFecHeader[ 14 ] = ( uint8_t )( pFec->mediaSsrc >> 8 );
+        pFecHeader[ 15 ] = ( uint8_t ) pFec->mediaSsrc;
+        pFecHeader[ 16 ] = ( uint8_t )( pFec->baseSequenceNumber >> 8 );
+        pFecHeader[ 17 ] = ( uint8_t ) pFec->baseSequenceNumber;
+        mask = pFec->mask | PEER_CONNECTION_FEC_MASK_K_BIT;
+        pFecHeader[ 18 ] = ( uint8_t )( mask >> 8 );
+        pFecHeader[ 19 ] = ( uint8_t ) mask;
+
+        pRtpPacket = pFecHeader - pFec->rtpHeaderTemplate.headerLength;
+        packetLength = PeerConnectionSrtp_WriteRtpHeader( &pFec->rtpHeaderTemplate,
+                                                          pRtpPacket,
+                                                          pFec->sequenceNumber++,
+                                                          timestamp,
+                                                          0U,
+                                                          twccExtensionPayload );
+        packetLength += PEER_CONNECTION_FEC_HEADER_LENGTH + pFec->protectedLength;
+
+        *ppRtpPacket = pRtpPacket;
+        pFec->packetCount = 0U;
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    return packetLength;
+}
+
+void PeerConnectionFec_ResetGroup( PeerConnectionFecEncoder_t * pFec )
+{
+    if( pFec == NULL )
+    {
+        LogError( ( "Invalid input, pFec: %p", pFec ) );
+    }
+    else
+    {
+        pFec->packetCount = 0U;
+    }
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef PEER_CONNECTION_FEC_H
+#define PEER_CONNECTION_FEC_H
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Standard includes. */
+#include <stdint.h>
+
+#include "peer_connection_data_types.h"
+
+/* FlexFEC-03 header protecting a single SSRC with the 15-bit packet mask. */
+#define PEER_CONNECTION_FEC_HEADER_LENGTH ( 20 )
+/* Media packets the 15-bit packet mask can cover. */
+#define PEER_CONNECTION_FEC_MAX_MEDIA_PACKETS ( 15 )
+
+/* FEC is only sent once the reported loss reaches this percentage. */
+#ifndef PEER_CONNECTION_FEC_MIN_LOSS_PERCENT
+#define PEER_CONNECTION_FEC_MIN_LOSS_PERCENT ( 1 )
+#endif
+
+/* A group spanning frames is closed at the end of a frame once it is this old, so recovery never waits long. */
+#ifndef PEER_CONNECTION_FEC_MAX_GROUP_DELAY_MS
+#define PEER_CONNECTION_FEC_MAX_GROUP_DELAY_MS ( 100 )
+#endif
+
+/* Enable FEC with the negotiated payload type, a payload type of 0 disables it. */
+void PeerConnectionFec_Init( PeerConnectionFecEncoder_t * pFec,
+                             uint32_t payloadType,
+                             uint32_t fecSsrc,
+                             uint32_t mediaSsrc,
+                             uint16_t twccId );
+
+/* Update the protection level from the fraction lost of a receiver report, in 1/256 units. */
+void PeerConnectionFec_UpdateLoss( PeerConnectionFecEncoder_t * pFec,
+                                   uint8_t fractionLost );
+
+/* XOR a plain RTP packet into the current group. */
+void PeerConnectionFec_AddPacket( PeerConnectionFecEncoder_t * pFec,
+                                  const uint8_t * pRtpPacket,
+                                  size_t rtpPacketLength );
+
+/* Return 1 when the current group should be closed by a FEC packet. */
+uint8_t PeerConnectionFec_IsGroupReady( const PeerConnectionFecEncoder_t * pFec,
+                                        uint32_t timestamp,
+                                        uint8_t isFrameEnd );
+
+/* Close the current group and build its FEC packet in the encoder. Returns the RTP packet length, 0 if there is no group.
+ * The packet stays valid until the next packet is added. */
+size_t PeerConnectionFec_BuildPacket( PeerConnectionFecEncoder_t * pFec,
+                                      uint32_t timestamp,
+                                      uint32_t twccExtensionPayload,
+                                      uint8_t ** ppRtpPacket );
+
+/* Drop the current group, e.g. when one of its packets couldn't be sent. */
+void PeerConnectionFec_ResetGroup( PeerConnectionFecEncoder_t * pFec );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PEER_CONNECTION_FEC_H */
@@ -28,21 +28,25 @@
 #include "FreeRTOS.h"
 
 #define PEER_CONNECTION_JITTER_BUFFER_MAX_PACKETS_NUM_IN_A_FRAME ( 32 )
-#define PEER_CONNECTION_JITTER_BUFFER_SEQ_WRAPPER_THRESHOLD ( 10 )
-#define PEER_CONNECTION_JITTER_BUFFER_TIMESTAMP_WRAPPER_THRESHOLD_SEC ( 0.1 )
 #define PEER_CONNECTION_JITTER_BUFFER_WRAP( x, max ) ( ( x ) % max )
 #define PEER_CONNECTION_JITTER_BUFFER_INCREASE_WITH_WRAP( x, y, max ) ( PEER_CONNECTION_JITTER_BUFFER_WRAP( ( x ) + ( y ),\
                                                                                                             max ) )
 #define PEER_CONNECTION_JITTER_BUFFER_DECREASE_WITH_WRAP( x, y, max ) ( PEER_CONNECTION_JITTER_BUFFER_WRAP( ( x ) - ( y ),\
                                                                                                             max ) )
 
+#define PEER_CONNECTION_JITTER_BUFFER_FRAME_AT( pJitterBuffer, position ) ( &( pJitterBuffer )->frames[ PEER_CONNECTION_JITTER_BUFFER_WRAP( ( pJitterBuffer )->frameHead + ( position ), \
+                                                                                                                                     PEER_CONNECTION_JITTER_BUFFER_MAX_FRAME_NUM ) ] )
+/* Serial number comparisons, RFC 1982. */
+#define PEER_CONNECTION_JITTER_BUFFER_IS_TIMESTAMP_OLDER( a, b ) ( ( int32_t )( ( uint32_t )( a ) - ( uint32_t )( b ) ) < 0 )
+#define PEER_CONNECTION_JITTER_BUFFER_IS_SEQ_OLDER( a, b ) ( ( int16_t )( ( uint16_t )( a ) - ( uint16_t )( b ) ) < 0 )
+#define PEER_CONNECTION_JITTER_BUFFER_IS_SEQ_IN_RANGE( seq, start, end ) ( ( uint16_t )( ( seq ) - ( start ) ) <= ( uint16_t )( ( end ) - ( start ) ) )
+
 static void DiscardPacket( PeerConnectionJitterBuffer_t * pJitterBuffer,
                            PeerConnectionJitterBufferPacket_t * pPacket );
 
 static void DiscardPackets( PeerConnectionJitterBuffer_t * pJitterBuffer,
                             uint16_t startSeq,
-                            uint16_t endSeq,
-                            PeerConnectionJitterBufferPacket_t * pNextPacket )
+                            uint16_t endSeq )
 {
     uint16_t i, index;
     PeerConnectionJitterBufferPacket_t * pPacket;
@@ -58,44 +62,269 @@ static void DiscardPackets( PeerConnectionJitterBuffer_t * pJitterBuffer,
             DiscardPacket( pJitterBuffer,
                            pPacket );
         }
+    }
+}
+
+static uint8_t IsRtpTimestampExpired( PeerConnectionJitterBuffer_t * pJitterBuffer,
+                                      uint32_t rtpTimestamp )
+{
+    uint32_t earliestBufferTimestamp = pJitterBuffer->newestReceivedTimestamp - pJitterBuffer->tolerenceRtpTimeStamp;
+
+    return PEER_CONNECTION_JITTER_BUFFER_IS_TIMESTAMP_OLDER( rtpTimestamp,
+                                                             earliestBufferTimestamp ) ? 1U : 0U;
+}
+
+static uint8_t IsFrameComplete( const PeerConnectionJitterBufferFrame_t * pFrame )
+{
+    return ( ( pFrame->isStartSeen != 0U ) &&
+             ( pFrame->isMarkerSeen != 0U ) &&
+             ( pFrame->missingCount == 0U ) ) ? 1U : 0U;
+}
+
+/* Look up the frame of the RTP timestamp from the newest one, packets mostly belong to the newest frames.
+ * If there is none, pInsertPosition is set to where it belongs in the timestamp order. */
+static PeerConnectionJitterBufferFrame_t * FindFrame( PeerConnectionJitterBuffer_t * pJitterBuffer,
+                                                      uint32_t rtpTimestamp,
+                                                      size_t * pInsertPosition )
+{
+    PeerConnectionJitterBufferFrame_t * pFrame = NULL;
+    size_t i;
+
+    for( i = pJitterBuffer->frameCount; i > 0U; i-- )
+    {
+        pFrame = PEER_CONNECTION_JITTER_BUFFER_FRAME_AT( pJitterBuffer,
+                                                         i - 1U );
+        if( pFrame->rtpTimestamp == rtpTimestamp )
+        {
+            break;
+        }
+        else if( PEER_CONNECTION_JITTER_BUFFER_IS_TIMESTAMP_OLDER( pFrame->rtpTimestamp,
+                                                                   rtpTimestamp ) )
+        {
+            pFrame = NULL;
+            break;
+        }
+        else
+        {
+            pFrame = NULL;
+        }
+    }
+
+    if( pInsertPosition != NULL )
+    {
+        *pInsertPosition = i;
+    }
+
+    return pFrame;
+}
+
+static PeerConnectionJitterBufferFrame_t * InsertFrame( PeerConnectionJitterBuffer_t * pJitterBuffer,
+                                                        uint32_t rtpTimestamp,
+                                                        size_t position )
+{
+    PeerConnectionJitterBufferFrame_t * pFrame;
+    size_t i;
+
+    /* Frames arrive in order, shifting only happens for a frame whose packets were all reordered behind a newer frame. */
+    for( i = pJitterBuffer->frameCount; i > position; i-- )
+    {
+        *PEER_CONNECTION_JITTER_BUFFER_FRAME_AT( pJitterBuffer,
+                                                 i ) = *PEER_CONNECTION_JITTER_BUFFER_FRAME_AT( pJitterBuffer,
+                                                                                                i - 1U );
+    }
+    pJitterBuffer->frameCount++;
+
+    pFrame = PEER_CONNECTION_JITTER_BUFFER_FRAME_AT( pJitterBuffer,
+                                                     position );
+    memset( pFrame,
+            0,
+            sizeof( PeerConnectionJitterBufferFrame_t ) );
+    pFrame->rtpTimestamp = rtpTimestamp;
+
+    return pFrame;
+}
+
+static uint8_t IsPacketOfFrame( PeerConnectionJitterBuffer_t * pJitterBuffer,
+                                const PeerConnectionJitterBufferFrame_t * pFrame,
+                                uint16_t rtpSeq )
+{
+    PeerConnectionJitterBufferPacket_t * pPacket;
+
+    pPacket = &pJitterBuffer->rtpPackets[ PEER_CONNECTION_JITTER_BUFFER_WRAP( rtpSeq,
+                                                                              PEER_CONNECTION_JITTER_BUFFER_MAX_ENTRY_NUM ) ];
+
+    return ( ( pPacket->isPushed != 0U ) &&
+             ( pPacket->sequenceNumber == rtpSeq ) &&
+             ( pPacket->rtpTimestamp == pFrame->rtpTimestamp ) ) ? 1U : 0U;
+}
+
+/* Count the packets not received yet once both ends of the frame are known, later packets only decrease it. */
+static uint32_t CountMissingPackets( PeerConnectionJitterBuffer_t * pJitterBuffer,
+                                     const PeerConnectionJitterBufferFrame_t * pFrame )
+{
+    uint32_t missingCount = ( uint32_t )( uint16_t )( pFrame->lastSequenceNumber - pFrame->firstSequenceNumber ) + 1U;
+    uint16_t i;
+
+    if( missingCount <= PEER_CONNECTION_JITTER_BUFFER_MAX_ENTRY_NUM )
+    {
+        for( i = pFrame->firstSequenceNumber; i != ( uint16_t )( pFrame->lastSequenceNumber + 1 ); i++ )
+        {
+            if( IsPacketOfFrame( pJitterBuffer,
+                                 pFrame,
+                                 i ) != 0U )
+            {
+                missingCount--;
+            }
+        }
+    }
+    else
+    {
+        /* The frame can't be held by the jitter buffer, it never completes and expires. */
+        LogWarn( ( "Frame with timestamp: %lu spans more packets than the jitter buffer holds, first seq: %u, last seq: %u",
+                   pFrame->rtpTimestamp,
+                   pFrame->firstSequenceNumber,
+                   pFrame->lastSequenceNumber ) );
+    }
+
+    return missingCount;
+}
+
+static void AddPacketToFrame( PeerConnectionJitterBuffer_t * pJitterBuffer,
+                              PeerConnectionJitterBufferFrame_t * pFrame,
+                              PeerConnectionJitterBufferPacket_t * pPacket,
+                              uint8_t isStart,
+                              uint8_t isEnd,
+                              uint8_t isNewFrame )
+{
+    uint8_t wasRangeKnown = ( ( pFrame->isStartSeen != 0U ) && ( pFrame->isMarkerSeen != 0U ) ) ? 1U : 0U;
+
+    if( isNewFrame != 0U )
+    {
+        pFrame->lowestSequenceNumber = pPacket->sequenceNumber;
+        pFrame->highestSequenceNumber = pPacket->sequenceNumber;
+    }
+    else if( PEER_CONNECTION_JITTER_BUFFER_IS_SEQ_OLDER( pPacket->sequenceNumber,
+                                                         pFrame->lowestSequenceNumber ) )
+    {
+        pFrame->lowestSequenceNumber = pPacket->sequenceNumber;
+    }
+    else if( PEER_CONNECTION_JITTER_BUFFER_IS_SEQ_OLDER( pFrame->highestSequenceNumber,
+                                                         pPacket->sequenceNumber ) )
+    {
+        pFrame->highestSequenceNumber = pPacket->sequenceNumber;
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    if( ( isStart != 0U ) && ( pFrame->isStartSeen == 0U ) )
+    {
+        pFrame->isStartSeen = 1U;
+        pFrame->firstSequenceNumber = pPacket->sequenceNumber;
+    }
 
-        if( pNextPacket != NULL )
+    if( ( isEnd != 0U ) && ( pFrame->isMarkerSeen == 0U ) )
+    {
+        pFrame->isMarkerSeen = 1U;
+        pFrame->lastSequenceNumber = pPacket->sequenceNumber;
+    }
+
+    if( wasRangeKnown != 0U )
+    {
+        if( ( pFrame->missingCount > 0U ) &&
+            PEER_CONNECTION_JITTER_BUFFER_IS_SEQ_IN_RANGE( pPacket->sequenceNumber,
+                                                           pFrame->firstSequenceNumber,
+                                                           pFrame->lastSequenceNumber ) )
         {
-            pJitterBuffer->oldestReceivedSequenceNumber = pNextPacket->sequenceNumber;
-            pJitterBuffer->lastPopRtpTimestamp = pNextPacket->rtpTimestamp;
+            pFrame->missingCount--;
         }
     }
+    else if( ( pFrame->isStartSeen != 0U ) && ( pFrame->isMarkerSeen != 0U ) )
+    {
+        pFrame->missingCount = CountMissingPackets( pJitterBuffer,
+                                                    pFrame );
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
 }
 
-static uint8_t IsRtpPacketExpired( PeerConnectionJitterBuffer_t * pJitterBuffer,
+/* A pushed packet is overwritten by a duplicate or by a packet a whole buffer later, it's missing from its frame again. */
+static void RemovePacketFromFrame( PeerConnectionJitterBuffer_t * pJitterBuffer,
                                    PeerConnectionJitterBufferPacket_t * pPacket )
 {
-    uint8_t isExpired = 0U;
-    uint32_t earliestBufferTimestamp = 0U;
+    PeerConnectionJitterBufferFrame_t * pFrame;
 
-    earliestBufferTimestamp = pJitterBuffer->newestReceivedTimestamp - pJitterBuffer->tolerenceRtpTimeStamp;
-    if( ( ( pJitterBuffer->newestReceivedTimestamp > earliestBufferTimestamp ) &&
-          ( pPacket->rtpTimestamp < earliestBufferTimestamp ) ) ||
-        ( ( pJitterBuffer->newestReceivedTimestamp < earliestBufferTimestamp ) &&
-          ( pPacket->rtpTimestamp < earliestBufferTimestamp ) &&
-          ( pPacket->rtpTimestamp > pJitterBuffer->newestReceivedTimestamp ) ) )
+    pFrame = FindFrame( pJitterBuffer,
+                        pPacket->rtpTimestamp,
+                        NULL );
+    if( ( pFrame != NULL ) &&
+        ( pFrame->isStartSeen != 0U ) &&
+        ( pFrame->isMarkerSeen != 0U ) &&
+        PEER_CONNECTION_JITTER_BUFFER_IS_SEQ_IN_RANGE( pPacket->sequenceNumber,
+                                                       pFrame->firstSequenceNumber,
+                                                       pFrame->lastSequenceNumber ) )
     {
-        isExpired = 1U;
+        pFrame->missingCount++;
     }
+}
+
+/* Pop the oldest frame, either handing it to the frame ready callback or dropping it, and release its packets. */
+static PeerConnectionResult_t PopFrame( PeerConnectionJitterBuffer_t * pJitterBuffer,
+                                        uint8_t isReady )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    PeerConnectionJitterBufferFrame_t * pFrame;
+    uint16_t i;
+
+    pFrame = PEER_CONNECTION_JITTER_BUFFER_FRAME_AT( pJitterBuffer,
+                                                     0U );
+    if( isReady != 0U )
+    {
+        ret = pJitterBuffer->onFrameReadyCallbackFunc( pJitterBuffer->pOnFrameReadyCallbackContext,
+                                                       pFrame->firstSequenceNumber,
+                                                       pFrame->lastSequenceNumber );
+    }
+    else
+    {
+        ret = pJitterBuffer->onFrameDropCallbackFunc( pJitterBuffer->pOnFrameDropCallbackContext,
+                                                      pFrame->lowestSequenceNumber,
+                                                      pFrame->highestSequenceNumber );
+    }
+
+    /* Packets of other timestamps in the range, if any, stay for their own frames. */
+    for( i = pFrame->lowestSequenceNumber; i != ( uint16_t )( pFrame->highestSequenceNumber + 1 ); i++ )
+    {
+        if( IsPacketOfFrame( pJitterBuffer,
+                             pFrame,
+                             i ) != 0U )
+        {
+            DiscardPacket( pJitterBuffer,
+                           &pJitterBuffer->rtpPackets[ PEER_CONNECTION_JITTER_BUFFER_WRAP( i,
+                                                                                           PEER_CONNECTION_JITTER_BUFFER_MAX_ENTRY_NUM ) ] );
+        }
+    }
+
+    pJitterBuffer->hasPoppedFrame = 1U;
+    pJitterBuffer->lastPopRtpTimestamp = pFrame->rtpTimestamp;
+    pJitterBuffer->lastPopSequenceNumber = pFrame->highestSequenceNumber;
+    pJitterBuffer->frameHead = PEER_CONNECTION_JITTER_BUFFER_INCREASE_WITH_WRAP( pJitterBuffer->frameHead,
+                                                                                 1U,
+                                                                                 PEER_CONNECTION_JITTER_BUFFER_MAX_FRAME_NUM );
+    pJitterBuffer->frameCount--;
 
-    return isExpired;
+    return ret;
 }
 
-static PeerConnectionResult_t ParseFramesInJitterBuffer( PeerConnectionJitterBuffer_t * pJitterBuffer,
-                                                         BaseType_t isClosing )
+/* Pop the frames at the head of the queue that are complete or expired. Frames are popped in timestamp order,
+ * so a complete frame waits for the incomplete frames before it to complete or expire. */
+static PeerConnectionResult_t PopFrames( PeerConnectionJitterBuffer_t * pJitterBuffer,
+                                         BaseType_t isClosing )
 {
     PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
-    uint16_t i, index, prev;
-    PeerConnectionJitterBufferPacket_t * pPacket;
-    uint8_t isFrameDataContinuous = 1U;
-    uint8_t isStart;
-    int32_t popingPacketStartSeq = -1;
-    int32_t firstPacketSeq = -1;
+    PeerConnectionJitterBufferFrame_t * pFrame;
 
     if( pJitterBuffer == NULL )
     {
@@ -115,154 +344,133 @@ static PeerConnectionResult_t ParseFramesInJitterBuffer( PeerConnectionJitterBuf
         /* Empty else marker. */
     }
 
-    if( ret == PEER_CONNECTION_RESULT_OK )
+    while( ( ret == PEER_CONNECTION_RESULT_OK ) &&
+           ( pJitterBuffer->frameCount > 0U ) )
     {
-        /* Note that newest sequence is probably less than oldest sequence due to wrapping. */
-        firstPacketSeq = pJitterBuffer->oldestReceivedSequenceNumber;
-        prev = firstPacketSeq;
-        for( i = pJitterBuffer->oldestReceivedSequenceNumber; i != ( uint16_t )( pJitterBuffer->newestReceivedSequenceNumber + 1 ); i++ )
+        pFrame = PEER_CONNECTION_JITTER_BUFFER_FRAME_AT( pJitterBuffer,
+                                                         0U );
+        if( IsFrameComplete( pFrame ) != 0U )
         {
-            index = PEER_CONNECTION_JITTER_BUFFER_WRAP( i,
-                                                        PEER_CONNECTION_JITTER_BUFFER_MAX_ENTRY_NUM );
-            pPacket = &pJitterBuffer->rtpPackets[ index ];
-            if( pPacket->isPushed == 0U )
+            ret = PopFrame( pJitterBuffer,
+                            1U );
+            if( ret != PEER_CONNECTION_RESULT_OK )
             {
-                isFrameDataContinuous = 0;
-                if( ( isClosing == 0U ) &&
-                    ( !IsRtpPacketExpired( pJitterBuffer, pPacket ) ) )
-                {
-                    /* Current frame is not completely received, break to wait for a while. */
-                    break;
-                }
+                LogError( ( "Terminating popping jitter buffer frames by frame ready callback function, result: %d", ret ) );
             }
-            else
+        }
+        else if( ( isClosing != pdFALSE ) ||
+                 ( IsRtpTimestampExpired( pJitterBuffer,
+                                          pFrame->rtpTimestamp ) != 0U ) )
+        {
+            ret = PopFrame( pJitterBuffer,
+                            0U );
+            if( ret != PEER_CONNECTION_RESULT_OK )
             {
-                if( pPacket->rtpTimestamp != pJitterBuffer->lastPopRtpTimestamp )
-                {
-                    if( ( popingPacketStartSeq != -1 ) &&
-                        ( isFrameDataContinuous != 0U ) )
-                    {
-                        /* We now have an full frame ready between start index and end index. */
-                        ret = pJitterBuffer->onFrameReadyCallbackFunc( pJitterBuffer->pOnFrameReadyCallbackContext,
-                                                                       popingPacketStartSeq,
-                                                                       prev );
-                        DiscardPackets( pJitterBuffer,
-                                        popingPacketStartSeq,
-                                        prev,
-                                        pPacket );
-                        popingPacketStartSeq = -1;
-                        firstPacketSeq = i;
-                        if( ret != PEER_CONNECTION_RESULT_OK )
-                        {
-                            LogError( ( "Terminating parsing jitter buffer by frame ready callback function, result: %d", ret ) );
-                            break;
-                        }
-                    }
-                    else if( IsRtpPacketExpired( pJitterBuffer, pPacket ) )
-                    {
-                        /* data is expired, drop them */
-                        ret = pJitterBuffer->onFrameDropCallbackFunc( pJitterBuffer->pOnFrameReadyCallbackContext,
-                                                                      firstPacketSeq,
-                                                                      prev );
-                        DiscardPackets( pJitterBuffer,
-                                        firstPacketSeq,
-                                        prev,
-                                        pPacket );
-                        popingPacketStartSeq = -1;
-                        firstPacketSeq = i;
-                        if( ret != PEER_CONNECTION_RESULT_OK )
-                        {
-                            LogError( ( "Terminating parsing jitter buffer by frame drop callback function, result: %d", ret ) );
-                            break;
-                        }
-                    }
-                    else
-                    {
-                        /* The following packets are still in tolerence timestamp, not necessary to parse them for now. */
-                        break;
-                    }
-                }
+                LogError( ( "Terminating popping jitter buffer frames by frame drop callback function, result: %d", ret ) );
             }
+        }
+        else
+        {
+            /* The oldest frame is still in tolerence timestamp, wait for its packets. */
+            break;
+        }
+    }
 
-            if( pPacket->rtpTimestamp == pJitterBuffer->lastPopRtpTimestamp )
-            {
-                if( ( pJitterBuffer->getPacketPropertyFunc ) &&
-                    ( pJitterBuffer->getPacketPropertyFunc( pPacket,
-                                                            &isStart ) == PEER_CONNECTION_RESULT_OK ) )
-                {
-                    if( ( popingPacketStartSeq == -1 ) &&
-                        ( isStart != 0U ) )
-                    {
-                        popingPacketStartSeq = i;
-                    }
-                }
-                else
-                {
-                    /* No get properties callback function or it returns failure. This packet is invalid, drop it. */
-                    isFrameDataContinuous = 0;
-                    LogInfo( ( "Fail to get property, dumping RTP payload, 0x%x 0x%x 0x%x 0x%x",
-                               pPacket->pPacketBuffer[0],
-                               pPacket->pPacketBuffer[1],
-                               pPacket->pPacketBuffer[2],
-                               pPacket->pPacketBuffer[3] ) );
-                    DiscardPacket( pJitterBuffer,
-                                   pPacket );
-                    if( ( isClosing == 0U ) &&
-                        ( !IsRtpPacketExpired( pJitterBuffer, pPacket ) ) )
-                    {
-                        /* Detect invalid packet */
-                        break;
-                    }
-                }
-            }
+    return ret;
+}
+
+/* Assign the pushed packet to the frame of its timestamp. The packet properties are parsed only here, once per packet. */
+static PeerConnectionResult_t AssemblePacket( PeerConnectionJitterBuffer_t * pJitterBuffer,
+                                              PeerConnectionJitterBufferPacket_t * pPacket )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    PeerConnectionJitterBufferFrame_t * pFrame = NULL;
+    size_t insertPosition = 0;
+    uint8_t isStart = 0U, isEnd = 0U, isNewFrame = 0U;
+
+    if( ( pJitterBuffer->getPacketPropertyFunc == NULL ) ||
+        ( pJitterBuffer->getPacketPropertyFunc( pPacket,
+                                                &isStart ) != PEER_CONNECTION_RESULT_OK ) )
+    {
+        /* No get properties callback function or it returns failure. This packet is invalid, drop it. */
+        LogInfo( ( "Fail to get property, dumping RTP payload, 0x%x 0x%x 0x%x 0x%x",
+                   pPacket->pPacketBuffer[0],
+                   pPacket->pPacketBuffer[1],
+                   pPacket->pPacketBuffer[2],
+                   pPacket->pPacketBuffer[3] ) );
+        ret = PEER_CONNECTION_RESULT_FAIL_DEPACKETIZER_GET_PROPERTIES;
+    }
 
-            prev = i;
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        if( pJitterBuffer->isSinglePacketFrame != 0U )
+        {
+            isStart = 1U;
+            isEnd = 1U;
+        }
+        else
+        {
+            isEnd = pPacket->isMarker;
         }
+    }
 
-        /* Deal with last frame when closing */
-        if( isClosing != 0U )
+    /* A timestamp up to the last popped one has already been delivered or dropped. */
+    if( ( ret == PEER_CONNECTION_RESULT_OK ) &&
+        ( pJitterBuffer->hasPoppedFrame != 0U ) &&
+        !PEER_CONNECTION_JITTER_BUFFER_IS_TIMESTAMP_OLDER( pJitterBuffer->lastPopRtpTimestamp,
+                                                           pPacket->rtpTimestamp ) )
+    {
+        LogDebug( ( "Dropping packet with seq: %u of popped timestamp: %lu",
+                    pPacket->sequenceNumber,
+                    pPacket->rtpTimestamp ) );
+        ret = PEER_CONNECTION_RESULT_PACKET_OUTDATED;
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        pFrame = FindFrame( pJitterBuffer,
+                            pPacket->rtpTimestamp,
+                            &insertPosition );
+        if( ( pFrame == NULL ) &&
+            ( pJitterBuffer->frameCount == PEER_CONNECTION_JITTER_BUFFER_MAX_FRAME_NUM ) )
         {
-            firstPacketSeq = pJitterBuffer->oldestReceivedSequenceNumber;
-            prev = firstPacketSeq;
-            for( i = pJitterBuffer->oldestReceivedSequenceNumber; i != ( uint16_t )( pJitterBuffer->newestReceivedSequenceNumber + 1 ); i++ )
+            if( insertPosition == 0U )
             {
-                index = PEER_CONNECTION_JITTER_BUFFER_WRAP( i,
-                                                            PEER_CONNECTION_JITTER_BUFFER_MAX_ENTRY_NUM );
-                pPacket = &pJitterBuffer->rtpPackets[ index ];
-                if( pPacket->isPushed == 0U )
-                {
-                    ret = pJitterBuffer->onFrameDropCallbackFunc( pJitterBuffer->pOnFrameReadyCallbackContext,
-                                                                  firstPacketSeq,
-                                                                  prev );
-                    DiscardPackets( pJitterBuffer,
-                                    firstPacketSeq,
-                                    prev,
-                                    NULL );
-                    firstPacketSeq = i;
-                    if( ret != PEER_CONNECTION_RESULT_OK )
-                    {
-                        LogWarn( ( "Getting error return in drop frame callback function while closing jitter buffer, result: %d", ret ) );
-                        continue;
-                    }
-                }
-
-                prev = i;
+                LogDebug( ( "Dropping packet with seq: %u older than all frames of the full frame queue",
+                            pPacket->sequenceNumber ) );
+                ret = PEER_CONNECTION_RESULT_PACKET_OUTDATED;
             }
-
-            ret = pJitterBuffer->onFrameDropCallbackFunc( pJitterBuffer->pOnFrameReadyCallbackContext,
-                                                          firstPacketSeq,
-                                                          prev );
-            DiscardPackets( pJitterBuffer,
-                            firstPacketSeq,
-                            prev,
-                            NULL );
-            if( ret != PEER_CONNECTION_RESULT_OK )
+            else
             {
-                LogWarn( ( "Getting error return in drop frame callback function while closing jitter buffer, result: %d", ret ) );
+                /* No room for another frame, give up the oldest one. */
+                LogWarn( ( "Jitter buffer frame queue is full, popping frame with timestamp: %lu",
+                           PEER_CONNECTION_JITTER_BUFFER_FRAME_AT( pJitterBuffer, 0U )->rtpTimestamp ) );
+                ( void ) PopFrame( pJitterBuffer,
+                                   IsFrameComplete( PEER_CONNECTION_JITTER_BUFFER_FRAME_AT( pJitterBuffer,
+                                                                                            0U ) ) );
+                insertPosition--;
             }
         }
     }
 
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        if( pFrame == NULL )
+        {
+            pFrame = InsertFrame( pJitterBuffer,
+                                  pPacket->rtpTimestamp,
+                                  insertPosition );
+            isNewFrame = 1U;
+        }
+
+        AddPacketToFrame( pJitterBuffer,
+                          pFrame,
+                          pPacket,
+                          isStart,
+                          isEnd,
+                          isNewFrame );
+    }
+
     return ret;
 }
 
@@ -329,80 +537,76 @@ static PeerConnectionResult_t UpdateJitterBufferAddPacket( PeerConnectionJitterB
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        /* Update newest sequence number. */
-        if( pPacket->sequenceNumber > pJitterBuffer->newestReceivedSequenceNumber )
+        /* Update newest sequence number and timestamp, both may wrap. */
+        if( PEER_CONNECTION_JITTER_BUFFER_IS_SEQ_OLDER( pJitterBuffer->newestReceivedSequenceNumber,
+                                                        pPacket->sequenceNumber ) )
         {
-            /* The RTP sequence number in packet is just larger than newest one. */
             pJitterBuffer->newestReceivedSequenceNumber = pPacket->sequenceNumber;
         }
-        else if( ( ( pJitterBuffer->newestReceivedSequenceNumber + PEER_CONNECTION_JITTER_BUFFER_SEQ_WRAPPER_THRESHOLD ) & 0xFFFF ) <= pPacket->sequenceNumber )
-        {
-            /* Overflow is happening, we update the newest sequence number only if it's in the range of threshold. */
-            pJitterBuffer->newestReceivedSequenceNumber = pPacket->sequenceNumber;
-        }
-        else
-        {
-            /* Do nothing for non newest packets. */
-        }
-
-        /* Update oldest sequecen number. */
-        if( pPacket->sequenceNumber < pJitterBuffer->oldestReceivedSequenceNumber )
-        {
-            /* The RTP sequence number in packet is just older than oldest one. */
-            pJitterBuffer->oldestReceivedSequenceNumber = pPacket->sequenceNumber;
-        }
-        else if( ( ( pJitterBuffer->oldestReceivedSequenceNumber - PEER_CONNECTION_JITTER_BUFFER_SEQ_WRAPPER_THRESHOLD ) & 0xFFFF ) <= pPacket->sequenceNumber )
-        {
-            /* Overflow is happening, we update the newest sequence number only if it's in the range of threshold. */
-            pJitterBuffer->newestReceivedSequenceNumber = pPacket->sequenceNumber;
-        }
-        else
-        {
-            /* Do nothing for non newest packets. */
-        }
 
-        /* Update newest timestamp. */
-        if( pPacket->rtpTimestamp > pJitterBuffer->newestReceivedTimestamp )
-        {
-            /* The RTP timestamp in packet is just larger than newest one. */
-            pJitterBuffer->newestReceivedTimestamp = pPacket->rtpTimestamp;
-        }
-        else if( ( ( uint64_t )( pJitterBuffer->newestReceivedTimestamp + ( PEER_CONNECTION_JITTER_BUFFER_TIMESTAMP_WRAPPER_THRESHOLD_SEC * pJitterBuffer->clockRate ) ) & 0xFFFFFFFF ) <= pPacket->rtpTimestamp )
+        if( PEER_CONNECTION_JITTER_BUFFER_IS_TIMESTAMP_OLDER( pJitterBuffer->newestReceivedTimestamp,
+                                                              pPacket->rtpTimestamp ) )
         {
-            /* Overflow is happening, we update the newest timestamp only if it's in the range of threshold. */
             pJitterBuffer->newestReceivedTimestamp = pPacket->rtpTimestamp;
         }
-        else
-        {
-            /* Do nothing for non newest packets. */
-        }
+    }
 
-        /* Update oldest timestamp. */
-        if( pPacket->rtpTimestamp < pJitterBuffer->lastPopRtpTimestamp )
-        {
-            pJitterBuffer->lastPopRtpTimestamp = pPacket->rtpTimestamp;
-        }
-        else if( ( ( uint64_t )( pJitterBuffer->lastPopRtpTimestamp > pPacket->rtpTimestamp + ( PEER_CONNECTION_JITTER_BUFFER_TIMESTAMP_WRAPPER_THRESHOLD_SEC * pJitterBuffer->clockRate ) ) & 0xFFFFFFFF ) )
-        {
-            /* Overflow is happening, we update the last pop timestamp only if it's in the range of threshold. */
-            pJitterBuffer->lastPopRtpTimestamp = pPacket->rtpTimestamp;
-        }
-        else
+    return ret;
+}
+
+static void PushFreeSlot( PeerConnectionJitterBuffer_t * pJitterBuffer,
+                          uint8_t * pSlot )
+{
+    memcpy( pSlot,
+            &pJitterBuffer->pFreeSlots,
+            sizeof( uint8_t * ) );
+    pJitterBuffer->pFreeSlots = pSlot;
+    pJitterBuffer->freeSlotCount++;
+}
+
+static uint8_t * PopFreeSlot( PeerConnectionJitterBuffer_t * pJitterBuffer )
+{
+    uint8_t * pSlot = pJitterBuffer->pFreeSlots;
+
+    if( pSlot != NULL )
+    {
+        memcpy( &pJitterBuffer->pFreeSlots,
+                pSlot,
+                sizeof( uint8_t * ) );
+        pJitterBuffer->freeSlotCount--;
+    }
+
+    return pSlot;
+}
+
+static void RefillSpareSlot( PeerConnectionJitterBuffer_t * pJitterBuffer )
+{
+    if( pJitterBuffer->pSpareSlot == NULL )
+    {
+        /* Out of slots, give up the oldest frames whole rather than keeping parts of many frames. */
+        pJitterBuffer->pSpareSlot = PopFreeSlot( pJitterBuffer );
+        while( ( pJitterBuffer->pSpareSlot == NULL ) &&
+               ( pJitterBuffer->frameCount > 0U ) )
         {
-            /* Empty else marker */
+            LogWarn( ( "No free jitter buffer slot, popping frame with timestamp: %lu",
+                       PEER_CONNECTION_JITTER_BUFFER_FRAME_AT( pJitterBuffer, 0U )->rtpTimestamp ) );
+            ( void ) PopFrame( pJitterBuffer,
+                               IsFrameComplete( PEER_CONNECTION_JITTER_BUFFER_FRAME_AT( pJitterBuffer,
+                                                                                        0U ) ) );
+            pJitterBuffer->pSpareSlot = PopFreeSlot( pJitterBuffer );
         }
     }
-
-    return ret;
 }
 
 static void DiscardPacket( PeerConnectionJitterBuffer_t * pJitterBuffer,
                            PeerConnectionJitterBufferPacket_t * pPacket )
 {
-    ( void ) pJitterBuffer;
-    if( pPacket && ( pPacket->pPacketBuffer != NULL ) )
+    if( ( pJitterBuffer != NULL ) &&
+        ( pPacket != NULL ) &&
+        ( pPacket->pPacketBuffer != NULL ) )
     {
-        vPortFree( pPacket->pPacketBuffer );
+        PushFreeSlot( pJitterBuffer,
+                      pPacket->pPacketBuffer - pPacket->payloadOffset );
         memset( pPacket,
                 0,
                 sizeof( PeerConnectionJitterBufferPacket_t ) );
@@ -419,6 +623,7 @@ PeerConnectionResult_t PeerConnectionJitterBuffer_Create( PeerConnectionJitterBu
                                                           uint32_t clockRate )
 {
     PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    size_t i;
 
     if( ( pJitterBuffer == NULL ) ||
         ( codec == 0 ) )
@@ -441,7 +646,6 @@ PeerConnectionResult_t PeerConnectionJitterBuffer_Create( PeerConnectionJitterBu
         pJitterBuffer->lastPopTick = portMAX_DELAY;
         pJitterBuffer->newestReceivedSequenceNumber = 0xFFFF;
         pJitterBuffer->newestReceivedTimestamp = 0xFFFFFFFF;
-        pJitterBuffer->oldestReceivedSequenceNumber = 0U;
         /* Converting tolerence buffer in seconds into RTP time stamp format. */
         pJitterBuffer->tolerenceRtpTimeStamp = tolerenceBufferSec * ( clockRate );
 
@@ -467,18 +671,21 @@ PeerConnectionResult_t PeerConnectionJitterBuffer_Create( PeerConnectionJitterBu
         {
             pJitterBuffer->getPacketPropertyFunc = PeerConnectionOpusHelper_GetOpusPacketProperty;
             pJitterBuffer->fillFrameFunc = PeerConnectionOpusHelper_FillFrameOpus;
+            pJitterBuffer->isSinglePacketFrame = 1U;
         }
         else if( TRANSCEIVER_IS_CODEC_ENABLED( codec,
                                                TRANSCEIVER_RTC_CODEC_MULAW_BIT ) )
         {
             pJitterBuffer->getPacketPropertyFunc = PeerConnectionG711Helper_GetG711PacketProperty;
             pJitterBuffer->fillFrameFunc = PeerConnectionG711Helper_FillFrameG711;
+            pJitterBuffer->isSinglePacketFrame = 1U;
         }
         else if( TRANSCEIVER_IS_CODEC_ENABLED( codec,
                                                TRANSCEIVER_RTC_CODEC_ALAW_BIT ) )
         {
             pJitterBuffer->getPacketPropertyFunc = PeerConnectionG711Helper_GetG711PacketProperty;
             pJitterBuffer->fillFrameFunc = PeerConnectionG711Helper_FillFrameG711;
+            pJitterBuffer->isSinglePacketFrame = 1U;
         }
         else if( TRANSCEIVER_IS_CODEC_ENABLED( codec,
                                                TRANSCEIVER_RTC_CODEC_H265_BIT ) )
@@ -494,6 +701,29 @@ PeerConnectionResult_t PeerConnectionJitterBuffer_Create( PeerConnectionJitterBu
         }
     }
 
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        /* Size the slot pool from the codec. */
+        pJitterBuffer->slotCount = ( pJitterBuffer->isSinglePacketFrame != 0U ) ? PEER_CONNECTION_JITTER_BUFFER_AUDIO_SLOT_NUM : PEER_CONNECTION_JITTER_BUFFER_VIDEO_SLOT_NUM;
+        pJitterBuffer->pSlotPool = ( uint8_t * )pvPortMalloc( ( pJitterBuffer->slotCount + 1U ) * PEER_CONNECTION_JITTER_BUFFER_SLOT_SIZE );
+        if( pJitterBuffer->pSlotPool == NULL )
+        {
+            LogError( ( "No memory available for allocating jitter buffer slots with size %u",
+                        ( pJitterBuffer->slotCount + 1U ) * PEER_CONNECTION_JITTER_BUFFER_SLOT_SIZE ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_JITTER_BUFFER_NO_ENOUGH_MEMORY;
+        }
+        else
+        {
+            /* Push in reverse order so the first slot is handed out first. */
+            for( i = pJitterBuffer->slotCount; i > 0U; i-- )
+            {
+                PushFreeSlot( pJitterBuffer,
+                              pJitterBuffer->pSlotPool + ( i - 1U ) * PEER_CONNECTION_JITTER_BUFFER_SLOT_SIZE );
+            }
+            pJitterBuffer->pSpareSlot = pJitterBuffer->pSlotPool + pJitterBuffer->slotCount * PEER_CONNECTION_JITTER_BUFFER_SLOT_SIZE;
+        }
+    }
+
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
         pJitterBuffer->isInit = 1U;
@@ -526,32 +756,109 @@ void PeerConnectionJitterBuffer_Free( PeerConnectionJitterBuffer_t * pJitterBuff
     {
         pJitterBuffer->isInit = 0U;
 
-        ( void ) ParseFramesInJitterBuffer( pJitterBuffer,
-                                            pdTRUE );
+        ( void ) PopFrames( pJitterBuffer,
+                            pdTRUE );
     }
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
         DiscardPackets( pJitterBuffer,
                         0,
-                        PEER_CONNECTION_JITTER_BUFFER_MAX_ENTRY_NUM - 1,
-                        NULL );
+                        PEER_CONNECTION_JITTER_BUFFER_MAX_ENTRY_NUM - 1 );
+
+        vPortFree( pJitterBuffer->pSlotPool );
+        pJitterBuffer->pSlotPool = NULL;
+        pJitterBuffer->pFreeSlots = NULL;
+        pJitterBuffer->freeSlotCount = 0U;
+        pJitterBuffer->pSpareSlot = NULL;
     }
 }
 
-PeerConnectionResult_t PeerConnectionJitterBuffer_AllocateBuffer( PeerConnectionJitterBuffer_t * pJitterBuffer,
-                                                                  PeerConnectionJitterBufferPacket_t ** ppOutPacket,
-                                                                  size_t packetBufferSize,
-                                                                  uint16_t rtpSeq )
+PeerConnectionResult_t PeerConnectionJitterBuffer_AcquireSlot( PeerConnectionJitterBuffer_t * pJitterBuffer,
+                                                               uint8_t ** ppSlot )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    uint8_t * pSlot = NULL;
+
+    if( ( pJitterBuffer == NULL ) ||
+        ( ppSlot == NULL ) )
+    {
+        LogError( ( "Invalid input, pJitterBuffer: %p, ppSlot: %p", pJitterBuffer, ppSlot ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+    else if( pJitterBuffer->isInit == 0U )
+    {
+        LogError( ( "Jitter buffer is not initialized yet or it has been freed." ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        /* The packet isn't authenticated yet, decrypt it into the spare slot instead of evicting frames. */
+        pSlot = PopFreeSlot( pJitterBuffer );
+        if( pSlot == NULL )
+        {
+            pSlot = pJitterBuffer->pSpareSlot;
+            pJitterBuffer->pSpareSlot = NULL;
+        }
+
+        if( pSlot == NULL )
+        {
+            LogError( ( "No free jitter buffer slot" ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_JITTER_BUFFER_NO_FREE_SLOT;
+        }
+        else
+        {
+            *ppSlot = pSlot;
+        }
+    }
+
+    return ret;
+}
+
+void PeerConnectionJitterBuffer_ReleaseSlot( PeerConnectionJitterBuffer_t * pJitterBuffer,
+                                             uint8_t * pSlot )
+{
+    if( ( pJitterBuffer == NULL ) ||
+        ( pSlot == NULL ) )
+    {
+        LogError( ( "Invalid input, pJitterBuffer: %p, pSlot: %p", pJitterBuffer, pSlot ) );
+    }
+    else if( pJitterBuffer->pSlotPool == NULL )
+    {
+        /* The pool has been released with the jitter buffer. */
+    }
+    else if( pJitterBuffer->pSpareSlot == NULL )
+    {
+        pJitterBuffer->pSpareSlot = pSlot;
+    }
+    else
+    {
+        PushFreeSlot( pJitterBuffer,
+                      pSlot );
+    }
+}
+
+PeerConnectionResult_t PeerConnectionJitterBuffer_SetPacket( PeerConnectionJitterBuffer_t * pJitterBuffer,
+                                                             PeerConnectionJitterBufferPacket_t ** ppOutPacket,
+                                                             uint8_t * pSlot,
+                                                             size_t payloadOffset,
+                                                             size_t payloadLength,
+                                                             uint16_t rtpSeq )
 {
     PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
     int index = PEER_CONNECTION_JITTER_BUFFER_WRAP( rtpSeq,
                                                     PEER_CONNECTION_JITTER_BUFFER_MAX_ENTRY_NUM );
 
     if( ( pJitterBuffer == NULL ) ||
-        ( ppOutPacket == NULL ) )
+        ( ppOutPacket == NULL ) ||
+        ( pSlot == NULL ) )
     {
-        LogError( ( "Invalid input, pJitterBuffer: %p, ppOutPacket: %p", pJitterBuffer, ppOutPacket ) );
+        LogError( ( "Invalid input, pJitterBuffer: %p, ppOutPacket: %p, pSlot: %p", pJitterBuffer, ppOutPacket, pSlot ) );
         ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
     }
     else if( pJitterBuffer->isInit == 0U )
@@ -559,11 +866,16 @@ PeerConnectionResult_t PeerConnectionJitterBuffer_AllocateBuffer( PeerConnection
         LogError( ( "Jitter buffer is not initialized yet or it has been freed." ) );
         ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
     }
-    else if( packetBufferSize == 0 )
+    else if( payloadLength == 0 )
     {
         LogError( ( "Invalid input, the input buffer length should be set correctly" ) );
         ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
     }
+    else if( payloadOffset + payloadLength > PEER_CONNECTION_JITTER_BUFFER_SLOT_SIZE )
+    {
+        LogError( ( "Payload at offset %u with length %u exceeds jitter buffer slot size %u", payloadOffset, payloadLength, PEER_CONNECTION_JITTER_BUFFER_SLOT_SIZE ) );
+        ret = PEER_CONNECTION_RESULT_FAIL_JITTER_BUFFER_PACKET_TOO_LARGE;
+    }
     else
     {
         /* Empty else marker. */
@@ -571,7 +883,16 @@ PeerConnectionResult_t PeerConnectionJitterBuffer_AllocateBuffer( PeerConnection
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
+        /* The packet has authenticated, frames can be given up for the spare slot now. */
+        RefillSpareSlot( pJitterBuffer );
+
         *ppOutPacket = &pJitterBuffer->rtpPackets[index];
+        if( ( *ppOutPacket )->isPushed != 0U )
+        {
+            RemovePacketFromFrame( pJitterBuffer,
+                                   *ppOutPacket );
+        }
+
         if( ( *ppOutPacket )->pPacketBuffer != NULL )
         {
             /* Remove old information. */
@@ -579,8 +900,10 @@ PeerConnectionResult_t PeerConnectionJitterBuffer_AllocateBuffer( PeerConnection
                            *ppOutPacket );
         }
 
-        ( *ppOutPacket )->pPacketBuffer = ( uint8_t * )pvPortMalloc( packetBufferSize );
-        ( *ppOutPacket )->packetBufferLength = packetBufferSize;
+        /* The payload stays where it was received, behind the RTP header. */
+        ( *ppOutPacket )->pPacketBuffer = pSlot + payloadOffset;
+        ( *ppOutPacket )->packetBufferLength = payloadLength;
+        ( *ppOutPacket )->payloadOffset = payloadOffset;
     }
 
     return ret;
@@ -657,7 +980,6 @@ PeerConnectionResult_t PeerConnectionJitterBuffer_Push( PeerConnectionJitterBuff
             pJitterBuffer->isStart = 1U;
             pJitterBuffer->newestReceivedSequenceNumber = pPacket->sequenceNumber;
             pJitterBuffer->newestReceivedTimestamp = pPacket->rtpTimestamp;
-            pJitterBuffer->oldestReceivedSequenceNumber = pPacket->sequenceNumber;
         }
 
         ret = ShouldAcceptPacket( pJitterBuffer,
@@ -673,23 +995,24 @@ PeerConnectionResult_t PeerConnectionJitterBuffer_Push( PeerConnectionJitterBuff
                                            pPacket );
     }
 
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        ret = AssemblePacket( pJitterBuffer,
+                              pPacket );
+    }
+
     if( ret != PEER_CONNECTION_RESULT_OK )
     {
         /* Remove this packet if any error happens. */
-        if( pPacket && ( pPacket->pPacketBuffer != NULL ) )
-        {
-            vPortFree( pPacket->pPacketBuffer );
-            memset( pPacket,
-                    0,
-                    sizeof( PeerConnectionJitterBufferPacket_t ) );
-        }
+        DiscardPacket( pJitterBuffer,
+                       pPacket );
     }
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        /* Parse the jitter buffer to check if any frames are ready for decoding or if any packets need to be dropped. */
-        ret = ParseFramesInJitterBuffer( pJitterBuffer,
-                                         pdFALSE );
+        /* Pop the frames that are ready for decoding now, and the expired ones. */
+        ret = PopFrames( pJitterBuffer,
+                         pdFALSE );
     }
 
     return ret;
@@ -31,6 +31,20 @@ extern "C" {
 
 #include "peer_connection_data_types.h"
 
+/* Received packets are kept in MTU-sized slots, a whole SRTP packet fits in one. */
+#define PEER_CONNECTION_JITTER_BUFFER_SLOT_SIZE ( 1400 )
+
+/* Slots of a video jitter buffer, the tolerence time of 1 Mbps video in 1200-byte packets. */
+#ifndef PEER_CONNECTION_JITTER_BUFFER_VIDEO_SLOT_NUM
+#define PEER_CONNECTION_JITTER_BUFFER_VIDEO_SLOT_NUM ( 256 )
+#endif
+
+/* Slots of an audio jitter buffer. Audio packets are frames delivered as they arrive,
+ * the slots only hold the packets waiting behind a lost one, one second of 20 ms frames. */
+#ifndef PEER_CONNECTION_JITTER_BUFFER_AUDIO_SLOT_NUM
+#define PEER_CONNECTION_JITTER_BUFFER_AUDIO_SLOT_NUM ( 50 )
+#endif
+
 PeerConnectionResult_t PeerConnectionJitterBuffer_Create( PeerConnectionJitterBuffer_t * pJitterBuffer,
                                                           OnJitterBufferFrameReadyCallback_t onFrameReadyCallbackFunc,
                                                           void * pOnFrameReadyCallbackContext,
@@ -42,10 +56,25 @@ PeerConnectionResult_t PeerConnectionJitterBuffer_Create( PeerConnectionJitterBu
 
 void PeerConnectionJitterBuffer_Free( PeerConnectionJitterBuffer_t * pJitterBuffer );
 
-PeerConnectionResult_t PeerConnectionJitterBuffer_AllocateBuffer( PeerConnectionJitterBuffer_t * pJitterBuffer,
-                                                                  PeerConnectionJitterBufferPacket_t ** ppOutPacket,
-                                                                  size_t packetBufferSize,
-                                                                  uint16_t rtpSeq );
+/* Take a free slot of PEER_CONNECTION_JITTER_BUFFER_SLOT_SIZE bytes to receive a packet into.
+ * When all slots are in use, the spare slot is handed out. Nothing is evicted here, so a packet
+ * failing to decrypt costs no frame. */
+PeerConnectionResult_t PeerConnectionJitterBuffer_AcquireSlot( PeerConnectionJitterBuffer_t * pJitterBuffer,
+                                                               uint8_t ** ppSlot );
+
+/* Give back a slot that hasn't been set as a packet. */
+void PeerConnectionJitterBuffer_ReleaseSlot( PeerConnectionJitterBuffer_t * pJitterBuffer,
+                                             uint8_t * pSlot );
+
+/* Store the packet received in the slot at its sequence number, replacing the packet there. The payload
+ * is referenced at its offset in the slot, not copied. The slot belongs to the jitter buffer from now on.
+ * If the spare slot is in use, the oldest frames are given up whole until it's replaced. */
+PeerConnectionResult_t PeerConnectionJitterBuffer_SetPacket( PeerConnectionJitterBuffer_t * pJitterBuffer,
+                                                             PeerConnectionJitterBufferPacket_t ** ppOutPacket,
+                                                             uint8_t * pSlot,
+                                                             size_t payloadOffset,
+                                                             size_t payloadLength,
+                                                             uint16_t rtpSeq );
 
 PeerConnectionResult_t PeerConnectionJitterBuffer_GetPacket( PeerConnectionJitterBuffer_t * pJitterBuffer,
                                                              uint16_t rtpSeq,
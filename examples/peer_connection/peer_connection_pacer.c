@@ -0,0 +1,156 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <string.h>
+#include "logging.h"
+#include "peer_connection_pacer.h"
+#include "networking_utils.h"
+
+#include "FreeRTOS.h"
+
+#define PEER_CONNECTION_PACER_US_IN_A_SECOND ( 1000000ULL )
+#define PEER_CONNECTION_PACER_MS_IN_A_SECOND ( 1000ULL )
+
+static void RefillBudget( PeerConnectionPacer_t * pPacer,
+                          uint32_t pacingBitrate,
+                          uint64_t currentTimeUs )
+{
+    if( pPacer->lastRefillTimeUs == 0U )
+    {
+        pPacer->budgetBytes = ( int64_t ) pPacer->burstBytes;
+    }
+    else if( currentTimeUs > pPacer->lastRefillTimeUs )
+    {
+        pPacer->budgetBytes += ( int64_t )( ( currentTimeUs - pPacer->lastRefillTimeUs ) * pacingBitrate / 8U / PEER_CONNECTION_PACER_US_IN_A_SECOND );
+        if( pPacer->budgetBytes > ( int64_t ) pPacer->burstBytes )
+        {
+            pPacer->budgetBytes = ( int64_t ) pPacer->burstBytes;
+        }
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    pPacer->lastRefillTimeUs = currentTimeUs;
+}
+
+void PeerConnectionPacer_Init( PeerConnectionPacer_t * pPacer,
+                               uint32_t startBitrate,
+                               uint32_t burstBytes )
+{
+    if( pPacer == NULL )
+    {
+        LogError( ( "Invalid input, pPacer: %p", pPacer ) );
+    }
+    else
+    {
+        memset( pPacer,
+                0,
+                sizeof( PeerConnectionPacer_t ) );
+        pPacer->minPacingBitrate = ( uint32_t )( ( uint64_t ) PEER_CONNECTION_PACER_MIN_BITRATE * PEER_CONNECTION_PACER_PACING_FACTOR_PERCENT / 100U );
+        pPacer->pacingBitrate = ( uint32_t )( ( uint64_t ) startBitrate * PEER_CONNECTION_PACER_PACING_FACTOR_PERCENT / 100U );
+        if( pPacer->pacingBitrate < pPacer->minPacingBitrate )
+        {
+            pPacer->pacingBitrate = pPacer->minPacingBitrate;
+        }
+        pPacer->burstBytes = burstBytes;
+    }
+}
+
+void PeerConnectionPacer_SetBitrate( PeerConnectionPacer_t * pPacer,
+                                     uint32_t estimatedBitrate )
+{
+    uint64_t pacingBitrate;
+
+    if( pPacer == NULL )
+    {
+        LogError( ( "Invalid input, pPacer: %p", pPacer ) );
+    }
+    else
+    {
+        pacingBitrate = ( uint64_t ) estimatedBitrate * PEER_CONNECTION_PACER_PACING_FACTOR_PERCENT / 100U;
+        if( pacingBitrate < pPacer->minPacingBitrate )
+        {
+            pacingBitrate = pPacer->minPacingBitrate;
+        }
+        else if( pacingBitrate > UINT32_MAX )
+        {
+            pacingBitrate = UINT32_MAX;
+        }
+        else
+        {
+            /* Empty else marker. */
+        }
+
+        pPacer->pacingBitrate = ( uint32_t ) pacingBitrate;
+    }
+}
+
+uint32_t PeerConnectionPacer_GetDelay( PeerConnectionPacer_t * pPacer )
+{
+    uint32_t delayMs = 0U;
+    uint32_t pacingBitrate;
+
+    if( pPacer == NULL )
+    {
+        LogError( ( "Invalid input, pPacer: %p", pPacer ) );
+    }
+    else if( pPacer->pacingBitrate != 0U )
+    {
+        pacingBitrate = pPacer->pacingBitrate;
+        RefillBudget( pPacer,
+                      pacingBitrate,
+                      NetworkingUtils_GetCurrentTimeUs( NULL ) );
+
+        if( pPacer->budgetBytes < 0 )
+        {
+            /* Wait for the debt of the previous batch to be paid off. */
+            delayMs = ( uint32_t )( ( ( uint64_t )( -pPacer->budgetBytes ) * 8U * PEER_CONNECTION_PACER_MS_IN_A_SECOND + pacingBitrate - 1U ) / pacingBitrate );
+            if( delayMs > PEER_CONNECTION_PACER_MAX_DELAY_MS )
+            {
+                delayMs = PEER_CONNECTION_PACER_MAX_DELAY_MS;
+            }
+        }
+    }
+    else
+    {
+        /* Pacing is disabled. */
+    }
+
+    return delayMs;
+}
+
+void PeerConnectionPacer_Consume( PeerConnectionPacer_t * pPacer,
+                                  size_t bytes )
+{
+    if( pPacer == NULL )
+    {
+        LogError( ( "Invalid input, pPacer: %p", pPacer ) );
+    }
+    else if( pPacer->pacingBitrate != 0U )
+    {
+        RefillBudget( pPacer,
+                      pPacer->pacingBitrate,
+                      NetworkingUtils_GetCurrentTimeUs( NULL ) );
+        pPacer->budgetBytes -= ( int64_t ) bytes;
+    }
+    else
+    {
+        /* Pacing is disabled. */
+    }
+}
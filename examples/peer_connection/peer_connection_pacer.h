@@ -0,0 +1,80 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef PEER_CONNECTION_PACER_H
+#define PEER_CONNECTION_PACER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Standard includes. */
+#include <stdint.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+
+#include "peer_connection_data_types.h"
+#include "peer_connection_bwe.h"
+
+/* Send faster than the estimated bitrate so the queue drains before the next frame. */
+#ifndef PEER_CONNECTION_PACER_PACING_FACTOR_PERCENT
+#define PEER_CONNECTION_PACER_PACING_FACTOR_PERCENT ( 250 )
+#endif
+
+/* Lowest bitrate in bps the pacing rate is derived from, so a low estimate still drains the queue.
+ * It follows the floor of bandwidth estimation, a higher floor would pace above the estimate. */
+#ifndef PEER_CONNECTION_PACER_MIN_BITRATE
+#if ENABLE_TWCC_SUPPORT
+#define PEER_CONNECTION_PACER_MIN_BITRATE PEER_CONNECTION_BWE_MIN_BITRATE
+#else
+#define PEER_CONNECTION_PACER_MIN_BITRATE ( 150000 )
+#endif
+#endif
+
+/* Bytes that can be sent back to back without waiting, e.g. the whole of a small P frame. */
+#ifndef PEER_CONNECTION_PACER_BURST_BYTES
+#define PEER_CONNECTION_PACER_BURST_BYTES ( 16 * 1200 )
+#endif
+
+/* Upper bound of a single wait, so a stale estimate can't stall the sender. */
+#ifndef PEER_CONNECTION_PACER_MAX_DELAY_MS
+#define PEER_CONNECTION_PACER_MAX_DELAY_MS ( 50 )
+#endif
+
+/* Start pacing at the encoder bitrate in bps until an estimate is set. */
+void PeerConnectionPacer_Init( PeerConnectionPacer_t * pPacer,
+                               uint32_t startBitrate,
+                               uint32_t burstBytes );
+
+/* Update the pacing rate from the estimated bitrate in bps. */
+void PeerConnectionPacer_SetBitrate( PeerConnectionPacer_t * pPacer,
+                                     uint32_t estimatedBitrate );
+
+/* Milliseconds to wait before the next batch can be sent, 0 if it can be sent now. It never waits itself,
+ * so the caller can wait without holding the sender. */
+uint32_t PeerConnectionPacer_GetDelay( PeerConnectionPacer_t * pPacer );
+
+/* Take the bytes just sent from the budget. */
+void PeerConnectionPacer_Consume( PeerConnectionPacer_t * pPacer,
+                                  size_t bytes );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PEER_CONNECTION_PACER_H */
@@ -0,0 +1,205 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <string.h>
+#include "logging.h"
+#include "peer_connection_red.h"
+
+#define PEER_CONNECTION_RED_F_BIT ( 0x80U )
+#define PEER_CONNECTION_RED_PAYLOAD_TYPE_MASK ( 0x7FU )
+#define PEER_CONNECTION_RED_MAX_TIMESTAMP_OFFSET ( 0x3FFFU )
+
+void PeerConnectionRed_Init( PeerConnectionRedEncoder_t * pRed,
+                             uint32_t payloadType,
+                             uint32_t primaryPayloadType )
+{
+    if( pRed == NULL )
+    {
+        LogError( ( "Invalid input, pRed: %p", pRed ) );
+    }
+    else
+    {
+        memset( pRed,
+                0,
+                sizeof( PeerConnectionRedEncoder_t ) );
+
+        if( payloadType != 0U )
+        {
+            pRed->payloadType = ( uint8_t )( payloadType & PEER_CONNECTION_RED_PAYLOAD_TYPE_MASK );
+            pRed->primaryPayloadType = ( uint8_t )( primaryPayloadType & PEER_CONNECTION_RED_PAYLOAD_TYPE_MASK );
+            pRed->redundantFrames = ( PEER_CONNECTION_RED_REDUNDANT_FRAMES < PEER_CONNECTION_RED_MAX_REDUNDANT_FRAMES ) ? PEER_CONNECTION_RED_REDUNDANT_FRAMES : PEER_CONNECTION_RED_MAX_REDUNDANT_FRAMES;
+            pRed->isEnabled = 1U;
+        }
+    }
+}
+
+PeerConnectionResult_t PeerConnectionRed_WritePayload( PeerConnectionRedEncoder_t * pRed,
+                                                       const uint8_t * pPayload,
+                                                       size_t payloadLength,
+                                                       uint32_t rtpTimestamp,
+                                                       uint8_t * pBuffer,
+                                                       size_t bufferLength,
+                                                       size_t * pWrittenLength )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    const PeerConnectionRedBlock_t * pBlocks[ PEER_CONNECTION_RED_MAX_REDUNDANT_FRAMES ];
+    const PeerConnectionRedBlock_t * pBlock;
+    PeerConnectionRedBlock_t * pHistory;
+    uint8_t blockCount = 0U;
+    uint32_t timestampOffset;
+    size_t totalLength;
+    size_t offset = 0;
+    uint8_t i;
+
+    if( ( pRed == NULL ) ||
+        ( pPayload == NULL ) ||
+        ( pBuffer == NULL ) ||
+        ( pWrittenLength == NULL ) )
+    {
+        LogError( ( "Invalid input, pRed: %p, pPayload: %p, pBuffer: %p, pWrittenLength: %p", pRed, pPayload, pBuffer, pWrittenLength ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+    else if( payloadLength + PEER_CONNECTION_RED_PRIMARY_HEADER_LENGTH > bufferLength )
+    {
+        LogError( ( "Payload length %u exceeds RED buffer size %u", payloadLength, bufferLength ) );
+        ret = PEER_CONNECTION_RESULT_FAIL_PACKETIZER_GET_PACKET;
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        /* Pick the previous frames from the newest, a frame too old for the 14 bits offset
+         * or not fitting in the packet is left out, the primary block always fits. */
+        totalLength = payloadLength + PEER_CONNECTION_RED_PRIMARY_HEADER_LENGTH;
+        for( i = 1; i <= pRed->redundantFrames; i++ )
+        {
+            pBlock = &pRed->history[ ( pRed->historyIndex + PEER_CONNECTION_RED_MAX_REDUNDANT_FRAMES - i ) % PEER_CONNECTION_RED_MAX_REDUNDANT_FRAMES ];
+            timestampOffset = rtpTimestamp - pBlock->rtpTimestamp;
+            if( ( pBlock->dataLength == 0U ) ||
+                ( timestampOffset == 0U ) ||
+                ( timestampOffset > PEER_CONNECTION_RED_MAX_TIMESTAMP_OFFSET ) ||
+                ( totalLength + PEER_CONNECTION_RED_BLOCK_HEADER_LENGTH + pBlock->dataLength > bufferLength ) )
+            {
+                break;
+            }
+
+            totalLength += PEER_CONNECTION_RED_BLOCK_HEADER_LENGTH + pBlock->dataLength;
+            pBlocks[ blockCount++ ] = pBlock;
+        }
+
+        /* Block headers, the oldest block first and the primary block last. */
+        for( i = blockCount; i > 0U; i-- )
+        {
+            pBlock = pBlocks[ i - 1U ];
+            timestampOffset = rtpTimestamp - pBlock->rtpTimestamp;
+            pBuffer[ offset++ ] = PEER_CONNECTION_RED_F_BIT | pRed->primaryPayloadType;
+            pBuffer[ offset++ ] = ( uint8_t )( timestampOffset >> 6 );
+            pBuffer[ offset++ ] = ( uint8_t )( ( ( timestampOffset & 0x3FU ) << 2 ) | ( ( pBlock->dataLength >> 8 ) & 0x03U ) );
+            pBuffer[ offset++ ] = ( uint8_t )( pBlock->dataLength & 0xFFU );
+        }
+        pBuffer[ offset++ ] = pRed->primaryPayloadType;
+
+        /* Block data in the same order. */
+        for( i = blockCount; i > 0U; i-- )
+        {
+            pBlock = pBlocks[ i - 1U ];
+            memcpy( pBuffer + offset,
+                    pBlock->data,
+                    pBlock->dataLength );
+            offset += pBlock->dataLength;
+        }
+        memcpy( pBuffer + offset,
+                pPayload,
+                payloadLength );
+        offset += payloadLength;
+
+        /* Keep the frame for the next packets, a frame too large for a block isn't repeated. */
+        pHistory = &pRed->history[ pRed->historyIndex ];
+        pHistory->rtpTimestamp = rtpTimestamp;
+        if( payloadLength <= PEER_CONNECTION_RED_MAX_BLOCK_LENGTH )
+        {
+            memcpy( pHistory->data,
+                    pPayload,
+                    payloadLength );
+            pHistory->dataLength = payloadLength;
+        }
+        else
+        {
+            pHistory->dataLength = 0U;
+        }
+        pRed->historyIndex = ( pRed->historyIndex + 1U ) % PEER_CONNECTION_RED_MAX_REDUNDANT_FRAMES;
+
+        *pWrittenLength = offset;
+    }
+
+    return ret;
+}
+
+PeerConnectionResult_t PeerConnectionRed_GetPrimaryPayload( uint8_t * pPayload,
+                                                            size_t payloadLength,
+                                                            uint8_t ** ppPrimaryPayload,
+                                                            size_t * pPrimaryPayloadLength )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    size_t headerLength = 0;
+    size_t redundantLength = 0;
+
+    if( ( pPayload == NULL ) ||
+        ( ppPrimaryPayload == NULL ) ||
+        ( pPrimaryPayloadLength == NULL ) )
+    {
+        LogError( ( "Invalid input, pPayload: %p, ppPrimaryPayload: %p, pPrimaryPayloadLength: %p", pPayload, ppPrimaryPayload, pPrimaryPayloadLength ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+
+    /* Walk the redundant block headers until the primary block header. */
+    while( ( ret == PEER_CONNECTION_RESULT_OK ) &&
+           ( headerLength < payloadLength ) &&
+           ( ( pPayload[ headerLength ] & PEER_CONNECTION_RED_F_BIT ) != 0U ) )
+    {
+        if( headerLength + PEER_CONNECTION_RED_BLOCK_HEADER_LENGTH > payloadLength )
+        {
+            LogWarn( ( "Truncated RED block header, payload length: %u", payloadLength ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_RED_PARSE;
+        }
+        else
+        {
+            redundantLength += ( ( ( size_t ) pPayload[ headerLength + 2 ] & 0x03U ) << 8 ) | pPayload[ headerLength + 3 ];
+            headerLength += PEER_CONNECTION_RED_BLOCK_HEADER_LENGTH;
+        }
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        headerLength += PEER_CONNECTION_RED_PRIMARY_HEADER_LENGTH;
+        if( headerLength + redundantLength > payloadLength )
+        {
+            LogWarn( ( "RED blocks exceed payload length: %u", payloadLength ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_RED_PARSE;
+        }
+        else
+        {
+            *ppPrimaryPayload = pPayload + headerLength + redundantLength;
+            *pPrimaryPayloadLength = payloadLength - headerLength - redundantLength;
+        }
+    }
+
+    return ret;
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef PEER_CONNECTION_RED_H
+#define PEER_CONNECTION_RED_H
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Standard includes. */
+#include <stdint.h>
+
+#include "peer_connection_data_types.h"
+
+/* Block header of a redundant block: F bit, payload type, 14 bits timestamp offset and 10 bits length. */
+#define PEER_CONNECTION_RED_BLOCK_HEADER_LENGTH ( 4 )
+/* Block header of the primary block: F bit and payload type. */
+#define PEER_CONNECTION_RED_PRIMARY_HEADER_LENGTH ( 1 )
+
+/* Previous frames repeated in each packet, one lost packet in a row is covered by 1, two by 2. */
+#ifndef PEER_CONNECTION_RED_REDUNDANT_FRAMES
+#define PEER_CONNECTION_RED_REDUNDANT_FRAMES ( 2 )
+#endif
+
+/* Enable RED with the negotiated payload type, a payload type of 0 disables it. */
+void PeerConnectionRed_Init( PeerConnectionRedEncoder_t * pRed,
+                             uint32_t payloadType,
+                             uint32_t primaryPayloadType );
+
+/* Write the RED payload of an audio frame into pBuffer: the previous frames that fit, then the frame itself.
+ * The frame is kept as redundancy of the next packets. */
+PeerConnectionResult_t PeerConnectionRed_WritePayload( PeerConnectionRedEncoder_t * pRed,
+                                                       const uint8_t * pPayload,
+                                                       size_t payloadLength,
+                                                       uint32_t rtpTimestamp,
+                                                       uint8_t * pBuffer,
+                                                       size_t bufferLength,
+                                                       size_t * pWrittenLength );
+
+/* Find the primary block of a received RED payload, it points into pPayload. */
+PeerConnectionResult_t PeerConnectionRed_GetPrimaryPayload( uint8_t * pPayload,
+                                                            size_t payloadLength,
+                                                            uint8_t ** ppPrimaryPayload,
+                                                            size_t * pPrimaryPayloadLength );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PEER_CONNECTION_RED_H */
@@ -15,11 +15,173 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include "logging.h"
 #include "peer_connection.h"
 #include "peer_connection_rolling_buffer.h"
 
 #include "FreeRTOS.h"
+#if METRIC_PRINT_ENABLED
+#include "metric.h"
+#endif
+
+/* Keep every slot aligned for the RtpPacket_t inside PeerConnectionRollingBufferPacket_t. */
+#define PEER_CONNECTION_ROLLING_BUFFER_SLOT_ALIGNMENT ( 8U )
+#define PEER_CONNECTION_ROLLING_BUFFER_ALIGN_SIZE( x ) ( ( ( x ) + PEER_CONNECTION_ROLLING_BUFFER_SLOT_ALIGNMENT - 1U ) & ~( PEER_CONNECTION_ROLLING_BUFFER_SLOT_ALIGNMENT - 1U ) )
+
+/* The index holds the retained packets, and one more slot is in use by the packet
+ * being written before PeerConnectionRollingBuffer_SetPacket() evicts the oldest one. */
+#define PEER_CONNECTION_ROLLING_BUFFER_EXTRA_SLOT_COUNT ( 1U )
+
+/* The slab index of a slot is kept in a uint8_t. */
+#define PEER_CONNECTION_ROLLING_BUFFER_MAX_SLAB_COUNT ( 255U )
+
+static size_t GetNeededSlabCount( size_t retainedCount )
+{
+    return ( retainedCount + PEER_CONNECTION_ROLLING_BUFFER_EXTRA_SLOT_COUNT + PEER_CONNECTION_ROLLING_BUFFER_SLAB_SLOT_COUNT - 1U ) / PEER_CONNECTION_ROLLING_BUFFER_SLAB_SLOT_COUNT;
+}
+
+static PeerConnectionResult_t AllocateSlab( PeerConnectionRollingBuffer_t * pRollingBuffer,
+                                            size_t slabIndex )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    PeerConnectionRollingBufferSlab_t * pSlab = &pRollingBuffer->pSlabs[ slabIndex ];
+    PeerConnectionRollingBufferPacket_t * pPacket;
+    size_t i;
+
+    pSlab->pSlots = ( uint8_t * )pvPortMalloc( PEER_CONNECTION_ROLLING_BUFFER_SLAB_SLOT_COUNT * pRollingBuffer->slotSize );
+    if( pSlab->pSlots == NULL )
+    {
+        LogWarn( ( "No memory available for allocating rolling buffer slab with size %u, allocated slabs: %u",
+                   PEER_CONNECTION_ROLLING_BUFFER_SLAB_SLOT_COUNT * pRollingBuffer->slotSize,
+                   pRollingBuffer->allocatedSlabCount ) );
+        ret = PEER_CONNECTION_RESULT_FAIL_ROLLING_BUFFER_SLAB_NO_ENOUGH_MEMORY;
+    }
+    else
+    {
+        #if METRIC_PRINT_ENABLED
+        Metric_IncreaseCounter( METRIC_COUNTER_ROLLING_BUFFER_HEAP_ALLOCATION, 1U );
+        #endif
+
+        /* Push in reverse order so the first slot is handed out first. */
+        pSlab->pFreeSlots = NULL;
+        for( i = PEER_CONNECTION_ROLLING_BUFFER_SLAB_SLOT_COUNT; i > 0U; i-- )
+        {
+            pPacket = ( PeerConnectionRollingBufferPacket_t * )( pSlab->pSlots + ( i - 1U ) * pRollingBuffer->slotSize );
+            pPacket->slabIndex = ( uint8_t ) slabIndex;
+            pPacket->pNextFree = pSlab->pFreeSlots;
+            pSlab->pFreeSlots = pPacket;
+        }
+        pSlab->freeCount = PEER_CONNECTION_ROLLING_BUFFER_SLAB_SLOT_COUNT;
+        pRollingBuffer->allocatedSlabCount++;
+    }
+
+    return ret;
+}
+
+static void ReleaseSlab( PeerConnectionRollingBuffer_t * pRollingBuffer,
+                         size_t slabIndex )
+{
+    PeerConnectionRollingBufferSlab_t * pSlab = &pRollingBuffer->pSlabs[ slabIndex ];
+
+    vPortFree( pSlab->pSlots );
+    pSlab->pSlots = NULL;
+    pSlab->pFreeSlots = NULL;
+    pSlab->freeCount = 0U;
+    pRollingBuffer->allocatedSlabCount--;
+}
+
+static void PushFreeSlot( PeerConnectionRollingBuffer_t * pRollingBuffer,
+                          PeerConnectionRollingBufferPacket_t * pPacket )
+{
+    PeerConnectionRollingBufferSlab_t * pSlab = &pRollingBuffer->pSlabs[ pPacket->slabIndex ];
+
+    pPacket->pNextFree = pSlab->pFreeSlots;
+    pSlab->pFreeSlots = pPacket;
+    pSlab->freeCount++;
+}
+
+static PeerConnectionRollingBufferPacket_t * PopFreeSlot( PeerConnectionRollingBuffer_t * pRollingBuffer )
+{
+    PeerConnectionRollingBufferPacket_t * pPacket = NULL;
+    PeerConnectionRollingBufferSlab_t * pSlab = NULL;
+    size_t i;
+
+    /* Take from the lowest slab, so the upper slabs drain and can be released when the retention shrinks. */
+    for( i = 0; i < pRollingBuffer->slabCount; i++ )
+    {
+        if( pRollingBuffer->pSlabs[ i ].pFreeSlots != NULL )
+        {
+            pSlab = &pRollingBuffer->pSlabs[ i ];
+            break;
+        }
+    }
+
+    /* The allocated slabs are all in use, which only happens when growing the retention was short of heap. */
+    for( i = 0; ( pSlab == NULL ) && ( i < pRollingBuffer->slabCount ); i++ )
+    {
+        if( pRollingBuffer->pSlabs[ i ].pSlots == NULL )
+        {
+            if( AllocateSlab( pRollingBuffer, i ) == PEER_CONNECTION_RESULT_OK )
+            {
+                pSlab = &pRollingBuffer->pSlabs[ i ];
+            }
+            break;
+        }
+    }
+
+    if( pSlab != NULL )
+    {
+        pPacket = pSlab->pFreeSlots;
+        pSlab->pFreeSlots = pPacket->pNextFree;
+        pSlab->freeCount--;
+    }
+
+    return pPacket;
+}
+
+static uint8_t IsSlabSlot( PeerConnectionRollingBuffer_t * pRollingBuffer,
+                           PeerConnectionRollingBufferPacket_t * pPacket )
+{
+    uint8_t * pSlot = ( uint8_t * ) pPacket;
+    uint8_t * pSlots;
+    uint8_t isSlot = 0U;
+
+    if( pPacket->slabIndex < pRollingBuffer->slabCount )
+    {
+        pSlots = pRollingBuffer->pSlabs[ pPacket->slabIndex ].pSlots;
+        if( ( pSlots != NULL ) &&
+            ( pSlot >= pSlots ) &&
+            ( pSlot < pSlots + PEER_CONNECTION_ROLLING_BUFFER_SLAB_SLOT_COUNT * pRollingBuffer->slotSize ) &&
+            ( ( ( size_t )( pSlot - pSlots ) % pRollingBuffer->slotSize ) == 0U ) )
+        {
+            isSlot = 1U;
+        }
+    }
+
+    return isSlot;
+}
+
+/* Evict the packets older than the retained count from the newest one. */
+static void EvictOldPackets( PeerConnectionRollingBuffer_t * pRollingBuffer )
+{
+    PeerConnectionRollingBufferPacket_t * pPacket;
+    size_t index;
+
+    while( ( uint16_t )( pRollingBuffer->newestSeq - pRollingBuffer->oldestSeq ) >= pRollingBuffer->retainedCount )
+    {
+        index = pRollingBuffer->oldestSeq & pRollingBuffer->indexMask;
+        pPacket = pRollingBuffer->ppIndex[ index ];
+        if( ( pPacket != NULL ) &&
+            ( pPacket->rtpPacket.header.sequenceNumber == pRollingBuffer->oldestSeq ) )
+        {
+            pRollingBuffer->ppIndex[ index ] = NULL;
+            PushFreeSlot( pRollingBuffer,
+                          pPacket );
+        }
+        pRollingBuffer->oldestSeq++;
+    }
+}
 
 PeerConnectionResult_t PeerConnectionRollingBuffer_Create( PeerConnectionRollingBuffer_t * pRollingBuffer,
                                                            uint32_t rollingbufferBitRate,  // bps
@@ -27,7 +189,9 @@ PeerConnectionResult_t PeerConnectionRollingBuffer_Create( PeerConnectionRolling
                                                            size_t maxSizePerPacket )
 {
     PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
-    RtpPacketQueueResult_t resultRtpPacketQueue;
+    uint8_t isCleared = 0U;
+    size_t indexSize = 1U;
+    size_t i;
 
     if( ( pRollingBuffer == NULL ) ||
         ( rollingbufferBitRate == 0 ) ||
@@ -44,42 +208,105 @@ PeerConnectionResult_t PeerConnectionRollingBuffer_Create( PeerConnectionRolling
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
+        memset( pRollingBuffer,
+                0,
+                sizeof( PeerConnectionRollingBuffer_t ) );
+        isCleared = 1U;
         pRollingBuffer->maxSizePerPacket = maxSizePerPacket;
         pRollingBuffer->capacity = rollingbufferDurationSec * rollingbufferBitRate / 8U / maxSizePerPacket;
-        pRollingBuffer->packetQueue.pRtpPacketInfoArray = ( RtpPacketInfo_t * )pvPortMalloc( pRollingBuffer->capacity * sizeof( RtpPacketInfo_t ) );
-        if( pRollingBuffer->packetQueue.pRtpPacketInfoArray == NULL )
+        if( pRollingBuffer->capacity > PEER_CONNECTION_ROLLING_BUFFER_MAX_SLAB_COUNT * PEER_CONNECTION_ROLLING_BUFFER_SLAB_SLOT_COUNT - PEER_CONNECTION_ROLLING_BUFFER_EXTRA_SLOT_COUNT )
+        {
+            pRollingBuffer->capacity = PEER_CONNECTION_ROLLING_BUFFER_MAX_SLAB_COUNT * PEER_CONNECTION_ROLLING_BUFFER_SLAB_SLOT_COUNT - PEER_CONNECTION_ROLLING_BUFFER_EXTRA_SLOT_COUNT;
+        }
+
+        /* Until the round trip time is measured, keep the whole configured duration. */
+        pRollingBuffer->retainedCount = pRollingBuffer->capacity;
+
+        while( ( indexSize < pRollingBuffer->capacity ) && ( indexSize < 0x10000U ) )
+        {
+            indexSize <<= 1;
+        }
+        pRollingBuffer->indexMask = indexSize - 1U;
+
+        pRollingBuffer->ppIndex = ( PeerConnectionRollingBufferPacket_t ** )pvPortMalloc( indexSize * sizeof( PeerConnectionRollingBufferPacket_t * ) );
+        if( pRollingBuffer->ppIndex == NULL )
         {
-            LogError( ( "No memory available for allocating RTP packet info array with total size %u, capacity: %u, sizeof( RtpPacketInfo_t ): %u",
-                        pRollingBuffer->capacity * sizeof( RtpPacketInfo_t ),
-                        pRollingBuffer->capacity,
-                        sizeof( RtpPacketInfo_t ) ) );
+            LogError( ( "No memory available for allocating rolling buffer index with total size %u, capacity: %u",
+                        indexSize * sizeof( PeerConnectionRollingBufferPacket_t * ),
+                        pRollingBuffer->capacity ) );
             ret = PEER_CONNECTION_RESULT_FAIL_PACKET_INFO_NO_ENOUGH_MEMORY;
         }
         else
         {
-            LogInfo( ( "Allocated RTP packet info array with total size %u, capacity: %u, sizeof( RtpPacketInfo_t ): %u",
-                       pRollingBuffer->capacity * sizeof( RtpPacketInfo_t ),
-                       pRollingBuffer->capacity,
-                       sizeof( RtpPacketInfo_t ) ) );
+            memset( pRollingBuffer->ppIndex,
+                    0,
+                    indexSize * sizeof( PeerConnectionRollingBufferPacket_t * ) );
+            LogInfo( ( "Allocated rolling buffer index with total size %u, capacity: %u",
+                       indexSize * sizeof( PeerConnectionRollingBufferPacket_t * ),
+                       pRollingBuffer->capacity ) );
         }
     }
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        resultRtpPacketQueue = RtpPacketQueue_Init( &pRollingBuffer->packetQueue,
-                                                    pRollingBuffer->packetQueue.pRtpPacketInfoArray,
-                                                    pRollingBuffer->capacity );
-        if( resultRtpPacketQueue != RTP_PACKET_QUEUE_RESULT_OK )
+        pRollingBuffer->slotSize = PEER_CONNECTION_ROLLING_BUFFER_ALIGN_SIZE( sizeof( PeerConnectionRollingBufferPacket_t ) + maxSizePerPacket );
+        pRollingBuffer->slabCount = GetNeededSlabCount( pRollingBuffer->capacity );
+        pRollingBuffer->pSlabs = ( PeerConnectionRollingBufferSlab_t * )pvPortMalloc( pRollingBuffer->slabCount * sizeof( PeerConnectionRollingBufferSlab_t ) );
+        if( pRollingBuffer->pSlabs == NULL )
         {
-            LogError( ( "Fail to init RTP packet queue with result: %d", resultRtpPacketQueue ) );
-            ret = PEER_CONNECTION_RESULT_FAIL_RTP_PACKET_QUEUE_INIT;
+            LogError( ( "No memory available for allocating rolling buffer slab table, slab count: %u",
+                        pRollingBuffer->slabCount ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_ROLLING_BUFFER_SLAB_NO_ENOUGH_MEMORY;
+        }
+        else
+        {
+            memset( pRollingBuffer->pSlabs,
+                    0,
+                    pRollingBuffer->slabCount * sizeof( PeerConnectionRollingBufferSlab_t ) );
         }
     }
 
+    for( i = 0; ( ret == PEER_CONNECTION_RESULT_OK ) && ( i < pRollingBuffer->slabCount ); i++ )
+    {
+        ret = AllocateSlab( pRollingBuffer,
+                            i );
+    }
+
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
+        LogInfo( ( "Allocated rolling buffer slabs with total size %u, slab count: %u, slot size: %u",
+                   pRollingBuffer->slabCount * PEER_CONNECTION_ROLLING_BUFFER_SLAB_SLOT_COUNT * pRollingBuffer->slotSize,
+                   pRollingBuffer->slabCount,
+                   pRollingBuffer->slotSize ) );
         pRollingBuffer->isInit = 1U;
     }
+    else if( isCleared != 0U )
+    {
+        for( i = 0; ( pRollingBuffer->pSlabs != NULL ) && ( i < pRollingBuffer->slabCount ); i++ )
+        {
+            if( pRollingBuffer->pSlabs[ i ].pSlots != NULL )
+            {
+                ReleaseSlab( pRollingBuffer,
+                             i );
+            }
+        }
+
+        if( pRollingBuffer->pSlabs != NULL )
+        {
+            vPortFree( pRollingBuffer->pSlabs );
+            pRollingBuffer->pSlabs = NULL;
+        }
+
+        if( pRollingBuffer->ppIndex != NULL )
+        {
+            vPortFree( pRollingBuffer->ppIndex );
+            pRollingBuffer->ppIndex = NULL;
+        }
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
 
     return ret;
 }
@@ -87,8 +314,7 @@ PeerConnectionResult_t PeerConnectionRollingBuffer_Create( PeerConnectionRolling
 void PeerConnectionRollingBuffer_Free( PeerConnectionRollingBuffer_t * pRollingBuffer )
 {
     PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
-    RtpPacketQueueResult_t resultRtpPacketQueue = RTP_PACKET_QUEUE_RESULT_OK;
-    RtpPacketInfo_t rtpPacketInfo;
+    size_t i;
 
     if( pRollingBuffer == NULL )
     {
@@ -110,20 +336,96 @@ void PeerConnectionRollingBuffer_Free( PeerConnectionRollingBuffer_t * pRollingB
     {
         pRollingBuffer->isInit = 0U;
 
-        while( resultRtpPacketQueue == RTP_PACKET_QUEUE_RESULT_OK )
+        /* Packets in the index live in the slabs, release them all at once. */
+        for( i = 0; i < pRollingBuffer->slabCount; i++ )
+        {
+            if( pRollingBuffer->pSlabs[ i ].pSlots != NULL )
+            {
+                ReleaseSlab( pRollingBuffer,
+                             i );
+            }
+        }
+
+        vPortFree( pRollingBuffer->pSlabs );
+        pRollingBuffer->pSlabs = NULL;
+
+        if( pRollingBuffer->ppIndex != NULL )
+        {
+            vPortFree( pRollingBuffer->ppIndex );
+            pRollingBuffer->ppIndex = NULL;
+        }
+    }
+}
+
+void PeerConnectionRollingBuffer_UpdateRetention( PeerConnectionRollingBuffer_t * pRollingBuffer,
+                                                  uint32_t packetRate,
+                                                  uint32_t roundTripTimeMs )
+{
+    size_t retainedCount;
+    size_t neededSlabCount;
+    size_t i;
+
+    if( pRollingBuffer == NULL )
+    {
+        LogError( ( "Invalid input, pRollingBuffer: %p", pRollingBuffer ) );
+    }
+    else if( pRollingBuffer->isInit == 0U )
+    {
+        LogWarn( ( "Rolling buffer is not initialized yet or it has been freed." ) );
+    }
+    else if( roundTripTimeMs == 0U )
+    {
+        /* No receiver report yet, keep the current retention. */
+    }
+    else
+    {
+        /* Keep the packets a NACK can still ask for: a few round trips at the current packet rate. */
+        retainedCount = ( size_t )( ( ( uint64_t ) packetRate * roundTripTimeMs * PEER_CONNECTION_ROLLING_BUFFER_RTT_FACTOR ) / 1000U );
+        if( retainedCount < PEER_CONNECTION_ROLLING_BUFFER_MIN_PACKETS )
+        {
+            retainedCount = PEER_CONNECTION_ROLLING_BUFFER_MIN_PACKETS;
+        }
+
+        if( retainedCount > pRollingBuffer->capacity )
         {
-            resultRtpPacketQueue = RtpPacketQueue_Dequeue( &pRollingBuffer->packetQueue,
-                                                           &rtpPacketInfo );
-            if( ( resultRtpPacketQueue == RTP_PACKET_QUEUE_RESULT_OK ) && ( rtpPacketInfo.pSerializedRtpPacket != NULL ) )
+            retainedCount = pRollingBuffer->capacity;
+        }
+
+        /* Grow in slab units, a short heap keeps the retention the allocated slabs hold. */
+        neededSlabCount = GetNeededSlabCount( retainedCount );
+        for( i = 0; ( i < pRollingBuffer->slabCount ) && ( pRollingBuffer->allocatedSlabCount < neededSlabCount ); i++ )
+        {
+            if( ( pRollingBuffer->pSlabs[ i ].pSlots == NULL ) &&
+                ( AllocateSlab( pRollingBuffer, i ) != PEER_CONNECTION_RESULT_OK ) )
             {
-                vPortFree( rtpPacketInfo.pSerializedRtpPacket );
+                if( pRollingBuffer->allocatedSlabCount * PEER_CONNECTION_ROLLING_BUFFER_SLAB_SLOT_COUNT > PEER_CONNECTION_ROLLING_BUFFER_EXTRA_SLOT_COUNT )
+                {
+                    retainedCount = pRollingBuffer->allocatedSlabCount * PEER_CONNECTION_ROLLING_BUFFER_SLAB_SLOT_COUNT - PEER_CONNECTION_ROLLING_BUFFER_EXTRA_SLOT_COUNT;
+                }
+                break;
             }
         }
 
-        if( pRollingBuffer->packetQueue.pRtpPacketInfoArray != NULL )
+        if( retainedCount != pRollingBuffer->retainedCount )
+        {
+            LogDebug( ( "Rolling buffer retention: %u packets, packet rate: %lu, RTT: %lu ms", retainedCount, packetRate, roundTripTimeMs ) );
+            pRollingBuffer->retainedCount = retainedCount;
+        }
+
+        if( pRollingBuffer->hasPackets != 0U )
         {
-            vPortFree( pRollingBuffer->packetQueue.pRtpPacketInfoArray );
-            pRollingBuffer->packetQueue.pRtpPacketInfoArray = NULL;
+            EvictOldPackets( pRollingBuffer );
+        }
+
+        /* Shrink in slab units, only a slab with all of its slots free can go. */
+        for( i = pRollingBuffer->slabCount; ( i > 0U ) && ( pRollingBuffer->allocatedSlabCount > neededSlabCount ); i-- )
+        {
+            if( ( pRollingBuffer->pSlabs[ i - 1U ].pSlots != NULL ) &&
+                ( pRollingBuffer->pSlabs[ i - 1U ].freeCount == PEER_CONNECTION_ROLLING_BUFFER_SLAB_SLOT_COUNT ) )
+            {
+                ReleaseSlab( pRollingBuffer,
+                             i - 1U );
+            }
         }
     }
 }
@@ -153,9 +455,23 @@ PeerConnectionResult_t PeerConnectionRollingBuffer_GetRtpSequenceBuffer( PeerCon
     }
     else
     {
-        *ppPacket = ( PeerConnectionRollingBufferPacket_t * )pvPortMalloc( sizeof( PeerConnectionRollingBufferPacket_t ) + pRollingBuffer->maxSizePerPacket );
-        ( *ppPacket )->pPacketBuffer = ( uint8_t * )( ( *ppPacket ) + 1 );
-        ( *ppPacket )->packetBufferLength = pRollingBuffer->maxSizePerPacket;
+        *ppPacket = PopFreeSlot( pRollingBuffer );
+        if( *ppPacket == NULL )
+        {
+            LogError( ( "No free slot in rolling buffer, allocated slabs: %u", pRollingBuffer->allocatedSlabCount ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_ROLLING_BUFFER_NO_FREE_SLOT;
+        }
+        else
+        {
+            ( *ppPacket )->pPacketBuffer = ( uint8_t * )( ( *ppPacket ) + 1 );
+            ( *ppPacket )->packetBufferLength = pRollingBuffer->maxSizePerPacket;
+            ( *ppPacket )->lastResendTimeUs = 0U;
+            ( *ppPacket )->pNextFree = NULL;
+
+            #if METRIC_PRINT_ENABLED
+            Metric_IncreaseCounter( METRIC_COUNTER_ROLLING_BUFFER_SLOT_ACQUIRE, 1U );
+            #endif
+        }
     }
 
     return ret;
@@ -174,9 +490,14 @@ void PeerConnectionRollingBuffer_DiscardRtpSequenceBuffer( PeerConnectionRolling
     {
         LogWarn( ( "Rolling buffer is not initialized yet or it has been freed." ) );
     }
+    else if( IsSlabSlot( pRollingBuffer, pPacket ) == 0U )
+    {
+        LogError( ( "Packet %p doesn't belong to rolling buffer %p", pPacket, pRollingBuffer ) );
+    }
     else
     {
-        vPortFree( pPacket );
+        PushFreeSlot( pRollingBuffer,
+                      pPacket );
     }
 }
 
@@ -185,8 +506,7 @@ PeerConnectionResult_t PeerConnectionRollingBuffer_SearchRtpSequenceBuffer( Peer
                                                                             PeerConnectionRollingBufferPacket_t ** ppPacket )
 {
     PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
-    RtpPacketQueueResult_t resultRtpPacketQueue = RTP_PACKET_QUEUE_RESULT_OK;
-    RtpPacketInfo_t rtpPacketInfo;
+    PeerConnectionRollingBufferPacket_t * pPacket = NULL;
 
     if( ( pRollingBuffer == NULL ) ||
         ( ppPacket == NULL ) )
@@ -212,22 +532,19 @@ PeerConnectionResult_t PeerConnectionRollingBuffer_SearchRtpSequenceBuffer( Peer
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        resultRtpPacketQueue = RtpPacketQueue_Retrieve( &pRollingBuffer->packetQueue,
-                                                        rtpSeq,
-                                                        &rtpPacketInfo );
-        if( resultRtpPacketQueue != RTP_PACKET_QUEUE_RESULT_OK )
+        /* The position may hold an evicted packet's successor or nothing. */
+        pPacket = pRollingBuffer->ppIndex[ rtpSeq & pRollingBuffer->indexMask ];
+        if( ( pPacket == NULL ) ||
+            ( pPacket->rtpPacket.header.sequenceNumber != rtpSeq ) )
         {
-            LogError( ( "Fail to retrieve RTP packet sequence number: %u with result: %d",
-                        rtpSeq,
-                        resultRtpPacketQueue ) );
+            LogDebug( ( "RTP packet sequence number: %u isn't in rolling buffer", rtpSeq ) );
             ret = PEER_CONNECTION_RESULT_FAIL_RTP_PACKET_QUEUE_RETRIEVE;
         }
     }
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        *ppPacket = ( PeerConnectionRollingBufferPacket_t * )rtpPacketInfo.pSerializedRtpPacket;
-        ( *ppPacket )->packetBufferLength = rtpPacketInfo.serializedPacketLength;
+        *ppPacket = pPacket;
     }
 
     return ret;
@@ -238,8 +555,8 @@ PeerConnectionResult_t PeerConnectionRollingBuffer_SetPacket( PeerConnectionRoll
                                                               PeerConnectionRollingBufferPacket_t * pPacket )
 {
     PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
-    RtpPacketQueueResult_t resultRtpPacketQueue = RTP_PACKET_QUEUE_RESULT_OK;
-    RtpPacketInfo_t rtpPacket, deletedRtpPacket;
+    PeerConnectionRollingBufferPacket_t * pEvictedPacket = NULL;
+    size_t index;
 
     if( ( pRollingBuffer == NULL ) || ( pPacket == NULL ) )
     {
@@ -264,29 +581,26 @@ PeerConnectionResult_t PeerConnectionRollingBuffer_SetPacket( PeerConnectionRoll
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        memset( &rtpPacket, 0, sizeof( RtpPacketInfo_t ) );
-        memset( &deletedRtpPacket, 0, sizeof( RtpPacketInfo_t ) );
-        rtpPacket.pSerializedRtpPacket = ( uint8_t * )pPacket;
-        rtpPacket.seqNum = rtpSeq;
-        rtpPacket.serializedPacketLength = pPacket->packetBufferLength;
-        resultRtpPacketQueue = RtpPacketQueue_ForceEnqueue( &pRollingBuffer->packetQueue,
-                                                            &rtpPacket,
-                                                            &deletedRtpPacket );
-        if( ( resultRtpPacketQueue != RTP_PACKET_QUEUE_RESULT_OK ) && ( resultRtpPacketQueue != RTP_PACKET_QUEUE_RESULT_PACKET_DELETED ) )
+        index = rtpSeq & pRollingBuffer->indexMask;
+        pEvictedPacket = pRollingBuffer->ppIndex[ index ];
+        pPacket->rtpPacket.header.sequenceNumber = rtpSeq;
+        pRollingBuffer->ppIndex[ index ] = pPacket;
+
+        if( ( pEvictedPacket != NULL ) && ( pEvictedPacket != pPacket ) )
         {
-            LogError( ( "Fail to enqueue RTP packet sequence number: %u with result: %d",
-                        rtpSeq,
-                        resultRtpPacketQueue ) );
-            ret = PEER_CONNECTION_RESULT_FAIL_RTP_PACKET_ENQUEUE;
+            /* Sequence numbers are consecutive and retention evicts older packets first,
+             * a packet is only left at this position when the sequence number jumped. */
+            PeerConnectionRollingBuffer_DiscardRtpSequenceBuffer( pRollingBuffer,
+                                                                  pEvictedPacket );
         }
-    }
 
-    if( ret == PEER_CONNECTION_RESULT_OK )
-    {
-        if( deletedRtpPacket.pSerializedRtpPacket )
+        if( pRollingBuffer->hasPackets == 0U )
         {
-            PeerConnectionRollingBuffer_DiscardRtpSequenceBuffer( pRollingBuffer, ( PeerConnectionRollingBufferPacket_t * ) deletedRtpPacket.pSerializedRtpPacket );
+            pRollingBuffer->oldestSeq = rtpSeq;
+            pRollingBuffer->hasPackets = 1U;
         }
+        pRollingBuffer->newestSeq = rtpSeq;
+        EvictOldPackets( pRollingBuffer );
     }
 
     return ret;
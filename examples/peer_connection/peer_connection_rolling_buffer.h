@@ -33,6 +33,24 @@ extern "C" {
 
 #define PEER_CONNECTION_ROLLING_BUFFER_DURATION_IN_SECONDS ( 3 )
 
+/* Slots allocated or released at once when the retention changes. */
+#ifndef PEER_CONNECTION_ROLLING_BUFFER_SLAB_SLOT_COUNT
+#define PEER_CONNECTION_ROLLING_BUFFER_SLAB_SLOT_COUNT ( 32U )
+#endif
+
+/* Packets are kept for this many round trips: the NACK, a repeated NACK and the receiver's wait before it asks. */
+#ifndef PEER_CONNECTION_ROLLING_BUFFER_RTT_FACTOR
+#define PEER_CONNECTION_ROLLING_BUFFER_RTT_FACTOR ( 4U )
+#endif
+
+/* Never keep fewer packets than a key frame takes, its burst is far above the average packet rate. */
+#ifndef PEER_CONNECTION_ROLLING_BUFFER_MIN_PACKETS
+#define PEER_CONNECTION_ROLLING_BUFFER_MIN_PACKETS ( 64U )
+#endif
+
+/* The packet rate is measured over this window, the retention is updated once per window. */
+#define PEER_CONNECTION_ROLLING_BUFFER_RATE_WINDOW_US ( 1000000ULL )
+
 PeerConnectionResult_t PeerConnectionRollingBuffer_Create( PeerConnectionRollingBuffer_t * pRollingBuffer,
                                                            uint32_t rollingbufferBitRate,  // bps
                                                            uint32_t rollingbufferDurationSec,  // duration in seconds
@@ -40,6 +58,12 @@ PeerConnectionResult_t PeerConnectionRollingBuffer_Create( PeerConnectionRolling
 
 void PeerConnectionRollingBuffer_Free( PeerConnectionRollingBuffer_t * pRollingBuffer );
 
+/* Size the retention from the packet rate in packets per second and the measured round trip time,
+ * within the capacity given at create time. Slabs no longer needed are released once all their slots are free. */
+void PeerConnectionRollingBuffer_UpdateRetention( PeerConnectionRollingBuffer_t * pRollingBuffer,
+                                                  uint32_t packetRate,
+                                                  uint32_t roundTripTimeMs );
+
 PeerConnectionResult_t PeerConnectionRollingBuffer_GetRtpSequenceBuffer( PeerConnectionRollingBuffer_t * pRollingBuffer,
                                                                          uint16_t rtpSeq,
                                                                          PeerConnectionRollingBufferPacket_t ** ppPacket );
@@ -47,6 +71,9 @@ PeerConnectionResult_t PeerConnectionRollingBuffer_GetRtpSequenceBuffer( PeerCon
 void PeerConnectionRollingBuffer_DiscardRtpSequenceBuffer( PeerConnectionRollingBuffer_t * pRollingBuffer,
                                                            PeerConnectionRollingBufferPacket_t * pPacket );
 
+/* Constant time lookup by sequence number. It only reads the index, it doesn't wait for the writer,
+ * but the packet can be recycled by the next PeerConnectionRollingBuffer_SetPacket(), so the caller
+ * holds the sender mutex while using it. */
 PeerConnectionResult_t PeerConnectionRollingBuffer_SearchRtpSequenceBuffer( PeerConnectionRollingBuffer_t * pRollingBuffer,
                                                                             uint16_t rtpSeq,
                                                                             PeerConnectionRollingBufferPacket_t ** ppPacket );
@@ -152,6 +152,12 @@
 #define PEER_CONNECTION_SDP_CODEC_RTX_VALUE_LENGTH ( 9 )
 #define PEER_CONNECTION_SDP_CODEC_APT_VALUE "apt="
 #define PEER_CONNECTION_SDP_CODEC_APT_VALUE_LENGTH ( 4 )
+#define PEER_CONNECTION_SDP_CODEC_FLEXFEC_VALUE "flexfec-03/90000"
+#define PEER_CONNECTION_SDP_CODEC_FLEXFEC_VALUE_LENGTH ( 16 )
+#define PEER_CONNECTION_SDP_CODEC_RED_OPUS_VALUE "red/48000/2"
+#define PEER_CONNECTION_SDP_CODEC_RED_OPUS_VALUE_LENGTH ( 11 )
+#define PEER_CONNECTION_SDP_CODEC_RED_PCM_VALUE "red/8000"
+#define PEER_CONNECTION_SDP_CODEC_RED_PCM_VALUE_LENGTH ( 8 )
 
 #define PEER_CONNECTION_SDP_CODEC_MULAW_DEFAULT_INDEX "0"
 #define PEER_CONNECTION_SDP_CODEC_MULAW_DEFAULT_INDEX_LENGTH ( 1 )
@@ -465,6 +471,108 @@ static uint32_t CollectAttributesCodec( SdpControllerAttributes_t * pAttributes,
     return codecBitMap;
 }
 
+static uint32_t GetFlexfecPayloadFromMedia( const SdpControllerMediaDescription_t * pMediaDescription )
+{
+    uint32_t fecPayload = 0;
+    StringUtilsResult_t stringResult;
+    int i;
+
+    for( i = 0; i < pMediaDescription->mediaAttributesCount; i++ )
+    {
+        if( ( pMediaDescription->attributes[i].attributeNameLength == PEER_CONNECTION_SDP_MEDIA_ATTRIBUTE_NAME_RTPMAP_LENGTH ) &&
+            ( strncmp( PEER_CONNECTION_SDP_MEDIA_ATTRIBUTE_NAME_RTPMAP, pMediaDescription->attributes[i].pAttributeName, PEER_CONNECTION_SDP_MEDIA_ATTRIBUTE_NAME_RTPMAP_LENGTH ) == 0 ) &&
+            ( pMediaDescription->attributes[i].attributeValueLength > PEER_CONNECTION_SDP_CODEC_FLEXFEC_VALUE_LENGTH ) &&
+            ( strncmp( PEER_CONNECTION_SDP_CODEC_FLEXFEC_VALUE,
+                       pMediaDescription->attributes[i].pAttributeValue + pMediaDescription->attributes[i].attributeValueLength - PEER_CONNECTION_SDP_CODEC_FLEXFEC_VALUE_LENGTH,
+                       PEER_CONNECTION_SDP_CODEC_FLEXFEC_VALUE_LENGTH ) == 0 ) )
+        {
+            /* The value is "<payload type> flexfec-03/90000". */
+            stringResult = StringUtils_ConvertStringToUl( pMediaDescription->attributes[i].pAttributeValue,
+                                                          pMediaDescription->attributes[i].attributeValueLength - PEER_CONNECTION_SDP_CODEC_FLEXFEC_VALUE_LENGTH - 1,
+                                                          &fecPayload );
+            if( stringResult != STRING_UTILS_RESULT_OK )
+            {
+                LogWarn( ( "StringUtils_ConvertStringToUl FlexFEC payload fail, result %d, converting %.*s",
+                           stringResult,
+                           ( int ) pMediaDescription->attributes[i].attributeValueLength, pMediaDescription->attributes[i].pAttributeValue ) );
+                fecPayload = 0;
+            }
+            break;
+        }
+    }
+
+    return fecPayload;
+}
+
+static uint32_t GetRedPayloadFromMedia( const SdpControllerMediaDescription_t * pMediaDescription,
+                                        const char * pRedValue,
+                                        size_t redValueLength,
+                                        uint32_t primaryPayload )
+{
+    uint32_t redPayload = 0;
+    uint32_t candidatePayload;
+    StringUtilsResult_t stringResult;
+    char fmtpPrefix[ 12 ];
+    char primaryPrefix[ 12 ];
+    int fmtpPrefixLength;
+    int primaryPrefixLength;
+    int i, j;
+    uint8_t isMatched;
+
+    for( i = 0; ( i < pMediaDescription->mediaAttributesCount ) && ( redPayload == 0 ); i++ )
+    {
+        if( ( pMediaDescription->attributes[i].attributeNameLength != PEER_CONNECTION_SDP_MEDIA_ATTRIBUTE_NAME_RTPMAP_LENGTH ) ||
+            ( strncmp( PEER_CONNECTION_SDP_MEDIA_ATTRIBUTE_NAME_RTPMAP, pMediaDescription->attributes[i].pAttributeName, PEER_CONNECTION_SDP_MEDIA_ATTRIBUTE_NAME_RTPMAP_LENGTH ) != 0 ) ||
+            ( pMediaDescription->attributes[i].attributeValueLength <= redValueLength ) ||
+            ( strncmp( pRedValue,
+                       pMediaDescription->attributes[i].pAttributeValue + pMediaDescription->attributes[i].attributeValueLength - redValueLength,
+                       redValueLength ) != 0 ) )
+        {
+            continue;
+        }
+
+        /* The value is "<payload type> red/<clock rate>". */
+        stringResult = StringUtils_ConvertStringToUl( pMediaDescription->attributes[i].pAttributeValue,
+                                                      pMediaDescription->attributes[i].attributeValueLength - redValueLength - 1,
+                                                      &candidatePayload );
+        if( stringResult != STRING_UTILS_RESULT_OK )
+        {
+            LogWarn( ( "StringUtils_ConvertStringToUl RED payload fail, result %d, converting %.*s",
+                       stringResult,
+                       ( int ) pMediaDescription->attributes[i].attributeValueLength, pMediaDescription->attributes[i].pAttributeValue ) );
+            continue;
+        }
+
+        /* The fmtp "<payload type> <primary>/<primary>" names the codec of the blocks, it must be the chosen codec.
+         * Without fmtp the blocks follow the negotiated codec. */
+        isMatched = 1U;
+        fmtpPrefixLength = snprintf( fmtpPrefix, sizeof( fmtpPrefix ), "%lu ", candidatePayload );
+        primaryPrefixLength = snprintf( primaryPrefix, sizeof( primaryPrefix ), "%lu/", primaryPayload );
+        for( j = 0; j < pMediaDescription->mediaAttributesCount; j++ )
+        {
+            if( ( pMediaDescription->attributes[j].attributeNameLength == PEER_CONNECTION_SDP_MEDIA_ATTRIBUTE_NAME_FMTP_LENGTH ) &&
+                ( strncmp( PEER_CONNECTION_SDP_MEDIA_ATTRIBUTE_NAME_FMTP, pMediaDescription->attributes[j].pAttributeName, PEER_CONNECTION_SDP_MEDIA_ATTRIBUTE_NAME_FMTP_LENGTH ) == 0 ) &&
+                ( pMediaDescription->attributes[j].attributeValueLength > ( size_t ) fmtpPrefixLength ) &&
+                ( strncmp( fmtpPrefix, pMediaDescription->attributes[j].pAttributeValue, fmtpPrefixLength ) == 0 ) )
+            {
+                if( ( pMediaDescription->attributes[j].attributeValueLength < ( size_t )( fmtpPrefixLength + primaryPrefixLength ) ) ||
+                    ( strncmp( primaryPrefix, pMediaDescription->attributes[j].pAttributeValue + fmtpPrefixLength, primaryPrefixLength ) != 0 ) )
+                {
+                    isMatched = 0U;
+                }
+                break;
+            }
+        }
+
+        if( isMatched != 0U )
+        {
+            redPayload = candidatePayload;
+        }
+    }
+
+    return redPayload;
+}
+
 static PeerConnectionResult_t GetPayloadTypesFromMedia( SdpControllerMediaDescription_t * pMediaDescription,
                                                         uint32_t * pCodecBitMap,
                                                         uint32_t codecPayloads[TRANSCEIVER_RTC_CODEC_NUM] )
@@ -553,6 +661,8 @@ static PeerConnectionResult_t SetPayloadType( PeerConnectionSession_t * pSession
     uint32_t * pTargetCodecPayload = NULL;
     uint32_t * pTargetCodecRtxPayload = NULL;
     uint8_t * pIsTargetCodecPayloadSet = NULL;
+    const char * pRedValue = NULL;
+    size_t redValueLength = 0;
 
     if( ( pSession == NULL ) ||
         ( pMediaDescription == NULL ) ||
@@ -680,6 +790,8 @@ static PeerConnectionResult_t SetPayloadType( PeerConnectionSession_t * pSession
                 *pIsTargetCodecPayloadSet = 1;
                 *pTargetCodecPayload = PEER_CONNECTION_SDP_GET_APT_CODEC_FROM_PAYLOAD( codecPayloads[ TRANSCEIVER_RTC_CODEC_OPUS_BIT ] );
                 *pTargetCodecRtxPayload = PEER_CONNECTION_SDP_GET_RTX_CODEC_FROM_PAYLOAD( codecPayloads[ TRANSCEIVER_RTC_CODEC_OPUS_BIT ] );
+                pRedValue = PEER_CONNECTION_SDP_CODEC_RED_OPUS_VALUE;
+                redValueLength = PEER_CONNECTION_SDP_CODEC_RED_OPUS_VALUE_LENGTH;
                 if( pSession->mLinesTransceiverCount < PEER_CONNECTION_TRANSCEIVER_MAX_COUNT )
                 {
                     pSession->pMLinesTransceivers[ pSession->mLinesTransceiverCount++ ] = pSession->pTransceivers[ currentTransceiverIdx ];
@@ -696,6 +808,8 @@ static PeerConnectionResult_t SetPayloadType( PeerConnectionSession_t * pSession
                 *pIsTargetCodecPayloadSet = 1;
                 *pTargetCodecPayload = PEER_CONNECTION_SDP_GET_APT_CODEC_FROM_PAYLOAD( codecPayloads[ TRANSCEIVER_RTC_CODEC_MULAW_BIT ] );
                 *pTargetCodecRtxPayload = PEER_CONNECTION_SDP_GET_RTX_CODEC_FROM_PAYLOAD( codecPayloads[ TRANSCEIVER_RTC_CODEC_MULAW_BIT ] );
+                pRedValue = PEER_CONNECTION_SDP_CODEC_RED_PCM_VALUE;
+                redValueLength = PEER_CONNECTION_SDP_CODEC_RED_PCM_VALUE_LENGTH;
                 if( pSession->mLinesTransceiverCount < PEER_CONNECTION_TRANSCEIVER_MAX_COUNT )
                 {
                     pSession->pMLinesTransceivers[ pSession->mLinesTransceiverCount++ ] = pSession->pTransceivers[ currentTransceiverIdx ];
@@ -712,6 +826,8 @@ static PeerConnectionResult_t SetPayloadType( PeerConnectionSession_t * pSession
                 *pIsTargetCodecPayloadSet = 1;
                 *pTargetCodecPayload = PEER_CONNECTION_SDP_GET_APT_CODEC_FROM_PAYLOAD( codecPayloads[ TRANSCEIVER_RTC_CODEC_ALAW_BIT ] );
                 *pTargetCodecRtxPayload = PEER_CONNECTION_SDP_GET_RTX_CODEC_FROM_PAYLOAD( codecPayloads[ TRANSCEIVER_RTC_CODEC_ALAW_BIT ] );
+                pRedValue = PEER_CONNECTION_SDP_CODEC_RED_PCM_VALUE;
+                redValueLength = PEER_CONNECTION_SDP_CODEC_RED_PCM_VALUE_LENGTH;
                 if( pSession->mLinesTransceiverCount < PEER_CONNECTION_TRANSCEIVER_MAX_COUNT )
                 {
                     pSession->pMLinesTransceivers[ pSession->mLinesTransceiverCount++ ] = pSession->pTransceivers[ currentTransceiverIdx ];
@@ -731,6 +847,26 @@ static PeerConnectionResult_t SetPayloadType( PeerConnectionSession_t * pSession
         if( *pIsTargetCodecPayloadSet == 1 )
         {
             LogDebug( ( "Set payload type successfully, idx: %d, payload: 0x%lx, RTX payload: 0x%lx", currentTransceiverIdx, *pTargetCodecPayload, *pTargetCodecRtxPayload ) );
+
+            if( trackKind == TRANSCEIVER_TRACK_KIND_VIDEO )
+            {
+                /* FEC is only sent when the remote is able to recover from it. */
+                pSession->rtpConfig.videoCodecFecPayload = GetFlexfecPayloadFromMedia( pMediaDescription );
+                LogDebug( ( "FlexFEC payload: %lu", pSession->rtpConfig.videoCodecFecPayload ) );
+            }
+            else if( ( trackKind == TRANSCEIVER_TRACK_KIND_AUDIO ) && ( pRedValue != NULL ) )
+            {
+                /* Redundant audio is only sent when the remote is able to unwrap it. */
+                pSession->rtpConfig.audioCodecRedPayload = GetRedPayloadFromMedia( pMediaDescription,
+                                                                                   pRedValue,
+                                                                                   redValueLength,
+                                                                                   *pTargetCodecPayload );
+                LogDebug( ( "RED payload: %lu", pSession->rtpConfig.audioCodecRedPayload ) );
+            }
+            else
+            {
+                /* Empty else marker. */
+            }
         }
         else
         {
@@ -778,11 +914,15 @@ static PeerConnectionResult_t PopulateMediaDescriptions( PeerConnectionSession_t
             {
                 populateConfiguration.payloadType = pSession->rtpConfig.videoCodecPayload;
                 populateConfiguration.rtxPayloadType = pSession->rtpConfig.videoCodecRtxPayload;
+                populateConfiguration.fecPayloadType = pSession->rtpConfig.videoCodecFecPayload;
+                populateConfiguration.redPayloadType = 0;
             }
             else
             {
                 populateConfiguration.payloadType = pSession->rtpConfig.audioCodecPayload;
                 populateConfiguration.rtxPayloadType = pSession->rtpConfig.audioCodecRtxPayload;
+                populateConfiguration.fecPayloadType = 0;
+                populateConfiguration.redPayloadType = pSession->rtpConfig.audioCodecRedPayload;
             }
 
             retSdpController = SdpController_PopulateSingleMedia( NULL,
@@ -848,11 +988,15 @@ static PeerConnectionResult_t PopulateMediaDescriptions( PeerConnectionSession_t
             {
                 populateConfiguration.payloadType = pSession->rtpConfig.videoCodecPayload;
                 populateConfiguration.rtxPayloadType = pSession->rtpConfig.videoCodecRtxPayload;
+                populateConfiguration.fecPayloadType = pSession->rtpConfig.videoCodecFecPayload;
+                populateConfiguration.redPayloadType = 0;
             }
             else
             {
                 populateConfiguration.payloadType = pSession->rtpConfig.audioCodecPayload;
                 populateConfiguration.rtxPayloadType = pSession->rtpConfig.audioCodecRtxPayload;
+                populateConfiguration.fecPayloadType = 0;
+                populateConfiguration.redPayloadType = pSession->rtpConfig.audioCodecRedPayload;
             }
 
             retSdpController = SdpController_PopulateSingleMedia( &pRemoteBufferSessionDescription->sdpDescription.mediaDescriptions[ i ],
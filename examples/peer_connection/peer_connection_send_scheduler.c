@@ -0,0 +1,354 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <string.h>
+#include "logging.h"
+#include "peer_connection_send_scheduler.h"
+#include "ice_controller.h"
+#include "atomic.h"
+
+/* Send the queued urgent packets, the caller holds the lane. */
+static void SendUrgentPackets( PeerConnectionSendScheduler_t * pScheduler,
+                               IceControllerContext_t * pIceControllerContext )
+{
+    PeerConnectionSendSchedulerPacket_t * pPacket;
+    IceControllerResult_t resultIceController;
+
+    while( pScheduler->urgentCount != 0U )
+    {
+        /* Only the lane holder releases slots, so the head slot is stable without the queue lock. */
+        pPacket = &pScheduler->urgentPackets[ pScheduler->urgentHead ];
+        resultIceController = IceController_SendToRemotePeer( pIceControllerContext,
+                                                              pPacket->buffer,
+                                                              pPacket->bufferLength );
+        if( resultIceController != ICE_CONTROLLER_RESULT_OK )
+        {
+            LogWarn( ( "Fail to send queued urgent packet, ret: %d", resultIceController ) );
+        }
+
+        if( xSemaphoreTake( pScheduler->queueMutex,
+                            portMAX_DELAY ) == pdTRUE )
+        {
+            pScheduler->urgentHead = ( pScheduler->urgentHead + 1U ) % PEER_CONNECTION_SEND_SCHEDULER_URGENT_QUEUE_LENGTH;
+            pScheduler->urgentCount--;
+            xSemaphoreGive( pScheduler->queueMutex );
+        }
+        else
+        {
+            LogError( ( "Fail to take send scheduler queue mutex" ) );
+            break;
+        }
+    }
+}
+
+/* Copy the packets into the urgent queue, all or none of them. Returns 1 if they're queued. */
+static uint8_t QueueUrgentPackets( PeerConnectionSendScheduler_t * pScheduler,
+                                   const IceControllerSendBuffer_t * pSendBuffers,
+                                   size_t sendBufferCount )
+{
+    uint8_t isQueued = 0U;
+    PeerConnectionSendSchedulerPacket_t * pPacket;
+    size_t i;
+
+    for( i = 0; i < sendBufferCount; i++ )
+    {
+        if( pSendBuffers[ i ].bufferLength > PEER_CONNECTION_SEND_SCHEDULER_URGENT_PACKET_MAX_LENGTH )
+        {
+            break;
+        }
+    }
+
+    if( ( i == sendBufferCount ) &&
+        ( xSemaphoreTake( pScheduler->queueMutex,
+                          portMAX_DELAY ) == pdTRUE ) )
+    {
+        if( pScheduler->urgentCount + sendBufferCount <= PEER_CONNECTION_SEND_SCHEDULER_URGENT_QUEUE_LENGTH )
+        {
+            for( i = 0; i < sendBufferCount; i++ )
+            {
+                pPacket = &pScheduler->urgentPackets[ ( pScheduler->urgentHead + pScheduler->urgentCount ) % PEER_CONNECTION_SEND_SCHEDULER_URGENT_QUEUE_LENGTH ];
+                memcpy( pPacket->buffer,
+                        pSendBuffers[ i ].pBuffer,
+                        pSendBuffers[ i ].bufferLength );
+                pPacket->bufferLength = pSendBuffers[ i ].bufferLength;
+                pScheduler->urgentCount++;
+            }
+            isQueued = 1U;
+        }
+
+        xSemaphoreGive( pScheduler->queueMutex );
+    }
+
+    return isQueued;
+}
+
+static void ReleaseLane( PeerConnectionSendScheduler_t * pScheduler,
+                         IceControllerContext_t * pIceControllerContext )
+{
+    xSemaphoreGive( pScheduler->laneMutex );
+
+    /* A packet queued after the holder's last check would wait for the next sender, send it now if the lane is free. */
+    while( ( pScheduler->urgentCount != 0U ) &&
+           ( xSemaphoreTake( pScheduler->laneMutex,
+                             0 ) == pdTRUE ) )
+    {
+        SendUrgentPackets( pScheduler,
+                           pIceControllerContext );
+        xSemaphoreGive( pScheduler->laneMutex );
+    }
+}
+
+PeerConnectionResult_t PeerConnectionSendScheduler_Init( PeerConnectionSendScheduler_t * pScheduler )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+
+    if( pScheduler == NULL )
+    {
+        LogError( ( "Invalid input, pScheduler: %p", pScheduler ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        memset( pScheduler,
+                0,
+                sizeof( PeerConnectionSendScheduler_t ) );
+
+        pScheduler->laneMutex = xSemaphoreCreateMutex();
+        pScheduler->queueMutex = xSemaphoreCreateMutex();
+        if( ( pScheduler->laneMutex == NULL ) ||
+            ( pScheduler->queueMutex == NULL ) )
+        {
+            LogError( ( "Fail to create send scheduler mutex." ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_CREATE_SEND_SCHEDULER_MUTEX;
+
+            if( pScheduler->laneMutex != NULL )
+            {
+                vSemaphoreDelete( pScheduler->laneMutex );
+                pScheduler->laneMutex = NULL;
+            }
+
+            if( pScheduler->queueMutex != NULL )
+            {
+                vSemaphoreDelete( pScheduler->queueMutex );
+                pScheduler->queueMutex = NULL;
+            }
+        }
+        else
+        {
+            pScheduler->isInit = 1U;
+        }
+    }
+
+    return ret;
+}
+
+void PeerConnectionSendScheduler_Deinit( PeerConnectionSendScheduler_t * pScheduler )
+{
+    if( pScheduler == NULL )
+    {
+        LogError( ( "Invalid input, pScheduler: %p", pScheduler ) );
+    }
+    else if( pScheduler->isInit != 0U )
+    {
+        /* Wait for the packet being sent, later senders see the scheduler gone and send directly. */
+        if( xSemaphoreTake( pScheduler->laneMutex,
+                            portMAX_DELAY ) == pdTRUE )
+        {
+            pScheduler->isInit = 0U;
+            xSemaphoreGive( pScheduler->laneMutex );
+        }
+        else
+        {
+            LogError( ( "Fail to take send scheduler lane mutex" ) );
+            pScheduler->isInit = 0U;
+        }
+
+        vSemaphoreDelete( pScheduler->laneMutex );
+        pScheduler->laneMutex = NULL;
+        vSemaphoreDelete( pScheduler->queueMutex );
+        pScheduler->queueMutex = NULL;
+        pScheduler->urgentHead = 0U;
+        pScheduler->urgentCount = 0U;
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+}
+
+IceControllerResult_t PeerConnectionSendScheduler_Send( PeerConnectionSendScheduler_t * pScheduler,
+                                                        IceControllerContext_t * pIceControllerContext,
+                                                        PeerConnectionSendClass_t sendClass,
+                                                        const IceControllerSendBuffer_t * pSendBuffers,
+                                                        size_t sendBufferCount )
+{
+    IceControllerResult_t ret = ICE_CONTROLLER_RESULT_OK;
+    size_t i;
+    size_t j;
+    size_t batchCount = 0;
+
+    if( ( pScheduler == NULL ) ||
+        ( pIceControllerContext == NULL ) ||
+        ( pSendBuffers == NULL ) )
+    {
+        LogError( ( "Invalid input, pScheduler: %p, pIceControllerContext: %p, pSendBuffers: %p", pScheduler, pIceControllerContext, pSendBuffers ) );
+        ret = ICE_CONTROLLER_RESULT_BAD_PARAMETER;
+    }
+    else if( pScheduler->isInit == 0U )
+    {
+        ret = IceController_SendBatchToRemotePeer( pIceControllerContext,
+                                                   pSendBuffers,
+                                                   sendBufferCount );
+    }
+    else if( sendClass == PEER_CONNECTION_SEND_CLASS_URGENT )
+    {
+        if( xSemaphoreTake( pScheduler->laneMutex,
+                            0 ) == pdTRUE )
+        {
+            SendUrgentPackets( pScheduler,
+                               pIceControllerContext );
+            ret = IceController_SendBatchToRemotePeer( pIceControllerContext,
+                                                       pSendBuffers,
+                                                       sendBufferCount );
+            ReleaseLane( pScheduler,
+                         pIceControllerContext );
+        }
+        else if( QueueUrgentPackets( pScheduler,
+                                     pSendBuffers,
+                                     sendBufferCount ) != 0U )
+        {
+            /* The holder sends them before its next packet, unless it gave the lane back meanwhile. */
+            if( xSemaphoreTake( pScheduler->laneMutex,
+                                0 ) == pdTRUE )
+            {
+                SendUrgentPackets( pScheduler,
+                                   pIceControllerContext );
+                ReleaseLane( pScheduler,
+                             pIceControllerContext );
+            }
+        }
+        else if( xSemaphoreTake( pScheduler->laneMutex,
+                                 portMAX_DELAY ) == pdTRUE )
+        {
+            /* Too large to queue or the queue is full, wait for the packet being sent. */
+            SendUrgentPackets( pScheduler,
+                               pIceControllerContext );
+            ret = IceController_SendBatchToRemotePeer( pIceControllerContext,
+                                                       pSendBuffers,
+                                                       sendBufferCount );
+            ReleaseLane( pScheduler,
+                         pIceControllerContext );
+        }
+        else
+        {
+            ret = ICE_CONTROLLER_RESULT_FAIL_MUTEX_TAKE;
+        }
+    }
+    else if( sendClass == PEER_CONNECTION_SEND_CLASS_RTX )
+    {
+        if( xSemaphoreTake( pScheduler->laneMutex,
+                            portMAX_DELAY ) == pdTRUE )
+        {
+            SendUrgentPackets( pScheduler,
+                               pIceControllerContext );
+            ret = IceController_SendBatchToRemotePeer( pIceControllerContext,
+                                                       pSendBuffers,
+                                                       sendBufferCount );
+            ReleaseLane( pScheduler,
+                         pIceControllerContext );
+        }
+        else
+        {
+            ret = ICE_CONTROLLER_RESULT_FAIL_MUTEX_TAKE;
+        }
+    }
+    else
+    {
+        for( i = 0; ( ret == ICE_CONTROLLER_RESULT_OK ) && ( i < sendBufferCount ); i += batchCount )
+        {
+            batchCount = sendBufferCount - i;
+            if( batchCount > PEER_CONNECTION_SEND_SCHEDULER_VIDEO_BATCH_COUNT )
+            {
+                batchCount = PEER_CONNECTION_SEND_SCHEDULER_VIDEO_BATCH_COUNT;
+            }
+
+            if( xSemaphoreTake( pScheduler->laneMutex,
+                                portMAX_DELAY ) != pdTRUE )
+            {
+                ret = ICE_CONTROLLER_RESULT_FAIL_MUTEX_TAKE;
+                break;
+            }
+
+            /* Urgent packets queued meanwhile wait behind one video packet at most. */
+            for( j = i; ( ret == ICE_CONTROLLER_RESULT_OK ) && ( j < i + batchCount ); j++ )
+            {
+                SendUrgentPackets( pScheduler,
+                                   pIceControllerContext );
+                ret = IceController_SendBatchToRemotePeer( pIceControllerContext,
+                                                           &pSendBuffers[ j ],
+                                                           1U );
+            }
+            ReleaseLane( pScheduler,
+                         pIceControllerContext );
+
+            /* A re-transmission of the same task priority doesn't preempt us, let it take the lane. */
+            if( pScheduler->rtxWaitingCount != 0U )
+            {
+                taskYIELD();
+            }
+        }
+    }
+
+    return ret;
+}
+
+void PeerConnectionSendScheduler_BeginRtx( PeerConnectionSendScheduler_t * pScheduler )
+{
+    if( pScheduler == NULL )
+    {
+        LogError( ( "Invalid input, pScheduler: %p", pScheduler ) );
+    }
+    else
+    {
+        ( void ) Atomic_Increment_u32( &pScheduler->rtxWaitingCount );
+    }
+}
+
+void PeerConnectionSendScheduler_EndRtx( PeerConnectionSendScheduler_t * pScheduler )
+{
+    if( pScheduler == NULL )
+    {
+        LogError( ( "Invalid input, pScheduler: %p", pScheduler ) );
+    }
+    else
+    {
+        ( void ) Atomic_Decrement_u32( &pScheduler->rtxWaitingCount );
+    }
+}
+
+uint8_t PeerConnectionSendScheduler_IsRtxWaiting( const PeerConnectionSendScheduler_t * pScheduler )
+{
+    uint8_t isWaiting = 0U;
+
+    if( ( pScheduler != NULL ) && ( pScheduler->rtxWaitingCount != 0U ) )
+    {
+        isWaiting = 1U;
+    }
+
+    return isWaiting;
+}
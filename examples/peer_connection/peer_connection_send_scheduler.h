@@ -0,0 +1,63 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef PEER_CONNECTION_SEND_SCHEDULER_H
+#define PEER_CONNECTION_SEND_SCHEDULER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Standard includes. */
+#include <stdint.h>
+
+#include "peer_connection_data_types.h"
+
+/* Video packets sent per take of the send lane, queued urgent packets go out before each of them. */
+#ifndef PEER_CONNECTION_SEND_SCHEDULER_VIDEO_BATCH_COUNT
+#define PEER_CONNECTION_SEND_SCHEDULER_VIDEO_BATCH_COUNT ( 4 )
+#endif
+
+PeerConnectionResult_t PeerConnectionSendScheduler_Init( PeerConnectionSendScheduler_t * pScheduler );
+
+/* Delete the mutexes once the session's senders are stopped, queued urgent packets are dropped. */
+void PeerConnectionSendScheduler_Deinit( PeerConnectionSendScheduler_t * pScheduler );
+
+/* Send the packets of one class to the remote peer.
+ * - Urgent packets go out at once, or right after the video packet or RTX packets being sent.
+ *   They may be queued, the result is then the result of queuing.
+ * - RTX packets go out before the next video batch.
+ * - Video packets are sent one by one and give the lane back after every PEER_CONNECTION_SEND_SCHEDULER_VIDEO_BATCH_COUNT packets. */
+IceControllerResult_t PeerConnectionSendScheduler_Send( PeerConnectionSendScheduler_t * pScheduler,
+                                                        IceControllerContext_t * pIceControllerContext,
+                                                        PeerConnectionSendClass_t sendClass,
+                                                        const IceControllerSendBuffer_t * pSendBuffers,
+                                                        size_t sendBufferCount );
+
+/* Mark a re-transmission in progress, from before it takes the sender mutex until it's sent,
+ * so the video sender gives way to it. */
+void PeerConnectionSendScheduler_BeginRtx( PeerConnectionSendScheduler_t * pScheduler );
+void PeerConnectionSendScheduler_EndRtx( PeerConnectionSendScheduler_t * pScheduler );
+
+/* Returns 1 if a re-transmission is waiting for the sender mutex or the lane. */
+uint8_t PeerConnectionSendScheduler_IsRtxWaiting( const PeerConnectionSendScheduler_t * pScheduler );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PEER_CONNECTION_SEND_SCHEDULER_H */
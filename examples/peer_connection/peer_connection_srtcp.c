@@ -20,6 +20,10 @@
 #include "peer_connection_srtcp.h"
 #include "peer_connection_srtp.h"
 #include "peer_connection_rolling_buffer.h"
+#include "peer_connection_twcc.h"
+#include "peer_connection_bwe.h"
+#include "peer_connection_fec.h"
+#include "peer_connection_send_scheduler.h"
 
 /* API includes. */
 #include "rtp_api.h"
@@ -35,6 +39,9 @@
 #define PEER_CONNECTION_SRTCP_NACK_MAX_SEQ_NUM                       ( 128 )
 #define PEER_CONNECTION_SRTCP_REMB_MAX_SSRC_NUM                      ( 255 )
 
+/* Suppression window of repeated NACKs until a receiver report gives the round trip time. */
+#define PEER_CONNECTION_SRTCP_NACK_DEFAULT_RTT_MS                    ( 100 )
+
 /* https://datatracker.ietf.org/doc/html/rfc3550#section-6.4.1 */
 #define PEER_CONNECTION_SRTCP_DLSR_TIMESCALE                         65536
 
@@ -69,45 +76,88 @@ static PeerConnectionResult_t PeerConnectionSrtcp_MatchRemoteBySsrc( PeerConnect
     return ret;
 }
 
-static PeerConnectionResult_t ResendSrtpPacket( PeerConnectionSession_t * pSession,
-                                                const Transceiver_t * pTransceiver,
-                                                uint16_t rtpSeq,
-                                                uint32_t ssrc )
+static PeerConnectionResult_t SendResendBatch( PeerConnectionSession_t * pSession,
+                                               uint8_t * pIsSrtpBatchLocked,
+                                               const IceControllerSendBuffer_t * pSendBuffers,
+                                               size_t sendBufferCount )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    IceControllerResult_t resultIceController;
+
+    /* Don't hold the Tx SRTP session while sending. */
+    if( *pIsSrtpBatchLocked != 0U )
+    {
+        PeerConnectionSrtp_EndEncryptBatch( pSession );
+        *pIsSrtpBatchLocked = 0U;
+    }
+
+    if( sendBufferCount != 0U )
+    {
+        resultIceController = PeerConnectionSendScheduler_Send( &pSession->sendScheduler,
+                                                                &pSession->iceControllerContext,
+                                                                PEER_CONNECTION_SEND_CLASS_RTX,
+                                                                pSendBuffers,
+                                                                sendBufferCount );
+
+        if( resultIceController != ICE_CONTROLLER_RESULT_OK )
+        {
+            LogWarn( ( "Fail to re-send RTP packets, ret: %d, count: %u", resultIceController, sendBufferCount ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_ICE_CONTROLLER_RESEND_RTP_PACKET;
+        }
+    }
+
+    return ret;
+}
+
+/* Re-send the packets of one NACK in a single pass over the rolling buffer. A packet re-sent within the
+ * last round trip is skipped, its re-transmission can't have arrived yet when the NACK was sent. */
+static PeerConnectionResult_t ResendSrtpPackets( PeerConnectionSession_t * pSession,
+                                                 const Transceiver_t * pTransceiver,
+                                                 const uint16_t * pSeqNumList,
+                                                 size_t seqNumCount,
+                                                 uint32_t ssrc )
 {
     PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
     PeerConnectionSrtpSender_t * pSrtpSender = NULL;
     uint8_t isSenderLocked = 0;
+    uint8_t isSrtpBatchLocked = 0U;
+    uint8_t isRtxInProgress = 0U;
     PeerConnectionRollingBufferPacket_t * pRollingBufferPacket = NULL;
-    IceControllerResult_t resultIceController;
+    IceControllerSendBuffer_t sendBuffers[ PEER_CONNECTION_SRTP_SEND_BATCH_MAX_COUNT ];
+    size_t sendBufferCount = 0;
+    size_t maxSendBufferCount = PEER_CONNECTION_SRTP_SEND_BATCH_MAX_COUNT;
     uint8_t bufferAfterEncrypt = 1;
-    uint8_t srtpBuffer[ PEER_CONNECTION_SRTP_RTP_PACKET_MAX_LENGTH ];
     uint8_t * pSrtpPacket = NULL;
     size_t srtpPacketLength = 0;
-    uint32_t payloadType;
+    uint8_t * pRtpPacket = NULL;
+    size_t rtpPacketLength = 0;
     uint16_t * pRtpSeq = NULL;
     uint16_t * pOsn = NULL;
-
-    if( ( pSession == NULL ) || ( pTransceiver == NULL ) )
+    uint16_t rtpSeq;
+    uint64_t currentTimeUs = 0;
+    uint64_t suppressWindowUs = 0;
+    uint32_t resentCount = 0;
+    uint32_t suppressedCount = 0;
+    uint32_t missingCount = 0;
+    size_t i;
+
+    if( ( pSession == NULL ) || ( pTransceiver == NULL ) || ( pSeqNumList == NULL ) )
     {
-        LogError( ( "Invalid input, pSession: %p, pTransceiver: %p", pSession, pTransceiver ) );
+        LogError( ( "Invalid input, pSession: %p, pTransceiver: %p, pSeqNumList: %p", pSession, pTransceiver, pSeqNumList ) );
         ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
     }
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        pRtpSeq = &rtpSeq;
-
         if( pTransceiver->trackKind == TRANSCEIVER_TRACK_KIND_VIDEO )
         {
             pSrtpSender = &pSession->videoSrtpSender;
-            payloadType = pSession->rtpConfig.videoCodecPayload;
 
             if( ( pSession->rtpConfig.videoCodecRtxPayload != 0 ) &&
                 ( pSession->rtpConfig.videoCodecRtxPayload != pSession->rtpConfig.videoCodecPayload ) )
             {
-                /* Use RTX payload type, sequence number and ssrc for re-transmission. */
+                /* Use RTX header template, sequence number and ssrc for re-transmission. */
                 bufferAfterEncrypt = 0;
-                payloadType = pSession->rtpConfig.videoCodecRtxPayload;
                 pRtpSeq = &pSession->rtpConfig.videoRtxSequenceNumber;
                 ssrc = pTransceiver->rtxSsrc;
             }
@@ -115,19 +165,21 @@ static PeerConnectionResult_t ResendSrtpPacket( PeerConnectionSession_t * pSessi
         else
         {
             pSrtpSender = &pSession->audioSrtpSender;
-            payloadType = pSession->rtpConfig.audioCodecPayload;
 
             if( ( pSession->rtpConfig.audioCodecRtxPayload != 0 ) &&
                 ( pSession->rtpConfig.audioCodecRtxPayload != pSession->rtpConfig.audioCodecPayload ) )
             {
-                /* Use RTX payload type, sequence number and ssrc for re-transmission. */
+                /* Use RTX header template, sequence number and ssrc for re-transmission. */
                 bufferAfterEncrypt = 0;
-                payloadType = pSession->rtpConfig.audioCodecRtxPayload;
                 pRtpSeq = &pSession->rtpConfig.audioRtxSequenceNumber;
                 ssrc = pTransceiver->rtxSsrc;
             }
         }
 
+        /* Let the video sender know before blocking on the sender mutex, it gives way between batches. */
+        PeerConnectionSendScheduler_BeginRtx( &pSession->sendScheduler );
+        isRtxInProgress = 1U;
+
         /* Lock sender. */
         if( xSemaphoreTake( pSrtpSender->senderMutex, portMAX_DELAY ) == pdTRUE )
         {
@@ -140,75 +192,128 @@ static PeerConnectionResult_t ResendSrtpPacket( PeerConnectionSession_t * pSessi
         }
     }
 
+    if( ( ret == PEER_CONNECTION_RESULT_OK ) && ( bufferAfterEncrypt == 0 ) )
+    {
+        /* RTX packets are encrypted into the batch buffer, the rolling buffer keeps the RTP payloads. */
+        if( ( pSrtpSender->pSendBatchBuffer == NULL ) || ( pSrtpSender->sendBatchBufferCount == 0U ) )
+        {
+            LogError( ( "No send batch buffer for the sender." ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_SEND_BATCH_BUFFER_ALLOCATE;
+        }
+        else if( pSrtpSender->sendBatchBufferCount < maxSendBufferCount )
+        {
+            maxSendBufferCount = pSrtpSender->sendBatchBufferCount;
+        }
+        else
+        {
+            /* Empty else marker. */
+        }
+    }
+
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
+        currentTimeUs = NetworkingUtils_GetCurrentTimeUs( NULL );
+        suppressWindowUs = ( ( pSrtpSender->roundTripTimeMs != 0U ) ? pSrtpSender->roundTripTimeMs : PEER_CONNECTION_SRTCP_NACK_DEFAULT_RTT_MS ) * 1000ULL;
+    }
+
+    for( i = 0; ( ret == PEER_CONNECTION_RESULT_OK ) && ( i < seqNumCount ); i++ )
+    {
+        rtpSeq = pSeqNumList[ i ];
         ret = PeerConnectionRollingBuffer_SearchRtpSequenceBuffer( &pSrtpSender->txRollingBuffer,
                                                                    rtpSeq,
                                                                    &pRollingBufferPacket );
 
         if( ( ret != PEER_CONNECTION_RESULT_OK ) || ( pRollingBufferPacket == NULL ) )
         {
-            LogWarn( ( "Fail to find target buffer, seq: %u", rtpSeq ) );
-            ret = PEER_CONNECTION_RESULT_FAIL_RTP_PACKET_NOT_FOUND;
+            /* Too old for the rolling buffer, the rest of the list may still be there. */
+            LogDebug( ( "Fail to find target buffer, seq: %u", rtpSeq ) );
+            missingCount++;
+            ret = PEER_CONNECTION_RESULT_OK;
+            continue;
         }
-        else
+
+        if( ( pRollingBufferPacket->lastResendTimeUs != 0U ) &&
+            ( currentTimeUs - pRollingBufferPacket->lastResendTimeUs < suppressWindowUs ) )
         {
-            LogDebug( ( "Found target buffer, pRollingBufferPacket: %p, packetBufferLength: %u, pPacketBuffer: %p",
-                        pRollingBufferPacket,
-                        pRollingBufferPacket->packetBufferLength,
-                        pRollingBufferPacket->pPacketBuffer ) );
-            LogDebug( ( "Found target buffer, sequence in buffer: %u, target sequence: %u",
-                        pRollingBufferPacket->rtpPacket.header.sequenceNumber, rtpSeq ) );
+            suppressedCount++;
+            continue;
         }
-    }
 
-    if( ret == PEER_CONNECTION_RESULT_OK )
-    {
-        if( bufferAfterEncrypt == 0 )
+        if( pRollingBufferPacket->packetBufferLength > pSrtpSender->rtxBudgetBytes )
         {
-            /* Don't reset the header as re-using the setting from write frame.
-             * Update sequence, SSRC, payload type and OSN for RTX packet. */
-            pRollingBufferPacket->rtpPacket.header.sequenceNumber = ( *pRtpSeq )++;
-            pRollingBufferPacket->rtpPacket.header.ssrc = ssrc;
-            pRollingBufferPacket->rtpPacket.header.payloadType = payloadType;
+            LogWarn( ( "Re-transmission budget used up, %u NACKed packets not re-sent, SSRC: 0x%lx", seqNumCount - i, ssrc ) );
+            break;
+        }
 
-            /* Follow RTX format to add OSN(original RTP sequence number) at the very beginning of payload.
-             * Note that we reserve PEER_CONNECTION_SRTP_RTX_WRITE_RESERVED_BYTES at the beginning of buffer at write frame. */
-            pOsn = ( uint16_t * ) pRollingBufferPacket->pPacketBuffer;
+        if( bufferAfterEncrypt == 0 )
+        {
+            /* Follow RTX format to add OSN(original RTP sequence number) at the very beginning of payload,
+             * then write the RTX header in front of it. Note that we reserve PEER_CONNECTION_SRTP_RTP_HEADROOM_LENGTH
+             * in front of the payload at write frame. */
+            pOsn = ( uint16_t * )( pRollingBufferPacket->rtpPacket.pPayload - PEER_CONNECTION_SRTP_RTX_WRITE_RESERVED_BYTES );
             *pOsn = htons( rtpSeq );
-            pRollingBufferPacket->rtpPacket.payloadLength = pRollingBufferPacket->packetBufferLength + 2;
-            pRollingBufferPacket->rtpPacket.pPayload = pRollingBufferPacket->pPacketBuffer;
-
-            pSrtpPacket = srtpBuffer;
+            pRtpPacket = ( uint8_t * ) pOsn - pSrtpSender->rtxHeaderTemplate.headerLength;
+            rtpPacketLength = PeerConnectionSrtp_WriteRtpHeader( &pSrtpSender->rtxHeaderTemplate,
+                                                                 pRtpPacket,
+                                                                 ( *pRtpSeq )++,
+                                                                 pRollingBufferPacket->rtpPacket.header.timestamp,
+                                                                 ( ( pRollingBufferPacket->rtpPacket.header.flags & RTP_HEADER_FLAG_MARKER ) != 0 ) ? 1U : 0U,
+                                                                 pRollingBufferPacket->twccExtensionPayload );
+            rtpPacketLength += PEER_CONNECTION_SRTP_RTX_WRITE_RESERVED_BYTES + pRollingBufferPacket->packetBufferLength;
+
+            pSrtpPacket = pSrtpSender->pSendBatchBuffer + sendBufferCount * PEER_CONNECTION_SRTP_RTP_PACKET_MAX_LENGTH;
             srtpPacketLength = PEER_CONNECTION_SRTP_RTP_PACKET_MAX_LENGTH;
 
-            /* PeerConnectionSrtp_ConstructSrtpPacket() serializes RTP packet and encrypt it. */
-            ret = PeerConnectionSrtp_ConstructSrtpPacket( pSession,
-                                                          &pRollingBufferPacket->rtpPacket,
-                                                          pSrtpPacket,
-                                                          &srtpPacketLength );
+            if( isSrtpBatchLocked == 0U )
+            {
+                ret = PeerConnectionSrtp_BeginEncryptBatch( pSession );
+                isSrtpBatchLocked = ( ret == PEER_CONNECTION_RESULT_OK ) ? 1U : 0U;
+            }
+
+            if( ret == PEER_CONNECTION_RESULT_OK )
+            {
+                ret = PeerConnectionSrtp_EncryptRtpPacketInBatch( pSession,
+                                                                  pRtpPacket,
+                                                                  rtpPacketLength,
+                                                                  pSrtpPacket,
+                                                                  &srtpPacketLength );
+            }
         }
         else
         {
             pSrtpPacket = pRollingBufferPacket->pPacketBuffer;
             srtpPacketLength = pRollingBufferPacket->packetBufferLength;
         }
-    }
 
-    if( ret == PEER_CONNECTION_RESULT_OK )
-    {
-        resultIceController = IceController_SendToRemotePeer( &pSession->iceControllerContext,
-                                                              pSrtpPacket,
-                                                              srtpPacketLength );
+        if( ret == PEER_CONNECTION_RESULT_OK )
+        {
+            pRollingBufferPacket->lastResendTimeUs = currentTimeUs;
+            pSrtpSender->rtxBudgetBytes -= ( srtpPacketLength < pSrtpSender->rtxBudgetBytes ) ? srtpPacketLength : pSrtpSender->rtxBudgetBytes;
+            sendBuffers[ sendBufferCount ].pBuffer = pSrtpPacket;
+            sendBuffers[ sendBufferCount ].bufferLength = srtpPacketLength;
+            sendBufferCount++;
+            resentCount++;
+        }
 
-        if( resultIceController != ICE_CONTROLLER_RESULT_OK )
+        if( ( ret == PEER_CONNECTION_RESULT_OK ) && ( sendBufferCount >= maxSendBufferCount ) )
         {
-            LogWarn( ( "Fail to re-send RTP packet, ret: %d, seq: %u, SSRC: 0x%lx", resultIceController, rtpSeq, ssrc ) );
-            ret = PEER_CONNECTION_RESULT_FAIL_ICE_CONTROLLER_RESEND_RTP_PACKET;
+            ret = SendResendBatch( pSession,
+                                   &isSrtpBatchLocked,
+                                   sendBuffers,
+                                   sendBufferCount );
+            sendBufferCount = 0;
         }
-        else
+    }
+
+    if( ( isSrtpBatchLocked != 0U ) || ( sendBufferCount != 0U ) )
+    {
+        /* Flush the packets prepared before the end of the list or a failure. */
+        if( SendResendBatch( pSession,
+                             &isSrtpBatchLocked,
+                             sendBuffers,
+                             sendBufferCount ) != PEER_CONNECTION_RESULT_OK )
         {
-            LogDebug( ( "Re-send RTP successfully, RTP seq: %u, SSRC: 0x%lx", rtpSeq, ssrc ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_ICE_CONTROLLER_RESEND_RTP_PACKET;
         }
     }
 
@@ -217,6 +322,14 @@ static PeerConnectionResult_t ResendSrtpPacket( PeerConnectionSession_t * pSessi
         xSemaphoreGive( pSrtpSender->senderMutex );
     }
 
+    if( isRtxInProgress != 0U )
+    {
+        PeerConnectionSendScheduler_EndRtx( &pSession->sendScheduler );
+    }
+
+    LogDebug( ( "Re-sent %lu of %u NACKed packets, suppressed: %lu, not found: %lu, SSRC: 0x%lx",
+                resentCount, seqNumCount, suppressedCount, missingCount, ssrc ) );
+
     return ret;
 }
 
@@ -226,6 +339,7 @@ static PeerConnectionResult_t OnRtcpFirEvent( PeerConnectionSession_t * pSession
     PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
     RtcpResult_t resultRtcp;
     RtcpFirPacket_t firPacket;
+    RtcpPliPacket_t pliPacket;
     const Transceiver_t * pTransceiver = NULL;
 
     if( ( pSession == NULL ) || ( pRtcpPacket == NULL ) )
@@ -252,20 +366,29 @@ static PeerConnectionResult_t OnRtcpFirEvent( PeerConnectionSession_t * pSession
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
+        /* The FCI entry names our media stream, the sender SSRC is the viewer's. */
         ret = PeerConnection_MatchTransceiverBySsrc( pSession,
-                                                     firPacket.senderSsrc,
+                                                     firPacket.mediaSourceSsrc,
                                                      &pTransceiver );
     }
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        /* Increase the FIR Counter as per our application design. */
-
-        /* Initiate a callback to transmit an intra-picture to achieve resynchronization. */
+        /* FIR asks for the same intra-picture as PLI, so report it through the PLI callback
+         * and let the application merge the requests of all viewers. */
+        if( pSession->onPictureLossIndicationCallback != NULL )
+        {
+            memset( &pliPacket,
+                    0,
+                    sizeof( RtcpPliPacket_t ) );
+            pliPacket.mediaSourceSsrc = firPacket.mediaSourceSsrc;
+            pSession->onPictureLossIndicationCallback( pSession->pPictureLossIndicationUserContext,
+                                                       &pliPacket );
+        }
     }
     else if( ret == PEER_CONNECTION_RESULT_UNKNOWN_SSRC )
     {
-        LogWarn( ( "Received FIR for non existing ssrc: %lu", firPacket.senderSsrc ) );
+        LogWarn( ( "Received FIR for non existing ssrc: %lu", firPacket.mediaSourceSsrc ) );
     }
     else
     {
@@ -283,7 +406,6 @@ static PeerConnectionResult_t OnRtcpNackEvent( PeerConnectionSession_t * pSessio
     RtcpNackPacket_t nackPacket;
     const Transceiver_t * pTransceiver = NULL;
     uint16_t seqNumList[ PEER_CONNECTION_SRTCP_NACK_MAX_SEQ_NUM ];
-    int i;
 
     if( ( pSession == NULL ) || ( pRtcpPacket == NULL ) )
     {
@@ -317,19 +439,11 @@ static PeerConnectionResult_t OnRtcpNackEvent( PeerConnectionSession_t * pSessio
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        for( i = 0; i < nackPacket.seqNumListLength; i++ )
-        {
-            /* Retransmit matching sequence number one by one. */
-            ret = ResendSrtpPacket( pSession,
-                                    pTransceiver,
-                                    nackPacket.pSeqNumList[ i ],
-                                    nackPacket.senderSsrc );
-
-            if( ret != PEER_CONNECTION_RESULT_OK )
-            {
-                break;
-            }
-        }
+        ret = ResendSrtpPackets( pSession,
+                                 pTransceiver,
+                                 nackPacket.pSeqNumList,
+                                 nackPacket.seqNumListLength,
+                                 nackPacket.senderSsrc );
     }
 
     return ret;
@@ -340,13 +454,9 @@ static PeerConnectionResult_t OnRtcpNackEvent( PeerConnectionSession_t * pSessio
     {
         PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
         RtcpResult_t resultRtcp;
-        RtcpTwccManagerResult_t resultRtcpTwccManager = RTCP_TWCC_MANAGER_RESULT_OK;
         RtcpTwccPacket_t twccPacket;
-        TwccPacketInfo_t * pTwccPacketInfo;
         TwccBandwidthInfo_t twccBandwidthInfo;
-        PacketArrivalInfo_t packetArrivalInfo[ PEER_CONNECTION_RTCP_TWCC_MAX_ARRAY ];
-        int i;
-
+        PeerConnectionBandwidthEstimate_t estimate;
 
         if( ( pSession == NULL ) || ( pRtcpPacket == NULL ) )
         {
@@ -359,11 +469,11 @@ static PeerConnectionResult_t OnRtcpNackEvent( PeerConnectionSession_t * pSessio
             memset( &twccPacket,
                     0,
                     sizeof( RtcpTwccPacket_t ) );
-            memset( &packetArrivalInfo[ 0 ],
+            memset( &pSession->twccHistory.arrivalInfos[ 0 ],
                     0,
-                    sizeof( PacketArrivalInfo_t ) * PEER_CONNECTION_RTCP_TWCC_MAX_ARRAY );
-            twccPacket.pArrivalInfoList = packetArrivalInfo;
-            twccPacket.arrivalInfoListLength = PEER_CONNECTION_RTCP_TWCC_MAX_ARRAY;
+                    sizeof( PacketArrivalInfo_t ) * PEER_CONNECTION_TWCC_FEEDBACK_MAX_PACKETS );
+            twccPacket.pArrivalInfoList = pSession->twccHistory.arrivalInfos;
+            twccPacket.arrivalInfoListLength = PEER_CONNECTION_TWCC_FEEDBACK_MAX_PACKETS;
             resultRtcp = Rtcp_ParseTwccPacket( &pSession->pCtx->rtcpContext,
                                                pRtcpPacket,
                                                &twccPacket );
@@ -377,40 +487,32 @@ static PeerConnectionResult_t OnRtcpNackEvent( PeerConnectionSession_t * pSessio
 
         if( ret == PEER_CONNECTION_RESULT_OK )
         {
-            for( i = 0; i < twccPacket.arrivalInfoListLength; i++ )
-            {
-                /* Checks if the seq number already exists. */
-                resultRtcpTwccManager = RtcpTwccManager_FindPacketInfo( &pSession->pCtx->rtcpTwccManager,
-                                                                        twccPacket.pArrivalInfoList[ i ].seqNum,
-                                                                        &pTwccPacketInfo );
-
-                if( resultRtcpTwccManager == RTCP_TWCC_MANAGER_RESULT_OK )
-                {
-                    pTwccPacketInfo->localSentTime = twccPacket.pArrivalInfoList[ i ].remoteArrivalTime;
-                }
-            }
-        }
-
-        if( ret == PEER_CONNECTION_RESULT_OK )
-        {
-            resultRtcpTwccManager = RtcpTwccManager_HandleTwccPacket( &pSession->pCtx->rtcpTwccManager,
-                                                                      &twccPacket,
-                                                                      &twccBandwidthInfo );
-
-            if( resultRtcpTwccManager != RTCP_TWCC_MANAGER_RESULT_OK )
+            /* Each reported packet is looked up directly by its transport sequence number. */
+            ret = PeerConnectionTwcc_HandleFeedback( &pSession->twccHistory,
+                                                     &twccPacket,
+                                                     &pSession->bwe,
+                                                     &twccBandwidthInfo );
+            if( ret != PEER_CONNECTION_RESULT_OK )
             {
-                LogError( ( "Fail to handle RTCP TWCC packet, result: %d", resultRtcpTwccManager ) );
+                LogError( ( "Fail to handle RTCP TWCC packet, result: %d", ret ) );
                 ret = PEER_CONNECTION_RESULT_FAIL_RTCP_HANDLE_TWCC;
             }
         }
 
         if( ret == PEER_CONNECTION_RESULT_OK )
         {
-            if( ( twccBandwidthInfo.duration > 0 ) && ( pSession->pCtx->onBandwidthEstimationCallback != NULL ) )
+            /* Every feedback updates the estimate, so the sender reacts within a feedback interval. */
+            PeerConnectionBwe_Update( &pSession->bwe,
+                                      &twccBandwidthInfo,
+                                      NetworkingUtils_GetCurrentTimeUs( NULL ),
+                                      &estimate );
+
+            if( ( twccBandwidthInfo.sentPackets > 0 ) && ( pSession->onBandwidthEstimationCallback != NULL ) )
             {
                 /* Call the bandwidth estimation callback */
-                pSession->pCtx->onBandwidthEstimationCallback( pSession->pCtx->pOnBandwidthEstimationCallbackContext,
-                                                               &twccBandwidthInfo );
+                pSession->onBandwidthEstimationCallback( pSession->pOnBandwidthEstimationCallbackContext,
+                                                         &twccBandwidthInfo,
+                                                         &estimate );
             }
 
             LogDebug( ( "TWCC Bandwidth Info : SentBytes - %llu, ReceivedBytes - %llu, SentPackets - %llu, ReceivedPackets - %llu, Duration - %lld", twccBandwidthInfo.sentBytes, twccBandwidthInfo.receivedBytes, twccBandwidthInfo.sentPackets, twccBandwidthInfo.receivedPackets, twccBandwidthInfo.duration ) );
@@ -714,26 +816,35 @@ static PeerConnectionResult_t OnRtcpReceiverReportEvent( PeerConnectionSession_t
         for( i = 0; i < receiverReport.numReceptionReports; i++ )
         {
             ret = PeerConnection_MatchTransceiverBySsrc( pSession,
-                                                         receiverReport.pReceptionReports[ 0 ].sourceSsrc,
+                                                         receiverReport.pReceptionReports[ i ].sourceSsrc,
                                                          &pTransceiver );
 
             LogDebug( ( "RTCP_PACKET_TYPE_RECEIVER_REPORT, sender SSRC: %lu, source SSRC: %lu, fraction loss: %u, cumulative loss: %lu, highest seq: %lu, jit: %lu, lsr: %lu, dlsr: %lu",
                         receiverReport.senderSsrc,
-                        receiverReport.pReceptionReports[ 0 ].sourceSsrc,
-                        receiverReport.pReceptionReports[ 0 ].fractionLost,
-                        receiverReport.pReceptionReports[ 0 ].cumulativePacketsLost,
-                        receiverReport.pReceptionReports[ 0 ].extendedHighestSeqNumReceived,
-                        receiverReport.pReceptionReports[ 0 ].interArrivalJitter,
-                        receiverReport.pReceptionReports[ 0 ].lastSR,
-                        receiverReport.pReceptionReports[ 0 ].delaySinceLastSR ) );
+                        receiverReport.pReceptionReports[ i ].sourceSsrc,
+                        receiverReport.pReceptionReports[ i ].fractionLost,
+                        receiverReport.pReceptionReports[ i ].cumulativePacketsLost,
+                        receiverReport.pReceptionReports[ i ].extendedHighestSeqNumReceived,
+                        receiverReport.pReceptionReports[ i ].interArrivalJitter,
+                        receiverReport.pReceptionReports[ i ].lastSR,
+                        receiverReport.pReceptionReports[ i ].delaySinceLastSR ) );
 
             if( ret == PEER_CONNECTION_RESULT_UNKNOWN_SSRC )
             {
-                LogWarn( ( "Received receiver report for non existing ssrc: %lu", receiverReport.pReceptionReports[ 0 ].sourceSsrc ) );
+                LogWarn( ( "Received receiver report for non existing ssrc: %lu", receiverReport.pReceptionReports[ i ].sourceSsrc ) );
                 ret = PEER_CONNECTION_RESULT_OK;
                 continue;
             }
 
+            if( ( ret == PEER_CONNECTION_RESULT_OK ) &&
+                ( pTransceiver->trackKind == TRANSCEIVER_TRACK_KIND_VIDEO ) &&
+                ( receiverReport.pReceptionReports[ i ].sourceSsrc == pTransceiver->ssrc ) )
+            {
+                /* The loss of the media SSRC decides how much FEC protects it. */
+                PeerConnectionFec_UpdateLoss( &pSession->videoSrtpSender.fecEncoder,
+                                              receiverReport.pReceptionReports[ i ].fractionLost );
+            }
+
             if( ( ret == PEER_CONNECTION_RESULT_OK ) && ( receiverReport.pReceptionReports[ i ].lastSR != 0 ) )
             {
                 /* https://tools.ietf.org/html/rfc3550#section-6.4.1 */
@@ -744,16 +855,29 @@ static PeerConnectionResult_t OnRtcpReceiverReportEvent( PeerConnectionSession_t
                 /*      leave the round-trip propagation delay as (A - LSR - DLSR). */
                 currentTimeNTP = NetworkingUtils_GetNTPTimeFromUnixTimeUs( NetworkingUtils_GetCurrentTimeUs( NULL ) );
                 currentTimeNTP = PEER_CONNECTION_SRTCP_MID_NTP( currentTimeNTP );
-                roundTripPropagationDelay = currentTimeNTP - receiverReport.pReceptionReports[ 0 ].lastSR - receiverReport.pReceptionReports[ 0 ].delaySinceLastSR;
-                roundTripPropagationDelay = ( roundTripPropagationDelay * 1000 ) / PEER_CONNECTION_SRTCP_DLSR_TIMESCALE;                             /* The Round Trip Propogation Delay is in ms unit. */
+                roundTripPropagationDelay = currentTimeNTP - receiverReport.pReceptionReports[ i ].lastSR - receiverReport.pReceptionReports[ i ].delaySinceLastSR;
+                if( ( int32_t ) roundTripPropagationDelay < 0 )
+                {
+                    /* The remote's delay doesn't match our clock, keep the last round trip time. */
+                    roundTripPropagationDelay = 0;
+                }
+                roundTripPropagationDelay = ( uint32_t )( ( ( uint64_t ) roundTripPropagationDelay * 1000 ) / PEER_CONNECTION_SRTCP_DLSR_TIMESCALE );                             /* The Round Trip Propogation Delay is in ms unit. */
 
                 if( pTransceiver->trackKind == TRANSCEIVER_TRACK_KIND_AUDIO )
                 {
                     LogVerbose( ( "RTCP_PACKET_TYPE_RECEIVER_REPORT Round Trip Propagation Delay for Audio : %lu ms", roundTripPropagationDelay ) );
+                    if( roundTripPropagationDelay != 0U )
+                    {
+                        pSession->audioSrtpSender.roundTripTimeMs = roundTripPropagationDelay;
+                    }
                 }
                 else if( pTransceiver->trackKind == TRANSCEIVER_TRACK_KIND_VIDEO )
                 {
                     LogVerbose( ( "RTCP_PACKET_TYPE_RECEIVER_REPORT Round Trip Propagation Delay for Video : %lu ms", roundTripPropagationDelay ) );
+                    if( roundTripPropagationDelay != 0U )
+                    {
+                        pSession->videoSrtpSender.roundTripTimeMs = roundTripPropagationDelay;
+                    }
                 }
             }
         }
@@ -811,14 +935,14 @@ PeerConnectionResult_t PeerConnectionSrtcp_ConstructSenderReportPacket( PeerConn
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        if( xSemaphoreTake( pSession->srtpSessionMutex,
+        if( xSemaphoreTake( pSession->srtpTransmitSessionMutex,
                             portMAX_DELAY ) == pdTRUE )
         {
             isLocked = 1U;
         }
         else
         {
-            LogError( ( "Fail to take SRTP session mutex to construct SRTCP packet." ) );
+            LogError( ( "Fail to take Tx SRTP session mutex to construct SRTCP packet." ) );
             ret = PEER_CONNECTION_RESULT_FAIL_TAKE_SRTP_MUTEX;
         }
     }
@@ -849,7 +973,7 @@ PeerConnectionResult_t PeerConnectionSrtcp_ConstructSenderReportPacket( PeerConn
 
     if( isLocked != 0U )
     {
-        xSemaphoreGive( pSession->srtpSessionMutex );
+        xSemaphoreGive( pSession->srtpTransmitSessionMutex );
     }
 
     return ret;
@@ -878,14 +1002,14 @@ PeerConnectionResult_t PeerConnectionSrtp_HandleSrtcpPacket( PeerConnectionSessi
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        if( xSemaphoreTake( pSession->srtpSessionMutex,
+        if( xSemaphoreTake( pSession->srtpReceiveSessionMutex,
                             portMAX_DELAY ) == pdTRUE )
         {
             isLocked = 1U;
         }
         else
         {
-            LogError( ( "Fail to take SRTP session mutex to construct SRTCP packet." ) );
+            LogError( ( "Fail to take Rx SRTP session mutex to decrypt SRTCP packet." ) );
             ret = PEER_CONNECTION_RESULT_FAIL_TAKE_SRTP_MUTEX;
         }
     }
@@ -920,7 +1044,7 @@ PeerConnectionResult_t PeerConnectionSrtp_HandleSrtcpPacket( PeerConnectionSessi
 
     if( isLocked != 0U )
     {
-        xSemaphoreGive( pSession->srtpSessionMutex );
+        xSemaphoreGive( pSession->srtpReceiveSessionMutex );
     }
 
     while( ( remainingLength >= RTCP_HEADER_LENGTH ) &&
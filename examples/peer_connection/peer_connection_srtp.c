@@ -20,6 +20,9 @@
 #include "peer_connection_srtp.h"
 #include "peer_connection_rolling_buffer.h"
 #include "peer_connection_jitter_buffer.h"
+#include "peer_connection_pacer.h"
+#include "peer_connection_fec.h"
+#include "peer_connection_red.h"
 #if METRIC_PRINT_ENABLED
 #include "metric.h"
 #endif
@@ -35,6 +38,33 @@
 #include "peer_connection_h265_helper.h"
 #include "peer_connection_opus_helper.h"
 
+#define PEER_CONNECTION_SRTP_RTP_FIXED_HEADER_LENGTH ( 12 )
+#define PEER_CONNECTION_SRTP_RTP_EXTENSION_HEADER_LENGTH ( 4 )
+#define PEER_CONNECTION_SRTP_RTP_VERSION_BITS ( 0x80U )
+#define PEER_CONNECTION_SRTP_RTP_EXTENSION_BIT ( 0x10U )
+#define PEER_CONNECTION_SRTP_RTP_MARKER_BIT ( 0x80U )
+#define PEER_CONNECTION_SRTP_RTP_SEQUENCE_OFFSET ( 2 )
+#define PEER_CONNECTION_SRTP_RTP_TIMESTAMP_OFFSET ( 4 )
+#define PEER_CONNECTION_SRTP_RTP_SSRC_OFFSET ( 8 )
+#define PEER_CONNECTION_SRTP_RTP_TWCC_ELEMENT_OFFSET ( PEER_CONNECTION_SRTP_RTP_FIXED_HEADER_LENGTH + PEER_CONNECTION_SRTP_RTP_EXTENSION_HEADER_LENGTH )
+
+#define PEER_CONNECTION_SRTP_READ_UINT32( pSrc ) ( ( ( uint32_t )( pSrc )[ 0 ] << 24 ) | ( ( uint32_t )( pSrc )[ 1 ] << 16 ) | ( ( uint32_t )( pSrc )[ 2 ] << 8 ) | ( pSrc )[ 3 ] )
+#define PEER_CONNECTION_SRTP_WRITE_UINT16( pDst, val ) \
+    do                                                 \
+    {                                                  \
+        ( pDst )[ 0 ] = ( uint8_t )( ( val ) >> 8 );   \
+        ( pDst )[ 1 ] = ( uint8_t )( val );            \
+    } while( 0 )
+
+#define PEER_CONNECTION_SRTP_WRITE_UINT32( pDst, val ) \
+    do                                                 \
+    {                                                  \
+        ( pDst )[ 0 ] = ( uint8_t )( ( val ) >> 24 );  \
+        ( pDst )[ 1 ] = ( uint8_t )( ( val ) >> 16 );  \
+        ( pDst )[ 2 ] = ( uint8_t )( ( val ) >> 8 );   \
+        ( pDst )[ 3 ] = ( uint8_t )( val );            \
+    } while( 0 )
+
 /*-----------------------------------------------------------*/
 
 static PeerConnectionResult_t OnJitterBufferFrameReady( void * pCustomContext,
@@ -120,8 +150,6 @@ PeerConnectionResult_t PeerConnectionSrtp_ConstructSrtpPacket( PeerConnectionSes
     PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
     RtpResult_t resultRtp;
     size_t rtpBufferLength;
-    srtp_err_status_t errorStatus;
-    uint8_t isLocked = 0U;
 
     if( ( pSession == NULL ) ||
         ( pPacketRtp == NULL ) ||
@@ -156,51 +184,201 @@ PeerConnectionResult_t PeerConnectionSrtp_ConstructSrtpPacket( PeerConnectionSes
         }
     }
 
+    /* Encrypt it by SRTP. */
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        if( xSemaphoreTake( pSession->srtpSessionMutex,
-                            portMAX_DELAY ) == pdTRUE )
+        ret = PeerConnectionSrtp_EncryptRtpPacket( pSession,
+                                                   pOutputSrtpPacket,
+                                                   rtpBufferLength,
+                                                   pOutputSrtpPacket,
+                                                   pOutputSrtpPacketLength );
+    }
+
+    return ret;
+}
+
+void PeerConnectionSrtp_InitRtpHeaderTemplate( PeerConnectionRtpHeaderTemplate_t * pTemplate,
+                                               uint32_t payloadType,
+                                               uint32_t ssrc,
+                                               uint16_t twccId )
+{
+    uint8_t * pHeader;
+
+    if( pTemplate == NULL )
+    {
+        LogError( ( "Invalid input, pTemplate: %p", pTemplate ) );
+    }
+    else
+    {
+        memset( pTemplate, 0, sizeof( PeerConnectionRtpHeaderTemplate_t ) );
+        pHeader = pTemplate->header;
+
+        pHeader[ 0 ] = PEER_CONNECTION_SRTP_RTP_VERSION_BITS;
+        pHeader[ 1 ] = ( uint8_t )( payloadType & 0x7FU );
+        PEER_CONNECTION_SRTP_WRITE_UINT32( &pHeader[ PEER_CONNECTION_SRTP_RTP_SSRC_OFFSET ], ssrc );
+        pTemplate->headerLength = PEER_CONNECTION_SRTP_RTP_FIXED_HEADER_LENGTH;
+
+        if( twccId > 0 )
         {
-            isLocked = 1U;
+            /* One-byte header extension with a single TWCC element, only the sequence changes per packet. */
+            pHeader[ 0 ] |= PEER_CONNECTION_SRTP_RTP_EXTENSION_BIT;
+            PEER_CONNECTION_SRTP_WRITE_UINT16( &pHeader[ PEER_CONNECTION_SRTP_RTP_FIXED_HEADER_LENGTH ], PEER_CONNECTION_SRTP_TWCC_EXT_PROFILE );
+            PEER_CONNECTION_SRTP_WRITE_UINT16( &pHeader[ PEER_CONNECTION_SRTP_RTP_FIXED_HEADER_LENGTH + sizeof( uint16_t ) ], 1U );
+            PEER_CONNECTION_SRTP_WRITE_UINT32( &pHeader[ PEER_CONNECTION_SRTP_RTP_TWCC_ELEMENT_OFFSET ], PEER_CONNECTION_SRTP_GET_TWCC_PAYLOAD( twccId, 0U ) );
+            pTemplate->headerLength += PEER_CONNECTION_SRTP_RTP_EXTENSION_HEADER_LENGTH + sizeof( uint32_t );
+            pTemplate->twccId = twccId;
         }
-        else
+    }
+}
+
+size_t PeerConnectionSrtp_WriteRtpHeader( const PeerConnectionRtpHeaderTemplate_t * pTemplate,
+                                          uint8_t * pBuffer,
+                                          uint16_t sequenceNumber,
+                                          uint32_t timestamp,
+                                          uint8_t isMarker,
+                                          uint32_t twccExtensionPayload )
+{
+    /* Hot path, the caller reserves PEER_CONNECTION_RTP_HEADER_TEMPLATE_MAX_LENGTH bytes. */
+    memcpy( pBuffer,
+            pTemplate->header,
+            pTemplate->headerLength );
+
+    if( isMarker != 0U )
+    {
+        pBuffer[ 1 ] |= PEER_CONNECTION_SRTP_RTP_MARKER_BIT;
+    }
+    PEER_CONNECTION_SRTP_WRITE_UINT16( &pBuffer[ PEER_CONNECTION_SRTP_RTP_SEQUENCE_OFFSET ], sequenceNumber );
+    PEER_CONNECTION_SRTP_WRITE_UINT32( &pBuffer[ PEER_CONNECTION_SRTP_RTP_TIMESTAMP_OFFSET ], timestamp );
+
+    if( pTemplate->twccId > 0 )
+    {
+        PEER_CONNECTION_SRTP_WRITE_UINT32( &pBuffer[ PEER_CONNECTION_SRTP_RTP_TWCC_ELEMENT_OFFSET ], twccExtensionPayload );
+    }
+
+    return pTemplate->headerLength;
+}
+
+static PeerConnectionResult_t ProtectRtpPacket( PeerConnectionSession_t * pSession,
+                                                uint8_t * pRtpPacket,
+                                                size_t rtpPacketLength,
+                                                uint8_t * pOutputSrtpPacket,
+                                                size_t * pOutputSrtpPacketLength )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    srtp_err_status_t errorStatus;
+
+    /* The caller holds srtpTransmitSessionMutex. */
+    if( pSession->srtpTransmitSession != NULL )
+    {
+        errorStatus = srtp_protect( pSession->srtpTransmitSession,
+                                    pRtpPacket,
+                                    rtpPacketLength,
+                                    pOutputSrtpPacket,
+                                    pOutputSrtpPacketLength,
+                                    0 );
+        if( errorStatus != srtp_err_status_ok )
         {
-            LogError( ( "Fail to take SRTP session mutex to construct SRTP packet." ) );
-            ret = PEER_CONNECTION_RESULT_FAIL_TAKE_SRTP_MUTEX;
+            LogError( ( "Fail to encrypt Tx SRTP packet, errorStatus: %d", errorStatus ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_ENCRYPT_SRTP_RTP_PACKET;
         }
     }
+    else
+    {
+        LogWarn( ( "SRTP session has been freed before encrypting." ) );
+    }
+
+    return ret;
+}
+
+PeerConnectionResult_t PeerConnectionSrtp_EncryptRtpPacket( PeerConnectionSession_t * pSession,
+                                                            uint8_t * pRtpPacket,
+                                                            size_t rtpPacketLength,
+                                                            uint8_t * pOutputSrtpPacket,
+                                                            size_t * pOutputSrtpPacketLength )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+
+    ret = PeerConnectionSrtp_BeginEncryptBatch( pSession );
 
-    /* Encrypt it by SRTP. */
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        if( pSession->srtpTransmitSession != NULL )
-        {
-            errorStatus = srtp_protect( pSession->srtpTransmitSession,
-                                        pOutputSrtpPacket,
-                                        rtpBufferLength,
-                                        pOutputSrtpPacket,
-                                        pOutputSrtpPacketLength,
-                                        0 );
-            if( errorStatus != srtp_err_status_ok )
-            {
-                LogError( ( "Fail to encrypt Tx SRTP packet, errorStatus: %d", errorStatus ) );
-                ret = PEER_CONNECTION_RESULT_FAIL_ENCRYPT_SRTP_RTP_PACKET;
-            }
-        }
-        else
-        {
-            LogWarn( ( "SRTP session has been freed before encrypting." ) );
-        }
+        ret = PeerConnectionSrtp_EncryptRtpPacketInBatch( pSession,
+                                                          pRtpPacket,
+                                                          rtpPacketLength,
+                                                          pOutputSrtpPacket,
+                                                          pOutputSrtpPacketLength );
+
+        PeerConnectionSrtp_EndEncryptBatch( pSession );
     }
 
-    if( isLocked != 0U )
+    return ret;
+}
+
+PeerConnectionResult_t PeerConnectionSrtp_BeginEncryptBatch( PeerConnectionSession_t * pSession )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+
+    if( pSession == NULL )
+    {
+        LogError( ( "Invalid input, pSession: %p", pSession ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+    else if( xSemaphoreTake( pSession->srtpTransmitSessionMutex,
+                             portMAX_DELAY ) != pdTRUE )
+    {
+        LogError( ( "Fail to take Tx SRTP session mutex to construct SRTP packet." ) );
+        ret = PEER_CONNECTION_RESULT_FAIL_TAKE_SRTP_MUTEX;
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    return ret;
+}
+
+PeerConnectionResult_t PeerConnectionSrtp_EncryptRtpPacketInBatch( PeerConnectionSession_t * pSession,
+                                                                   uint8_t * pRtpPacket,
+                                                                   size_t rtpPacketLength,
+                                                                   uint8_t * pOutputSrtpPacket,
+                                                                   size_t * pOutputSrtpPacketLength )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+
+    if( ( pSession == NULL ) ||
+        ( pRtpPacket == NULL ) ||
+        ( pOutputSrtpPacket == NULL ) ||
+        ( pOutputSrtpPacketLength == NULL ) )
     {
-        xSemaphoreGive( pSession->srtpSessionMutex );
+        LogError( ( "Invalid input, pSession: %p, pRtpPacket: %p, pOutputSrtpPacket: %p, pOutputSrtpPacketLength: %p",
+                    pSession,
+                    pRtpPacket,
+                    pOutputSrtpPacket,
+                    pOutputSrtpPacketLength ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+
+    /* Encrypt it by SRTP. */
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        ret = ProtectRtpPacket( pSession,
+                                pRtpPacket,
+                                rtpPacketLength,
+                                pOutputSrtpPacket,
+                                pOutputSrtpPacketLength );
     }
 
     return ret;
 }
 
+void PeerConnectionSrtp_EndEncryptBatch( PeerConnectionSession_t * pSession )
+{
+    if( pSession != NULL )
+    {
+        xSemaphoreGive( pSession->srtpTransmitSessionMutex );
+    }
+}
+
 PeerConnectionResult_t PeerConnectionSrtp_Init( PeerConnectionSession_t * pSession )
 {
     PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
@@ -212,7 +390,8 @@ PeerConnectionResult_t PeerConnectionSrtp_Init( PeerConnectionSession_t * pSessi
     PeerConnectionSrtpReceiver_t * pSrtpReceiver = NULL;
     int i;
     size_t maxSizePerPacket = PEER_CONNECTION_SRTP_RTP_PACKET_MAX_LENGTH;
-    uint8_t isLocked = 0U;
+    uint8_t isTxLocked = 0U;
+    uint8_t isRxLocked = 0U;
 
     if( pSession == NULL )
     {
@@ -241,14 +420,14 @@ PeerConnectionResult_t PeerConnectionSrtp_Init( PeerConnectionSession_t * pSessi
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        if( xSemaphoreTake( pSession->srtpSessionMutex,
+        if( xSemaphoreTake( pSession->srtpReceiveSessionMutex,
                             portMAX_DELAY ) == pdTRUE )
         {
-            isLocked = 1U;
+            isRxLocked = 1U;
         }
         else
         {
-            LogError( ( "Fail to take SRTP session mutex to create SRTP session instance." ) );
+            LogError( ( "Fail to take Rx SRTP session mutex to create SRTP session instance." ) );
             ret = PEER_CONNECTION_RESULT_FAIL_TAKE_SRTP_MUTEX;
         }
     }
@@ -279,6 +458,25 @@ PeerConnectionResult_t PeerConnectionSrtp_Init( PeerConnectionSession_t * pSessi
         }
     }
 
+    if( isRxLocked != 0U )
+    {
+        xSemaphoreGive( pSession->srtpReceiveSessionMutex );
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        if( xSemaphoreTake( pSession->srtpTransmitSessionMutex,
+                            portMAX_DELAY ) == pdTRUE )
+        {
+            isTxLocked = 1U;
+        }
+        else
+        {
+            LogError( ( "Fail to take Tx SRTP session mutex to create SRTP session instance." ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_TAKE_SRTP_MUTEX;
+        }
+    }
+
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
         memset( &transmitPolicy, 0, sizeof( transmitPolicy ) );
@@ -305,9 +503,9 @@ PeerConnectionResult_t PeerConnectionSrtp_Init( PeerConnectionSession_t * pSessi
         }
     }
 
-    if( isLocked != 0U )
+    if( isTxLocked != 0U )
     {
-        xSemaphoreGive( pSession->srtpSessionMutex );
+        xSemaphoreGive( pSession->srtpTransmitSessionMutex );
     }
 
     if( ret == PEER_CONNECTION_RESULT_OK )
@@ -315,37 +513,117 @@ PeerConnectionResult_t PeerConnectionSrtp_Init( PeerConnectionSession_t * pSessi
         /* Initialize Rolling buffers. */
         for( i = 0; i < pSession->transceiverCount; i++ )
         {
+            maxSizePerPacket = PEER_CONNECTION_SRTP_RTP_PACKET_MAX_LENGTH;
+
             if( ( pSession->pTransceivers[i]->trackKind == TRANSCEIVER_TRACK_KIND_VIDEO ) &&
                 ( ( pSession->pTransceivers[i]->direction == TRANSCEIVER_TRACK_DIRECTION_SENDRECV ) ||
                   ( pSession->pTransceivers[i]->direction == TRANSCEIVER_TRACK_DIRECTION_SENDONLY ) ) )
             {
                 pSrtpSender = &pSession->videoSrtpSender;
+                PeerConnectionSrtp_InitRtpHeaderTemplate( &pSrtpSender->rtpHeaderTemplate,
+                                                          pSession->rtpConfig.videoCodecPayload,
+                                                          pSession->pTransceivers[i]->ssrc,
+                                                          pSession->rtpConfig.twccId );
+                PeerConnectionSrtp_InitRtpHeaderTemplate( &pSrtpSender->rtxHeaderTemplate,
+                                                          pSession->rtpConfig.videoCodecRtxPayload,
+                                                          pSession->pTransceivers[i]->rtxSsrc,
+                                                          pSession->rtpConfig.twccId );
+                PeerConnectionFec_Init( &pSrtpSender->fecEncoder,
+                                        pSession->rtpConfig.videoCodecFecPayload,
+                                        pSession->pTransceivers[i]->fecSsrc,
+                                        pSession->pTransceivers[i]->ssrc,
+                                        pSession->rtpConfig.twccId );
                 if( ( pSession->rtpConfig.videoCodecRtxPayload != 0 ) &&
                     ( pSession->rtpConfig.videoCodecRtxPayload != pSession->rtpConfig.videoCodecPayload ) )
                 {
-                    /* If we're using different payload type in re-transmission, we create the rolling buffer just for RTP payload. */
-                    maxSizePerPacket = PEER_CONNECTION_SRTP_RTP_PAYLOAD_MAX_LENGTH;
+                    /* If we're using different payload type in re-transmission, we create the rolling buffer just for RTP payload,
+                     * with headroom for the RTP header in front of it. */
+                    maxSizePerPacket = PEER_CONNECTION_SRTP_RTP_HEADROOM_LENGTH + PEER_CONNECTION_SRTP_RTP_PAYLOAD_MAX_LENGTH;
                 }
                 ret = PeerConnectionRollingBuffer_Create( &pSession->videoSrtpSender.txRollingBuffer,
                                                           pSession->pTransceivers[i]->rollingbufferBitRate, // bps
                                                           pSession->pTransceivers[i]->rollingbufferDurationSec, // duration in seconds
                                                           maxSizePerPacket );
+
+                if( ret == PEER_CONNECTION_RESULT_OK )
+                {
+                    /* Only video is paced, audio frames are small and latency sensitive. */
+                    PeerConnectionPacer_Init( &pSrtpSender->pacer,
+                                              pSession->pTransceivers[i]->rollingbufferBitRate,
+                                              PEER_CONNECTION_PACER_BURST_BYTES );
+                    pSrtpSender->rtxBudgetBytes = PEER_CONNECTION_SRTP_RTX_BUDGET_MAX_BYTES;
+                }
+
+                if( ( ret == PEER_CONNECTION_RESULT_OK ) &&
+                    ( pSession->rtpConfig.videoCodecRtxPayload != 0 ) &&
+                    ( pSession->rtpConfig.videoCodecRtxPayload != pSession->rtpConfig.videoCodecPayload ) &&
+                    ( pSrtpSender->pSendBatchBuffer == NULL ) )
+                {
+                    /* The rolling buffer only keeps RTP payloads, so a video frame needs its own
+                     * buffer to hold the SRTP packets that are sent together. */
+                    pSrtpSender->pSendBatchBuffer = ( uint8_t * ) pvPortMalloc( PEER_CONNECTION_SRTP_SEND_BATCH_MAX_COUNT * PEER_CONNECTION_SRTP_RTP_PACKET_MAX_LENGTH );
+                    if( pSrtpSender->pSendBatchBuffer == NULL )
+                    {
+                        LogError( ( "Fail to allocate send batch buffer for video sender." ) );
+                        ret = PEER_CONNECTION_RESULT_FAIL_SEND_BATCH_BUFFER_ALLOCATE;
+                    }
+                    else
+                    {
+                        pSrtpSender->sendBatchBufferCount = PEER_CONNECTION_SRTP_SEND_BATCH_MAX_COUNT;
+                    }
+                }
             }
             else if( ( pSession->pTransceivers[i]->trackKind == TRANSCEIVER_TRACK_KIND_AUDIO ) &&
                      ( ( pSession->pTransceivers[i]->direction == TRANSCEIVER_TRACK_DIRECTION_SENDRECV ) ||
                        ( pSession->pTransceivers[i]->direction == TRANSCEIVER_TRACK_DIRECTION_SENDONLY ) ) )
             {
                 pSrtpSender = &pSession->audioSrtpSender;
+                PeerConnectionRed_Init( &pSrtpSender->redEncoder,
+                                        pSession->rtpConfig.audioCodecRedPayload,
+                                        pSession->rtpConfig.audioCodecPayload );
+                /* With RED every audio packet carries the RED payload type, the codec's is in the block headers. */
+                PeerConnectionSrtp_InitRtpHeaderTemplate( &pSrtpSender->rtpHeaderTemplate,
+                                                          ( pSrtpSender->redEncoder.isEnabled != 0U ) ? pSession->rtpConfig.audioCodecRedPayload : pSession->rtpConfig.audioCodecPayload,
+                                                          pSession->pTransceivers[i]->ssrc,
+                                                          pSession->rtpConfig.twccId );
+                PeerConnectionSrtp_InitRtpHeaderTemplate( &pSrtpSender->rtxHeaderTemplate,
+                                                          pSession->rtpConfig.audioCodecRtxPayload,
+                                                          pSession->pTransceivers[i]->rtxSsrc,
+                                                          pSession->rtpConfig.twccId );
                 if( ( pSession->rtpConfig.audioCodecRtxPayload != 0 ) &&
                     ( pSession->rtpConfig.audioCodecRtxPayload != pSession->rtpConfig.audioCodecPayload ) )
                 {
-                    /* If we're using different payload type in re-transmission, we create the rolling buffer just for RTP payload. */
-                    maxSizePerPacket = PEER_CONNECTION_SRTP_RTP_PAYLOAD_MAX_LENGTH;
+                    /* If we're using different payload type in re-transmission, we create the rolling buffer just for RTP payload,
+                     * with headroom for the RTP header in front of it. */
+                    maxSizePerPacket = PEER_CONNECTION_SRTP_RTP_HEADROOM_LENGTH + PEER_CONNECTION_SRTP_RTP_PAYLOAD_MAX_LENGTH;
                 }
                 ret = PeerConnectionRollingBuffer_Create( &pSession->audioSrtpSender.txRollingBuffer,
                                                           pSession->pTransceivers[i]->rollingbufferBitRate, // bps
                                                           pSession->pTransceivers[i]->rollingbufferDurationSec, // duration in seconds
                                                           maxSizePerPacket );
+
+                if( ret == PEER_CONNECTION_RESULT_OK )
+                {
+                    pSrtpSender->rtxBudgetBytes = PEER_CONNECTION_SRTP_RTX_BUDGET_MAX_BYTES;
+                }
+
+                if( ( ret == PEER_CONNECTION_RESULT_OK ) &&
+                    ( pSession->rtpConfig.audioCodecRtxPayload != 0 ) &&
+                    ( pSession->rtpConfig.audioCodecRtxPayload != pSession->rtpConfig.audioCodecPayload ) &&
+                    ( pSrtpSender->pSendBatchBuffer == NULL ) )
+                {
+                    /* An audio frame is a single packet, one SRTP packet is enough. */
+                    pSrtpSender->pSendBatchBuffer = ( uint8_t * ) pvPortMalloc( PEER_CONNECTION_SRTP_RTP_PACKET_MAX_LENGTH );
+                    if( pSrtpSender->pSendBatchBuffer == NULL )
+                    {
+                        LogError( ( "Fail to allocate send batch buffer for audio sender." ) );
+                        ret = PEER_CONNECTION_RESULT_FAIL_SEND_BATCH_BUFFER_ALLOCATE;
+                    }
+                    else
+                    {
+                        pSrtpSender->sendBatchBufferCount = 1U;
+                    }
+                }
             }
             else
             {
@@ -415,6 +693,10 @@ PeerConnectionResult_t PeerConnectionSrtp_Init( PeerConnectionSession_t * pSessi
                                                          PEER_CONNECTION_SRTP_JITTER_BUFFER_TOLERENCE_TIME_SECOND,   // buffer time in seconds
                                                          pSession->pTransceivers[i]->codecBitMap,
                                                          PEER_CONNECTION_SRTP_PCM_CLOCKRATE );
+                if( ret == PEER_CONNECTION_RESULT_OK )
+                {
+                    pSrtpReceiver->rxJitterBuffer.redPayloadType = pSession->rtpConfig.audioCodecRedPayload;
+                }
             }
             else
             {
@@ -437,7 +719,8 @@ PeerConnectionResult_t PeerConnectionSrtp_DeInit( PeerConnectionSession_t * pSes
 {
     PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
     srtp_err_status_t errorStatus;
-    uint8_t isLocked = 0U;
+    uint8_t isTxLocked = 0U;
+    uint8_t isRxLocked = 0U;
 
     if( pSession == NULL )
     {
@@ -447,19 +730,16 @@ PeerConnectionResult_t PeerConnectionSrtp_DeInit( PeerConnectionSession_t * pSes
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        if( xSemaphoreTake( pSession->srtpSessionMutex,
+        if( xSemaphoreTake( pSession->srtpReceiveSessionMutex,
                             portMAX_DELAY ) == pdTRUE )
         {
-            isLocked = 1U;
+            isRxLocked = 1U;
         }
         else
         {
-            LogError( ( "Fail to take SRTP session mutex to release SRTP session." ) );
+            LogError( ( "Fail to take Rx SRTP session mutex to release SRTP session." ) );
         }
-    }
 
-    if( ret == PEER_CONNECTION_RESULT_OK )
-    {
         if( pSession->srtpReceiveSession != NULL )
         {
             errorStatus = srtp_dealloc( pSession->srtpReceiveSession );
@@ -470,6 +750,24 @@ PeerConnectionResult_t PeerConnectionSrtp_DeInit( PeerConnectionSession_t * pSes
             pSession->srtpReceiveSession = NULL;
         }
 
+        if( isRxLocked != 0U )
+        {
+            xSemaphoreGive( pSession->srtpReceiveSessionMutex );
+        }
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        if( xSemaphoreTake( pSession->srtpTransmitSessionMutex,
+                            portMAX_DELAY ) == pdTRUE )
+        {
+            isTxLocked = 1U;
+        }
+        else
+        {
+            LogError( ( "Fail to take Tx SRTP session mutex to release SRTP session." ) );
+        }
+
         if( pSession->srtpTransmitSession != NULL )
         {
             errorStatus = srtp_dealloc( pSession->srtpTransmitSession );
@@ -479,11 +777,11 @@ PeerConnectionResult_t PeerConnectionSrtp_DeInit( PeerConnectionSession_t * pSes
             }
             pSession->srtpTransmitSession = NULL;
         }
-    }
 
-    if( isLocked != 0U )
-    {
-        xSemaphoreGive( pSession->srtpSessionMutex );
+        if( isTxLocked != 0U )
+        {
+            xSemaphoreGive( pSession->srtpTransmitSessionMutex );
+        }
     }
 
     if( ret == PEER_CONNECTION_RESULT_OK )
@@ -494,6 +792,12 @@ PeerConnectionResult_t PeerConnectionSrtp_DeInit( PeerConnectionSession_t * pSes
                               portMAX_DELAY ) == pdTRUE ) )
         {
             PeerConnectionRollingBuffer_Free( &pSession->videoSrtpSender.txRollingBuffer );
+            if( pSession->videoSrtpSender.pSendBatchBuffer != NULL )
+            {
+                vPortFree( pSession->videoSrtpSender.pSendBatchBuffer );
+                pSession->videoSrtpSender.pSendBatchBuffer = NULL;
+            }
+            pSession->videoSrtpSender.sendBatchBufferCount = 0U;
             xSemaphoreGive( pSession->videoSrtpSender.senderMutex );
         }
     }
@@ -506,6 +810,12 @@ PeerConnectionResult_t PeerConnectionSrtp_DeInit( PeerConnectionSession_t * pSes
                               portMAX_DELAY ) == pdTRUE ) )
         {
             PeerConnectionRollingBuffer_Free( &pSession->audioSrtpSender.txRollingBuffer );
+            if( pSession->audioSrtpSender.pSendBatchBuffer != NULL )
+            {
+                vPortFree( pSession->audioSrtpSender.pSendBatchBuffer );
+                pSession->audioSrtpSender.pSendBatchBuffer = NULL;
+            }
+            pSession->audioSrtpSender.sendBatchBufferCount = 0U;
             xSemaphoreGive( pSession->audioSrtpSender.senderMutex );
         }
     }
@@ -542,8 +852,9 @@ PeerConnectionResult_t PeerConnectionSrtp_HandleSrtpPacket( PeerConnectionSessio
 {
     PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
     srtp_err_status_t errorStatus;
-    uint8_t rtpBuffer[ PEER_CONNECTION_SRTP_RTP_PACKET_MAX_LENGTH ];
-    size_t rtpBufferLength = PEER_CONNECTION_SRTP_RTP_PACKET_MAX_LENGTH;
+    uint8_t * pSlot = NULL;
+    size_t rtpBufferLength = PEER_CONNECTION_JITTER_BUFFER_SLOT_SIZE;
+    uint32_t ssrc;
     RtpResult_t resultRtp;
     RtpPacket_t rtpPacket;
     PeerConnectionJitterBufferPacket_t * pJitterBufferPacket = NULL;
@@ -555,22 +866,56 @@ PeerConnectionResult_t PeerConnectionSrtp_HandleSrtpPacket( PeerConnectionSessio
         LogError( ( "Invalid input, pSession: %p, pBuffer: %p", pSession, pBuffer ) );
         ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
     }
+    else if( bufferLength < PEER_CONNECTION_SRTP_RTP_FIXED_HEADER_LENGTH )
+    {
+        LogWarn( ( "Received SRTP packet shorter than RTP header, length: %u", bufferLength ) );
+        ret = PEER_CONNECTION_RESULT_FAIL_RTP_DESERIALIZE;
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        /* The RTP header isn't encrypted, pick the receiver before decrypting into its jitter buffer. */
+        ssrc = PEER_CONNECTION_SRTP_READ_UINT32( &pBuffer[ PEER_CONNECTION_SRTP_RTP_SSRC_OFFSET ] );
+        if( pSession->rtpConfig.remoteVideoSsrc == ssrc )
+        {
+            pSrtpReceiver = &pSession->videoSrtpReceiver;
+        }
+        else if( pSession->rtpConfig.remoteAudioSsrc == ssrc )
+        {
+            pSrtpReceiver = &pSession->audioSrtpReceiver;
+        }
+        else
+        {
+            LogWarn( ( "Received unknown SSRC: %lu RTP packet.", ssrc ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_RTP_RX_NO_MATCHING_SSRC;
+        }
+    }
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        if( xSemaphoreTake( pSession->srtpSessionMutex,
+        ret = PeerConnectionJitterBuffer_AcquireSlot( &pSrtpReceiver->rxJitterBuffer,
+                                                      &pSlot );
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        if( xSemaphoreTake( pSession->srtpReceiveSessionMutex,
                             portMAX_DELAY ) == pdTRUE )
         {
             isLocked = 1U;
         }
         else
         {
-            LogError( ( "Fail to take SRTP session mutex to construct SRTP packet." ) );
+            LogError( ( "Fail to take Rx SRTP session mutex to decrypt SRTP packet." ) );
             ret = PEER_CONNECTION_RESULT_FAIL_TAKE_SRTP_MUTEX;
         }
     }
 
-    /* Decrypt it by SRTP. */
+    /* Decrypt it by SRTP, straight into the jitter buffer slot. */
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
         if( pSession->srtpReceiveSession != NULL )
@@ -578,7 +923,7 @@ PeerConnectionResult_t PeerConnectionSrtp_HandleSrtpPacket( PeerConnectionSessio
             errorStatus = srtp_unprotect( pSession->srtpReceiveSession,
                                           pBuffer,
                                           bufferLength,
-                                          rtpBuffer,
+                                          pSlot,
                                           &rtpBufferLength );
             if( errorStatus != srtp_err_status_ok )
             {
@@ -599,14 +944,14 @@ PeerConnectionResult_t PeerConnectionSrtp_HandleSrtpPacket( PeerConnectionSessio
 
     if( isLocked != 0U )
     {
-        xSemaphoreGive( pSession->srtpSessionMutex );
+        xSemaphoreGive( pSession->srtpReceiveSessionMutex );
     }
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
         /* Deserialize RTP packet. */
         resultRtp = Rtp_DeSerialize( &pSession->pCtx->rtpContext,
-                                     rtpBuffer,
+                                     pSlot,
                                      rtpBufferLength,
                                      &rtpPacket );
         if( resultRtp != RTP_RESULT_OK )
@@ -618,34 +963,23 @@ PeerConnectionResult_t PeerConnectionSrtp_HandleSrtpPacket( PeerConnectionSessio
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        if( pSession->rtpConfig.remoteVideoSsrc == rtpPacket.header.ssrc )
-        {
-            pSrtpReceiver = &pSession->videoSrtpReceiver;
-        }
-        else if( pSession->rtpConfig.remoteAudioSsrc == rtpPacket.header.ssrc )
-        {
-            pSrtpReceiver = &pSession->audioSrtpReceiver;
-        }
-        else
-        {
-            LogWarn( ( "Received unknown SSRC: %lu RTP packet.", rtpPacket.header.ssrc ) );
-            ret = PEER_CONNECTION_RESULT_FAIL_RTP_RX_NO_MATCHING_SSRC;
-        }
-    }
-
-    if( ret == PEER_CONNECTION_RESULT_OK )
-    {
-        ret = PeerConnectionJitterBuffer_AllocateBuffer( &pSrtpReceiver->rxJitterBuffer,
-                                                         &pJitterBufferPacket,
-                                                         rtpPacket.payloadLength,
-                                                         rtpPacket.header.sequenceNumber );
+        /* The payload points into the slot, it's kept there without copying. */
+        ret = PeerConnectionJitterBuffer_SetPacket( &pSrtpReceiver->rxJitterBuffer,
+                                                    &pJitterBufferPacket,
+                                                    pSlot,
+                                                    ( size_t )( rtpPacket.pPayload - pSlot ),
+                                                    rtpPacket.payloadLength,
+                                                    rtpPacket.header.sequenceNumber );
     }
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        memcpy( pJitterBufferPacket->pPacketBuffer, rtpPacket.pPayload, rtpPacket.payloadLength );
+        /* The slot belongs to the jitter buffer now, Push() discards the packet if it's rejected. */
+        pSlot = NULL;
         pJitterBufferPacket->receiveTick = xTaskGetTickCount();
         pJitterBufferPacket->rtpTimestamp = rtpPacket.header.timestamp;
+        pJitterBufferPacket->payloadType = rtpPacket.header.payloadType;
+        pJitterBufferPacket->isMarker = ( ( rtpPacket.header.flags & RTP_HEADER_FLAG_MARKER ) != 0 ) ? 1U : 0U;
         pJitterBufferPacket->sequenceNumber = rtpPacket.header.sequenceNumber;
         // LogInfo( ( "Dumping RTP payload: %u, seq: %u, timestamp: %lu", rtpPacket.payloadLength, rtpPacket.header.sequenceNumber, rtpPacket.header.timestamp ) );
         // for( int i = 0; i < rtpPacket.payloadLength; i++ )
@@ -658,5 +992,11 @@ PeerConnectionResult_t PeerConnectionSrtp_HandleSrtpPacket( PeerConnectionSessio
                                                pJitterBufferPacket );
     }
 
+    if( pSlot != NULL )
+    {
+        PeerConnectionJitterBuffer_ReleaseSlot( &pSrtpReceiver->rxJitterBuffer,
+                                                pSlot );
+    }
+
     return ret;
 }
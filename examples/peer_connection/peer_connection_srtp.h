@@ -29,6 +29,17 @@ extern "C" {
 #include "peer_connection_data_types.h"
 
 #define PEER_CONNECTION_SRTP_RTP_PACKET_MAX_LENGTH      ( 1400 )
+#define PEER_CONNECTION_SRTP_SEND_BATCH_MAX_COUNT       ( 8 )
+
+/* Share of the media bytes sent that re-transmissions may use, so answering NACKs doesn't add much to the congestion causing the loss. */
+#ifndef PEER_CONNECTION_SRTP_RTX_BUDGET_PERCENT
+#define PEER_CONNECTION_SRTP_RTX_BUDGET_PERCENT ( 25 )
+#endif
+
+/* Unused re-transmission budget is capped, a new sender starts with the full budget. */
+#ifndef PEER_CONNECTION_SRTP_RTX_BUDGET_MAX_BYTES
+#define PEER_CONNECTION_SRTP_RTX_BUDGET_MAX_BYTES ( 32 * 1200 )
+#endif
 #define PEER_CONNECTION_SRTP_VIDEO_CLOCKRATE ( uint32_t ) 90000
 #define PEER_CONNECTION_SRTP_OPUS_CLOCKRATE  ( uint32_t ) 48000
 #define PEER_CONNECTION_SRTP_PCM_CLOCKRATE   ( uint32_t ) 8000
@@ -46,6 +57,34 @@ PeerConnectionResult_t PeerConnectionSrtp_ConstructSrtpPacket( PeerConnectionSes
                                                                RtpPacket_t * pPacketRtp,
                                                                uint8_t * pOutputSrtpPacket,
                                                                size_t * pOutputSrtpPacketLength );
+/* Build the RTP header template of a sender from the negotiated payload type, SSRC and TWCC extension ID. */
+void PeerConnectionSrtp_InitRtpHeaderTemplate( PeerConnectionRtpHeaderTemplate_t * pTemplate,
+                                               uint32_t payloadType,
+                                               uint32_t ssrc,
+                                               uint16_t twccId );
+/* Write the RTP header from the template into pBuffer and return its length. */
+size_t PeerConnectionSrtp_WriteRtpHeader( const PeerConnectionRtpHeaderTemplate_t * pTemplate,
+                                          uint8_t * pBuffer,
+                                          uint16_t sequenceNumber,
+                                          uint32_t timestamp,
+                                          uint8_t isMarker,
+                                          uint32_t twccExtensionPayload );
+/* Encrypt a serialized RTP packet. pOutputSrtpPacket can be pRtpPacket to encrypt in place. */
+PeerConnectionResult_t PeerConnectionSrtp_EncryptRtpPacket( PeerConnectionSession_t * pSession,
+                                                            uint8_t * pRtpPacket,
+                                                            size_t rtpPacketLength,
+                                                            uint8_t * pOutputSrtpPacket,
+                                                            size_t * pOutputSrtpPacketLength );
+/* Encrypting a batch of packets takes the Tx SRTP session once: call PeerConnectionSrtp_BeginEncryptBatch(),
+ * PeerConnectionSrtp_EncryptRtpPacketInBatch() for each packet, then PeerConnectionSrtp_EndEncryptBatch().
+ * The Rx SRTP session has its own lock, so decrypting incoming packets never waits for a batch. */
+PeerConnectionResult_t PeerConnectionSrtp_BeginEncryptBatch( PeerConnectionSession_t * pSession );
+PeerConnectionResult_t PeerConnectionSrtp_EncryptRtpPacketInBatch( PeerConnectionSession_t * pSession,
+                                                                   uint8_t * pRtpPacket,
+                                                                   size_t rtpPacketLength,
+                                                                   uint8_t * pOutputSrtpPacket,
+                                                                   size_t * pOutputSrtpPacketLength );
+void PeerConnectionSrtp_EndEncryptBatch( PeerConnectionSession_t * pSession );
 
 #ifdef __cplusplus
 }
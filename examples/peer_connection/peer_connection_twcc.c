@@ -0,0 +1,156 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include "logging.h"
+#include "peer_connection_twcc.h"
+#include "peer_connection_bwe.h"
+
+#include "task.h"
+
+#if ENABLE_TWCC_SUPPORT
+
+#define PEER_CONNECTION_TWCC_HISTORY_INDEX( seqNum ) ( ( seqNum ) & ( PEER_CONNECTION_TWCC_HISTORY_LENGTH - 1U ) )
+
+/* The RTCP library reports arrival times and TwccBandwidthInfo_t the duration in 100 ns units. */
+#define PEER_CONNECTION_TWCC_TIME_UNITS_PER_US ( 10U )
+
+#if ( PEER_CONNECTION_TWCC_HISTORY_LENGTH & ( PEER_CONNECTION_TWCC_HISTORY_LENGTH - 1 ) ) != 0
+    #error "PEER_CONNECTION_TWCC_HISTORY_LENGTH must be a power of two."
+#endif
+
+void PeerConnectionTwcc_Init( PeerConnectionTwccHistory_t * pHistory )
+{
+    if( pHistory == NULL )
+    {
+        LogError( ( "Invalid input, pHistory: %p", pHistory ) );
+    }
+    else
+    {
+        memset( pHistory,
+                0,
+                sizeof( PeerConnectionTwccHistory_t ) );
+    }
+}
+
+void PeerConnectionTwcc_AddPacket( PeerConnectionTwccHistory_t * pHistory,
+                                   uint16_t seqNum,
+                                   size_t packetSize,
+                                   uint64_t sentTimeUs )
+{
+    PeerConnectionTwccPacket_t * pPacket;
+
+    if( pHistory == NULL )
+    {
+        LogError( ( "Invalid input, pHistory: %p", pHistory ) );
+    }
+    else
+    {
+        /* Overwrite whatever was sent a history length ago, its feedback is long overdue.
+         * The audio and video Tx tasks add packets while the socket listener reads them,
+         * a critical section keeps the 64-bit send time from tearing. */
+        pPacket = &pHistory->packets[ PEER_CONNECTION_TWCC_HISTORY_INDEX( seqNum ) ];
+        taskENTER_CRITICAL();
+        pPacket->seqNum = seqNum;
+        pPacket->packetSize = ( uint16_t ) packetSize;
+        pPacket->sentTimeUs = sentTimeUs;
+        taskEXIT_CRITICAL();
+    }
+}
+
+PeerConnectionResult_t PeerConnectionTwcc_HandleFeedback( PeerConnectionTwccHistory_t * pHistory,
+                                                          const RtcpTwccPacket_t * pTwccPacket,
+                                                          PeerConnectionBwe_t * pBwe,
+                                                          TwccBandwidthInfo_t * pBandwidthInfo )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    PeerConnectionTwccPacket_t * pPacket;
+    PeerConnectionTwccPacket_t packet;
+    const PacketArrivalInfo_t * pArrivalInfo;
+    uint64_t firstSentTimeUs = 0;
+    uint64_t lastSentTimeUs = 0;
+    size_t i;
+
+    if( ( pHistory == NULL ) ||
+        ( pTwccPacket == NULL ) ||
+        ( pBandwidthInfo == NULL ) )
+    {
+        LogError( ( "Invalid input, pHistory: %p, pTwccPacket: %p, pBandwidthInfo: %p", pHistory, pTwccPacket, pBandwidthInfo ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        memset( pBandwidthInfo,
+                0,
+                sizeof( TwccBandwidthInfo_t ) );
+
+        for( i = 0; i < pTwccPacket->arrivalInfoListLength; i++ )
+        {
+            pArrivalInfo = &pTwccPacket->pArrivalInfoList[ i ];
+            pPacket = &pHistory->packets[ PEER_CONNECTION_TWCC_HISTORY_INDEX( pArrivalInfo->seqNum ) ];
+
+            /* Take the entry out of the history at once, so a Tx task can't change it half way. */
+            taskENTER_CRITICAL();
+            memcpy( &packet,
+                    pPacket,
+                    sizeof( PeerConnectionTwccPacket_t ) );
+            if( ( packet.sentTimeUs != 0U ) && ( packet.seqNum == pArrivalInfo->seqNum ) )
+            {
+                pPacket->sentTimeUs = 0U;
+            }
+            taskEXIT_CRITICAL();
+
+            if( ( packet.sentTimeUs == 0U ) || ( packet.seqNum != pArrivalInfo->seqNum ) )
+            {
+                /* Already reported, or overwritten by a newer packet. */
+                continue;
+            }
+
+            pBandwidthInfo->sentBytes += packet.packetSize;
+            pBandwidthInfo->sentPackets++;
+            if( pArrivalInfo->remoteArrivalTime != RTCP_TWCC_PACKET_LOST_TIME )
+            {
+                pBandwidthInfo->receivedBytes += packet.packetSize;
+                pBandwidthInfo->receivedPackets++;
+
+                if( pBwe != NULL )
+                {
+                    PeerConnectionBwe_OnPacketFeedback( pBwe,
+                                                        packet.sentTimeUs,
+                                                        pArrivalInfo->remoteArrivalTime / PEER_CONNECTION_TWCC_TIME_UNITS_PER_US,
+                                                        packet.packetSize );
+                }
+            }
+
+            if( ( firstSentTimeUs == 0U ) || ( packet.sentTimeUs < firstSentTimeUs ) )
+            {
+                firstSentTimeUs = packet.sentTimeUs;
+            }
+
+            if( packet.sentTimeUs > lastSentTimeUs )
+            {
+                lastSentTimeUs = packet.sentTimeUs;
+            }
+        }
+
+        pBandwidthInfo->duration = ( lastSentTimeUs - firstSentTimeUs ) * PEER_CONNECTION_TWCC_TIME_UNITS_PER_US;
+    }
+
+    return ret;
+}
+
+#endif /* ENABLE_TWCC_SUPPORT */
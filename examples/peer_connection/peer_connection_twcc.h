@@ -0,0 +1,55 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PEER_CONNECTION_TWCC_H
+#define PEER_CONNECTION_TWCC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Standard includes. */
+#include <stdint.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+
+#include "peer_connection_data_types.h"
+
+#if ENABLE_TWCC_SUPPORT
+
+void PeerConnectionTwcc_Init( PeerConnectionTwccHistory_t * pHistory );
+
+/* Record a packet sent with the transport-wide sequence number seqNum. */
+void PeerConnectionTwcc_AddPacket( PeerConnectionTwccHistory_t * pHistory,
+                                   uint16_t seqNum,
+                                   size_t packetSize,
+                                   uint64_t sentTimeUs );
+
+/* Match the packets reported by a TWCC feedback against the history and sum them up in pBandwidthInfo.
+ * Packets that fell out of the history or were reported before are skipped, received ones are fed to pBwe if given. */
+PeerConnectionResult_t PeerConnectionTwcc_HandleFeedback( PeerConnectionTwccHistory_t * pHistory,
+                                                          const RtcpTwccPacket_t * pTwccPacket,
+                                                          PeerConnectionBwe_t * pBwe,
+                                                          TwccBandwidthInfo_t * pBandwidthInfo );
+
+#endif /* ENABLE_TWCC_SUPPORT */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PEER_CONNECTION_TWCC_H */
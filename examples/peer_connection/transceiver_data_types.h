@@ -126,6 +126,7 @@ typedef struct Transceiver
     size_t trackIdLength;
     uint32_t ssrc;
     uint32_t rtxSsrc;
+    uint32_t fecSsrc;
 
     OnPcEventCallback_t onPcEventCallbackFunc;
     void * pOnPcEventCustomContext;
@@ -75,6 +75,10 @@
 #define SDP_CONTROLLER_MEDIA_ATTRIBUTE_VALUE_RTPMAP_H264_LENGTH ( 10 )
 #define SDP_CONTROLLER_MEDIA_ATTRIBUTE_VALUE_RTPMAP_RTX_H264 "rtx/90000"
 #define SDP_CONTROLLER_MEDIA_ATTRIBUTE_VALUE_RTPMAP_RTX_H264_LENGTH ( 9 )
+#define SDP_CONTROLLER_MEDIA_ATTRIBUTE_VALUE_RTPMAP_FLEXFEC "flexfec-03/90000"
+#define SDP_CONTROLLER_MEDIA_ATTRIBUTE_VALUE_FMTP_FLEXFEC "repair-window=10000000"
+#define SDP_CONTROLLER_MEDIA_ATTRIBUTE_VALUE_RTPMAP_RED_OPUS "red/48000/2"
+#define SDP_CONTROLLER_MEDIA_ATTRIBUTE_VALUE_RTPMAP_RED_PCM "red/8000"
 #define SDP_CONTROLLER_MEDIA_ATTRIBUTE_VALUE_RTPMAP_OPUS "opus/48000/2"
 #define SDP_CONTROLLER_MEDIA_ATTRIBUTE_VALUE_RTPMAP_OPUS_LENGTH ( 12 )
 #define SDP_CONTROLLER_MEDIA_ATTRIBUTE_VALUE_RTPMAP_VP8 "VP8/90000"
@@ -196,7 +200,8 @@ static SdpControllerResult_t PopulateTransceiverSsrc( char ** ppBuffer,
                                                       const Transceiver_t * pTransceiver,
                                                       const char * pCname,
                                                       size_t cnameLength,
-                                                      uint32_t containRtx );
+                                                      uint32_t containRtx,
+                                                      uint32_t containFec );
 static SdpControllerResult_t PopulateRtcpFb( uint32_t payload,
                                              uint16_t twccExtId,
                                              char ** ppBuffer,
@@ -244,6 +249,16 @@ static SdpControllerResult_t PopulateCodecAttributesH265( SdpControllerMediaDesc
                                                           char ** ppBuffer,
                                                           size_t * pBufferLength,
                                                           SdpControllerMediaDescription_t * pLocalMediaDescription );
+static SdpControllerResult_t PopulateFlexfecAttributes( uint32_t fecPayload,
+                                                        char ** ppBuffer,
+                                                        size_t * pBufferLength,
+                                                        SdpControllerMediaDescription_t * pLocalMediaDescription );
+static SdpControllerResult_t PopulateRedAttributes( uint32_t redPayload,
+                                                    uint32_t payload,
+                                                    const char * pRtpmapValue,
+                                                    char ** ppBuffer,
+                                                    size_t * pBufferLength,
+                                                    SdpControllerMediaDescription_t * pLocalMediaDescription );
 static SdpControllerResult_t PopulateCodecAttributes( SdpControllerMediaDescription_t * pRemoteMediaDescription,
                                                       SdpControllerPopulateMediaConfiguration_t populateConfiguration,
                                                       char ** ppBuffer,
@@ -675,7 +690,8 @@ static SdpControllerResult_t PopulateTransceiverSsrc( char ** ppBuffer,
                                                       const Transceiver_t * pTransceiver,
                                                       const char * pCname,
                                                       size_t cnameLength,
-                                                      uint32_t containRtx )
+                                                      uint32_t containRtx,
+                                                      uint32_t containFec )
 {
     SdpControllerResult_t ret = SDP_CONTROLLER_RESULT_OK;
     SdpControllerAttributes_t * pTargetAttribute = NULL;
@@ -956,6 +972,69 @@ static SdpControllerResult_t PopulateTransceiverSsrc( char ** ppBuffer,
         }
     }
 
+    /* For FlexFEC: cname */
+    if( ( ret == SDP_CONTROLLER_RESULT_OK ) && ( containFec != 0 ) )
+    {
+        pTargetAttribute = &pLocalMediaDescription->attributes[ *pTargetAttributeCount ];
+        pTargetAttribute->pAttributeName = SDP_CONTROLLER_MEDIA_ATTRIBUTE_NAME_SSRC;
+        pTargetAttribute->attributeNameLength = SDP_CONTROLLER_MEDIA_ATTRIBUTE_NAME_SSRC_LENGTH;
+
+        written = snprintf( pCurBuffer, remainSize, "%lu cname:%.*s",
+                            pTransceiver->fecSsrc,
+                            ( int ) cnameLength, pCname );
+        if( written < 0 )
+        {
+            ret = SDP_CONTROLLER_RESULT_SDP_FAIL_SNPRINTF;
+            LogError( ( "snprintf return unexpected value %d", written ) );
+        }
+        else if( written == remainSize )
+        {
+            ret = SDP_CONTROLLER_RESULT_SDP_POPULATE_BUFFER_TOO_SMALL;
+            LogError( ( "buffer has no space for FlexFEC SSRC CNAME" ) );
+        }
+        else
+        {
+            pTargetAttribute->pAttributeValue = pCurBuffer;
+            pTargetAttribute->attributeValueLength = strlen( pCurBuffer );
+            *pTargetAttributeCount += 1;
+
+            pCurBuffer += written;
+            remainSize -= written;
+        }
+    }
+
+    /* For FlexFEC: msid, the FEC stream belongs to the media track. */
+    if( ( ret == SDP_CONTROLLER_RESULT_OK ) && ( containFec != 0 ) )
+    {
+        pTargetAttribute = &pLocalMediaDescription->attributes[ *pTargetAttributeCount ];
+        pTargetAttribute->pAttributeName = SDP_CONTROLLER_MEDIA_ATTRIBUTE_NAME_SSRC;
+        pTargetAttribute->attributeNameLength = SDP_CONTROLLER_MEDIA_ATTRIBUTE_NAME_SSRC_LENGTH;
+
+        written = snprintf( pCurBuffer, remainSize, "%lu msid:%.*s %.*s",
+                            pTransceiver->fecSsrc,
+                            ( int ) pTransceiver->streamIdLength, pTransceiver->streamId,
+                            ( int ) pTransceiver->trackIdLength, pTransceiver->trackId );
+        if( written < 0 )
+        {
+            ret = SDP_CONTROLLER_RESULT_SDP_FAIL_SNPRINTF;
+            LogError( ( "snprintf return unexpected value %d", written ) );
+        }
+        else if( written == remainSize )
+        {
+            ret = SDP_CONTROLLER_RESULT_SDP_POPULATE_BUFFER_TOO_SMALL;
+            LogError( ( "buffer has no space for FlexFEC SSRC msid" ) );
+        }
+        else
+        {
+            pTargetAttribute->pAttributeValue = pCurBuffer;
+            pTargetAttribute->attributeValueLength = strlen( pCurBuffer );
+            *pTargetAttributeCount += 1;
+
+            pCurBuffer += written;
+            remainSize -= written;
+        }
+    }
+
     if( ret == SDP_CONTROLLER_RESULT_OK )
     {
         *ppBuffer = pCurBuffer;
@@ -1827,6 +1906,169 @@ static SdpControllerResult_t PopulateCodecAttributesH265( SdpControllerMediaDesc
     return ret;
 }
 
+static SdpControllerResult_t PopulateFlexfecAttributes( uint32_t fecPayload,
+                                                        char ** ppBuffer,
+                                                        size_t * pBufferLength,
+                                                        SdpControllerMediaDescription_t * pLocalMediaDescription )
+{
+    SdpControllerResult_t ret = SDP_CONTROLLER_RESULT_OK;
+    char * pCurBuffer = *ppBuffer;
+    size_t remainSize = *pBufferLength;
+    SdpControllerAttributes_t * pTargetAttribute = NULL;
+    uint8_t * pTargetAttributeCount = &pLocalMediaDescription->mediaAttributesCount;
+    int written = 0;
+
+    /* FlexFEC rtpmap */
+    pTargetAttribute = &pLocalMediaDescription->attributes[ *pTargetAttributeCount ];
+    pTargetAttribute->pAttributeName = SDP_CONTROLLER_MEDIA_ATTRIBUTE_NAME_RTPMAP;
+    pTargetAttribute->attributeNameLength = SDP_CONTROLLER_MEDIA_ATTRIBUTE_NAME_RTPMAP_LENGTH;
+
+    written = snprintf( pCurBuffer, remainSize, "%lu %s",
+                        fecPayload,
+                        SDP_CONTROLLER_MEDIA_ATTRIBUTE_VALUE_RTPMAP_FLEXFEC );
+    if( written < 0 )
+    {
+        ret = SDP_CONTROLLER_RESULT_SDP_FAIL_SNPRINTF;
+        LogError( ( "snprintf return unexpected value %d", written ) );
+    }
+    else if( written == remainSize )
+    {
+        ret = SDP_CONTROLLER_RESULT_SDP_POPULATE_BUFFER_TOO_SMALL;
+        LogError( ( "buffer has no space for rtpmap FlexFEC value" ) );
+    }
+    else
+    {
+        pTargetAttribute->pAttributeValue = pCurBuffer;
+        pTargetAttribute->attributeValueLength = strlen( pCurBuffer );
+        *pTargetAttributeCount += 1;
+
+        pCurBuffer += written;
+        remainSize -= written;
+    }
+
+    /* FlexFEC fmtp */
+    if( ret == SDP_CONTROLLER_RESULT_OK )
+    {
+        pTargetAttribute = &pLocalMediaDescription->attributes[ *pTargetAttributeCount ];
+        pTargetAttribute->pAttributeName = SDP_CONTROLLER_MEDIA_ATTRIBUTE_NAME_FMTP;
+        pTargetAttribute->attributeNameLength = SDP_CONTROLLER_MEDIA_ATTRIBUTE_NAME_FMTP_LENGTH;
+
+        written = snprintf( pCurBuffer, remainSize, "%lu %s",
+                            fecPayload,
+                            SDP_CONTROLLER_MEDIA_ATTRIBUTE_VALUE_FMTP_FLEXFEC );
+        if( written < 0 )
+        {
+            ret = SDP_CONTROLLER_RESULT_SDP_FAIL_SNPRINTF;
+            LogError( ( "snprintf return unexpected value %d", written ) );
+        }
+        else if( written == remainSize )
+        {
+            ret = SDP_CONTROLLER_RESULT_SDP_POPULATE_BUFFER_TOO_SMALL;
+            LogError( ( "buffer has no space for FlexFEC fmtp" ) );
+        }
+        else
+        {
+            pTargetAttribute->pAttributeValue = pCurBuffer;
+            pTargetAttribute->attributeValueLength = strlen( pCurBuffer );
+            *pTargetAttributeCount += 1;
+
+            pCurBuffer += written;
+            remainSize -= written;
+        }
+    }
+
+    if( ret == SDP_CONTROLLER_RESULT_OK )
+    {
+        *ppBuffer = pCurBuffer;
+        *pBufferLength = remainSize;
+    }
+
+    return ret;
+}
+
+static SdpControllerResult_t PopulateRedAttributes( uint32_t redPayload,
+                                                    uint32_t payload,
+                                                    const char * pRtpmapValue,
+                                                    char ** ppBuffer,
+                                                    size_t * pBufferLength,
+                                                    SdpControllerMediaDescription_t * pLocalMediaDescription )
+{
+    SdpControllerResult_t ret = SDP_CONTROLLER_RESULT_OK;
+    char * pCurBuffer = *ppBuffer;
+    size_t remainSize = *pBufferLength;
+    SdpControllerAttributes_t * pTargetAttribute = NULL;
+    uint8_t * pTargetAttributeCount = &pLocalMediaDescription->mediaAttributesCount;
+    int written = 0;
+
+    /* RED rtpmap */
+    pTargetAttribute = &pLocalMediaDescription->attributes[ *pTargetAttributeCount ];
+    pTargetAttribute->pAttributeName = SDP_CONTROLLER_MEDIA_ATTRIBUTE_NAME_RTPMAP;
+    pTargetAttribute->attributeNameLength = SDP_CONTROLLER_MEDIA_ATTRIBUTE_NAME_RTPMAP_LENGTH;
+
+    written = snprintf( pCurBuffer, remainSize, "%lu %s",
+                        redPayload,
+                        pRtpmapValue );
+    if( written < 0 )
+    {
+        ret = SDP_CONTROLLER_RESULT_SDP_FAIL_SNPRINTF;
+        LogError( ( "snprintf return unexpected value %d", written ) );
+    }
+    else if( written == remainSize )
+    {
+        ret = SDP_CONTROLLER_RESULT_SDP_POPULATE_BUFFER_TOO_SMALL;
+        LogError( ( "buffer has no space for rtpmap RED value" ) );
+    }
+    else
+    {
+        pTargetAttribute->pAttributeValue = pCurBuffer;
+        pTargetAttribute->attributeValueLength = strlen( pCurBuffer );
+        *pTargetAttributeCount += 1;
+
+        pCurBuffer += written;
+        remainSize -= written;
+    }
+
+    /* RED fmtp, every block is the media codec. */
+    if( ret == SDP_CONTROLLER_RESULT_OK )
+    {
+        pTargetAttribute = &pLocalMediaDescription->attributes[ *pTargetAttributeCount ];
+        pTargetAttribute->pAttributeName = SDP_CONTROLLER_MEDIA_ATTRIBUTE_NAME_FMTP;
+        pTargetAttribute->attributeNameLength = SDP_CONTROLLER_MEDIA_ATTRIBUTE_NAME_FMTP_LENGTH;
+
+        written = snprintf( pCurBuffer, remainSize, "%lu %lu/%lu",
+                            redPayload,
+                            payload,
+                            payload );
+        if( written < 0 )
+        {
+            ret = SDP_CONTROLLER_RESULT_SDP_FAIL_SNPRINTF;
+            LogError( ( "snprintf return unexpected value %d", written ) );
+        }
+        else if( written == remainSize )
+        {
+            ret = SDP_CONTROLLER_RESULT_SDP_POPULATE_BUFFER_TOO_SMALL;
+            LogError( ( "buffer has no space for RED fmtp" ) );
+        }
+        else
+        {
+            pTargetAttribute->pAttributeValue = pCurBuffer;
+            pTargetAttribute->attributeValueLength = strlen( pCurBuffer );
+            *pTargetAttributeCount += 1;
+
+            pCurBuffer += written;
+            remainSize -= written;
+        }
+    }
+
+    if( ret == SDP_CONTROLLER_RESULT_OK )
+    {
+        *ppBuffer = pCurBuffer;
+        *pBufferLength = remainSize;
+    }
+
+    return ret;
+}
+
 static SdpControllerResult_t PopulateCodecAttributes( SdpControllerMediaDescription_t * pRemoteMediaDescription,
                                                       SdpControllerPopulateMediaConfiguration_t populateConfiguration,
                                                       char ** ppBuffer,
@@ -1892,6 +2134,23 @@ static SdpControllerResult_t PopulateCodecAttributes( SdpControllerMediaDescript
         ret = PopulateRtcpFb( payload, populateConfiguration.twccExtId, ppBuffer, pBufferLength, pLocalMediaDescription );
     }
 
+    /* FlexFEC rtpmap and fmtp */
+    if( ( ret == SDP_CONTROLLER_RESULT_OK ) && ( populateConfiguration.fecPayloadType != 0 ) )
+    {
+        ret = PopulateFlexfecAttributes( populateConfiguration.fecPayloadType, ppBuffer, pBufferLength, pLocalMediaDescription );
+    }
+
+    /* RED rtpmap and fmtp, RED runs at the clock rate of the audio codec. */
+    if( ( ret == SDP_CONTROLLER_RESULT_OK ) && ( populateConfiguration.redPayloadType != 0 ) )
+    {
+        ret = PopulateRedAttributes( populateConfiguration.redPayloadType,
+                                     payload,
+                                     TRANSCEIVER_IS_CODEC_ENABLED( pTransceiver->codecBitMap, TRANSCEIVER_RTC_CODEC_OPUS_BIT ) ? SDP_CONTROLLER_MEDIA_ATTRIBUTE_VALUE_RTPMAP_RED_OPUS : SDP_CONTROLLER_MEDIA_ATTRIBUTE_VALUE_RTPMAP_RED_PCM,
+                                     ppBuffer,
+                                     pBufferLength,
+                                     pLocalMediaDescription );
+    }
+
     return ret;
 }
 
@@ -2691,14 +2950,24 @@ SdpControllerResult_t SdpController_PopulateSingleMedia( SdpControllerMediaDescr
             }
             case TRANSCEIVER_TRACK_KIND_AUDIO:
             {
-                if( populateConfiguration.rtxPayloadType == 0 )
+                /* The primary codec stays first, so the remote doesn't send RED: receiving only unwraps its primary block.
+                 * RED is still listed for the packets sent to the remote. */
+                if( ( populateConfiguration.redPayloadType == 0 ) && ( populateConfiguration.rtxPayloadType == 0 ) )
                 {
                     written = snprintf( pCurBuffer, remainSize, "audio 9 UDP/TLS/RTP/SAVPF %lu", populateConfiguration.payloadType );
                 }
-                else
+                else if( populateConfiguration.redPayloadType == 0 )
                 {
                     written = snprintf( pCurBuffer, remainSize, "audio 9 UDP/TLS/RTP/SAVPF %lu %lu", populateConfiguration.payloadType, populateConfiguration.rtxPayloadType );
                 }
+                else if( populateConfiguration.rtxPayloadType == 0 )
+                {
+                    written = snprintf( pCurBuffer, remainSize, "audio 9 UDP/TLS/RTP/SAVPF %lu %lu", populateConfiguration.payloadType, populateConfiguration.redPayloadType );
+                }
+                else
+                {
+                    written = snprintf( pCurBuffer, remainSize, "audio 9 UDP/TLS/RTP/SAVPF %lu %lu %lu", populateConfiguration.payloadType, populateConfiguration.redPayloadType, populateConfiguration.rtxPayloadType );
+                }
                 break;
             }
             case TRANSCEIVER_TRACK_KIND_DATA_CHANNEL:
@@ -2736,6 +3005,30 @@ SdpControllerResult_t SdpController_PopulateSingleMedia( SdpControllerMediaDescr
         }
     }
 
+    /* FlexFEC payload type follows the media payload types, the media name continues in place. */
+    if( ( ret == SDP_CONTROLLER_RESULT_OK ) && ( trackKind == TRANSCEIVER_TRACK_KIND_VIDEO ) && ( populateConfiguration.fecPayloadType != 0 ) )
+    {
+        written = snprintf( pCurBuffer, remainSize, " %lu", populateConfiguration.fecPayloadType );
+
+        if( written < 0 )
+        {
+            ret = SDP_CONTROLLER_RESULT_SDP_FAIL_SNPRINTF;
+            LogError( ( "snprintf return unexpected value %d", written ) );
+        }
+        else if( written == remainSize )
+        {
+            ret = SDP_CONTROLLER_RESULT_SDP_POPULATE_BUFFER_TOO_SMALL;
+            LogError( ( "buffer has no space for FlexFEC payload type in media name" ) );
+        }
+        else
+        {
+            pLocalMediaDescription->mediaNameLength += written;
+
+            pCurBuffer += written;
+            remainSize -= written;
+        }
+    }
+
     /* Set media title and connection information. */
     if( ret == SDP_CONTROLLER_RESULT_OK )
     {
@@ -2823,10 +3116,43 @@ SdpControllerResult_t SdpController_PopulateSingleMedia( SdpControllerMediaDescr
         }
     }
 
+    /* For FlexFEC: ssrc-group */
+    if( ( ret == SDP_CONTROLLER_RESULT_OK ) && ( trackKind == TRANSCEIVER_TRACK_KIND_VIDEO ) && ( populateConfiguration.fecPayloadType != 0 ) )
+    {
+        pTargetAttribute = &pLocalMediaDescription->attributes[ *pTargetAttributeCount ];
+        pTargetAttribute->pAttributeName = SDP_CONTROLLER_MEDIA_ATTRIBUTE_NAME_SSRC_GROUP;
+        pTargetAttribute->attributeNameLength = SDP_CONTROLLER_MEDIA_ATTRIBUTE_NAME_SSRC_GROUP_LENGTH;
+
+        written = snprintf( pCurBuffer, remainSize, "FEC-FR %lu %lu",
+                            populateConfiguration.pTransceiver->ssrc,
+                            populateConfiguration.pTransceiver->fecSsrc );
+
+        if( written < 0 )
+        {
+            ret = SDP_CONTROLLER_RESULT_SDP_FAIL_SNPRINTF;
+            LogError( ( "snprintf return unexpected value %d", written ) );
+        }
+        else if( written == remainSize )
+        {
+            ret = SDP_CONTROLLER_RESULT_SDP_POPULATE_BUFFER_TOO_SMALL;
+            LogError( ( "buffer has no space for FlexFEC ssrc-group" ) );
+        }
+        else
+        {
+            pTargetAttribute->pAttributeValue = pCurBuffer;
+            pTargetAttribute->attributeValueLength = strlen( pCurBuffer );
+            *pTargetAttributeCount += 1;
+
+            pCurBuffer += written;
+            remainSize -= written;
+        }
+    }
+
     /* ssrc */
     if( ( ret == SDP_CONTROLLER_RESULT_OK ) && ( trackKind != TRANSCEIVER_TRACK_KIND_DATA_CHANNEL ) )
     {
-        ret = PopulateTransceiverSsrc( &pCurBuffer, &remainSize, pLocalMediaDescription, populateConfiguration.pTransceiver, populateConfiguration.pCname, populateConfiguration.cnameLength, populateConfiguration.rtxPayloadType == 0 ? 0 : 1 );
+        ret = PopulateTransceiverSsrc( &pCurBuffer, &remainSize, pLocalMediaDescription, populateConfiguration.pTransceiver, populateConfiguration.pCname, populateConfiguration.cnameLength, populateConfiguration.rtxPayloadType == 0 ? 0 : 1,
+                                       ( ( trackKind == TRANSCEIVER_TRACK_KIND_VIDEO ) && ( populateConfiguration.fecPayloadType != 0 ) ) ? 1 : 0 );
     }
 
     /* rtcp, ice-ufrag, ice-pwd */
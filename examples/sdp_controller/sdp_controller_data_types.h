@@ -242,6 +242,8 @@ typedef struct SdpControllerPopulateMediaConfiguration
     const Transceiver_t * pTransceiver;
     uint32_t payloadType;
     uint32_t rtxPayloadType;
+    uint32_t fecPayloadType; /* FlexFEC payload type of video, 0 to disable. */
+    uint32_t redPayloadType; /* RED payload type of audio, 0 to disable. */
 
     /* Fingerprint. */
     const char * pLocalFingerprint;
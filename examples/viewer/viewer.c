@@ -141,7 +141,10 @@ static int32_t OnMediaSinkHook( void * pCustom,
                 break;
             }
 
-            if( pAppContext->appSessions[ i ].peerConnectionSession.state == PEER_CONNECTION_SESSION_STATE_CONNECTION_READY )
+            if( ( pAppContext->appSessions[ i ].peerConnectionSession.state == PEER_CONNECTION_SESSION_STATE_CONNECTION_READY ) &&
+                ( ( pFrame->trackKind != TRANSCEIVER_TRACK_KIND_VIDEO ) ||
+                  ( AppCommon_IsVideoFrameForSession( &pAppContext->appSessions[ i ],
+                                                      pFrame ) != 0U ) ) )
             {
                 peerConnectionResult = PeerConnection_WriteFrame( &pAppContext->appSessions[ i ].peerConnectionSession,
                                                                   pTransceiver,